@@ -1,14 +1,30 @@
 # debug output, no USB, just prints to serial
 set(PROJECT_DEBUG ${PROJECT}-debug)
 add_executable(${PROJECT_DEBUG}
+  src/boot-time.c
+  src/capture.c
+  src/cec-dispatch.c
+  src/cec-filter.c
+  src/cec-stats.c
+  src/cec-timing.c
+  src/cec-topology.c
+  src/cec-transaction.c
+  src/crashlog.c
+  src/edid.c
   src/freertos_hook.c
   src/hdmi-cec.c
   src/hdmi-ddc.c
-  src/debug.c)
+  src/key-ring.c
+  src/debug.c
+  src/recovery.c
+  src/wakeups.c)
 
 target_include_directories(${PROJECT_DEBUG} PRIVATE
   ${PROJECT_SOURCE_DIR}/include)
 
+target_compile_definitions(${PROJECT_DEBUG} PRIVATE
+  ${CEC_PIN_DEFINITIONS})
+
 target_link_libraries(${PROJECT_DEBUG}
   pico_stdlib
   pico_unique_id
@@ -20,3 +36,25 @@ pico_set_binary_type(${PROJECT_DEBUG} copy_to_ram)
 
 # enable stdio
 pico_enable_stdio_usb(${PROJECT_DEBUG} 1)
+
+if(Python3_Interpreter_FOUND)
+  add_custom_target(memory-report-debug
+    COMMAND ${Python3_EXECUTABLE} ${PROJECT_SOURCE_DIR}/scripts/memory-report.py
+      --map $<TARGET_FILE:${PROJECT_DEBUG}>.map
+      --elf $<TARGET_FILE:${PROJECT_DEBUG}>
+      --nm ${CMAKE_NM}
+      ${MEMORY_BUDGETS}
+    DEPENDS ${PROJECT_DEBUG}
+    VERBATIM)
+endif()
+
+if(HAVE_CALLGRAPH_INFO AND Python3_Interpreter_FOUND)
+  add_custom_target(stack-report-debug ${STACK_CHECK_ALL}
+    COMMAND ${Python3_EXECUTABLE} ${PROJECT_SOURCE_DIR}/scripts/stack-report.py
+      --ci ${CMAKE_CURRENT_BINARY_DIR}/CMakeFiles/${PROJECT_DEBUG}.dir
+      --tasks ${PROJECT_SOURCE_DIR}/src/debug.c
+      --tasks ${PROJECT_SOURCE_DIR}/src/hdmi-ddc.c
+      ${STACK_REPORT_ARGS}
+    DEPENDS ${PROJECT_DEBUG}
+    VERBATIM)
+endif()
@@ -0,0 +1,374 @@
+#include <errno.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#ifdef HAVE_LIBUSB
+#include <libusb.h>
+#endif
+
+#include "capture.h"
+
+/* Reference reader for the bus capture stream.
+ *
+ * Reads the vendor bulk interface with libusb, or a raw stream saved earlier,
+ * and prints one line per record.  The loopback mode runs the firmware capture
+ * ring itself, draining it as the USB task would, and checks that every record
+ * produced is either decoded or accounted for by an overrun record.
+ */
+
+#define LOOPBACK_DRAIN (64)
+
+static FILE *out;
+static FILE *raw;
+static volatile sig_atomic_t stop;
+
+/* Totals from the decoded stream. */
+static unsigned long records;
+static unsigned long overrun_records;
+static unsigned long lost;
+
+static void print_record(const capture_record_t *record, const uint8_t *payload) {
+  records++;
+
+  switch (record->type) {
+    case CAPTURE_FRAME:
+      if (out != NULL) {
+        // frames and edges from any bus but the first are tagged with its index
+        fprintf(out, "%10lu %s%.0u ", (unsigned long)record->time_us,
+                (record->flags & CAPTURE_FLAG_TX) ? "tx" : "rx", record->bus);
+        for (uint8_t i = 0; i < record->len; i++) {
+          fprintf(out, (i == 0) ? "%02x" : ":%02x", payload[i]);
+        }
+        fprintf(out, "%s%s\n", (record->flags & CAPTURE_FLAG_ACK) ? " ack" : "",
+                (record->flags & CAPTURE_FLAG_ERROR) ? " error" : "");
+      }
+      break;
+    case CAPTURE_EDGE:
+      if (out != NULL) {
+        fprintf(out, "%10lu edge%.0u %s\n", (unsigned long)record->time_us, record->bus,
+                (record->flags & CAPTURE_FLAG_HIGH) ? "high" : "low");
+      }
+      break;
+    case CAPTURE_OVERRUN: {
+      uint32_t count = 0;
+      memcpy(&count, payload, (record->len < sizeof(count)) ? record->len : sizeof(count));
+      lost += count;
+      overrun_records++;
+      if (out != NULL) {
+        fprintf(out, "%10lu overrun %lu\n", (unsigned long)record->time_us, (unsigned long)count);
+      }
+    } break;
+    default:
+      if (out != NULL) {
+        fprintf(out, "%10lu unknown %u\n", (unsigned long)record->time_us, record->type);
+      }
+  }
+}
+
+/**
+ * Decode a chunk of the stream, records may straddle chunks.
+ */
+static void decode(const uint8_t *data, size_t len) {
+  static uint8_t partial[sizeof(capture_record_t) + 255];
+  static size_t partial_len;
+
+  if (raw != NULL) {
+    fwrite(data, 1, len, raw);
+  }
+
+  while (len > 0) {
+    size_t need = sizeof(capture_record_t);
+    if (partial_len >= need) {
+      need += ((const capture_record_t *)partial)->len;
+    }
+
+    size_t n = need - partial_len;
+    if (n > len) {
+      n = len;
+    }
+    memcpy(&partial[partial_len], data, n);
+    partial_len += n;
+    data += n;
+    len -= n;
+
+    if (partial_len < sizeof(capture_record_t)) {
+      continue;
+    }
+    const capture_record_t *record = (const capture_record_t *)partial;
+    if (partial_len == sizeof(capture_record_t) + record->len) {
+      print_record(record, &partial[sizeof(capture_record_t)]);
+      partial_len = 0;
+    }
+  }
+}
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static int read_file(const char *path) {
+  FILE *f = (strcmp(path, "-") == 0) ? stdin : fopen(path, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return 1;
+  }
+
+  uint8_t buffer[CAPTURE_BUF_SIZE];
+  size_t n;
+  while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+    decode(buffer, n);
+  }
+  if (f != stdin) {
+    fclose(f);
+  }
+
+  return 0;
+}
+
+static void loopback_kick(bool in_isr) {
+  // collected on the next drain, as if the USB task was slow to run
+}
+
+/**
+ * Complete the transfer in flight and start the next, as the USB task does
+ * when the host collects a transfer.
+ */
+static void loopback_drain(void) {
+  static uint8_t *in_flight;
+  static uint16_t in_flight_len;
+
+  if (in_flight != NULL) {
+    decode(in_flight, in_flight_len);
+    capture_release();
+  }
+  in_flight = capture_take(&in_flight_len);
+}
+
+static int loopback(unsigned long count, unsigned long drain, bool edges) {
+  capture_set_kick(loopback_kick);
+  capture_set_mode(edges ? CAPTURE_MODE_EDGES : CAPTURE_MODE_FRAMES);
+
+  uint64_t start = now_ns();
+  uint32_t time_us = 0;
+  for (unsigned long i = 0; i < count; i++) {
+    // a user control press from the TV, or the edges of a start bit
+    uint8_t pld[] = {0x04, 0x44, (uint8_t)(i & 0x7f)};
+    time_us += 2400;
+    if (edges && (i & 1)) {
+      capture_edge(0, time_us, (i & 2) != 0);
+    } else {
+      capture_frame(0, time_us, pld, sizeof(pld), CAPTURE_FLAG_ACK);
+    }
+
+    // the host collects a transfer after every drain records
+    if (((i + 1) % drain) == 0) {
+      loopback_drain();
+    }
+  }
+  loopback_drain();
+  loopback_drain();
+  loopback_drain();
+  uint64_t elapsed = now_ns() - start;
+
+  unsigned long decoded = records - overrun_records;
+  fprintf(stderr,
+          "loopback: %lu records, %lu decoded, %lu lost, %lu flow waits, %lu transfers, "
+          "%lu bytes, %llu ns per record\n",
+          count, decoded, (unsigned long)capture_stats.overruns,
+          (unsigned long)capture_stats.flow_waits,
+          (unsigned long)capture_stats.transfers, (unsigned long)capture_stats.bytes,
+          (unsigned long long)(elapsed / count));
+
+  // every record is either decoded or counted as an overrun, the last of which are
+  // only reported in front of a record that is never made
+  if ((decoded + capture_stats.overruns != count) || (lost > capture_stats.overruns)) {
+    fprintf(stderr, "loopback: stream does not account for every record\n");
+    return 1;
+  }
+
+  return 0;
+}
+
+#ifdef HAVE_LIBUSB
+static int read_device(bool edges) {
+  libusb_context *ctx = NULL;
+  libusb_device **list;
+  libusb_device_handle *handle = NULL;
+  int itf = -1;
+  uint8_t ep_in = 0;
+  uint8_t ep_out = 0;
+
+  if (libusb_init(&ctx) != 0) {
+    fprintf(stderr, "libusb init failed\n");
+    return 1;
+  }
+
+  // the first pico-cec with a vendor interface
+  ssize_t n = libusb_get_device_list(ctx, &list);
+  for (ssize_t i = 0; (i < n) && (handle == NULL); i++) {
+    struct libusb_device_descriptor desc;
+    struct libusb_config_descriptor *config;
+    if ((libusb_get_device_descriptor(list[i], &desc) != 0) || (desc.idVendor != CAPTURE_VID)
+        || (libusb_get_active_config_descriptor(list[i], &config) != 0)) {
+      continue;
+    }
+
+    for (uint8_t j = 0; (j < config->bNumInterfaces) && (itf < 0); j++) {
+      const struct libusb_interface_descriptor *alt = &config->interface[j].altsetting[0];
+      if ((alt->bInterfaceClass != LIBUSB_CLASS_VENDOR_SPEC) || (alt->bNumEndpoints != 2)) {
+        continue;
+      }
+      itf = alt->bInterfaceNumber;
+      for (uint8_t k = 0; k < 2; k++) {
+        uint8_t addr = alt->endpoint[k].bEndpointAddress;
+        if (addr & LIBUSB_ENDPOINT_IN) {
+          ep_in = addr;
+        } else {
+          ep_out = addr;
+        }
+      }
+    }
+    libusb_free_config_descriptor(config);
+    if ((itf >= 0) && (libusb_open(list[i], &handle) != 0)) {
+      handle = NULL;
+      itf = -1;
+    }
+  }
+  libusb_free_device_list(list, 1);
+
+  if ((handle == NULL) || (libusb_claim_interface(handle, itf) != 0)) {
+    fprintf(stderr, "no pico-cec capture interface found\n");
+    if (handle != NULL) {
+      libusb_close(handle);
+    }
+    libusb_exit(ctx);
+    return 1;
+  }
+
+  int transferred;
+  uint8_t mode = edges ? CAPTURE_MODE_EDGES : CAPTURE_MODE_FRAMES;
+  libusb_bulk_transfer(handle, ep_out, &mode, 1, &transferred, 1000);
+
+  uint8_t buffer[CAPTURE_BUF_SIZE];
+  uint64_t start = now_ns();
+  unsigned long bytes = 0;
+  while (!stop) {
+    int r = libusb_bulk_transfer(handle, ep_in, buffer, sizeof(buffer), &transferred, 200);
+    if ((r != 0) && (r != LIBUSB_ERROR_TIMEOUT)) {
+      fprintf(stderr, "read failed: %s\n", libusb_error_name(r));
+      break;
+    }
+    decode(buffer, transferred);
+    bytes += transferred;
+    if (out != NULL) {
+      fflush(out);
+    }
+  }
+  uint64_t elapsed = now_ns() - start;
+
+  mode = CAPTURE_MODE_OFF;
+  libusb_bulk_transfer(handle, ep_out, &mode, 1, &transferred, 1000);
+  libusb_release_interface(handle, itf);
+  libusb_close(handle);
+  libusb_exit(ctx);
+
+  fprintf(stderr, "%lu records, %lu lost, %lu bytes in %llu ms\n", records, lost, bytes,
+          (unsigned long long)(elapsed / 1000000));
+
+  return 0;
+}
+#endif
+
+static void on_signal(int sig) {
+  stop = 1;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-e] [-q] [-w <raw>] [-f <raw> | -l <records> [-d <drain>]]\n"
+          "  -e  capture line edges as well as frames\n"
+          "  -q  count records without printing them\n"
+          "  -w  also save the raw stream to a file\n"
+          "  -f  decode a saved raw stream, - for stdin, instead of the device\n"
+          "  -l  loopback this many records through the firmware capture ring\n"
+          "  -d  loopback records produced per transfer collected, default %u\n",
+          name, LOOPBACK_DRAIN);
+}
+
+int main(int argc, char **argv) {
+  const char *file = NULL;
+  const char *save = NULL;
+  unsigned long count = 0;
+  unsigned long drain = LOOPBACK_DRAIN;
+  bool edges = false;
+  bool quiet = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "eqw:f:l:d:")) != -1) {
+    switch (opt) {
+      case 'e':
+        edges = true;
+        break;
+      case 'q':
+        quiet = true;
+        break;
+      case 'w':
+        save = optarg;
+        break;
+      case 'f':
+        file = optarg;
+        break;
+      case 'l':
+        count = strtoul(optarg, NULL, 10);
+        break;
+      case 'd':
+        drain = strtoul(optarg, NULL, 10);
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+  if ((optind != argc) || (drain == 0)) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  out = quiet ? NULL : stdout;
+  if (save != NULL) {
+    raw = fopen(save, "wb");
+    if (raw == NULL) {
+      fprintf(stderr, "%s: %s\n", save, strerror(errno));
+      return 1;
+    }
+  }
+  signal(SIGINT, on_signal);
+
+  int r;
+  if (count > 0) {
+    r = loopback(count, drain, edges);
+  } else if (file != NULL) {
+    r = read_file(file);
+    fprintf(stderr, "%lu records, %lu lost\n", records, lost);
+  } else {
+#ifdef HAVE_LIBUSB
+    r = read_device(edges);
+#else
+    fprintf(stderr, "built without libusb, use -f or -l\n");
+    r = 2;
+#endif
+  }
+
+  if (raw != NULL) {
+    fclose(raw);
+  }
+
+  return r;
+}
@@ -0,0 +1,829 @@
+#include <stdarg.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cec-dispatch.h"
+#include "cec-filter.h"
+
+/* Compliance checks for the protocol logic, after the Linux cec-compliance tool.
+ *
+ * The firmware's dispatch runs against a simulated bus holding a TV, an audio
+ * system and, where a test asks for one, a second playback device.  Each test
+ * sends the device under test a frame from one of them and checks the frames
+ * it transmits in reply: the right replies to the right destination, Feature
+ * Abort only where the spec calls for one, broadcasts and frames for other
+ * devices left alone, and logical addresses taken around the ones already in
+ * use.  Replies the spec requires must start within the response time limit.
+ * The receive filter tests first pass each frame through the filter decisions
+ * the edge interrupt takes, block by block, and drop it as the firmware would.
+ *
+ * Time is virtual.  Frames take their nominal time on the wire, each waits
+ * for the signal free time, and the CPU time of the dispatch is added, scaled
+ * by -c for a slower processor.  Response times run from the end of the
+ * request to the start of the reply.
+ *
+ * Known deviations, workarounds for particular devices and features not yet
+ * implemented, are noted against their tests and reported without failing the
+ * run.  One that starts passing fails the run until it is taken off the list.
+ */
+
+#define US (0x10)  // stands for the address the device under test took
+#define END (-1)   // ends operand lists
+
+/* Logical addresses of the simulated devices. */
+#define TV (0x0)
+#define AUDIO (0x5)
+#define PLAYBACK_1 (0x4)
+#define PLAYBACK_2 (0x8)
+#define PLAYBACK_3 (0xb)
+#define BROADCAST (0xf)
+
+#define PHYSICAL_ADDRESS (0x1000)  // read from the sink by the device under test
+#define OTHER_PATH (0x3000)        // another source's physical address
+
+/* Nominal bit timing, and signal free times in bit periods. */
+#define START_BIT_US (4500)
+#define BIT_US (2400)
+#define FREE_NEW_INITIATOR (5)
+#define FREE_NEXT_FRAME (7)
+
+/* Required maximum response time. */
+#define RESPONSE_LIMIT_MS (200)
+
+#define MAX_SENT (32)
+
+/* Opcodes the protocol header does not name. */
+#define RECORD_OFF (0x0b)
+
+typedef struct {
+  uint8_t pld[16];
+  uint8_t len;
+  bool ack;
+  uint64_t start_us;
+} frame_t;
+
+typedef struct {
+  const char *group;
+  const char *name;
+  void (*run)(void);
+  const char *known;  // why a deviation is kept, NULL if the test should pass
+} test_t;
+
+/* Simulated bus. */
+static struct {
+  uint16_t followers;  // logical addresses held by the simulated devices
+  uint64_t now_us;
+  uint64_t idle_us;  // end of the last frame
+  uint8_t last_initiator;
+  uint64_t mark_ns;  // real time the dispatch was last entered or returned to
+
+  uint64_t request_end_us;
+  bool untimed;  // no request yet, frames sent are not responses
+  frame_t sent[MAX_SENT];
+  unsigned int num_sent;
+  unsigned int checked;  // frames sent before this were matched by expect()
+
+  int key;  // last user control code passed on, -1 for none
+  unsigned int keys;
+
+  bool filter;   // frames pass the receive filter first
+  bool dropped;  // the last frame received was dropped by it
+} bus;
+
+static cec_dispatch_t dut;
+static cec_filter_t filter;
+static double cpu_scale = 1.0;
+static uint32_t limit_ms = RESPONSE_LIMIT_MS;
+static bool verbose;
+
+/* Result of the running test. */
+static bool failed;
+static char reason[256];
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void fail(const char *fmt, ...) {
+  va_list ap;
+
+  // keep the first reason, later ones tend to follow from it
+  if (!failed) {
+    va_start(ap, fmt);
+    vsnprintf(reason, sizeof(reason), fmt, ap);
+    va_end(ap);
+  }
+  failed = true;
+}
+
+static void format_frame(char *buf, size_t size, const uint8_t *pld, uint8_t len) {
+  int n = 0;
+
+  buf[0] = '\0';
+  for (uint8_t i = 0; (i < len) && (n < (int)size); i++) {
+    n += snprintf(&buf[n], size - n, (i == 0) ? "%02x" : ":%02x", pld[i]);
+  }
+}
+
+/**
+ * Put a frame on the bus after the signal free time, returning its start.
+ */
+static uint64_t wire(uint8_t initiator, uint8_t len) {
+  unsigned int free_bits =
+      (initiator == bus.last_initiator) ? FREE_NEXT_FRAME : FREE_NEW_INITIATOR;
+  uint64_t start = bus.idle_us + free_bits * BIT_US;
+
+  if (start < bus.now_us) {
+    start = bus.now_us;
+  }
+  bus.now_us = start + START_BIT_US + len * 10 * BIT_US;
+  bus.idle_us = bus.now_us;
+  bus.last_initiator = initiator;
+
+  return start;
+}
+
+/**
+ * Charge the CPU time spent in the dispatch since the last mark to the clock.
+ */
+static void charge_cpu(void) {
+  uint64_t ns = now_ns();
+
+  bus.now_us += (uint64_t)((ns - bus.mark_ns) * cpu_scale / 1000);
+  bus.mark_ns = ns;
+}
+
+static bool send(void *arg, uint8_t *pld, uint8_t len) {
+  uint8_t destination = pld[0] & 0x0f;
+  // broadcasts count as acknowledged, none of the followers rejects them
+  bool ack = (destination == BROADCAST) || (bus.followers & (1 << destination));
+
+  charge_cpu();
+  if (bus.num_sent < MAX_SENT) {
+    frame_t *frame = &bus.sent[bus.num_sent++];
+    memcpy(frame->pld, pld, len);
+    frame->len = len;
+    frame->ack = ack;
+    frame->start_us = wire(pld[0] >> 4, len);
+  } else {
+    fail("more than %d frames sent", MAX_SENT);
+  }
+  bus.mark_ns = now_ns();
+
+  return ack;
+}
+
+static void user_control(void *arg, uint8_t code, bool pressed) {
+  if (pressed) {
+    bus.key = code;
+    bus.keys++;
+  }
+}
+
+static uint16_t physical_address(void *arg) {
+  return PHYSICAL_ADDRESS;
+}
+
+static const cec_dispatch_ops_t ops = {
+    .send = send,
+    .user_control = user_control,
+    .physical_address = physical_address,
+};
+
+/**
+ * Start a test with the device under test joining a bus of these followers.
+ */
+static void start(uint16_t followers) {
+  memset(&bus, 0, sizeof(bus));
+  bus.followers = followers;
+  bus.key = -1;
+  bus.last_initiator = BROADCAST;
+  bus.untimed = true;
+
+  cec_dispatch_init(&dut, &ops, NULL);
+  bus.mark_ns = now_ns();
+  cec_dispatch_announce(&dut);
+  charge_cpu();
+}
+
+/**
+ * Forget the frames sent so far, so expectations only see what follows.
+ */
+static void settle(void) {
+  bus.checked = bus.num_sent;
+}
+
+/**
+ * Receive a frame from a simulated device, opcode and operands as ints
+ * terminated by END.  A destination of US is the device under test.
+ */
+static void receive(uint8_t initiator, int destination, ...) {
+  uint8_t pld[16];
+  uint8_t len = 0;
+  va_list ap;
+
+  pld[len++] = (initiator << 4) | ((destination == US) ? dut.laddr : destination);
+  va_start(ap, destination);
+  for (int byte = va_arg(ap, int); (byte != END) && (len < 16); byte = va_arg(ap, int)) {
+    pld[len++] = byte;
+  }
+  va_end(ap);
+
+  bus.dropped = false;
+  for (uint8_t n = 1; bus.filter && (n <= 2) && (n <= len) && !bus.dropped; n++) {
+    bus.dropped = cec_filter_check(&filter, pld, n, n == len, 1 << dut.laddr) != CEC_FILTER_KEEP;
+  }
+
+  settle();
+  wire(initiator, len);
+  bus.request_end_us = bus.now_us;
+  bus.untimed = false;
+  if (!bus.dropped) {
+    bus.mark_ns = now_ns();
+    cec_dispatch_frame(&dut, pld, len);
+    charge_cpu();
+  }
+
+  if (verbose) {
+    char text[64];
+    format_frame(text, sizeof(text), pld, len);
+    printf("\t\t--> %s%s\n", text, bus.dropped ? " dropped" : "");
+    for (unsigned int i = bus.checked; i < bus.num_sent; i++) {
+      format_frame(text, sizeof(text), bus.sent[i].pld, bus.sent[i].len);
+      printf("\t\t<-- %s %s, %llu ms\n", text, bus.sent[i].ack ? "ack" : "nack",
+             (unsigned long long)((bus.sent[i].start_us - bus.request_end_us) / 1000));
+    }
+  }
+}
+
+static bool matches(const frame_t *frame, int destination, const int *expected, int n) {
+  if ((frame->pld[0] != ((dut.laddr << 4) | destination)) || (frame->len < n + 1)) {
+    return false;
+  }
+  for (int i = 0; i < n; i++) {
+    if (frame->pld[i + 1] != expected[i]) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Check the device under test sent a frame to destination since the request,
+ * starting with the given opcode and operands (END terminated), within the
+ * response time limit.
+ */
+static void expect(int destination, ...) {
+  int expected[16];
+  int n = 0;
+  va_list ap;
+
+  va_start(ap, destination);
+  for (int byte = va_arg(ap, int); (byte != END) && (n < 16); byte = va_arg(ap, int)) {
+    expected[n++] = byte;
+  }
+  va_end(ap);
+
+  for (unsigned int i = bus.checked; i < bus.num_sent; i++) {
+    const frame_t *frame = &bus.sent[i];
+    if (matches(frame, destination, expected, n)) {
+      uint64_t ms = (frame->start_us - bus.request_end_us) / 1000;
+      if (!bus.untimed && (ms > limit_ms)) {
+        fail("%s after %llu ms, limit %lu ms", cec_message(expected[0]), (unsigned long long)ms,
+             (unsigned long)limit_ms);
+      }
+      return;
+    }
+  }
+
+  const char *name = cec_message(expected[0]);
+  if (name != NULL) {
+    fail("no %s to %x", name, destination);
+  } else {
+    fail("no opcode %02x to %x", expected[0], destination);
+  }
+}
+
+/**
+ * Check a Feature Abort of opcode went back to the initiator with the reason.
+ */
+static void expect_abort(uint8_t initiator, uint8_t opcode, uint8_t abort_reason) {
+  expect(initiator, CEC_ID_FEATURE_ABORT, opcode, abort_reason, END);
+}
+
+/**
+ * Check nothing was sent since the request.
+ */
+static void expect_none(void) {
+  if (bus.num_sent > bus.checked) {
+    char text[64];
+    format_frame(text, sizeof(text), bus.sent[bus.checked].pld, bus.sent[bus.checked].len);
+    fail("unexpected reply %s", text);
+  }
+}
+
+/**
+ * Check no frame with the opcode was sent since the request.
+ */
+static void expect_no(uint8_t opcode) {
+  for (unsigned int i = bus.checked; i < bus.num_sent; i++) {
+    if ((bus.sent[i].len > 1) && (bus.sent[i].pld[1] == opcode)) {
+      char text[64];
+      format_frame(text, sizeof(text), bus.sent[i].pld, bus.sent[i].len);
+      fail("unexpected %s %s", cec_message(opcode), text);
+      return;
+    }
+  }
+}
+
+/**
+ * Check whether the receive filter dropped the last frame.
+ */
+static void expect_dropped(bool dropped) {
+  if (bus.dropped != dropped) {
+    fail(dropped ? "passed by the receive filter" : "dropped by the receive filter");
+  }
+}
+
+static void expect_address(uint8_t laddr) {
+  if (dut.laddr != laddr) {
+    fail("took logical address %x, expected %x", dut.laddr, laddr);
+  }
+}
+
+/**
+ * Check the reported power status, asking as the TV.
+ */
+static void expect_power(uint8_t status) {
+  receive(TV, US, CEC_ID_GIVE_DEVICE_POWER_STATUS, END);
+  expect(TV, CEC_ID_REPORT_POWER_STATUS, status, END);
+}
+
+#define FOLLOWERS_TV_AUDIO ((1 << TV) | (1 << AUDIO))
+
+/* Address allocation. */
+
+static void allocate_first(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  expect_address(PLAYBACK_1);
+  expect(BROADCAST, CEC_ID_REPORT_PHYSICAL_ADDRESS, PHYSICAL_ADDRESS >> 8,
+         PHYSICAL_ADDRESS & 0xff, 0x04, END);
+  if (CEC_VERSION >= CEC_VERSION_2_0) {
+    expect(BROADCAST, CEC_ID_REPORT_FEATURES, CEC_VERSION, END);
+  }
+}
+
+static void allocate_collision(void) {
+  start(FOLLOWERS_TV_AUDIO | (1 << PLAYBACK_1));
+  expect_address(PLAYBACK_2);
+  expect(BROADCAST, CEC_ID_REPORT_PHYSICAL_ADDRESS, END);
+}
+
+static void allocate_full(void) {
+  start(FOLLOWERS_TV_AUDIO | (1 << PLAYBACK_1) | (1 << PLAYBACK_2) | (1 << PLAYBACK_3));
+  expect_address(BROADCAST);
+}
+
+static void reallocate_keeps_address(void) {
+  start(FOLLOWERS_TV_AUDIO | (1 << PLAYBACK_1));
+  receive(TV, BROADCAST, CEC_ID_REPORT_PHYSICAL_ADDRESS, 0x00, 0x00, 0x00, END);
+  expect_address(PLAYBACK_2);
+}
+
+/* Replies to directed queries. */
+
+static void give_physical_address(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GIVE_PHYSICAL_ADDRESS, END);
+  expect(BROADCAST, CEC_ID_REPORT_PHYSICAL_ADDRESS, PHYSICAL_ADDRESS >> 8, PHYSICAL_ADDRESS & 0xff,
+         0x04, END);
+}
+
+static void give_osd_name(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GIVE_OSD_NAME, END);
+  expect(TV, CEC_ID_SET_OSD_NAME, END);
+}
+
+static void give_device_vendor_id(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GIVE_DEVICE_VENDOR_ID, END);
+  expect(BROADCAST, CEC_ID_DEVICE_VENDOR_ID, END);
+}
+
+static void get_cec_version(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GET_CEC_VERSION, END);
+  expect(TV, CEC_ID_CEC_VERSION, CEC_VERSION, END);
+}
+
+static void give_features(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GIVE_FEATURES, END);
+  if (CEC_VERSION >= CEC_VERSION_2_0) {
+    expect(BROADCAST, CEC_ID_REPORT_FEATURES, CEC_VERSION, END);
+  } else {
+    expect_abort(TV, CEC_ID_GIVE_FEATURES, 0x00);
+  }
+}
+
+static void give_device_power_status(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  expect_power(0x00);
+}
+
+static void give_deck_status(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GIVE_DECK_STATUS, 0x01, END);
+  expect(TV, CEC_ID_DECK_STATUS, END);
+}
+
+static void audio_system_query(void) {
+  // a playback device is no audio system, it should refuse audio system queries
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GIVE_AUDIO_STATUS, END);
+  expect_abort(TV, CEC_ID_GIVE_AUDIO_STATUS, 0x00);
+  receive(TV, US, CEC_ID_GIVE_SYSTEM_AUDIO_MODE_STATUS, END);
+  expect_abort(TV, CEC_ID_GIVE_SYSTEM_AUDIO_MODE_STATUS, 0x00);
+}
+
+static void system_audio_mode_request(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_SYSTEM_AUDIO_MODE_REQUEST, PHYSICAL_ADDRESS >> 8, PHYSICAL_ADDRESS & 0xff,
+          END);
+  expect_no(CEC_ID_SET_SYSTEM_AUDIO_MODE);
+  expect_abort(TV, CEC_ID_SYSTEM_AUDIO_MODE_REQUEST, 0x00);
+}
+
+/* Feature Abort. */
+
+static void abort_unrecognized(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, RECORD_OFF, END);
+  expect_abort(TV, RECORD_OFF, 0x00);
+}
+
+static void abort_from_audio(void) {
+  // the Feature Abort goes back to whoever asked
+  start(FOLLOWERS_TV_AUDIO);
+  receive(AUDIO, US, RECORD_OFF, END);
+  expect_abort(AUDIO, RECORD_OFF, 0x00);
+}
+
+static void abort_invalid_operand(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_DECK_CONTROL, 0x7f, END);
+  expect_abort(TV, CEC_ID_DECK_CONTROL, 0x03);
+  receive(TV, US, CEC_ID_PLAY, 0x7f, END);
+  expect_abort(TV, CEC_ID_PLAY, 0x03);
+}
+
+static void abort_message(void) {
+  // <Abort> exists to test this, any reason other than unrecognized opcode
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_ABORT, END);
+  expect(TV, CEC_ID_FEATURE_ABORT, CEC_ID_ABORT, END);
+  for (unsigned int i = bus.checked; i < bus.num_sent; i++) {
+    if ((bus.sent[i].len >= 4) && (bus.sent[i].pld[1] == CEC_ID_FEATURE_ABORT)
+        && (bus.sent[i].pld[3] == 0x00)) {
+      fail("Feature Abort of Abort gives unrecognized opcode");
+    }
+  }
+}
+
+static void no_abort_of_abort(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_FEATURE_ABORT, RECORD_OFF, 0x00, END);
+  expect_none();
+}
+
+static void get_menu_language(void) {
+  // a TV only message, a source should refuse it
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GET_MENU_LANGUAGE, END);
+  expect_abort(TV, CEC_ID_GET_MENU_LANGUAGE, 0x00);
+}
+
+/* Broadcast and directed handling. */
+
+static void broadcast_unrecognized(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, RECORD_OFF, END);
+  expect_none();
+}
+
+static void broadcast_query(void) {
+  // queries are directed only, a broadcast one is ignored
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_GIVE_OSD_NAME, END);
+  expect_none();
+  receive(TV, BROADCAST, CEC_ID_GET_CEC_VERSION, END);
+  expect_none();
+  receive(TV, BROADCAST, CEC_ID_GIVE_DECK_STATUS, 0x01, END);
+  expect_none();
+}
+
+static void other_device_query(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, AUDIO, CEC_ID_GIVE_OSD_NAME, END);
+  expect_none();
+  receive(TV, AUDIO, CEC_ID_GIVE_DEVICE_POWER_STATUS, END);
+  expect_none();
+  receive(TV, AUDIO, RECORD_OFF, END);
+  expect_none();
+}
+
+static void query_for_tv(void) {
+  // the audio system asks the TV, which is present and answers for itself
+  start(FOLLOWERS_TV_AUDIO);
+  receive(AUDIO, TV, CEC_ID_GIVE_DEVICE_POWER_STATUS, END);
+  expect_none();
+}
+
+static void other_device_user_control(void) {
+  start(FOLLOWERS_TV_AUDIO | (1 << PLAYBACK_1));
+  receive(TV, PLAYBACK_1, CEC_ID_USER_CONTROL_PRESSED, 0x00, END);
+  receive(TV, PLAYBACK_1, CEC_ID_USER_CONTROL_RELEASED, END);
+  if (bus.keys != 0) {
+    fail("key %02x from a press for another device", bus.key);
+  }
+}
+
+static void user_control_pressed(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_USER_CONTROL_PRESSED, 0x01, END);
+  receive(TV, US, CEC_ID_USER_CONTROL_RELEASED, END);
+  if ((bus.keys != 1) || (bus.key != 0x01)) {
+    fail("user control 01 not passed on");
+  }
+  expect_none();
+}
+
+/* Routing and power. */
+
+static void set_stream_path(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_SET_STREAM_PATH, PHYSICAL_ADDRESS >> 8, PHYSICAL_ADDRESS & 0xff,
+          END);
+  expect(BROADCAST, CEC_ID_ACTIVE_SOURCE, PHYSICAL_ADDRESS >> 8, PHYSICAL_ADDRESS & 0xff, END);
+}
+
+static void set_stream_path_other(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_SET_STREAM_PATH, OTHER_PATH >> 8, OTHER_PATH & 0xff, END);
+  expect_no(CEC_ID_ACTIVE_SOURCE);
+}
+
+static void request_active_source(void) {
+  // once selected, the device must answer for itself as the active source
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_SET_STREAM_PATH, PHYSICAL_ADDRESS >> 8, PHYSICAL_ADDRESS & 0xff,
+          END);
+  receive(TV, BROADCAST, CEC_ID_REQUEST_ACTIVE_SOURCE, END);
+  expect(BROADCAST, CEC_ID_ACTIVE_SOURCE, PHYSICAL_ADDRESS >> 8, PHYSICAL_ADDRESS & 0xff, END);
+}
+
+static void request_active_source_inactive(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_REQUEST_ACTIVE_SOURCE, END);
+  expect_no(CEC_ID_ACTIVE_SOURCE);
+}
+
+static void routing_change_other(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_ROUTING_CHANGE, PHYSICAL_ADDRESS >> 8, PHYSICAL_ADDRESS & 0xff,
+          OTHER_PATH >> 8, OTHER_PATH & 0xff, END);
+  expect_none();
+}
+
+static void standby_broadcast(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_STANDBY, END);
+  if (CEC_VERSION >= CEC_VERSION_2_0) {
+    expect(BROADCAST, CEC_ID_REPORT_POWER_STATUS, 0x01, END);
+  }
+  expect_power(0x01);
+}
+
+static void standby_other(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, AUDIO, CEC_ID_STANDBY, END);
+  expect_none();
+  expect_power(0x00);
+}
+
+static void power_on_key(void) {
+  start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_STANDBY, END);
+  receive(TV, US, CEC_ID_USER_CONTROL_PRESSED, 0x6d, END);
+  if (CEC_VERSION >= CEC_VERSION_2_0) {
+    expect(BROADCAST, CEC_ID_REPORT_POWER_STATUS, 0x00, END);
+  }
+  receive(TV, US, CEC_ID_USER_CONTROL_RELEASED, END);
+  expect_power(0x00);
+}
+
+/* Receive filter. */
+
+static void filter_start(uint16_t followers) {
+  start(followers);
+  bus.filter = true;
+}
+
+static void filter_polls(void) {
+  filter_start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, END);
+  expect_dropped(true);
+  receive(TV, AUDIO, END);
+  expect_dropped(true);
+}
+
+static void filter_directed(void) {
+  filter_start(FOLLOWERS_TV_AUDIO);
+  receive(TV, US, CEC_ID_GIVE_OSD_NAME, END);
+  expect_dropped(false);
+  expect(TV, CEC_ID_SET_OSD_NAME, END);
+}
+
+static void filter_other_device(void) {
+  filter_start(FOLLOWERS_TV_AUDIO);
+  receive(TV, AUDIO, CEC_ID_GIVE_OSD_NAME, END);
+  expect_dropped(true);
+  receive(TV, AUDIO, CEC_ID_USER_CONTROL_PRESSED, 0x00, END);
+  expect_dropped(true);
+}
+
+static void filter_other_device_reports(void) {
+  // the topology learns from replies between other devices
+  filter_start(FOLLOWERS_TV_AUDIO);
+  receive(AUDIO, TV, CEC_ID_SET_OSD_NAME, 'A', 'V', 'R', END);
+  expect_dropped(false);
+  receive(AUDIO, TV, CEC_ID_REPORT_POWER_STATUS, 0x00, END);
+  expect_dropped(false);
+  receive(AUDIO, TV, CEC_ID_CEC_VERSION, 0x05, END);
+  expect_dropped(false);
+  expect_none();
+}
+
+static void filter_power_status_for_tv(void) {
+  // without a TV the device answers in its place, so the query must get through
+  filter_start(1 << AUDIO);
+  receive(AUDIO, TV, CEC_ID_GIVE_DEVICE_POWER_STATUS, END);
+  expect_dropped(false);
+  if (bus.num_sent == bus.checked) {
+    fail("no Report Power Status in place of the TV");
+  }
+}
+
+static void filter_broadcasts(void) {
+  filter_start(FOLLOWERS_TV_AUDIO);
+  receive(TV, BROADCAST, CEC_ID_STANDBY, END);
+  expect_dropped(false);
+  receive(TV, BROADCAST, CEC_ID_GIVE_PHYSICAL_ADDRESS, END);
+  expect_dropped(true);
+}
+
+static const test_t tests[] = {
+    {"Address allocation", "first playback address", allocate_first, NULL},
+    {"Address allocation", "collision with another playback device", allocate_collision, NULL},
+    {"Address allocation", "unregistered when all are taken", allocate_full, NULL},
+    {"Address allocation", "same address on reallocation", reallocate_keeps_address, NULL},
+
+    {"Directed queries", "Give Physical Address", give_physical_address, NULL},
+    {"Directed queries", "Give OSD Name", give_osd_name, NULL},
+    {"Directed queries", "Give Device Vendor ID", give_device_vendor_id, NULL},
+    {"Directed queries", "Get CEC Version", get_cec_version, NULL},
+    {"Directed queries", "Give Features", give_features, NULL},
+    {"Directed queries", "Give Device Power Status", give_device_power_status, NULL},
+    {"Directed queries", "Give Deck Status", give_deck_status, NULL},
+    {"Directed queries", "audio system queries", audio_system_query,
+     "answers as an audio system for TVs that want one"},
+    {"Directed queries", "System Audio Mode Request", system_audio_mode_request,
+     "answers as an audio system for TVs that want one"},
+
+    {"Feature Abort", "unrecognized opcode", abort_unrecognized, NULL},
+    {"Feature Abort", "sent to the initiator", abort_from_audio, NULL},
+    {"Feature Abort", "invalid operand", abort_invalid_operand, NULL},
+    {"Feature Abort", "Abort message", abort_message, "Abort is ignored"},
+    {"Feature Abort", "no reply to Feature Abort", no_abort_of_abort, NULL},
+    {"Feature Abort", "Get Menu Language", get_menu_language, "TV only messages are ignored"},
+
+    {"Broadcast and directed", "broadcast unrecognized opcode", broadcast_unrecognized, NULL},
+    {"Broadcast and directed", "broadcast queries ignored", broadcast_query, NULL},
+    {"Broadcast and directed", "queries for other devices ignored", other_device_query, NULL},
+    {"Broadcast and directed", "no answer for a present TV", query_for_tv,
+     "reports the TV on, for sources that want a TV"},
+    {"Broadcast and directed", "keys for other devices ignored", other_device_user_control,
+     "user control is not checked for destination"},
+    {"Broadcast and directed", "User Control Pressed", user_control_pressed, NULL},
+
+    {"Routing and power", "Set Stream Path", set_stream_path, NULL},
+    {"Routing and power", "Set Stream Path to another source", set_stream_path_other,
+     "answers every Set Stream Path"},
+    {"Routing and power", "Request Active Source", request_active_source,
+     "active source is not tracked"},
+    {"Routing and power", "Request Active Source when inactive", request_active_source_inactive,
+     NULL},
+    {"Routing and power", "Routing Change to another source", routing_change_other,
+     "wakes the TV on every Routing Change"},
+    {"Routing and power", "Standby broadcast", standby_broadcast, NULL},
+    {"Routing and power", "Standby for another device", standby_other, NULL},
+    {"Routing and power", "power on key", power_on_key, NULL},
+
+    {"Receive filter", "polls dropped", filter_polls, NULL},
+    {"Receive filter", "directed queries passed", filter_directed, NULL},
+    {"Receive filter", "frames for other devices dropped", filter_other_device, NULL},
+    {"Receive filter", "reports between other devices passed", filter_other_device_reports,
+     NULL},
+    {"Receive filter", "Give Device Power Status for an absent TV passed",
+     filter_power_status_for_tv, NULL},
+    {"Receive filter", "unsubscribed broadcasts dropped", filter_broadcasts, NULL},
+};
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-c <factor>] [-t <ms>] [-s] [-v]\n"
+          "  -c  scale the host CPU time of the dispatch, default 1\n"
+          "  -t  response time limit, default %d ms\n"
+          "  -s  strict, known deviations fail the run too\n"
+          "  -v  print the frames of each test and keep the firmware log on stdout\n",
+          name, RESPONSE_LIMIT_MS);
+}
+
+int main(int argc, char **argv) {
+  bool strict = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "c:t:sv")) != -1) {
+    switch (opt) {
+      case 'c':
+        cpu_scale = strtod(optarg, NULL);
+        break;
+      case 't':
+        limit_ms = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        strict = true;
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+  if (optind != argc) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  cec_filter_init(&filter);
+
+  // the firmware logs with printf, keep it out of the report
+  FILE *out = verbose ? stdout : fdopen(dup(STDOUT_FILENO), "w");
+  if (!verbose) {
+    freopen("/dev/null", "w", stdout);
+  }
+
+  unsigned int passed = 0, known = 0, failures = 0;
+  const char *group = NULL;
+  for (unsigned int i = 0; i < sizeof(tests) / sizeof(tests[0]); i++) {
+    const test_t *test = &tests[i];
+    if ((group == NULL) || (strcmp(group, test->group) != 0)) {
+      group = test->group;
+      fprintf(out, "%s:\n", group);
+    }
+
+    failed = false;
+    test->run();
+    fflush(stdout);
+
+    if (!failed && (test->known == NULL)) {
+      fprintf(out, "\t%s: OK\n", test->name);
+      passed++;
+    } else if (!failed) {
+      fprintf(out, "\t%s: FAIL (known deviation now passes: %s)\n", test->name, test->known);
+      failures++;
+    } else if (test->known != NULL) {
+      fprintf(out, "\t%s: WARN (%s: %s)\n", test->name, test->known, reason);
+      known++;
+    } else {
+      fprintf(out, "\t%s: FAIL (%s)\n", test->name, reason);
+      failures++;
+    }
+  }
+
+  fprintf(out, "\nTotal: %u, Succeeded: %u, Known deviations: %u, Failed: %u\n",
+          (unsigned int)(sizeof(tests) / sizeof(tests[0])), passed, known, failures);
+  fclose(out);
+
+  return ((failures > 0) || (strict && (known > 0))) ? 1 : 0;
+}
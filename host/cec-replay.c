@@ -0,0 +1,211 @@
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "cec-dispatch.h"
+#include "cec-frame.h"
+
+/* Replay a recorded CEC trace through the protocol logic.
+ *
+ * The trace has one frame per line as "<time_ms> <frame>", with the frame in
+ * colon separated hex as accepted by the 'tx' console command.  Frames are
+ * fed in order against a virtual clock taken from the trace, so a replay runs
+ * as fast as the logic allows.  The transcript of received frames, replies
+ * and user control codes is written in a stable format for diffing between
+ * firmware versions.
+ */
+
+#define MAX_FRAMES (65536)
+
+typedef struct {
+  uint32_t time_ms;
+  uint8_t len;
+  uint8_t pld[16];
+} frame_t;
+
+static frame_t frames[MAX_FRAMES];
+static unsigned int num_frames;
+
+/* Transcript output and the virtual time of the frame being dispatched. */
+static FILE *out;
+static uint32_t now_ms;
+static uint16_t paddr = 0x1000;
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static void print_frame(const char *dir, const uint8_t *pld, uint8_t len) {
+  if (out == NULL) {
+    return;
+  }
+
+  fprintf(out, "%lu %s ", (unsigned long)now_ms, dir);
+  for (uint8_t i = 0; i < len; i++) {
+    fprintf(out, (i == 0) ? "%02x" : ":%02x", pld[i]);
+  }
+  fprintf(out, "\n");
+}
+
+static bool send(void *arg, uint8_t *pld, uint8_t len) {
+  print_frame("<--", pld, len);
+
+  // nobody answers polls, so address allocation takes the first choice
+  return (len > 1) && ((pld[0] & 0x0f) != 0x0f);
+}
+
+static void user_control(void *arg, uint8_t code, bool pressed) {
+  if (out == NULL) {
+    return;
+  }
+
+  if (pressed) {
+    fprintf(out, "%lu key %02x\n", (unsigned long)now_ms, code);
+  } else {
+    fprintf(out, "%lu key release\n", (unsigned long)now_ms);
+  }
+}
+
+static uint16_t physical_address(void *arg) {
+  return paddr;
+}
+
+static const cec_dispatch_ops_t ops = {
+    .send = send,
+    .user_control = user_control,
+    .physical_address = physical_address,
+};
+
+static bool load(const char *path) {
+  FILE *f = fopen(path, "r");
+  if (f == NULL) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return false;
+  }
+
+  char line[128];
+  unsigned int n = 0;
+  while (fgets(line, sizeof(line), f) != NULL) {
+    n++;
+    unsigned long time_ms;
+    char frame[64];
+    if ((line[0] == '#') || (line[0] == '\n')) {
+      continue;
+    }
+
+    if ((num_frames >= MAX_FRAMES) || (sscanf(line, "%lu %63s", &time_ms, frame) != 2)
+        || !cec_frame_parse(frame, frames[num_frames].pld, &frames[num_frames].len)) {
+      fprintf(stderr, "%s:%u: bad frame\n", path, n);
+      fclose(f);
+      return false;
+    }
+    frames[num_frames++].time_ms = time_ms;
+  }
+  fclose(f);
+
+  return true;
+}
+
+static void replay(void) {
+  cec_dispatch_t dispatch;
+
+  now_ms = 0;
+  cec_dispatch_init(&dispatch, &ops, NULL);
+  cec_dispatch_announce(&dispatch);
+
+  for (unsigned int i = 0; i < num_frames; i++) {
+    now_ms = frames[i].time_ms;
+    print_frame("-->", frames[i].pld, frames[i].len);
+    cec_dispatch_frame(&dispatch, frames[i].pld, frames[i].len);
+  }
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-o <transcript>] [-p <physical address>] [-n <runs>] [-v] <trace>\n"
+          "  -o  write the transcript to a file instead of stdout\n"
+          "  -p  physical address read from the sink, default 1000\n"
+          "  -n  time the dispatch over this many runs without a transcript\n"
+          "  -v  keep the firmware log on stdout\n",
+          name);
+}
+
+int main(int argc, char **argv) {
+  const char *output = NULL;
+  unsigned long runs = 0;
+  bool verbose = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "o:p:n:v")) != -1) {
+    switch (opt) {
+      case 'o':
+        output = optarg;
+        break;
+      case 'p':
+        paddr = strtoul(optarg, NULL, 16);
+        break;
+      case 'n':
+        runs = strtoul(optarg, NULL, 10);
+        break;
+      case 'v':
+        verbose = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+  if (optind != argc - 1) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  if (!load(argv[optind])) {
+    return 1;
+  }
+
+  // the firmware logs with printf, keep it out of the transcript
+  if (output != NULL) {
+    out = fopen(output, "w");
+  } else {
+    out = fdopen(dup(STDOUT_FILENO), "w");
+  }
+  if (out == NULL) {
+    fprintf(stderr, "%s: %s\n", (output != NULL) ? output : "stdout", strerror(errno));
+    return 1;
+  }
+  if (!verbose) {
+    freopen("/dev/null", "w", stdout);
+  }
+
+  replay();
+  fflush(stdout);
+  fclose(out);
+  out = NULL;
+
+  if ((runs > 0) && (num_frames > 0)) {
+    uint64_t start = now_ns();
+    for (unsigned long i = 0; i < runs; i++) {
+      replay();
+    }
+    uint64_t elapsed = now_ns() - start;
+    uint64_t trace_ms = frames[num_frames - 1].time_ms;
+
+    fprintf(stderr, "%u frames x %lu runs in %llu us, %llu ns per frame", num_frames, runs,
+            (unsigned long long)(elapsed / 1000),
+            (unsigned long long)(elapsed / (runs * num_frames)));
+    if (elapsed > 0) {
+      fprintf(stderr, ", %llux real time",
+              (unsigned long long)((trace_ms * 1000000 * runs) / elapsed));
+    }
+    fprintf(stderr, "\n");
+  }
+
+  return 0;
+}
@@ -0,0 +1,122 @@
+#include <errno.h>
+#include <libgen.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "edid.h"
+
+/* Run the EDID parser over a corpus of dumps, checking the physical address
+ * found in each and timing the parse.
+ *
+ * The manifest lists one dump per line as "<file> <physical address>", with
+ * paths relative to the manifest.
+ */
+
+#define EDID_MAX_SIZE (4 * EDID_BLOCK_SIZE)
+#define ITERATIONS (100000)
+
+static uint64_t now_ns(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+static size_t load(const char *path, uint8_t *edid, size_t size) {
+  FILE *f = fopen(path, "rb");
+  if (f == NULL) {
+    fprintf(stderr, "%s: %s\n", path, strerror(errno));
+    return 0;
+  }
+
+  size_t len = fread(edid, 1, size, f);
+  fclose(f);
+
+  return len;
+}
+
+/**
+ * Parse one dump, returns 0 if the expected address is found.
+ */
+static int bench(const char *path, const char *name, uint16_t expected) {
+  uint8_t edid[EDID_MAX_SIZE];
+  size_t len = load(path, edid, sizeof(edid));
+  if (len == 0) {
+    return -1;
+  }
+
+  bool valid = edid_verify(edid, len);
+  uint16_t addr = edid_physical_address(edid, len);
+
+  volatile uint16_t sink;
+  uint64_t start = now_ns();
+  for (unsigned int i = 0; i < ITERATIONS; i++) {
+    sink = edid_physical_address(edid, len);
+  }
+  (void)sink;
+  uint64_t per_parse = (now_ns() - start) / ITERATIONS;
+
+  int ok = (addr == expected);
+  printf("%-4s %-28s %4zu %-5s %x.%x.%x.%x %6llu ns\n", ok ? "ok" : "FAIL", name, len,
+         valid ? "ok" : "bad", (addr >> 12) & 0xf, (addr >> 8) & 0xf, (addr >> 4) & 0xf,
+         addr & 0xf, (unsigned long long)per_parse);
+  if (!ok) {
+    printf("     expected %04x, found %04x\n", expected, addr);
+  }
+
+  return ok ? 0 : -1;
+}
+
+int main(int argc, char **argv) {
+  if (argc != 2) {
+    fprintf(stderr, "usage: %s <manifest>\n", argv[0]);
+    return 2;
+  }
+
+  FILE *manifest = fopen(argv[1], "r");
+  if (manifest == NULL) {
+    fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+    return 2;
+  }
+
+  char dir[512];
+  snprintf(dir, sizeof(dir), "%s", argv[1]);
+  dirname(dir);
+
+  printf("     %-28s %4s %-5s %-7s %9s\n", "EDID", "LEN", "CKSUM", "PHYS", "PARSE");
+
+  char line[512];
+  unsigned int total = 0;
+  unsigned int failed = 0;
+  while (fgets(line, sizeof(line), manifest) != NULL) {
+    char name[256];
+    unsigned int expected;
+    if ((line[0] == '#') || (sscanf(line, "%255s %x", name, &expected) != 2)) {
+      continue;
+    }
+
+    char path[1024];
+    snprintf(path, sizeof(path), "%s/%s", dir, name);
+    total++;
+    if (bench(path, name, expected)) {
+      failed++;
+    }
+  }
+  // a directory opens, but fails on the first read
+  if (ferror(manifest)) {
+    fprintf(stderr, "%s: %s\n", argv[1], strerror(errno));
+    fclose(manifest);
+    return 2;
+  }
+  fclose(manifest);
+
+  printf("%u EDIDs, %u failed\n", total, failed);
+  if (total == 0) {
+    fprintf(stderr, "%s: no EDIDs listed\n", argv[1]);
+    return 1;
+  }
+
+  return (failed == 0) ? 0 : 1;
+}
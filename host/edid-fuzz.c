@@ -0,0 +1,12 @@
+#include <stddef.h>
+#include <stdint.h>
+
+#include "edid.h"
+
+/* libFuzzer entry point for the EDID parser, seed it with corpus/edid. */
+int LLVMFuzzerTestOneInput(const uint8_t *data, size_t size) {
+  edid_verify(data, size);
+  edid_physical_address(data, size);
+
+  return 0;
+}
@@ -0,0 +1,252 @@
+#include <dirent.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <stdbool.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/ioctl.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <linux/hidraw.h>
+
+#include "cec-frame.h"
+#include "hid-command.h"
+#include "usb_descriptors.h"
+
+/* Reference client for the HID command reports.
+ *
+ * Sends one frame through the Linux hidraw driver, then polls the status
+ * feature report until the result with the same sequence number arrives.
+ * Needs no driver beyond the one already bound to the keyboard, so works
+ * where the CDC console is unavailable.
+ */
+
+#define PICO_CEC_VID (0xcafe)
+
+/* Interval between status reads while waiting. */
+#define POLL_US (1000)
+
+/* Values of cec_transaction_status_t, whose header needs FreeRTOS. */
+#define STATUS_OK (2)
+#define STATUS_ABORTED (4)
+
+static const char *status_name[] = {
+    "QUEUED", "WAITING", "OK", "NACK", "ABORT", "TIMEOUT", "BUSY",
+};
+
+static uint64_t now_us(void) {
+  struct timespec ts;
+
+  clock_gettime(CLOCK_MONOTONIC, &ts);
+  return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static void print_frame(const uint8_t *pld, uint8_t len) {
+  for (uint8_t i = 0; i < len; i++) {
+    printf((i == 0) ? "%02x" : ":%02x", pld[i]);
+  }
+}
+
+/**
+ * Open the first hidraw node of a pico-cec with the command reports.
+ */
+static int open_device(void) {
+  DIR *dir = opendir("/dev");
+  if (dir == NULL) {
+    return -1;
+  }
+
+  int fd = -1;
+  struct dirent *entry;
+  while ((fd < 0) && ((entry = readdir(dir)) != NULL)) {
+    if (strncmp(entry->d_name, "hidraw", 6) != 0) {
+      continue;
+    }
+
+    char path[288];
+    snprintf(path, sizeof(path), "/dev/%s", entry->d_name);
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+      continue;
+    }
+
+    // the keyboard interface is the only HID one, check it has the vendor collection
+    struct hidraw_devinfo info;
+    struct hidraw_report_descriptor desc;
+    int size;
+    bool found = false;
+    if ((ioctl(fd, HIDIOCGRAWINFO, &info) == 0) && ((uint16_t)info.vendor == PICO_CEC_VID)
+        && (ioctl(fd, HIDIOCGRDESCSIZE, &size) == 0)) {
+      desc.size = size;
+      if (ioctl(fd, HIDIOCGRDESC, &desc) == 0) {
+        for (int i = 0; (i + 2) < size; i++) {
+          // Usage Page (Vendor Defined 0xFF00)
+          found |= (desc.value[i] == 0x06) && (desc.value[i + 1] == 0x00)
+                   && (desc.value[i + 2] == 0xff);
+        }
+      }
+    }
+    if (!found) {
+      close(fd);
+      fd = -1;
+    }
+  }
+  closedir(dir);
+
+  return fd;
+}
+
+static bool read_status(int fd, hid_status_t *status) {
+  uint8_t report[1 + sizeof(hid_status_t)] = {REPORT_ID_CEC};
+
+  if (ioctl(fd, HIDIOCGFEATURE(sizeof(report)), report) < (int)sizeof(report)) {
+    return false;
+  }
+  memcpy(status, &report[1], sizeof(*status));
+
+  return true;
+}
+
+static void print_bus(const hid_status_t *status) {
+  printf("laddr %x paddr %x.%x.%x.%x power %02x queued %u\n", status->laddr,
+         (status->paddr >> 12) & 0xf, (status->paddr >> 8) & 0xf, (status->paddr >> 4) & 0xf,
+         status->paddr & 0xf, status->power_status, status->queued);
+}
+
+static int send_command(int fd, const hid_command_t *command) {
+  uint8_t report[1 + sizeof(hid_command_t)] = {REPORT_ID_CEC};
+  hid_status_t status;
+
+  // results left over from an earlier client
+  while (read_status(fd, &status) && (status.status != HID_STATUS_NONE)) {
+  }
+
+  memcpy(&report[1], command, sizeof(*command));
+  uint64_t start = now_us();
+  if (write(fd, report, sizeof(report)) != sizeof(report)) {
+    fprintf(stderr, "write failed: %s\n", strerror(errno));
+    return 1;
+  }
+
+  // allow for the queue ahead of this command as well as its own timeout
+  uint64_t limit = start + (command->timeout_ms + 1000) * 1000ull;
+  do {
+    if (!read_status(fd, &status)) {
+      fprintf(stderr, "status read failed: %s\n", strerror(errno));
+      return 1;
+    }
+    if ((status.status != HID_STATUS_NONE) && (status.seq == command->seq)) {
+      break;
+    }
+    usleep(POLL_US);
+  } while (now_us() < limit);
+  uint64_t elapsed = now_us() - start;
+
+  if ((status.status == HID_STATUS_NONE) || (status.seq != command->seq)) {
+    fprintf(stderr, "no result after %llu ms\n", (unsigned long long)(elapsed / 1000));
+    return 1;
+  }
+
+  if (status.status == HID_STATUS_INVALID) {
+    printf("INVALID");
+  } else if (status.status < (sizeof(status_name) / sizeof(status_name[0]))) {
+    printf("%s", status_name[status.status]);
+  } else {
+    printf("%02x", status.status);
+  }
+  if (status.status == STATUS_ABORTED) {
+    printf(" reason %u", status.abort_reason);
+  }
+  if (status.response_len > 0) {
+    printf(" ");
+    print_frame(status.response, status.response_len);
+  }
+  printf(" (wire %u us, total %llu us)\n", status.duration_us, (unsigned long long)elapsed);
+
+  return (status.status == STATUS_OK) ? 0 : 1;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-d <hidraw>] [-t <timeout_ms>] -s | <frame> [<opcode>]\n"
+          "  -d  device node, instead of the first pico-cec found\n"
+          "  -t  reply timeout, instead of the firmware default\n"
+          "  -s  print the bus state\n"
+          "  <frame>   whole frame in colon separated hex, as for the 'tx' command\n"
+          "  <opcode>  reply to wait for from the destination, in hex\n",
+          name);
+}
+
+int main(int argc, char **argv) {
+  const char *path = NULL;
+  unsigned long timeout = 0;
+  bool state = false;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "d:t:s")) != -1) {
+    switch (opt) {
+      case 'd':
+        path = optarg;
+        break;
+      case 't':
+        timeout = strtoul(optarg, NULL, 10);
+        break;
+      case 's':
+        state = true;
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+
+  hid_command_t command = {.flags = HID_COMMAND_RAW};
+  unsigned long opcode = 0;
+  char *end = NULL;
+  if (!state
+      && ((optind == argc) || ((argc - optind) > 2) || (timeout > UINT16_MAX)
+          || !cec_frame_parse(argv[optind], command.frame, &command.len)
+          || (((argc - optind) == 2)
+              && (((opcode = strtoul(argv[optind + 1], &end, 16)) > 0xff) || (*end != '\0'))))) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  int fd;
+  if (path != NULL) {
+    fd = open(path, O_RDWR);
+    if (fd < 0) {
+      fprintf(stderr, "%s: %s\n", path, strerror(errno));
+      return 1;
+    }
+  } else {
+    fd = open_device();
+    if (fd < 0) {
+      fprintf(stderr, "no pico-cec command reports found, check /dev/hidraw* permissions\n");
+      return 1;
+    }
+  }
+
+  int r;
+  if (state) {
+    hid_status_t status;
+    r = read_status(fd, &status) ? 0 : 1;
+    if (r == 0) {
+      print_bus(&status);
+    }
+  } else {
+    if ((argc - optind) == 2) {
+      command.opcode = opcode;
+    } else {
+      command.flags |= HID_COMMAND_ACK_ONLY;
+    }
+    command.timeout_ms = (timeout != 0) ? timeout : HID_COMMAND_TIMEOUT_MS;
+    command.seq = (uint8_t)(now_us() & 0xff);
+    r = send_command(fd, &command);
+  }
+  close(fd);
+
+  return r;
+}
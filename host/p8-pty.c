@@ -0,0 +1,278 @@
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#include "cec-frame.h"
+#include "cec-p8.h"
+
+/* Pulse-Eight adapter stand-in on a pseudo terminal.
+ *
+ * Runs the firmware adapter emulation behind a pty so libcec (cec-client -p
+ * <pty>) or the kernel driver (inputattach --pulse8-cec <pty>) can be tried
+ * against it without a board.  The bus is simulated: followers at the given
+ * logical addresses acknowledge frames, the TV answers a few queries, and
+ * frames typed on stdin in colon separated hex are received as if from the
+ * bus.  Traffic is logged to stderr.
+ */
+
+#define DEFAULT_FOLLOWERS ((1 << 0) | (1 << 5))  // TV and audio system
+#define MAX_PENDING (8)
+
+typedef struct {
+  uint8_t pld[16];
+  uint8_t len;
+} frame_t;
+
+static int master = -1;
+static cec_p8_t p8;
+static uint16_t followers = DEFAULT_FOLLOWERS;
+static uint16_t host_mask;
+static volatile sig_atomic_t stop;
+
+/* Replies from simulated followers, delivered once the transmit result is. */
+static frame_t pending[MAX_PENDING];
+static unsigned int num_pending;
+
+static void print_frame(const char *dir, const uint8_t *pld, uint8_t len, const char *result) {
+  fprintf(stderr, "%s ", dir);
+  for (uint8_t i = 0; i < len; i++) {
+    fprintf(stderr, (i == 0) ? "%02x" : ":%02x", pld[i]);
+  }
+  fprintf(stderr, " %s\n", result);
+}
+
+static void reply(uint8_t initiator, uint8_t destination, const uint8_t *data, uint8_t len) {
+  if (num_pending >= MAX_PENDING) {
+    return;
+  }
+
+  frame_t *frame = &pending[num_pending++];
+  frame->pld[0] = (initiator << 4) | destination;
+  memcpy(&frame->pld[1], data, len);
+  frame->len = len + 1;
+}
+
+/**
+ * Answer a few of the queries a host makes while starting up, as a TV would.
+ */
+static void tv_respond(const uint8_t *pld, uint8_t len) {
+  uint8_t initiator = pld[0] >> 4;
+
+  if ((len < 2) || ((pld[0] & 0x0f) != 0x0)) {
+    return;
+  }
+
+  switch (pld[1]) {
+    case 0x83: {  // Give Physical Address
+      uint8_t data[] = {0x84, 0x00, 0x00, 0x00};
+      reply(0x0, 0xf, data, sizeof(data));
+    } break;
+    case 0x8f: {  // Give Device Power Status
+      uint8_t data[] = {0x90, 0x00};
+      reply(0x0, initiator, data, sizeof(data));
+    } break;
+    case 0x9f: {  // Get CEC Version
+      uint8_t data[] = {0x9e, 0x05};
+      reply(0x0, initiator, data, sizeof(data));
+    } break;
+    case 0x46: {  // Give OSD Name
+      uint8_t data[] = {0x47, 'T', 'V'};
+      reply(0x0, initiator, data, sizeof(data));
+    } break;
+    case 0x8c: {  // Give Device Vendor ID
+      uint8_t data[] = {0x87, 0x00, 0x00, 0x00};
+      reply(0x0, 0xf, data, sizeof(data));
+    } break;
+  }
+}
+
+static bool acked(uint8_t header) {
+  uint8_t destination = header & 0x0f;
+
+  return (destination != 0x0f) && (host_mask & (1 << destination));
+}
+
+static cec_p8_tx_t transmit(void *arg, const uint8_t *pld, uint8_t len) {
+  uint8_t destination = pld[0] & 0x0f;
+
+  if ((destination != 0x0f) && !(followers & (1 << destination))) {
+    print_frame("tx", pld, len, "nack");
+    return CEC_P8_TX_NACK;
+  }
+
+  print_frame("tx", pld, len, "ack");
+  tv_respond(pld, len);
+
+  return CEC_P8_TX_OK;
+}
+
+static void write_host(void *arg, const uint8_t *data, size_t len) {
+  while (len > 0) {
+    ssize_t n = write(master, data, len);
+    if (n < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      // nobody has the pty open, drop it as the USB stack would
+      return;
+    }
+    data += n;
+    len -= n;
+  }
+}
+
+static void ack_mask(void *arg, uint16_t mask) {
+  host_mask = mask;
+  fprintf(stderr, "ack mask %04x\n", mask);
+}
+
+static uint16_t physical_address(void *arg) {
+  return 0x1000;
+}
+
+static const cec_p8_ops_t ops = {
+    .transmit = transmit,
+    .write = write_host,
+    .ack_mask = ack_mask,
+    .physical_address = physical_address,
+};
+
+static void deliver_pending(void) {
+  for (unsigned int i = 0; i < num_pending; i++) {
+    bool ack = acked(pending[i].pld[0]);
+    print_frame("rx", pending[i].pld, pending[i].len, ack ? "ack" : "");
+    cec_p8_frame(&p8, pending[i].pld, pending[i].len, ack);
+  }
+  num_pending = 0;
+}
+
+static void on_signal(int sig) {
+  stop = 1;
+}
+
+static void usage(const char *name) {
+  fprintf(stderr,
+          "usage: %s [-a <mask>] [-l <link>]\n"
+          "  -a  hex mask of logical addresses present on the bus, default %04x\n"
+          "  -l  also make a symlink to the pty\n",
+          name, DEFAULT_FOLLOWERS);
+}
+
+int main(int argc, char **argv) {
+  const char *link = NULL;
+  int opt;
+
+  while ((opt = getopt(argc, argv, "a:l:")) != -1) {
+    switch (opt) {
+      case 'a':
+        followers = strtoul(optarg, NULL, 16);
+        break;
+      case 'l':
+        link = optarg;
+        break;
+      default:
+        usage(argv[0]);
+        return 2;
+    }
+  }
+  if (optind != argc) {
+    usage(argv[0]);
+    return 2;
+  }
+
+  master = posix_openpt(O_RDWR | O_NOCTTY);
+  if ((master < 0) || (grantpt(master) != 0) || (unlockpt(master) != 0)) {
+    fprintf(stderr, "pty: %s\n", strerror(errno));
+    return 1;
+  }
+
+  // raw bytes both ways until the client sets its own line discipline
+  struct termios tio;
+  tcgetattr(master, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(master, TCSANOW, &tio);
+
+  const char *name = ptsname(master);
+  if (link != NULL) {
+    unlink(link);
+    if (symlink(name, link) != 0) {
+      fprintf(stderr, "%s: %s\n", link, strerror(errno));
+      return 1;
+    }
+  }
+  printf("%s\n", name);
+  fflush(stdout);
+
+  signal(SIGINT, on_signal);
+  signal(SIGTERM, on_signal);
+  cec_p8_init(&p8, &ops, NULL, 0);
+
+  bool open = false;
+  int input = 0;
+  while (!stop) {
+    struct pollfd fds[2] = {{.fd = master, .events = POLLIN}, {.fd = input, .events = POLLIN}};
+    if (poll(fds, 2, 100) < 0) {
+      continue;
+    }
+
+    if (fds[0].revents & POLLIN) {
+      uint8_t buffer[256];
+      ssize_t n = read(master, buffer, sizeof(buffer));
+      if (n > 0) {
+        if (!open) {
+          fprintf(stderr, "host attached\n");
+          open = true;
+        }
+        cec_p8_input(&p8, buffer, n);
+        deliver_pending();
+      }
+    } else if (fds[0].revents & POLLHUP) {
+      // the client closed the pty, start afresh for the next one as the
+      // firmware does when DTR drops
+      if (open) {
+        fprintf(stderr, "host detached\n");
+        open = false;
+        host_mask = 0;
+        num_pending = 0;
+        cec_p8_init(&p8, &ops, NULL, 0);
+      }
+      usleep(100000);
+    }
+
+    if (fds[1].revents & POLLIN) {
+      char line[128];
+      uint8_t pld[16];
+      uint8_t len;
+      if (fgets(line, sizeof(line), stdin) == NULL) {
+        // keep serving the host with nothing more to inject
+        input = -1;
+        continue;
+      }
+
+      line[strcspn(line, "\r\n")] = '\0';
+      if (cec_frame_parse(line, pld, &len)) {
+        bool ack = acked(pld[0]);
+        print_frame("rx", pld, len, ack ? "ack" : "");
+        cec_p8_frame(&p8, pld, len, ack);
+      } else {
+        fprintf(stderr, "bad frame: %s\n", line);
+      }
+    }
+  }
+
+  if (link != NULL) {
+    unlink(link);
+  }
+  close(master);
+
+  return 0;
+}
@@ -0,0 +1,29 @@
+#ifndef HOST_SHIM_HARDWARE_SYNC_H
+#define HOST_SHIM_HARDWARE_SYNC_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Single threaded stand-ins for the RP2040 spin locks, enough to run the
+ * firmware capture ring in a host loopback. */
+typedef volatile uint32_t spin_lock_t;
+
+static inline spin_lock_t *spin_lock_instance(unsigned int n) {
+  static spin_lock_t locks[32];
+  return &locks[n];
+}
+
+static inline unsigned int spin_lock_claim_unused(bool required) {
+  return 0;
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock) {
+  *lock = 1;
+  return 0;
+}
+
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved) {
+  *lock = 0;
+}
+
+#endif
@@ -0,0 +1,88 @@
+#ifndef FREERTOS_CONFIG_H
+#define FREERTOS_CONFIG_H
+
+/* FreeRTOS configuration for the simulator on the POSIX port.
+ *
+ * Follows include/FreeRTOSConfig.h wherever the port allows, so the tasks run
+ * with the priorities, tick and notification layout they have on the board.
+ * The POSIX port runs one task at a time, so the simulator has a single core
+ * and core affinity is a no-op.
+ */
+
+#if !defined(__ASSEMBLER__)
+#include <stdint.h>
+#include <stdlib.h>
+#endif
+
+#define configUSE_PREEMPTION 1
+#define configUSE_PORT_OPTIMISED_TASK_SELECTION 0
+#define configTICK_RATE_HZ (1000)
+#define configMAX_PRIORITIES (5)
+#define configMINIMAL_STACK_SIZE (64)
+#define configMAX_TASK_NAME_LEN 16
+#define configUSE_16_BIT_TICKS 0
+#define configIDLE_SHOULD_YIELD 1
+#define configUSE_MUTEXES 1
+#define configUSE_RECURSIVE_MUTEXES 1
+#define configUSE_COUNTING_SEMAPHORES 1
+#define configQUEUE_REGISTRY_SIZE 2
+#define configUSE_QUEUE_SETS 0
+#define configUSE_TIME_SLICING 0
+#define configUSE_NEWLIB_REENTRANT 0
+#define configENABLE_BACKWARD_COMPATIBILITY 1
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 3  // 0 and 1 per task, 2 for cec_transact()
+
+// the stack size type freertos_hook.c declares the task memory callbacks with
+#define configSTACK_DEPTH_TYPE uint32_t
+
+#define configSUPPORT_STATIC_ALLOCATION 1
+#define configSUPPORT_DYNAMIC_ALLOCATION 0
+#define configTOTAL_HEAP_SIZE (0)
+#define configNUMBER_OF_CORES 1
+
+#define configUSE_IDLE_HOOK 0
+#define configUSE_TICK_HOOK 0
+#define configUSE_MALLOC_FAILED_HOOK 0
+// tasks run on pthread stacks the port allocates, not the buffers they are given
+#define configCHECK_FOR_STACK_OVERFLOW 0
+#define configGENERATE_RUN_TIME_STATS 0
+#define configUSE_TRACE_FACILITY 1
+#define configUSE_STATS_FORMATTING_FUNCTIONS 0
+#define configUSE_CO_ROUTINES 0
+#define configMAX_CO_ROUTINE_PRIORITIES 2
+
+#define configUSE_TIMERS 1
+#define configTIMER_TASK_PRIORITY (configMAX_PRIORITIES - 2)
+#define configTIMER_QUEUE_LENGTH 32
+#define configTIMER_TASK_STACK_DEPTH configMINIMAL_STACK_SIZE
+
+#define INCLUDE_vTaskPrioritySet 0
+#define INCLUDE_uxTaskPriorityGet 0
+#define INCLUDE_vTaskDelete 0
+#define INCLUDE_vTaskSuspend 1
+#define INCLUDE_xResumeFromISR 0
+#define INCLUDE_vTaskDelayUntil 1
+#define INCLUDE_vTaskDelay 1
+#define INCLUDE_xTaskGetSchedulerState 1
+#define INCLUDE_xTaskGetCurrentTaskHandle 1
+#define INCLUDE_uxTaskGetStackHighWaterMark 1
+#define INCLUDE_xTaskGetIdleTaskHandle 1
+#define INCLUDE_xTimerGetTimerDaemonTaskHandle 0
+#define INCLUDE_pcTaskGetTaskName 0
+#define INCLUDE_eTaskGetState 0
+#define INCLUDE_xEventGroupSetBitsFromISR 1
+#define INCLUDE_xTimerPendFunctionCall 1
+
+#define configASSERT(x) \
+  do {                  \
+    if (!(x)) {         \
+      abort();          \
+    }                   \
+  } while (0)
+
+#if !defined(__ASSEMBLER__)
+// one core, tasks stay where they are
+#define vTaskCoreAffinitySet(task, mask) ((void)(task), (void)(mask))
+#endif
+
+#endif
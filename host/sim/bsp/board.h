@@ -0,0 +1,13 @@
+#ifndef SIM_BSP_BOARD_H
+#define SIM_BSP_BOARD_H
+
+#include <stdbool.h>
+
+/**
+ * Set up the simulation around the firmware, before the tasks are created.
+ */
+void board_init(void);
+
+void board_led_write(bool state);
+
+#endif
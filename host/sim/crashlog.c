@@ -0,0 +1,24 @@
+#include "crashlog.h"
+#include "sim.h"
+
+/* Stands in for src/crashlog.c, which saves the fault state of the Cortex-M0+
+ * core.  A crash ends the simulation, so there is never a record to keep. */
+
+const char *crashlog_reason_name[CRASHLOG_COUNT] = {
+    [CRASHLOG_HARDFAULT] = "hardfault",
+    [CRASHLOG_STACK_OVERFLOW] = "stack overflow",
+};
+
+void crashlog_init(void) {}
+
+void crashlog_frame(uint8_t bus, const uint8_t *pld, uint8_t len, uint8_t flags) {}
+
+const crashlog_t *crashlog_get(void) {
+  return NULL;
+}
+
+void crashlog_clear(void) {}
+
+void crashlog_stack_overflow(const char *task) {
+  sim_reset(crashlog_reason_name[CRASHLOG_STACK_OVERFLOW]);
+}
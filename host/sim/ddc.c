@@ -0,0 +1,106 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "hardware/i2c.h"
+#include "pico/stdlib.h"
+
+#include "edid.h"
+#include "sim.h"
+
+/* The sink's EDID on the DDC bus, read from the file PICO_CEC_SIM_EDID names,
+ * "none" for no sink, or built in with physical address 1.0.0.0.  Reads
+ * start at the offset last written and wrap at the end of the EDID, as the
+ * EEPROM does.
+ */
+
+#define EDID_ADDR (0x50)
+#define EDID_SIZE (EDID_BLOCK_SIZE * 4)
+
+struct i2c_inst {
+  uint baudrate;
+};
+
+static i2c_inst_t i2c1_inst;
+i2c_inst_t *i2c_default = &i2c1_inst;
+
+static uint8_t edid[EDID_SIZE];
+static size_t edid_len;
+static uint8_t offset;
+
+/* A base block and a CTA extension with an HDMI vendor block giving 1.0.0.0. */
+static const uint8_t builtin_edid[EDID_BLOCK_SIZE * 2] = {
+    // base block, one extension
+    [0] = 0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00,
+    [126] = 0x01,
+    // CTA-861 extension, data blocks up to byte 12
+    [128] = 0x02, 0x03, 0x0c, 0x00,
+    // HDMI vendor specific data block: IEEE OUI 00-0c-03, physical address
+    [132] = 0x67, 0x03, 0x0c, 0x00, 0x10, 0x00, 0x00, 0x00,
+};
+
+static void checksum(uint8_t *block) {
+  uint8_t sum = 0;
+
+  for (unsigned int i = 0; i < EDID_BLOCK_SIZE - 1; i++) {
+    sum += block[i];
+  }
+  block[EDID_BLOCK_SIZE - 1] = -sum;
+}
+
+void sim_ddc_init(void) {
+  const char *path = getenv("PICO_CEC_SIM_EDID");
+
+  if (path == NULL) {
+    memcpy(edid, builtin_edid, sizeof(builtin_edid));
+    edid_len = sizeof(builtin_edid);
+    for (size_t i = 0; i < edid_len; i += EDID_BLOCK_SIZE) {
+      checksum(&edid[i]);
+    }
+  } else if (strcmp(path, "none") != 0) {
+    FILE *f = fopen(path, "rb");
+    if (f == NULL) {
+      perror(path);
+      exit(EXIT_FAILURE);
+    }
+    edid_len = fread(edid, 1, sizeof(edid), f);
+    fclose(f);
+  }
+}
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate) {
+  i2c->baudrate = baudrate;
+  return baudrate;
+}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c,
+                         uint8_t addr,
+                         const uint8_t *src,
+                         size_t len,
+                         bool nostop,
+                         uint timeout_us) {
+  if ((addr != EDID_ADDR) || (edid_len == 0)) {
+    return PICO_ERROR_GENERIC;
+  }
+
+  if (len > 0) {
+    offset = src[0];
+  }
+  return len;
+}
+
+int i2c_read_timeout_us(i2c_inst_t *i2c,
+                        uint8_t addr,
+                        uint8_t *dst,
+                        size_t len,
+                        bool nostop,
+                        uint timeout_us) {
+  if ((addr != EDID_ADDR) || (edid_len == 0)) {
+    return PICO_ERROR_GENERIC;
+  }
+
+  for (size_t i = 0; i < len; i++) {
+    dst[i] = edid[offset++ % edid_len];
+  }
+  return len;
+}
@@ -0,0 +1,13 @@
+#ifndef SIM_DEVICE_USBD_PVT_H
+#define SIM_DEVICE_USBD_PVT_H
+
+#include <stdbool.h>
+
+typedef void (*osal_task_func_t)(void *param);
+
+/**
+ * Run a function in the device task, after the events queued before it.
+ */
+void usbd_defer_func(osal_task_func_t func, void *param, bool in_isr);
+
+#endif
@@ -0,0 +1,69 @@
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+
+#include "sim.h"
+
+/* The flash, for the event log, kept in the file PICO_CEC_SIM_FLASH names
+ * between runs or starting erased.  Erasing sets every bit of a range and
+ * programming only clears bits, as on the chip.  The image takes no flash,
+ * the link places its end at the start.
+ */
+
+uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+static int fd = -1;
+
+void sim_flash_init(void) {
+  const char *path = getenv("PICO_CEC_SIM_FLASH");
+
+  memset(sim_flash, 0xff, sizeof(sim_flash));
+  if (path == NULL) {
+    return;
+  }
+
+  fd = open(path, O_RDWR | O_CREAT, 0644);
+  if (fd < 0) {
+    perror(path);
+    exit(EXIT_FAILURE);
+  }
+
+  // a new or short file reads as erased beyond its end
+  size_t len = 0;
+  ssize_t n;
+  while ((len < sizeof(sim_flash))
+         && ((n = pread(fd, &sim_flash[len], sizeof(sim_flash) - len, len)) > 0)) {
+    len += n;
+  }
+}
+
+static void save(uint32_t flash_offs, size_t count) {
+  if ((fd >= 0) && (pwrite(fd, &sim_flash[flash_offs], count, flash_offs) != (ssize_t)count)) {
+    perror("flash");
+  }
+}
+
+void flash_range_erase(uint32_t flash_offs, size_t count) {
+  if (((flash_offs | count) % FLASH_SECTOR_SIZE) || (flash_offs + count > sizeof(sim_flash))) {
+    sim_reset("flash erase out of range");
+  }
+
+  memset(&sim_flash[flash_offs], 0xff, count);
+  save(flash_offs, count);
+}
+
+void flash_range_program(uint32_t flash_offs, const uint8_t *data, size_t count) {
+  if (((flash_offs | count) % FLASH_PAGE_SIZE) || (flash_offs + count > sizeof(sim_flash))) {
+    sim_reset("flash program out of range");
+  }
+
+  for (size_t i = 0; i < count; i++) {
+    sim_flash[flash_offs + i] &= data[i];
+  }
+  save(flash_offs, count);
+}
@@ -0,0 +1,456 @@
+#include <errno.h>
+#include <stdarg.h>
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "bsp/board.h"
+#include "hardware/clocks.h"
+#include "hardware/gpio.h"
+#include "hardware/structs/systick.h"
+#include "hardware/watchdog.h"
+#include "pico/bootrom.h"
+#include "pico/stdlib.h"
+#include "pico/time.h"
+
+#include "sim-stdio.h"
+#include "sim.h"
+
+/* The interrupt task stands in for the timer and GPIO interrupts.  It hands
+ * each level change to the edge callback with the time and level it had when
+ * it happened, so the firmware measures the bits as the board would however
+ * late the host schedules the task, then runs the alarms that are due.
+ *
+ * Waiting for the next alarm only has the tick's resolution.  While one is
+ * due within two ticks the task yields in a loop instead, so a frame on the
+ * bus keeps the lower priority tasks waiting, much as the CEC interrupts load
+ * the board's first core.
+ */
+
+#define IRQ_STACK_SIZE (configMINIMAL_STACK_SIZE * 4)
+#define IRQ_IDLE_MS (10)
+
+#define ALARMS (16)
+#define EDGES (64)
+#define PIN_WATCHERS (2)
+
+typedef struct {
+  alarm_id_t id;  // 0 if free
+  uint64_t due_us;
+  alarm_callback_t callback;
+  void *user_data;
+} alarm_t;
+
+typedef struct {
+  uint8_t pin;
+  bool high;
+  uint64_t ns;
+} edge_t;
+
+typedef struct {
+  bool out;       // driven low by the firmware
+  bool ext_low;   // driven low from outside
+  enum gpio_function function;
+  uint32_t irq_mask;
+  struct {
+    void (*watch)(void *arg, bool high);
+    void *arg;
+  } watchers[PIN_WATCHERS];
+} pin_t;
+
+static struct timespec start;
+
+static TaskHandle_t irq_task;
+
+static alarm_t alarms[ALARMS];
+static alarm_id_t next_id = 1;
+
+static edge_t edges[EDGES];
+static uint32_t edges_head;
+static uint32_t edges_tail;
+
+static pin_t pins[NUM_BANK0_GPIOS];
+static gpio_irq_callback_t irq_callback;
+
+/* While an edge is delivered, the interrupt task sees the time and level it
+ * had. */
+static const edge_t *delivering;
+
+static uint64_t watchdog_timeout_us;
+static uint64_t watchdog_due_us;
+
+watchdog_hw_t sim_watchdog_hw;
+
+static bool in_irq_task(void) {
+  return (irq_task != NULL) && (xTaskGetCurrentTaskHandle() == irq_task);
+}
+
+uint64_t sim_time_ns(void) {
+  struct timespec now;
+
+  if ((delivering != NULL) && in_irq_task()) {
+    return delivering->ns;
+  }
+
+  clock_gettime(CLOCK_MONOTONIC, &now);
+  return (uint64_t)(now.tv_sec - start.tv_sec) * 1000000000 + now.tv_nsec - start.tv_nsec;
+}
+
+int sim_printf(const char *format, ...) {
+  char buf[512];
+  va_list args;
+
+  va_start(args, format);
+  int len = vsnprintf(buf, sizeof(buf), format, args);
+  va_end(args);
+
+  if (len > (int)sizeof(buf) - 1) {
+    len = sizeof(buf) - 1;
+  }
+  for (int done = 0; done < len;) {
+    ssize_t n = write(STDOUT_FILENO, &buf[done], len - done);
+    if ((n < 0) && (errno != EINTR)) {
+      break;
+    }
+    done += (n > 0) ? n : 0;
+  }
+  return len;
+}
+
+void sim_reset(const char *why) {
+  char buf[64];
+  int len = snprintf(buf, sizeof(buf), "reset: %s\n", why);
+
+  // the tasks may hold stdio locks, so no exit handlers
+  ssize_t ret = write(STDERR_FILENO, buf, len);
+  (void)ret;
+  _exit(EXIT_FAILURE);
+}
+
+/**
+ * Wake the interrupt task for a new edge or alarm, unless it is the caller.
+ */
+static void irq_kick(void) {
+  if ((irq_task != NULL) && !in_irq_task()
+      && (xTaskGetSchedulerState() == taskSCHEDULER_RUNNING)) {
+    xTaskNotifyGive(irq_task);
+  }
+}
+
+//--------------------------------------------------------------------+
+// GPIO
+//--------------------------------------------------------------------+
+
+static bool level(const pin_t *p) {
+  return !(p->out || p->ext_low);
+}
+
+/**
+ * Apply a change to a pin, queueing an edge if its level changed.
+ */
+static void pin_update(uint gpio, bool out, bool ext_low) {
+  pin_t *p = &pins[gpio];
+
+  taskENTER_CRITICAL();
+  bool was = level(p);
+  p->out = out;
+  p->ext_low = ext_low;
+  bool high = level(p);
+  bool queued = false;
+  if ((high != was) && (edges_head - edges_tail < EDGES)) {
+    edges[edges_head++ % EDGES] = (edge_t){gpio, high, sim_time_ns()};
+    queued = true;
+  }
+  taskEXIT_CRITICAL();
+
+  if (queued) {
+    irq_kick();
+  }
+}
+
+void gpio_init(uint gpio) {
+  pins[gpio].function = GPIO_FUNC_SIO;
+  pin_update(gpio, false, pins[gpio].ext_low);
+}
+
+void gpio_set_function(uint gpio, enum gpio_function fn) {
+  pins[gpio].function = fn;
+}
+
+enum gpio_function gpio_get_function(uint gpio) {
+  return pins[gpio].function;
+}
+
+void gpio_set_dir(uint gpio, bool out) {
+  pin_update(gpio, out, pins[gpio].ext_low);
+}
+
+void gpio_put(uint gpio, bool value) {
+  // outputs are only ever driven low
+}
+
+bool gpio_get(uint gpio) {
+  if ((delivering != NULL) && (delivering->pin == gpio) && in_irq_task()) {
+    return delivering->high;
+  }
+
+  return level(&pins[gpio]);
+}
+
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled) {
+  taskENTER_CRITICAL();
+  if (enabled) {
+    pins[gpio].irq_mask |= event_mask;
+  } else {
+    pins[gpio].irq_mask &= ~event_mask;
+  }
+  taskEXIT_CRITICAL();
+}
+
+void gpio_set_irq_callback(gpio_irq_callback_t callback) {
+  irq_callback = callback;
+}
+
+void sim_gpio_drive(unsigned int pin, bool low) {
+  pin_update(pin, pins[pin].out, low);
+}
+
+void sim_gpio_watch(unsigned int pin, void (*watch)(void *arg, bool high), void *arg) {
+  for (unsigned int i = 0; i < PIN_WATCHERS; i++) {
+    if (pins[pin].watchers[i].watch == NULL) {
+      pins[pin].watchers[i].watch = watch;
+      pins[pin].watchers[i].arg = arg;
+      return;
+    }
+  }
+}
+
+static void deliver(const edge_t *edge) {
+  pin_t *p = &pins[edge->pin];
+  uint32_t event = edge->high ? GPIO_IRQ_EDGE_RISE : GPIO_IRQ_EDGE_FALL;
+
+  delivering = edge;
+  if ((irq_callback != NULL) && (p->irq_mask & event)) {
+    irq_callback(edge->pin, event);
+  }
+  for (unsigned int i = 0; i < PIN_WATCHERS; i++) {
+    if (p->watchers[i].watch != NULL) {
+      p->watchers[i].watch(p->watchers[i].arg, edge->high);
+    }
+  }
+  delivering = NULL;
+}
+
+/**
+ * Deliver the edges queued so far, including those the callbacks cause.
+ */
+static void deliver_edges(void) {
+  while (true) {
+    edge_t edge;
+
+    taskENTER_CRITICAL();
+    bool pending = (edges_tail != edges_head);
+    if (pending) {
+      edge = edges[edges_tail++ % EDGES];
+    }
+    taskEXIT_CRITICAL();
+
+    if (!pending) {
+      return;
+    }
+    deliver(&edge);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Alarms
+//--------------------------------------------------------------------+
+
+void alarm_pool_init_default(void) {}
+
+alarm_id_t add_alarm_at(absolute_time_t time,
+                        alarm_callback_t callback,
+                        void *user_data,
+                        bool fire_if_past) {
+  alarm_id_t id = -1;
+
+  if (!fire_if_past && time_reached(time)) {
+    return 0;
+  }
+
+  taskENTER_CRITICAL();
+  for (unsigned int i = 0; i < ALARMS; i++) {
+    if (alarms[i].id == 0) {
+      id = next_id;
+      next_id = (next_id == INT32_MAX) ? 1 : (next_id + 1);
+      alarms[i] = (alarm_t){id, time, callback, user_data};
+      break;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  irq_kick();
+  return id;
+}
+
+bool cancel_alarm(alarm_id_t id) {
+  bool found = false;
+
+  taskENTER_CRITICAL();
+  for (unsigned int i = 0; i < ALARMS; i++) {
+    if ((id > 0) && (alarms[i].id == id)) {
+      alarms[i].id = 0;
+      found = true;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  return found;
+}
+
+/**
+ * Run the earliest alarm that is due, if any.  Returns the time the next one
+ * is due, UINT64_MAX if there is none.
+ */
+static uint64_t run_alarm(void) {
+  uint64_t now = time_us_64();
+  alarm_t *next = NULL;
+
+  taskENTER_CRITICAL();
+  for (unsigned int i = 0; i < ALARMS; i++) {
+    if ((alarms[i].id != 0) && ((next == NULL) || (alarms[i].due_us < next->due_us))) {
+      next = &alarms[i];
+    }
+  }
+  alarm_t alarm = (next != NULL) ? *next : (alarm_t){0};
+  taskEXIT_CRITICAL();
+
+  if ((next == NULL) || (alarm.due_us > now)) {
+    return (next != NULL) ? alarm.due_us : UINT64_MAX;
+  }
+
+  int64_t again = alarm.callback(alarm.id, alarm.user_data);
+
+  taskENTER_CRITICAL();
+  // unless cancelled from the callback
+  if (next->id == alarm.id) {
+    if (again > 0) {
+      next->due_us = alarm.due_us + again;
+    } else if (again < 0) {
+      next->due_us = time_us_64() - again;
+    } else {
+      next->id = 0;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  return now;
+}
+
+void sleep_us(uint64_t us) {
+  busy_wait_us(us);
+}
+
+void sleep_ms(uint32_t ms) {
+  busy_wait_us((uint64_t)ms * 1000);
+}
+
+void busy_wait_us(uint64_t us) {
+  uint64_t until = time_us_64() + us;
+
+  while (time_us_64() < until) {
+    // spin as the board does
+  }
+}
+
+//--------------------------------------------------------------------+
+// Watchdog
+//--------------------------------------------------------------------+
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug) {
+  watchdog_timeout_us = (uint64_t)delay_ms * 1000;
+  watchdog_update();
+}
+
+void watchdog_update(void) {
+  watchdog_due_us = time_us_64() + watchdog_timeout_us;
+}
+
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms) {
+  sim_reset("reboot");
+}
+
+void reset_usb_boot(uint32_t gpio_activity_pin_mask, uint32_t disable_interface_mask) {
+  sim_reset("bootloader");
+}
+
+//--------------------------------------------------------------------+
+// Interrupt task
+//--------------------------------------------------------------------+
+
+static void irq_loop(void *param) {
+  while (true) {
+    deliver_edges();
+
+    uint64_t next = run_alarm();
+    uint64_t now = time_us_64();
+
+    if ((watchdog_timeout_us > 0) && (now >= watchdog_due_us)) {
+      sim_reset("watchdog");
+    }
+    if ((watchdog_timeout_us > 0) && (watchdog_due_us < next)) {
+      next = watchdog_due_us;
+    }
+
+    if (next <= now + 2000) {
+      taskYIELD();
+    } else {
+      uint64_t ms = (next - now) / 1000 - 1;
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS((ms < IRQ_IDLE_MS) ? ms : IRQ_IDLE_MS));
+    }
+  }
+}
+
+void sim_irq_init(void) {
+  static StackType_t stack[IRQ_STACK_SIZE];
+  static StaticTask_t tcb;
+
+  for (unsigned int i = 0; i < NUM_BANK0_GPIOS; i++) {
+    pins[i].function = GPIO_FUNC_NULL;
+  }
+
+  irq_task = xTaskCreateStatic(irq_loop, "irq", IRQ_STACK_SIZE, NULL, configMAX_PRIORITIES - 1,
+                               &stack[0], &tcb);
+}
+
+//--------------------------------------------------------------------+
+// Board
+//--------------------------------------------------------------------+
+
+systick_hw_t *sim_systick(void) {
+  static systick_hw_t systick;
+  uint64_t cycles = sim_time_ns() * (SIM_CLK_SYS_HZ / 1000000) / 1000;
+
+  systick.rvr = SIM_CLK_SYS_HZ / configTICK_RATE_HZ - 1;
+  systick.cvr = systick.rvr - (uint32_t)(cycles % (systick.rvr + 1));
+  return &systick;
+}
+
+bool stdio_init_all(void) {
+  clock_gettime(CLOCK_MONOTONIC, &start);
+  return true;
+}
+
+void board_init(void) {
+  sim_irq_init();
+  sim_ddc_init();
+  sim_flash_init();
+  sim_tv_init();
+  sim_usb_init();
+}
+
+void board_led_write(bool state) {}
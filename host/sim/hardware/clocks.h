@@ -0,0 +1,21 @@
+#ifndef SIM_HARDWARE_CLOCKS_H
+#define SIM_HARDWARE_CLOCKS_H
+
+#include <stdint.h>
+
+/* The nominal system clock, which the simulated SysTick counts at. */
+#define SIM_CLK_SYS_HZ (125000000)
+
+enum clock_index {
+  clk_gpout0 = 0,
+  clk_ref = 4,
+  clk_sys = 5,
+  clk_peri = 6,
+  clk_usb = 7,
+};
+
+static inline uint32_t clock_get_hz(enum clock_index clk_index) {
+  return (clk_index == clk_usb) ? 48000000 : SIM_CLK_SYS_HZ;
+}
+
+#endif
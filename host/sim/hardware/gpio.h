@@ -0,0 +1,56 @@
+#ifndef SIM_HARDWARE_GPIO_H
+#define SIM_HARDWARE_GPIO_H
+
+#include "hardware/irq.h"
+#include "pico/platform.h"
+
+/* Every pin is a wire with a pull-up, low while the firmware drives it as an
+ * output or anything else on the wire drives it, see sim_gpio_drive().  The
+ * output value is always 0, which is all the firmware uses. */
+
+enum gpio_function {
+  GPIO_FUNC_I2C = 3,
+  GPIO_FUNC_SIO = 5,
+  GPIO_FUNC_NULL = 0x1f,
+};
+
+#define GPIO_IN (false)
+#define GPIO_OUT (true)
+
+enum gpio_irq_level {
+  GPIO_IRQ_LEVEL_LOW = 0x1u,
+  GPIO_IRQ_LEVEL_HIGH = 0x2u,
+  GPIO_IRQ_EDGE_FALL = 0x4u,
+  GPIO_IRQ_EDGE_RISE = 0x8u,
+};
+
+typedef void (*gpio_irq_callback_t)(uint gpio, uint32_t event_mask);
+
+void gpio_init(uint gpio);
+void gpio_set_function(uint gpio, enum gpio_function fn);
+enum gpio_function gpio_get_function(uint gpio);
+void gpio_set_dir(uint gpio, bool out);
+void gpio_put(uint gpio, bool value);
+bool gpio_get(uint gpio);
+
+static inline void gpio_pull_up(uint gpio) {}
+
+static inline void gpio_disable_pulls(uint gpio) {}
+
+/**
+ * Edge events only, levels are not simulated.
+ */
+void gpio_set_irq_enabled(uint gpio, uint32_t event_mask, bool enabled);
+void gpio_set_irq_callback(gpio_irq_callback_t callback);
+
+static inline void gpio_set_irq_enabled_with_callback(uint gpio,
+                                                      uint32_t event_mask,
+                                                      bool enabled,
+                                                      gpio_irq_callback_t callback) {
+  gpio_set_irq_enabled(gpio, event_mask, enabled);
+  gpio_set_irq_callback(callback);
+}
+
+static inline void gpio_acknowledge_irq(uint gpio, uint32_t event_mask) {}
+
+#endif
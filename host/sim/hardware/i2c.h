@@ -0,0 +1,29 @@
+#ifndef SIM_HARDWARE_I2C_H
+#define SIM_HARDWARE_I2C_H
+
+#include "pico/stdlib.h"
+
+/* The DDC bus, with the sink's EDID at 0x50. */
+
+typedef struct i2c_inst i2c_inst_t;
+
+extern i2c_inst_t *i2c_default;
+
+uint i2c_init(i2c_inst_t *i2c, uint baudrate);
+
+static inline void i2c_deinit(i2c_inst_t *i2c) {}
+
+int i2c_write_timeout_us(i2c_inst_t *i2c,
+                         uint8_t addr,
+                         const uint8_t *src,
+                         size_t len,
+                         bool nostop,
+                         uint timeout_us);
+int i2c_read_timeout_us(i2c_inst_t *i2c,
+                        uint8_t addr,
+                        uint8_t *dst,
+                        size_t len,
+                        bool nostop,
+                        uint timeout_us);
+
+#endif
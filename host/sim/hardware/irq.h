@@ -0,0 +1,11 @@
+#ifndef SIM_HARDWARE_IRQ_H
+#define SIM_HARDWARE_IRQ_H
+
+#include "pico/platform.h"
+
+#define IO_IRQ_BANK0 (13)
+
+/* The interrupt task serves every source from the start. */
+static inline void irq_set_enabled(uint num, bool enabled) {}
+
+#endif
@@ -0,0 +1,12 @@
+#ifndef SIM_HARDWARE_REGS_ADDRESSMAP_H
+#define SIM_HARDWARE_REGS_ADDRESSMAP_H
+
+#include "pico/platform.h"
+
+/* Only the flash is mapped, onto host memory. */
+
+extern uint8_t sim_flash[PICO_FLASH_SIZE_BYTES];
+
+#define XIP_BASE ((uintptr_t)sim_flash)
+
+#endif
@@ -0,0 +1,20 @@
+#ifndef SIM_HARDWARE_STRUCTS_SYSTICK_H
+#define SIM_HARDWARE_STRUCTS_SYSTICK_H
+
+#include <stdint.h>
+
+/* SysTick counting down from the tick period at the nominal system clock,
+ * worked out from the host clock on each access. */
+
+typedef struct {
+  uint32_t csr;
+  uint32_t rvr;
+  uint32_t cvr;
+  uint32_t calib;
+} systick_hw_t;
+
+systick_hw_t *sim_systick(void);
+
+#define systick_hw (sim_systick())
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SIM_HARDWARE_SYNC_H
+#define SIM_HARDWARE_SYNC_H
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "pico/platform.h"
+
+/* Interrupts are the interrupt task, which one core cannot run while another
+ * task holds a critical section, so masking them and taking a spin lock both
+ * come down to a critical section. */
+
+typedef volatile uint32_t spin_lock_t;
+
+static inline uint32_t save_and_disable_interrupts(void) {
+  taskENTER_CRITICAL();
+  return 0;
+}
+
+static inline void restore_interrupts(uint32_t status) {
+  taskEXIT_CRITICAL();
+}
+
+static inline void __dmb(void) {
+  __atomic_thread_fence(__ATOMIC_SEQ_CST);
+}
+
+static inline spin_lock_t *spin_lock_instance(uint lock_num) {
+  static spin_lock_t locks[32];
+  return &locks[lock_num];
+}
+
+static inline uint spin_lock_claim_unused(bool required) {
+  static uint next;
+  return next++;
+}
+
+static inline uint32_t spin_lock_blocking(spin_lock_t *lock) {
+  taskENTER_CRITICAL();
+  *lock = 1;
+  return 0;
+}
+
+static inline void spin_unlock(spin_lock_t *lock, uint32_t saved_irq) {
+  *lock = 0;
+  taskEXIT_CRITICAL();
+}
+
+#endif
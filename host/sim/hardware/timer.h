@@ -0,0 +1,16 @@
+#ifndef SIM_HARDWARE_TIMER_H
+#define SIM_HARDWARE_TIMER_H
+
+#include <stdint.h>
+
+#include "sim.h"
+
+static inline uint64_t time_us_64(void) {
+  return sim_time_ns() / 1000;
+}
+
+static inline uint32_t time_us_32(void) {
+  return (uint32_t)time_us_64();
+}
+
+#endif
@@ -0,0 +1,33 @@
+#ifndef SIM_HARDWARE_WATCHDOG_H
+#define SIM_HARDWARE_WATCHDOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* The watchdog ends the simulation when it runs out, each run is a cold
+ * boot. */
+
+typedef struct {
+  uint32_t ctrl;
+  uint32_t load;
+  uint32_t reason;
+  uint32_t scratch[8];
+} watchdog_hw_t;
+
+extern watchdog_hw_t sim_watchdog_hw;
+
+#define watchdog_hw (&sim_watchdog_hw)
+
+void watchdog_enable(uint32_t delay_ms, bool pause_on_debug);
+void watchdog_update(void);
+void watchdog_reboot(uint32_t pc, uint32_t sp, uint32_t delay_ms) __attribute__((noreturn));
+
+static inline bool watchdog_caused_reboot(void) {
+  return false;
+}
+
+static inline bool watchdog_enable_caused_reboot(void) {
+  return false;
+}
+
+#endif
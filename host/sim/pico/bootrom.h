@@ -0,0 +1,14 @@
+#ifndef SIM_PICO_BOOTROM_H
+#define SIM_PICO_BOOTROM_H
+
+#include <stdint.h>
+
+#include "pico/platform.h"
+
+/**
+ * There is no bootloader to go to, so this ends the simulation.
+ */
+void reset_usb_boot(uint32_t gpio_activity_pin_mask, uint32_t disable_interface_mask)
+    __attribute__((noreturn));
+
+#endif
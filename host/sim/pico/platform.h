@@ -0,0 +1,38 @@
+#ifndef SIM_PICO_PLATFORM_H
+#define SIM_PICO_PLATFORM_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Stand-in for the SDK platform header, everything runs from host memory. */
+
+#define PICO_ON_DEVICE 0
+
+#define NUM_CORES (2)
+#define NUM_BANK0_GPIOS (30)
+
+/* Board pins of the Seeed XIAO RP2040, the firmware's default board, which
+ * the SDK has every header see. */
+#define PICO_DEFAULT_LED_PIN (25)
+#define PICO_DEFAULT_I2C (1)
+#define PICO_DEFAULT_I2C_SDA_PIN (6)
+#define PICO_DEFAULT_I2C_SCL_PIN (7)
+#define PICO_FLASH_SIZE_BYTES (2 * 1024 * 1024)
+
+typedef unsigned int uint;
+
+#define __not_in_flash_func(func) func
+#define __no_inline_not_in_flash_func(func) __attribute__((noinline)) func
+#define __time_critical_func(func) func
+#define __scratch_x(group)
+#define __scratch_y(group)
+#define __uninitialized_ram(group) group
+
+static inline void tight_loop_contents(void) {}
+
+static inline uint get_core_num(void) {
+  return 0;
+}
+
+#endif
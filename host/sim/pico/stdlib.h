@@ -0,0 +1,19 @@
+#ifndef SIM_PICO_STDLIB_H
+#define SIM_PICO_STDLIB_H
+
+#include "hardware/gpio.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+#include "pico/types.h"
+
+enum pico_error_codes {
+  PICO_OK = 0,
+  PICO_ERROR_NONE = 0,
+  PICO_ERROR_TIMEOUT = -1,
+  PICO_ERROR_GENERIC = -2,
+  PICO_ERROR_NO_DATA = -3,
+};
+
+bool stdio_init_all(void);
+
+#endif
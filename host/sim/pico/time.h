@@ -0,0 +1,88 @@
+#ifndef SIM_PICO_TIME_H
+#define SIM_PICO_TIME_H
+
+#include "hardware/timer.h"
+#include "pico/types.h"
+
+/* Alarms, run in the simulator's interrupt task in time order. */
+
+typedef int32_t alarm_id_t;
+
+/**
+ * Return 0 to stop, > 0 to run again that many microseconds after the time
+ * the alarm was due, < 0 to run again that many microseconds from now.
+ */
+typedef int64_t (*alarm_callback_t)(alarm_id_t id, void *user_data);
+
+static inline absolute_time_t get_absolute_time(void) {
+  return time_us_64();
+}
+
+static inline absolute_time_t from_us_since_boot(uint64_t us) {
+  return us;
+}
+
+static inline uint64_t to_us_since_boot(absolute_time_t t) {
+  return t;
+}
+
+static inline uint32_t to_ms_since_boot(absolute_time_t t) {
+  return (uint32_t)(t / 1000);
+}
+
+static inline absolute_time_t delayed_by_us(absolute_time_t t, uint64_t us) {
+  return t + us;
+}
+
+static inline absolute_time_t delayed_by_ms(absolute_time_t t, uint32_t ms) {
+  return t + (uint64_t)ms * 1000;
+}
+
+static inline absolute_time_t make_timeout_time_us(uint64_t us) {
+  return delayed_by_us(get_absolute_time(), us);
+}
+
+static inline absolute_time_t make_timeout_time_ms(uint32_t ms) {
+  return delayed_by_ms(get_absolute_time(), ms);
+}
+
+static inline int64_t absolute_time_diff_us(absolute_time_t from, absolute_time_t to) {
+  return (int64_t)(to - from);
+}
+
+static inline bool time_reached(absolute_time_t t) {
+  return time_us_64() >= t;
+}
+
+void alarm_pool_init_default(void);
+
+/**
+ * Schedule an alarm, a time already past runs it as soon as possible if
+ * fire_if_past, otherwise returns 0.  Returns -1 when all alarms are in use.
+ */
+alarm_id_t add_alarm_at(absolute_time_t time,
+                        alarm_callback_t callback,
+                        void *user_data,
+                        bool fire_if_past);
+
+static inline alarm_id_t add_alarm_in_us(uint64_t us,
+                                         alarm_callback_t callback,
+                                         void *user_data,
+                                         bool fire_if_past) {
+  return add_alarm_at(make_timeout_time_us(us), callback, user_data, fire_if_past);
+}
+
+static inline alarm_id_t add_alarm_in_ms(uint32_t ms,
+                                         alarm_callback_t callback,
+                                         void *user_data,
+                                         bool fire_if_past) {
+  return add_alarm_at(make_timeout_time_ms(ms), callback, user_data, fire_if_past);
+}
+
+bool cancel_alarm(alarm_id_t id);
+
+void sleep_us(uint64_t us);
+void sleep_ms(uint32_t ms);
+void busy_wait_us(uint64_t us);
+
+#endif
@@ -0,0 +1,9 @@
+#ifndef SIM_PICO_TYPES_H
+#define SIM_PICO_TYPES_H
+
+#include "pico/platform.h"
+
+/* Microseconds since boot, a plain integer as in SDK release builds. */
+typedef uint64_t absolute_time_t;
+
+#endif
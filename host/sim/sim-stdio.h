@@ -0,0 +1,16 @@
+#ifndef SIM_STDIO_H
+#define SIM_STDIO_H
+
+#include <stdio.h>
+
+/* Included ahead of every firmware source.  The POSIX port can switch tasks
+ * from its tick signal anywhere, including inside printf() holding the stdout
+ * lock, and the next task to print would then wait for it forever.  The
+ * firmware's printf() formats into a buffer and writes that out in one system
+ * call instead, which takes no lock. */
+
+int sim_printf(const char *format, ...) __attribute__((format(printf, 1, 2)));
+
+#define printf(...) sim_printf(__VA_ARGS__)
+
+#endif
@@ -0,0 +1,63 @@
+#ifndef SIM_H
+#define SIM_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Host simulation of the board the firmware runs on.
+ *
+ * The firmware's tasks run unchanged on the FreeRTOS POSIX port.  Below them
+ * the SDK and TinyUSB are replaced by stand-ins: GPIO pins are wires pulled
+ * high that anything can drive low, alarms and edge interrupts run in an
+ * interrupt task at the CEC tasks' priority, a TV sits on each CEC line and a
+ * sink's EDID answers on the DDC bus.  The console is a pseudo terminal and
+ * the keyboard goes to uhid or a file.
+ *
+ * Time is the host's monotonic clock, so the bit timing the firmware sees is
+ * as accurate as the host can schedule the interrupt task.
+ */
+
+/* Time since the simulator started, in nanoseconds. */
+uint64_t sim_time_ns(void);
+
+/**
+ * Drive a pin low from outside the firmware, or let it go.
+ */
+void sim_gpio_drive(unsigned int pin, bool low);
+
+/**
+ * Call watch on every level change of a pin, from the interrupt task.
+ */
+void sim_gpio_watch(unsigned int pin, void (*watch)(void *arg, bool high), void *arg);
+
+/**
+ * Create the interrupt task, from board_init().
+ */
+void sim_irq_init(void);
+
+/**
+ * Attach a TV to each CEC line and read the frames it sends from stdin.
+ */
+void sim_tv_init(void);
+
+/**
+ * Load the sink EDID, from PICO_CEC_SIM_EDID or built in.
+ */
+void sim_ddc_init(void);
+
+/**
+ * Load the flash, from PICO_CEC_SIM_FLASH or erased.
+ */
+void sim_flash_init(void);
+
+/**
+ * Open the console pty and the keyboard sink.
+ */
+void sim_usb_init(void);
+
+/**
+ * Leave the simulation as the board would reset, noting why on stderr.
+ */
+void sim_reset(const char *why) __attribute__((noreturn));
+
+#endif
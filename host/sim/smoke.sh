@@ -0,0 +1,51 @@
+#!/bin/sh
+# Boot pico-cec-sim, wait for it to allocate a logical address, then press a
+# key on the TV's remote and wait for the keyboard report it becomes.
+#
+#   smoke.sh <pico-cec-sim>
+
+sim="$1"
+dir=$(mktemp -d) || exit 1
+log="$dir/log"
+fifo="$dir/tv"
+pid=
+
+finish() {
+  [ -n "$pid" ] && kill "$pid" 2>/dev/null
+  if [ "$1" -ne 0 ]; then
+    echo "smoke: $2" >&2
+    cat "$log" >&2
+  fi
+  rm -rf "$dir"
+  exit "$1"
+}
+
+# wait up to ten seconds for a line of the log to match
+wait_for() {
+  for i in 1 2 3 4 5 6 7 8 9 10; do
+    grep -q "$1" "$log" && return 0
+    kill -0 "$pid" 2>/dev/null || finish 1 "simulator exited"
+    sleep 1
+  done
+  return 1
+}
+
+mkfifo "$fifo" || finish 1 "no fifo"
+# the built in EDID, an erased flash and keyboard reports on stdout
+unset PICO_CEC_SIM_CONSOLE PICO_CEC_SIM_EDID PICO_CEC_SIM_FLASH PICO_CEC_SIM_HID
+"$sim" <"$fifo" >"$log" 2>&1 &
+pid=$!
+exec 3>"$fifo"
+
+# the TV logs the Report Physical Address broadcast that follows allocation
+wait_for 'rx [0-9a-e]f:84:' || finish 1 "no logical address"
+laddr=$(sed -n 's/.*rx \([0-9a-e]\)f:84:.*/\1/p' "$log" | head -n 1)
+
+reports=$(grep -c '^hid ' "$log")
+echo "0$laddr:44:01" >&3  # User Control Pressed, Up
+echo "0$laddr:45" >&3     # User Control Released
+for i in 1 2 3 4 5 6 7 8 9 10; do
+  [ "$(grep -c '^hid ' "$log")" -gt "$reports" ] && finish 0
+  sleep 1
+done
+finish 1 "no keyboard report"
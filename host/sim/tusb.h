@@ -0,0 +1,318 @@
+#ifndef SIM_TUSB_H
+#define SIM_TUSB_H
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "pico/platform.h"
+
+/* Stand-in for the TinyUSB device stack.
+ *
+ * Enough of the API for the firmware's HID and CDC code, with the descriptor
+ * macros and constants copied from TinyUSB so usb_descriptors.c builds
+ * unchanged.  The device is mounted from tud_init() on and never suspends.
+ * CDC is a pseudo terminal, DTR follows whether it is open.  The HID
+ * interface is a uhid device with the firmware's report descriptor, or writes
+ * its input reports to a file.  There is no capture interface.
+ */
+
+#define CFG_TUSB_MCU (0)
+#define OPT_OS_FREERTOS (4)
+#define OPT_MODE_DEFAULT_SPEED (0)
+#define TU_CHECK_MCU(...) (0)
+
+#include "tusb_config.h"
+
+#define TUD_OPT_HIGH_SPEED (0)
+
+#define TU_BIT(n) (1UL << (n))
+#define TU_U16_HIGH(u16) ((uint8_t)(((u16) >> 8) & 0x00ff))
+#define TU_U16_LOW(u16) ((uint8_t)((u16) & 0x00ff))
+#define U16_TO_U8S_LE(u16) TU_U16_LOW(u16), TU_U16_HIGH(u16)
+
+//--------------------------------------------------------------------+
+// Descriptors
+//--------------------------------------------------------------------+
+
+enum {
+  TUSB_DESC_DEVICE = 0x01,
+  TUSB_DESC_CONFIGURATION = 0x02,
+  TUSB_DESC_STRING = 0x03,
+  TUSB_DESC_INTERFACE = 0x04,
+  TUSB_DESC_ENDPOINT = 0x05,
+  TUSB_DESC_DEVICE_QUALIFIER = 0x06,
+  TUSB_DESC_OTHER_SPEED_CONFIG = 0x07,
+  TUSB_DESC_INTERFACE_ASSOCIATION = 0x0b,
+  TUSB_DESC_CS_INTERFACE = 0x24,
+};
+
+enum {
+  TUSB_XFER_CONTROL = 0,
+  TUSB_XFER_ISOCHRONOUS,
+  TUSB_XFER_BULK,
+  TUSB_XFER_INTERRUPT,
+};
+
+enum {
+  TUSB_CLASS_CDC = 2,
+  TUSB_CLASS_HID = 3,
+  TUSB_CLASS_CDC_DATA = 10,
+  TUSB_CLASS_VENDOR_SPECIFIC = 0xff,
+};
+
+#define TUSB_DESC_CONFIG_ATT_REMOTE_WAKEUP TU_BIT(5)
+
+typedef struct __attribute__((packed)) {
+  uint8_t bLength;
+  uint8_t bDescriptorType;
+  uint16_t bcdUSB;
+  uint8_t bDeviceClass;
+  uint8_t bDeviceSubClass;
+  uint8_t bDeviceProtocol;
+  uint8_t bMaxPacketSize0;
+  uint16_t idVendor;
+  uint16_t idProduct;
+  uint16_t bcdDevice;
+  uint8_t iManufacturer;
+  uint8_t iProduct;
+  uint8_t iSerialNumber;
+  uint8_t bNumConfigurations;
+} tusb_desc_device_t;
+
+#define TUD_CONFIG_DESC_LEN (9)
+
+#define TUD_CONFIG_DESCRIPTOR(config_num, _itfcount, _stridx, _total_len, _attribute, _power_ma) \
+  9, TUSB_DESC_CONFIGURATION, U16_TO_U8S_LE(_total_len), _itfcount, config_num, _stridx,         \
+      TU_BIT(7) | _attribute, (_power_ma) / 2
+
+#define TUD_HID_DESC_LEN (9 + 9 + 7)
+
+#define TUD_HID_DESCRIPTOR(_itfnum, _stridx, _boot_protocol, _report_desc_len, _epin, _epsize,  \
+                           _ep_interval)                                                        \
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_HID,                                        \
+      (uint8_t)((_boot_protocol) ? (uint8_t)HID_SUBCLASS_BOOT : 0), _boot_protocol, _stridx, 9, \
+      HID_DESC_TYPE_HID, U16_TO_U8S_LE(0x0111), 0, 1, HID_DESC_TYPE_REPORT,                     \
+      U16_TO_U8S_LE(_report_desc_len), 7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_INTERRUPT,       \
+      U16_TO_U8S_LE(_epsize), _ep_interval
+
+#define TUD_CDC_DESC_LEN (8 + 9 + 5 + 5 + 4 + 5 + 7 + 9 + 7 + 7)
+
+#define TUD_CDC_DESCRIPTOR(_itfnum, _stridx, _ep_notif, _ep_notif_size, _epout, _epin, _epsize) \
+  8, TUSB_DESC_INTERFACE_ASSOCIATION, _itfnum, 2, TUSB_CLASS_CDC, 2, 0, 0, 9,                   \
+      TUSB_DESC_INTERFACE, _itfnum, 0, 1, TUSB_CLASS_CDC, 2, 0, _stridx, 5,                     \
+      TUSB_DESC_CS_INTERFACE, 0, U16_TO_U8S_LE(0x0120), 5, TUSB_DESC_CS_INTERFACE, 1, 0,        \
+      (uint8_t)((_itfnum) + 1), 4, TUSB_DESC_CS_INTERFACE, 2, 6, 5, TUSB_DESC_CS_INTERFACE, 6,  \
+      _itfnum, (uint8_t)((_itfnum) + 1), 7, TUSB_DESC_ENDPOINT, _ep_notif, TUSB_XFER_INTERRUPT, \
+      U16_TO_U8S_LE(_ep_notif_size), 16, 9, TUSB_DESC_INTERFACE, (uint8_t)((_itfnum) + 1), 0,   \
+      2, TUSB_CLASS_CDC_DATA, 0, 0, 0, 7, TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK,           \
+      U16_TO_U8S_LE(_epsize), 0, 7, TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK,                  \
+      U16_TO_U8S_LE(_epsize), 0
+
+#define TUD_VENDOR_DESC_LEN (9 + 7 + 7)
+
+#define TUD_VENDOR_DESCRIPTOR(_itfnum, _stridx, _epout, _epin, _epsize)                        \
+  9, TUSB_DESC_INTERFACE, _itfnum, 0, 2, TUSB_CLASS_VENDOR_SPECIFIC, 0x00, 0x00, _stridx, 7,   \
+      TUSB_DESC_ENDPOINT, _epout, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0, 7,                \
+      TUSB_DESC_ENDPOINT, _epin, TUSB_XFER_BULK, U16_TO_U8S_LE(_epsize), 0
+
+uint8_t const *tud_descriptor_device_cb(void);
+uint8_t const *tud_descriptor_configuration_cb(uint8_t index);
+uint16_t const *tud_descriptor_string_cb(uint8_t index, uint16_t langid);
+
+//--------------------------------------------------------------------+
+// HID
+//--------------------------------------------------------------------+
+
+#define HID_SUBCLASS_BOOT (1)
+#define HID_ITF_PROTOCOL_NONE (0)
+#define HID_ITF_PROTOCOL_KEYBOARD (1)
+
+#define HID_DESC_TYPE_HID (0x21)
+#define HID_DESC_TYPE_REPORT (0x22)
+
+typedef enum {
+  HID_REPORT_TYPE_INVALID = 0,
+  HID_REPORT_TYPE_INPUT,
+  HID_REPORT_TYPE_OUTPUT,
+  HID_REPORT_TYPE_FEATURE,
+} hid_report_type_t;
+
+#define HID_REPORT_DATA_0(data)
+#define HID_REPORT_DATA_1(data) , data
+#define HID_REPORT_DATA_2(data) , U16_TO_U8S_LE(data)
+#define HID_REPORT_ITEM(data, tag, type, size) \
+  (((tag) << 4) | ((type) << 2) | (size)) HID_REPORT_DATA_##size(data)
+
+#define HID_INPUT(x) HID_REPORT_ITEM(x, 8, 0, 1)
+#define HID_OUTPUT(x) HID_REPORT_ITEM(x, 9, 0, 1)
+#define HID_COLLECTION(x) HID_REPORT_ITEM(x, 10, 0, 1)
+#define HID_FEATURE(x) HID_REPORT_ITEM(x, 11, 0, 1)
+#define HID_COLLECTION_END HID_REPORT_ITEM(x, 12, 0, 0)
+
+#define HID_USAGE_PAGE(x) HID_REPORT_ITEM(x, 0, 1, 1)
+#define HID_USAGE_PAGE_N(x, n) HID_REPORT_ITEM(x, 0, 1, n)
+#define HID_LOGICAL_MIN(x) HID_REPORT_ITEM(x, 1, 1, 1)
+#define HID_LOGICAL_MAX(x) HID_REPORT_ITEM(x, 2, 1, 1)
+#define HID_LOGICAL_MAX_N(x, n) HID_REPORT_ITEM(x, 2, 1, n)
+#define HID_REPORT_SIZE(x) HID_REPORT_ITEM(x, 7, 1, 1)
+#define HID_REPORT_ID(x) HID_REPORT_ITEM(x, 8, 1, 1),
+#define HID_REPORT_COUNT(x) HID_REPORT_ITEM(x, 9, 1, 1)
+
+#define HID_USAGE(x) HID_REPORT_ITEM(x, 0, 2, 1)
+#define HID_USAGE_MIN(x) HID_REPORT_ITEM(x, 1, 2, 1)
+#define HID_USAGE_MAX(x) HID_REPORT_ITEM(x, 2, 2, 1)
+#define HID_USAGE_MAX_N(x, n) HID_REPORT_ITEM(x, 2, 2, n)
+
+#define HID_DATA (0 << 0)
+#define HID_CONSTANT (1 << 0)
+#define HID_ARRAY (0 << 1)
+#define HID_VARIABLE (1 << 1)
+#define HID_ABSOLUTE (0 << 2)
+
+#define HID_COLLECTION_APPLICATION (1)
+
+#define HID_USAGE_PAGE_DESKTOP (0x01)
+#define HID_USAGE_PAGE_KEYBOARD (0x07)
+#define HID_USAGE_PAGE_LED (0x08)
+#define HID_USAGE_PAGE_VENDOR (0xff00)
+#define HID_USAGE_DESKTOP_KEYBOARD (0x06)
+
+#define TUD_HID_REPORT_DESC_KEYBOARD(...)                                                   \
+  HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP), HID_USAGE(HID_USAGE_DESKTOP_KEYBOARD),            \
+      HID_COLLECTION(HID_COLLECTION_APPLICATION), __VA_ARGS__ HID_USAGE_PAGE(               \
+          HID_USAGE_PAGE_KEYBOARD),                                                         \
+      HID_USAGE_MIN(224), HID_USAGE_MAX(231), HID_LOGICAL_MIN(0), HID_LOGICAL_MAX(1),       \
+      HID_REPORT_COUNT(8), HID_REPORT_SIZE(1), HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), \
+      HID_REPORT_COUNT(1), HID_REPORT_SIZE(8), HID_INPUT(HID_CONSTANT),                     \
+      HID_USAGE_PAGE(HID_USAGE_PAGE_LED), HID_USAGE_MIN(1), HID_USAGE_MAX(5),               \
+      HID_REPORT_COUNT(5), HID_REPORT_SIZE(1),                                              \
+      HID_OUTPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), HID_REPORT_COUNT(1),              \
+      HID_REPORT_SIZE(3), HID_OUTPUT(HID_CONSTANT), HID_USAGE_PAGE(HID_USAGE_PAGE_KEYBOARD), \
+      HID_USAGE_MIN(0), HID_USAGE_MAX_N(255, 2), HID_LOGICAL_MIN(0), HID_LOGICAL_MAX_N(255, 2), \
+      HID_REPORT_COUNT(6), HID_REPORT_SIZE(8), HID_INPUT(HID_DATA | HID_ARRAY | HID_ABSOLUTE), \
+      HID_COLLECTION_END
+
+#define KEYBOARD_LED_NUMLOCK (1 << 0)
+#define KEYBOARD_LED_CAPSLOCK (1 << 1)
+
+#define HID_KEY_NONE 0x00
+#define HID_KEY_A 0x04
+#define HID_KEY_B 0x05
+#define HID_KEY_C 0x06
+#define HID_KEY_D 0x07
+#define HID_KEY_E 0x08
+#define HID_KEY_F 0x09
+#define HID_KEY_G 0x0a
+#define HID_KEY_H 0x0b
+#define HID_KEY_I 0x0c
+#define HID_KEY_J 0x0d
+#define HID_KEY_K 0x0e
+#define HID_KEY_L 0x0f
+#define HID_KEY_M 0x10
+#define HID_KEY_N 0x11
+#define HID_KEY_O 0x12
+#define HID_KEY_P 0x13
+#define HID_KEY_Q 0x14
+#define HID_KEY_R 0x15
+#define HID_KEY_S 0x16
+#define HID_KEY_T 0x17
+#define HID_KEY_U 0x18
+#define HID_KEY_V 0x19
+#define HID_KEY_W 0x1a
+#define HID_KEY_X 0x1b
+#define HID_KEY_Y 0x1c
+#define HID_KEY_Z 0x1d
+#define HID_KEY_1 0x1e
+#define HID_KEY_2 0x1f
+#define HID_KEY_3 0x20
+#define HID_KEY_4 0x21
+#define HID_KEY_5 0x22
+#define HID_KEY_6 0x23
+#define HID_KEY_7 0x24
+#define HID_KEY_8 0x25
+#define HID_KEY_9 0x26
+#define HID_KEY_0 0x27
+#define HID_KEY_ENTER 0x28
+#define HID_KEY_ESCAPE 0x29
+#define HID_KEY_BACKSPACE 0x2a
+#define HID_KEY_TAB 0x2b
+#define HID_KEY_SPACE 0x2c
+#define HID_KEY_MINUS 0x2d
+#define HID_KEY_EQUAL 0x2e
+#define HID_KEY_COMMA 0x36
+#define HID_KEY_PERIOD 0x37
+#define HID_KEY_F1 0x3a
+#define HID_KEY_HOME 0x4a
+#define HID_KEY_PAGE_UP 0x4b
+#define HID_KEY_END 0x4d
+#define HID_KEY_PAGE_DOWN 0x4e
+#define HID_KEY_ARROW_RIGHT 0x4f
+#define HID_KEY_ARROW_LEFT 0x50
+#define HID_KEY_ARROW_DOWN 0x51
+#define HID_KEY_ARROW_UP 0x52
+
+bool tud_hid_ready(void);
+bool tud_hid_report(uint8_t report_id, void const *report, uint16_t len);
+bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t const keycode[6]);
+
+uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance);
+void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len);
+uint16_t tud_hid_get_report_cb(uint8_t instance,
+                               uint8_t report_id,
+                               hid_report_type_t report_type,
+                               uint8_t *buffer,
+                               uint16_t reqlen);
+void tud_hid_set_report_cb(uint8_t instance,
+                           uint8_t report_id,
+                           hid_report_type_t report_type,
+                           uint8_t const *buffer,
+                           uint16_t bufsize);
+
+//--------------------------------------------------------------------+
+// CDC
+//--------------------------------------------------------------------+
+
+bool tud_cdc_connected(void);
+uint32_t tud_cdc_available(void);
+int32_t tud_cdc_read_char(void);
+uint32_t tud_cdc_read(void *buffer, uint32_t bufsize);
+void tud_cdc_read_flush(void);
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize);
+uint32_t tud_cdc_write_flush(void);
+uint32_t tud_cdc_write_available(void);
+
+static inline uint32_t tud_cdc_write_char(char ch) {
+  return tud_cdc_write(&ch, 1);
+}
+
+static inline uint32_t tud_cdc_write_str(char const *str) {
+  return tud_cdc_write(str, strlen(str));
+}
+
+void tud_cdc_rx_cb(uint8_t itf);
+void tud_cdc_tx_complete_cb(uint8_t itf);
+void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts);
+
+//--------------------------------------------------------------------+
+// Device
+//--------------------------------------------------------------------+
+
+bool tud_init(uint8_t rhport);
+
+/**
+ * Wait for and handle the next events, runs the deferred functions and polls
+ * the console and keyboard for input.
+ */
+void tud_task(void);
+
+bool tud_mounted(void);
+bool tud_suspended(void);
+bool tud_remote_wakeup(void);
+
+void tud_mount_cb(void);
+void tud_umount_cb(void);
+void tud_suspend_cb(bool remote_wakeup_en);
+void tud_resume_cb(void);
+
+#endif
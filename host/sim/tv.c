@@ -0,0 +1,412 @@
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "hardware/gpio.h"
+#include "pico/time.h"
+
+#include "hdmi-cec.h"
+#include "sim.h"
+
+/* A TV at logical address 0 on each CEC line.
+ *
+ * It receives every frame by timing the low pulses on the line, pulls the
+ * acknowledge bit low for frames addressed to it and answers a few queries
+ * as p8-pty's TV does.  Frames typed on stdin in colon separated hex are sent
+ * by the TV on the first bus, "low <ms>" holds that line low instead.
+ * Traffic is logged to stderr.
+ */
+
+#define TV_LADDR (0x0)
+#define TV_STACK_SIZE (configMINIMAL_STACK_SIZE * 4)
+#define TV_INPUT_MS (50)
+
+#define START_LOW_US (3700)
+#define START_US (4500)
+#define ZERO_LOW_US (1500)
+#define ONE_LOW_US (600)
+#define SAMPLE_US (1050)
+#define BIT_US (2400)
+
+// signal free time before a new initiator sends, in bit periods
+#define FREE_BITS (5)
+
+#define TX_FRAMES (4)
+
+typedef enum {
+  TX_IDLE = 0,
+  TX_WAIT,     // for the line to be free
+  TX_LOW,      // pull the line low to start a bit
+  TX_RELEASE,  // let it go again
+  TX_SAMPLE,   // read the acknowledge bit
+} tx_state_t;
+
+typedef struct {
+  uint8_t pld[16];
+  uint8_t len;
+} frame_t;
+
+typedef struct {
+  uint8_t bus;
+  uint8_t pin;
+  uint64_t last_edge_us;
+
+  // receiver
+  uint64_t fall_us;
+  int bit;  // in the block, -1 until a start bit
+  uint8_t byte;
+  bool eom;
+  frame_t rx;
+
+  // transmitter, sends frames[0] while not idle
+  tx_state_t state;
+  int tx_bit;  // -1 for the start bit
+  frame_t frames[TX_FRAMES];
+  unsigned int num_frames;
+} tv_t;
+
+static tv_t tvs[CEC_BUSES];
+
+static void log_frame(const tv_t *tv, const char *dir, const frame_t *frame, const char *result) {
+  char line[128];
+  int len = snprintf(line, sizeof(line), "cec%u %s ", tv->bus, dir);
+
+  for (uint8_t i = 0; i < frame->len; i++) {
+    len += snprintf(&line[len], sizeof(line) - len, (i == 0) ? "%02x" : ":%02x", frame->pld[i]);
+  }
+  len += snprintf(&line[len], sizeof(line) - len, " %s\n", result);
+
+  // stderr is unbuffered, but may be locked by a task the tick switched out
+  ssize_t ret = write(STDERR_FILENO, line, len);
+  (void)ret;
+}
+
+//--------------------------------------------------------------------+
+// Transmitter
+//--------------------------------------------------------------------+
+
+static bool tx_bit_value(const frame_t *frame, int bit) {
+  int block = bit / 10;
+
+  switch (bit % 10) {
+    case 8:
+      return (block == frame->len - 1);  // end of message
+    case 9:
+      return true;  // acknowledge, left to the followers
+    default:
+      return (frame->pld[block] >> (7 - bit % 10)) & 1;
+  }
+}
+
+static void tx_done(tv_t *tv, const char *result) {
+  log_frame(tv, "tx", &tv->frames[0], result);
+
+  tv->num_frames--;
+  memmove(&tv->frames[0], &tv->frames[1], tv->num_frames * sizeof(frame_t));
+  tv->state = (tv->num_frames > 0) ? TX_WAIT : TX_IDLE;
+}
+
+/**
+ * Step through a frame, returns the microseconds to the next step from this
+ * one or, negative, from now.
+ */
+static int64_t tx_step(alarm_id_t alarm, void *user_data) {
+  tv_t *tv = user_data;
+  frame_t *frame = &tv->frames[0];
+  uint64_t now = time_us_64();
+
+  switch (tv->state) {
+    case TX_IDLE:
+      return 0;
+
+    case TX_WAIT: {
+      uint64_t free_us = tv->last_edge_us + FREE_BITS * BIT_US;
+      if (!gpio_get(tv->pin) || (now < free_us)) {
+        return -(int64_t)(gpio_get(tv->pin) ? (free_us - now) : BIT_US);
+      }
+      tv->tx_bit = -1;
+      tv->bit = -1;
+      tv->state = TX_LOW;
+    }
+      // fall through
+
+    case TX_LOW:
+      sim_gpio_drive(tv->pin, true);
+      tv->state = TX_RELEASE;
+      if (tv->tx_bit < 0) {
+        return START_LOW_US;
+      }
+      return tx_bit_value(frame, tv->tx_bit) ? ONE_LOW_US : ZERO_LOW_US;
+
+    case TX_RELEASE: {
+      bool one = (tv->tx_bit < 0) || tx_bit_value(frame, tv->tx_bit);
+      sim_gpio_drive(tv->pin, false);
+      if (tv->tx_bit < 0) {
+        tv->tx_bit = 0;
+        tv->state = TX_LOW;
+        return START_US - START_LOW_US;
+      }
+      if ((tv->tx_bit % 10) == 9) {
+        tv->state = TX_SAMPLE;
+        return SAMPLE_US - ONE_LOW_US;
+      }
+      tv->tx_bit++;
+      tv->state = TX_LOW;
+      return BIT_US - (one ? ONE_LOW_US : ZERO_LOW_US);
+    }
+
+    case TX_SAMPLE: {
+      bool broadcast = ((frame->pld[0] & 0x0f) == 0x0f);
+      // a follower acknowledges a directed frame by pulling the bit low, and
+      // rejects a broadcast one the same way
+      bool ack = (gpio_get(tv->pin) == broadcast);
+      if (!ack) {
+        tx_done(tv, "nack");
+      } else if (tv->tx_bit / 10 == frame->len - 1) {
+        tx_done(tv, "ack");
+      } else {
+        tv->tx_bit++;
+        tv->state = TX_LOW;
+        return BIT_US - SAMPLE_US;
+      }
+      return (tv->state == TX_WAIT) ? -(FREE_BITS * BIT_US) : 0;
+    }
+  }
+
+  return 0;
+}
+
+/**
+ * Queue a frame for the TV to send, from any task.
+ */
+static void tv_send(tv_t *tv, uint8_t destination, const uint8_t *data, uint8_t len) {
+  bool start = false;
+
+  taskENTER_CRITICAL();
+  if (tv->num_frames < TX_FRAMES) {
+    frame_t *frame = &tv->frames[tv->num_frames++];
+    frame->pld[0] = (TV_LADDR << 4) | destination;
+    memcpy(&frame->pld[1], data, len);
+    frame->len = len + 1;
+    start = (tv->state == TX_IDLE);
+    if (start) {
+      tv->state = TX_WAIT;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  if (start) {
+    add_alarm_in_us(0, tx_step, tv, true);
+  }
+}
+
+//--------------------------------------------------------------------+
+// Receiver
+//--------------------------------------------------------------------+
+
+/**
+ * Answer a few of the queries a playback device makes, as a TV would.
+ */
+static void tv_respond(tv_t *tv, const frame_t *frame) {
+  uint8_t initiator = frame->pld[0] >> 4;
+
+  if (frame->len < 2) {
+    return;
+  }
+
+  switch (frame->pld[1]) {
+    case 0x83: {  // Give Physical Address
+      uint8_t data[] = {0x84, 0x00, 0x00, 0x00};
+      tv_send(tv, 0xf, data, sizeof(data));
+    } break;
+    case 0x8f: {  // Give Device Power Status
+      uint8_t data[] = {0x90, 0x00};
+      tv_send(tv, initiator, data, sizeof(data));
+    } break;
+    case 0x9f: {  // Get CEC Version
+      uint8_t data[] = {0x9e, 0x05};
+      tv_send(tv, initiator, data, sizeof(data));
+    } break;
+    case 0x46: {  // Give OSD Name
+      uint8_t data[] = {0x47, 'T', 'V'};
+      tv_send(tv, initiator, data, sizeof(data));
+    } break;
+    case 0x8c: {  // Give Device Vendor ID
+      uint8_t data[] = {0x87, 0x00, 0x00, 0x00};
+      tv_send(tv, 0xf, data, sizeof(data));
+    } break;
+  }
+}
+
+/**
+ * Let the line go after an acknowledge bit or a held low.
+ */
+static int64_t release(alarm_id_t alarm, void *user_data) {
+  tv_t *tv = user_data;
+
+  sim_gpio_drive(tv->pin, false);
+  return 0;
+}
+
+static void rx_bit(tv_t *tv, bool one) {
+  uint8_t header = (tv->rx.len == 0) ? tv->byte : tv->rx.pld[0];
+  bool broadcast = ((header & 0x0f) == 0x0f);
+
+  int bit = tv->bit++;
+  if (bit < 8) {
+    tv->byte = (tv->byte << 1) | one;
+    return;
+  }
+  if (bit == 8) {
+    tv->eom = one;
+    return;
+  }
+
+  if (tv->rx.len < sizeof(tv->rx.pld)) {
+    tv->rx.pld[tv->rx.len++] = tv->byte;
+  }
+  tv->bit = 0;
+  tv->byte = 0;
+
+  if (tv->eom) {
+    bool ack = (one == broadcast);
+    log_frame(tv, "rx", &tv->rx, ack ? "ack" : "nack");
+    if ((header & 0x0f) == TV_LADDR) {
+      tv_respond(tv, &tv->rx);
+    }
+    tv->bit = -1;
+  }
+}
+
+/**
+ * Follows every edge on the line, including those the TV makes itself.
+ */
+static void rx_watch(void *arg, bool high) {
+  tv_t *tv = arg;
+  uint64_t now = time_us_64();
+
+  tv->last_edge_us = now;
+  if (tv->state > TX_WAIT) {
+    // sending
+    return;
+  }
+
+  if (!high) {
+    tv->fall_us = now;
+    // the acknowledge bit of a frame for the TV
+    uint8_t header = (tv->rx.len == 0) ? tv->byte : tv->rx.pld[0];
+    if ((tv->bit == 9) && ((header & 0x0f) == TV_LADDR)) {
+      sim_gpio_drive(tv->pin, true);
+      add_alarm_at(from_us_since_boot(now + ZERO_LOW_US), release, tv, true);
+    }
+    return;
+  }
+
+  uint64_t low = now - tv->fall_us;
+  if ((low >= 3500) && (low <= 3900)) {
+    tv->bit = 0;
+    tv->byte = 0;
+    tv->eom = false;
+    tv->rx.len = 0;
+  } else if ((tv->bit >= 0) && (low >= 400) && (low <= 1900)) {
+    rx_bit(tv, low < SAMPLE_US);
+  } else {
+    tv->bit = -1;
+  }
+}
+
+//--------------------------------------------------------------------+
+// Input
+//--------------------------------------------------------------------+
+
+static bool parse_frame(const char *str, uint8_t *pld, uint8_t *len) {
+  *len = 0;
+  while ((*str != '\0') && (*str != '\n')) {
+    char *end;
+    unsigned long byte = strtoul(str, &end, 16);
+    if ((end == str) || (byte > 0xff) || (*len >= 16)) {
+      return false;
+    }
+    pld[(*len)++] = byte;
+
+    if (*end == ':') {
+      end++;
+    }
+    str = end;
+  }
+
+  return (*len > 0);
+}
+
+static void input_line(tv_t *tv, const char *line) {
+  uint8_t pld[16];
+  uint8_t len;
+  unsigned int ms;
+
+  if (sscanf(line, "low %u", &ms) == 1) {
+    sim_gpio_drive(tv->pin, true);
+    add_alarm_in_ms(ms, release, tv, true);
+  } else if (parse_frame(line, pld, &len) && ((pld[0] >> 4) == TV_LADDR)) {
+    tv_send(tv, pld[0] & 0x0f, &pld[1], len - 1);
+  } else {
+    const char *bad = "bad input, expected 0<destination>:<opcode>:... or low <ms>\n";
+    ssize_t ret = write(STDERR_FILENO, bad, strlen(bad));
+    (void)ret;
+  }
+}
+
+/**
+ * Read stdin without blocking the scheduler, a line at a time.
+ */
+static void input_task(void *param) {
+  static char line[128];
+  size_t len = 0;
+
+  while (true) {
+    struct pollfd fd = {STDIN_FILENO, POLLIN, 0};
+    if ((poll(&fd, 1, 0) <= 0) || !(fd.revents & (POLLIN | POLLHUP))) {
+      vTaskDelay(pdMS_TO_TICKS(TV_INPUT_MS));
+      continue;
+    }
+
+    char c;
+    ssize_t n = read(STDIN_FILENO, &c, 1);
+    if (n < 0) {
+      // interrupted by the tick
+      continue;
+    } else if (n == 0) {
+      // end of input, the bus carries on with what the firmware sends
+      vTaskSuspend(NULL);
+      continue;
+    }
+    if (c == '\n') {
+      line[len] = '\0';
+      if (len > 0) {
+        input_line(&tvs[0], line);
+      }
+      len = 0;
+    } else if (len < sizeof(line) - 1) {
+      line[len++] = c;
+    }
+  }
+}
+
+void sim_tv_init(void) {
+  static const uint8_t pins[] = {CEC_PINS};
+  static StackType_t stack[TV_STACK_SIZE];
+  static StaticTask_t tcb;
+
+  for (unsigned int i = 0; i < CEC_BUSES; i++) {
+    tvs[i].bus = i;
+    tvs[i].pin = pins[i];
+    tvs[i].bit = -1;
+    sim_gpio_watch(pins[i], rx_watch, &tvs[i]);
+  }
+
+  xTaskCreateStatic(input_task, "tv", TV_STACK_SIZE, NULL, 1, &stack[0], &tcb);
+}
@@ -0,0 +1,453 @@
+#define _DEFAULT_SOURCE
+#define _XOPEN_SOURCE 600
+
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <termios.h>
+#include <unistd.h>
+
+#if HAVE_UHID
+#include <linux/input.h>
+#include <linux/uhid.h>
+#endif
+
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
+
+#include "device/usbd_pvt.h"
+#include "tusb.h"
+
+#include "sim-stdio.h"
+#include "sim.h"
+
+/* The device task's side of USB.
+ *
+ * The console is a pseudo terminal, connected while a client has it open.
+ * Input reports go to a uhid device when PICO_CEC_SIM_HID is "uhid", which
+ * the host sees as the board's HID interface, are appended to the file it
+ * names otherwise, or printed.  Reports complete, and the CDC transmit
+ * completes, from the device task as the USB interrupt would have them.
+ */
+
+#define DEFER_QUEUE_LENGTH (16)
+
+typedef struct {
+  osal_task_func_t func;
+  void *param;
+} defer_t;
+
+static QueueHandle_t defer_queue;
+
+static bool mounted;
+
+static int console = -1;
+static bool connected;
+static uint8_t rx_buf[CFG_TUD_CDC_RX_BUFSIZE];
+static uint32_t rx_head;
+static uint32_t rx_tail;
+static uint8_t tx_buf[CFG_TUD_CDC_TX_BUFSIZE];
+static uint32_t tx_len;
+
+typedef enum {
+  HID_SINK_PRINT = 0,
+  HID_SINK_FILE,
+  HID_SINK_UHID,
+} hid_sink_t;
+
+static hid_sink_t hid_sink;
+static int hid_fd = -1;
+static bool hid_pending;
+static uint8_t hid_report[CFG_TUD_HID_EP_BUFSIZE + 1];
+static uint16_t hid_report_len;
+
+void usbd_defer_func(osal_task_func_t func, void *param, bool in_isr) {
+  defer_t defer = {func, param};
+
+  if (in_isr) {
+    xQueueSendFromISR(defer_queue, &defer, NULL);
+  } else {
+    xQueueSend(defer_queue, &defer, portMAX_DELAY);
+  }
+}
+
+//--------------------------------------------------------------------+
+// CDC
+//--------------------------------------------------------------------+
+
+bool tud_cdc_connected(void) {
+  return connected;
+}
+
+uint32_t tud_cdc_available(void) {
+  return rx_head - rx_tail;
+}
+
+int32_t tud_cdc_read_char(void) {
+  int32_t c = -1;
+
+  taskENTER_CRITICAL();
+  if (rx_head != rx_tail) {
+    c = rx_buf[rx_tail++ % sizeof(rx_buf)];
+  }
+  taskEXIT_CRITICAL();
+
+  return c;
+}
+
+uint32_t tud_cdc_read(void *buffer, uint32_t bufsize) {
+  uint8_t *dst = buffer;
+  uint32_t n = 0;
+
+  for (int32_t c; (n < bufsize) && ((c = tud_cdc_read_char()) >= 0); n++) {
+    dst[n] = c;
+  }
+  return n;
+}
+
+void tud_cdc_read_flush(void) {
+  taskENTER_CRITICAL();
+  rx_tail = rx_head;
+  taskEXIT_CRITICAL();
+}
+
+uint32_t tud_cdc_write_available(void) {
+  return sizeof(tx_buf) - tx_len;
+}
+
+uint32_t tud_cdc_write(void const *buffer, uint32_t bufsize) {
+  taskENTER_CRITICAL();
+  uint32_t n = (bufsize < sizeof(tx_buf) - tx_len) ? bufsize : (sizeof(tx_buf) - tx_len);
+  memcpy(&tx_buf[tx_len], buffer, n);
+  tx_len += n;
+  taskEXIT_CRITICAL();
+
+  return n;
+}
+
+static void cdc_tx_complete(void *param) {
+  tud_cdc_tx_complete_cb(0);
+}
+
+uint32_t tud_cdc_write_flush(void) {
+  ssize_t n = 0;
+
+  taskENTER_CRITICAL();
+  if ((tx_len > 0) && connected) {
+    n = write(console, tx_buf, tx_len);
+    if (n > 0) {
+      memmove(tx_buf, &tx_buf[n], tx_len - n);
+      tx_len -= n;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  if (n <= 0) {
+    return 0;
+  }
+  usbd_defer_func(cdc_tx_complete, NULL, false);
+  return n;
+}
+
+/**
+ * Follow the client opening and closing the pty as DTR, and take its input.
+ */
+static void console_poll(void) {
+  struct pollfd fd = {console, POLLIN, 0};
+
+  if (poll(&fd, 1, 0) < 0) {
+    return;
+  }
+
+  // the master hangs up while no client has the pty open
+  bool open = !(fd.revents & POLLHUP);
+  if (open != connected) {
+    connected = open;
+    tud_cdc_line_state_cb(0, open, open);
+    if (!open) {
+      tx_len = 0;
+    }
+  }
+
+  if (!(fd.revents & POLLIN) || (rx_head - rx_tail == sizeof(rx_buf))) {
+    return;
+  }
+
+  uint8_t data[sizeof(rx_buf)];
+  ssize_t n = read(console, data, sizeof(rx_buf) - (rx_head - rx_tail));
+  if (n <= 0) {
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  for (ssize_t i = 0; i < n; i++) {
+    rx_buf[rx_head++ % sizeof(rx_buf)] = data[i];
+  }
+  taskEXIT_CRITICAL();
+  tud_cdc_rx_cb(0);
+
+  // keep the output moving while the CDC task waits for room
+  if (tx_len > 0) {
+    tud_cdc_write_flush();
+  }
+}
+
+static void console_init(void) {
+  console = posix_openpt(O_RDWR | O_NOCTTY | O_NONBLOCK);
+  if ((console < 0) || (grantpt(console) != 0) || (unlockpt(console) != 0)) {
+    fprintf(stderr, "pty: %s\n", strerror(errno));
+    exit(EXIT_FAILURE);
+  }
+
+  // raw bytes both ways until the client sets its own line discipline
+  struct termios tio;
+  tcgetattr(console, &tio);
+  cfmakeraw(&tio);
+  tcsetattr(console, TCSANOW, &tio);
+
+  const char *name = ptsname(console);
+  const char *link = getenv("PICO_CEC_SIM_CONSOLE");
+  if (link != NULL) {
+    unlink(link);
+    if (symlink(name, link) != 0) {
+      fprintf(stderr, "%s: %s\n", link, strerror(errno));
+      exit(EXIT_FAILURE);
+    }
+  }
+  fprintf(stderr, "console %s\n", name);
+}
+
+//--------------------------------------------------------------------+
+// HID
+//--------------------------------------------------------------------+
+
+static void hid_complete(void *param) {
+  hid_pending = false;
+  tud_hid_report_complete_cb(0, hid_report, hid_report_len);
+}
+
+bool tud_hid_ready(void) {
+  return mounted && !hid_pending;
+}
+
+bool tud_hid_report(uint8_t report_id, void const *report, uint16_t len) {
+  if (!tud_hid_ready() || (len > CFG_TUD_HID_EP_BUFSIZE)) {
+    return false;
+  }
+
+  hid_pending = true;
+  hid_report[0] = report_id;
+  memcpy(&hid_report[1], report, len);
+  hid_report_len = len + 1;
+
+  switch (hid_sink) {
+    case HID_SINK_PRINT: {
+      char line[3 * sizeof(hid_report) + 8];
+      int n = snprintf(line, sizeof(line), "hid");
+      for (uint16_t i = 0; i < hid_report_len; i++) {
+        n += snprintf(&line[n], sizeof(line) - n, (i == 0) ? " %02x" : ":%02x", hid_report[i]);
+      }
+      sim_printf("%s\n", line);
+    } break;
+
+    case HID_SINK_FILE: {
+      ssize_t ret = write(hid_fd, hid_report, hid_report_len);
+      (void)ret;
+    } break;
+
+    case HID_SINK_UHID: {
+#if HAVE_UHID
+      struct uhid_event ev = {.type = UHID_INPUT2};
+      ev.u.input2.size = hid_report_len;
+      memcpy(ev.u.input2.data, hid_report, hid_report_len);
+      ssize_t ret = write(hid_fd, &ev, sizeof(ev));
+      (void)ret;
+#endif
+    } break;
+  }
+
+  usbd_defer_func(hid_complete, NULL, false);
+  return true;
+}
+
+bool tud_hid_keyboard_report(uint8_t report_id, uint8_t modifier, uint8_t const keycode[6]) {
+  uint8_t report[8] = {modifier};
+
+  if (keycode != NULL) {
+    memcpy(&report[2], keycode, 6);
+  }
+  return tud_hid_report(report_id, report, sizeof(report));
+}
+
+#if HAVE_UHID
+static const hid_report_type_t report_types[] = {
+    [UHID_FEATURE_REPORT] = HID_REPORT_TYPE_FEATURE,
+    [UHID_OUTPUT_REPORT] = HID_REPORT_TYPE_OUTPUT,
+    [UHID_INPUT_REPORT] = HID_REPORT_TYPE_INPUT,
+};
+
+/**
+ * Length of the report descriptor, from the HID descriptor in the
+ * configuration.
+ */
+static uint16_t report_desc_len(void) {
+  const uint8_t *config = tud_descriptor_configuration_cb(0);
+  uint16_t total = config[2] | (config[3] << 8);
+
+  for (uint16_t i = 0; (i + 1 < total) && (config[i] > 0); i += config[i]) {
+    if ((config[i + 1] == HID_DESC_TYPE_HID) && (i + 8 < total)) {
+      return config[i + 7] | (config[i + 8] << 8);
+    }
+  }
+  return 0;
+}
+
+static void uhid_init(void) {
+  const tusb_desc_device_t *device = (const tusb_desc_device_t *)tud_descriptor_device_cb();
+  struct uhid_event ev = {.type = UHID_CREATE2};
+
+  hid_fd = open("/dev/uhid", O_RDWR | O_NONBLOCK | O_CLOEXEC);
+  if (hid_fd < 0) {
+    perror("/dev/uhid");
+    exit(EXIT_FAILURE);
+  }
+
+  snprintf((char *)ev.u.create2.name, sizeof(ev.u.create2.name), "pico-cec simulator");
+  ev.u.create2.rd_size = report_desc_len();
+  memcpy(ev.u.create2.rd_data, tud_hid_descriptor_report_cb(0), ev.u.create2.rd_size);
+  ev.u.create2.bus = BUS_USB;
+  ev.u.create2.vendor = device->idVendor;
+  ev.u.create2.product = device->idProduct;
+  ev.u.create2.version = device->bcdDevice;
+  if (write(hid_fd, &ev, sizeof(ev)) != sizeof(ev)) {
+    perror("uhid create");
+    exit(EXIT_FAILURE);
+  }
+}
+
+/**
+ * Serve the requests the host makes of the interface.  Reports start with
+ * their ID, which the callbacks get apart as TinyUSB does.
+ */
+static void uhid_poll(void) {
+  struct uhid_event ev;
+
+  while (read(hid_fd, &ev, sizeof(ev)) > 0) {
+    switch (ev.type) {
+      case UHID_OUTPUT:
+        if ((ev.u.output.size > 0) && (ev.u.output.rtype < 3)) {
+          tud_hid_set_report_cb(0, ev.u.output.data[0], report_types[ev.u.output.rtype],
+                                &ev.u.output.data[1], ev.u.output.size - 1);
+        }
+        break;
+
+      case UHID_GET_REPORT: {
+        struct uhid_event reply = {.type = UHID_GET_REPORT_REPLY};
+        reply.u.get_report_reply.id = ev.u.get_report.id;
+        reply.u.get_report_reply.data[0] = ev.u.get_report.rnum;
+        uint16_t len = (ev.u.get_report.rtype < 3)
+                           ? tud_hid_get_report_cb(0, ev.u.get_report.rnum,
+                                                   report_types[ev.u.get_report.rtype],
+                                                   &reply.u.get_report_reply.data[1],
+                                                   sizeof(reply.u.get_report_reply.data) - 1)
+                           : 0;
+        reply.u.get_report_reply.err = (len > 0) ? 0 : EIO;
+        reply.u.get_report_reply.size = (len > 0) ? (len + 1) : 0;
+        ssize_t ret = write(hid_fd, &reply, sizeof(reply));
+        (void)ret;
+      } break;
+
+      case UHID_SET_REPORT: {
+        struct uhid_event reply = {.type = UHID_SET_REPORT_REPLY};
+        if ((ev.u.set_report.size > 0) && (ev.u.set_report.rtype < 3)) {
+          tud_hid_set_report_cb(0, ev.u.set_report.rnum, report_types[ev.u.set_report.rtype],
+                                &ev.u.set_report.data[1], ev.u.set_report.size - 1);
+        }
+        reply.u.set_report_reply.id = ev.u.set_report.id;
+        ssize_t ret = write(hid_fd, &reply, sizeof(reply));
+        (void)ret;
+      } break;
+
+      default:
+        break;
+    }
+  }
+}
+#endif
+
+static void hid_init(void) {
+  const char *sink = getenv("PICO_CEC_SIM_HID");
+
+  if (sink == NULL) {
+    hid_sink = HID_SINK_PRINT;
+  } else if (strcmp(sink, "uhid") == 0) {
+#if HAVE_UHID
+    hid_sink = HID_SINK_UHID;
+    uhid_init();
+#else
+    fprintf(stderr, "uhid: not supported on this host\n");
+    exit(EXIT_FAILURE);
+#endif
+  } else {
+    hid_sink = HID_SINK_FILE;
+    hid_fd = open(sink, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644);
+    if (hid_fd < 0) {
+      perror(sink);
+      exit(EXIT_FAILURE);
+    }
+  }
+}
+
+//--------------------------------------------------------------------+
+// Device
+//--------------------------------------------------------------------+
+
+bool tud_init(uint8_t rhport) {
+  mounted = true;
+  tud_mount_cb();
+  return true;
+}
+
+void tud_task(void) {
+  defer_t defer;
+
+  if (xQueueReceive(defer_queue, &defer, 1) == pdTRUE) {
+    defer.func(defer.param);
+    while (xQueueReceive(defer_queue, &defer, 0) == pdTRUE) {
+      defer.func(defer.param);
+    }
+  }
+
+  console_poll();
+#if HAVE_UHID
+  if (hid_sink == HID_SINK_UHID) {
+    uhid_poll();
+  }
+#endif
+}
+
+bool tud_mounted(void) {
+  return mounted;
+}
+
+bool tud_suspended(void) {
+  return false;
+}
+
+bool tud_remote_wakeup(void) {
+  return true;
+}
+
+void sim_usb_init(void) {
+  static StaticQueue_t queue;
+  static uint8_t storage[DEFER_QUEUE_LENGTH * sizeof(defer_t)];
+
+  defer_queue = xQueueCreateStatic(DEFER_QUEUE_LENGTH, sizeof(defer_t), storage, &queue);
+
+  console_init();
+  hid_init();
+}
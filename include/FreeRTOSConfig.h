@@ -66,7 +66,7 @@
 #define configUSE_NEWLIB_REENTRANT 0
 #define configENABLE_BACKWARD_COMPATIBILITY 1
 #define configSTACK_ALLOCATION_FROM_SEPARATE_HEAP 0
-#define configTASK_NOTIFICATION_ARRAY_ENTRIES 2
+#define configTASK_NOTIFICATION_ARRAY_ENTRIES 3  // 0 and 1 per task, 2 for cec_transact()
 
 #define configSUPPORT_STATIC_ALLOCATION 1
 #define configSUPPORT_DYNAMIC_ALLOCATION 0
@@ -136,6 +136,30 @@
 #define configASSERT(x) (void)(x)
 #endif
 
+/* Scheduler event trace, the hooks expand inside tasks.c and queue.c. */
+#if PICO_CEC_SCHED_TRACE && !defined(__ASSEMBLER__)
+#include "sched-trace.h"
+
+#define traceTASK_SWITCHED_IN() \
+  sched_trace_record(SCHED_TRACE_SWITCH_IN, 0, pxCurrentTCB->uxTCBNumber)
+#define traceTASK_NOTIFY(uxIndexToNotify) \
+  sched_trace_record(SCHED_TRACE_NOTIFY, (uxIndexToNotify), pxTCB->uxTCBNumber)
+#define traceTASK_NOTIFY_FROM_ISR(uxIndexToNotify) \
+  sched_trace_record(SCHED_TRACE_NOTIFY_FROM_ISR, (uxIndexToNotify), pxTCB->uxTCBNumber)
+#define traceTASK_NOTIFY_GIVE_FROM_ISR(uxIndexToNotify) \
+  sched_trace_record(SCHED_TRACE_NOTIFY_FROM_ISR, (uxIndexToNotify), pxTCB->uxTCBNumber)
+#define traceQUEUE_SEND(pxQueue) \
+  sched_trace_record(SCHED_TRACE_QUEUE_SEND, 0, SCHED_TRACE_QUEUE(pxQueue))
+#define traceQUEUE_SEND_FROM_ISR(pxQueue) \
+  sched_trace_record(SCHED_TRACE_QUEUE_SEND_FROM_ISR, 0, SCHED_TRACE_QUEUE(pxQueue))
+#define traceQUEUE_RECEIVE(pxQueue) \
+  sched_trace_record(SCHED_TRACE_QUEUE_RECEIVE, 0, SCHED_TRACE_QUEUE(pxQueue))
+#define traceQUEUE_RECEIVE_FROM_ISR(pxQueue) \
+  sched_trace_record(SCHED_TRACE_QUEUE_RECEIVE_FROM_ISR, 0, SCHED_TRACE_QUEUE(pxQueue))
+#define traceBLOCKING_ON_QUEUE_RECEIVE(pxQueue) \
+  sched_trace_record(SCHED_TRACE_QUEUE_BLOCK, 0, SCHED_TRACE_QUEUE(pxQueue))
+#endif
+
 /* FreeRTOS hooks to NVIC vectors */
 #define xPortPendSVHandler PendSV_Handler
 #define xPortSysTickHandler SysTick_Handler
@@ -0,0 +1,58 @@
+#ifndef BENCH_H
+#define BENCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "hardware/clocks.h"
+#include "hardware/structs/systick.h"
+#include "hardware/timer.h"
+
+/* Micro-benchmarks of the firmware's hot paths, for comparing builds on the
+ * same hardware.
+ *
+ * The Cortex-M0+ has no cycle counter, so cycles are read from the SysTick
+ * the scheduler runs at the processor clock.  It wraps every tick, so a
+ * measurement longer than half a tick falls back to the microsecond timer.
+ * SysTick is per core, a measurement must start and end on the same one.
+ */
+
+/* Cycles of a run that could not be measured. */
+#define BENCH_SKIPPED (UINT32_MAX)
+
+typedef void (*bench_print_t)(void *arg, const char *str);
+
+typedef struct {
+  uint32_t ticks;  // SysTick current value, counting down
+  uint32_t us;
+} bench_mark_t;
+
+static inline bench_mark_t bench_mark(void) {
+  return (bench_mark_t){systick_hw->cvr, time_us_32()};
+}
+
+/**
+ * Cycles since the mark.
+ */
+static inline uint32_t bench_cycles(bench_mark_t start) {
+  uint32_t ticks = systick_hw->cvr;
+  uint32_t us = time_us_32() - start.us;
+
+  if (us >= (500000 / configTICK_RATE_HZ)) {
+    return us * (clock_get_hz(clk_sys) / 1000000);
+  }
+
+  // wrapped at most once since the mark
+  return (start.ticks >= ticks) ? (start.ticks - ticks)
+                                : (start.ticks + systick_hw->rvr + 1 - ticks);
+}
+
+/**
+ * Run each benchmark the given number of times and print the minimum, median
+ * and maximum in microseconds and cycles.  Runs on the calling task, which
+ * must be bound to the core taking the CEC interrupts.
+ */
+void bench_run(unsigned int runs, bench_print_t print, void *arg);
+
+#endif
@@ -0,0 +1,29 @@
+#ifndef BOOT_TIME_H
+#define BOOT_TIME_H
+
+#include <stdint.h>
+
+/* Steps from reset to the first key reaching the host, each timed once. */
+typedef enum {
+  BOOT_LINE_IDLE = 0,    // CEC line released and idle
+  BOOT_ADDRESS = 1,      // logical address allocated and announced
+  BOOT_EDID = 2,         // physical address read from the sink
+  BOOT_USB_MOUNTED = 3,  // configured by the USB host
+  BOOT_FIRST_KEY = 4,    // first key report accepted by the USB stack
+  BOOT_COUNT = 5,
+} boot_step_t;
+
+/**
+ * Note the time a step was first reached, later calls are ignored.
+ */
+void boot_mark(boot_step_t step);
+
+/**
+ * Milliseconds from reset to the step, 0 if not reached yet.
+ */
+uint32_t boot_time_ms(boot_step_t step);
+
+/* Step names for display. */
+extern const char *boot_step_name[BOOT_COUNT];
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef CAPTURE_H
+#define CAPTURE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Binary bus capture streamed over the USB vendor interface.
+ *
+ * The stream is a sequence of records, each a header followed by len bytes of
+ * payload.  Multi-byte fields are little endian.  The host selects what is
+ * captured by writing a single mode byte to the OUT endpoint.
+ */
+
+#define CAPTURE_VID (0xcafe)
+
+/* Modes written by the host. */
+#define CAPTURE_MODE_OFF (0)
+#define CAPTURE_MODE_FRAMES (1)
+#define CAPTURE_MODE_EDGES (2)  // frames and every line edge
+
+/* Record types. */
+#define CAPTURE_FRAME (1)    // payload is the frame
+#define CAPTURE_EDGE (2)     // no payload
+#define CAPTURE_OVERRUN (3)  // payload is the uint32_t count of records lost before this one
+
+/* Frame flags. */
+#define CAPTURE_FLAG_TX (1 << 0)     // sent by this device
+#define CAPTURE_FLAG_ACK (1 << 1)    // acknowledged by a follower
+#define CAPTURE_FLAG_ERROR (1 << 2)  // abandoned part way, payload is the bytes received
+
+/* Edge flags. */
+#define CAPTURE_FLAG_HIGH (1 << 0)  // line high after the edge
+
+typedef struct __attribute__((packed)) {
+  uint8_t type;
+  uint8_t flags;
+  uint8_t len;
+  uint8_t bus;       // index of the bus, 0 unless several are served
+  uint32_t time_us;  // low 32 bits of the time since boot
+} capture_record_t;
+
+/* Size of each half of the double buffer, also the largest USB transfer. */
+#define CAPTURE_BUF_SIZE (2048)
+
+typedef struct {
+  uint32_t records;
+  uint32_t transfers;
+  uint32_t bytes;
+  uint32_t flow_waits;  // data ready while the host still had the other buffer
+  uint32_t overruns;    // records lost with both buffers full
+} capture_stats_t;
+
+extern volatile capture_stats_t capture_stats;
+
+/**
+ * Record a frame received or sent.  Safe from any task.
+ */
+void capture_frame(uint8_t bus, uint64_t time_us, const uint8_t *pld, uint8_t len, uint8_t flags);
+
+/**
+ * Record a line edge.  Interrupt context only.
+ */
+void capture_edge(uint8_t bus, uint64_t time_us, bool high);
+
+/**
+ * Select what is captured, capture is off until the host asks for it.
+ */
+void capture_set_mode(uint8_t mode);
+
+uint8_t capture_get_mode(void);
+
+/**
+ * Called with interrupts possibly disabled when the first record is waiting
+ * and no transfer is in flight, to start one from the USB task.
+ */
+void capture_set_kick(void (*kick)(bool in_isr));
+
+/**
+ * Hand the filled buffer to the USB stack, returns NULL if it is empty or the
+ * other buffer has not been released yet.
+ */
+uint8_t *capture_take(uint16_t *len);
+
+/**
+ * Give back the buffer from capture_take() once its transfer completes.
+ */
+void capture_release(void);
+
+/**
+ * Stop capturing and drop everything buffered, eg. on a USB reset.
+ */
+void capture_reset(void);
+
+#endif
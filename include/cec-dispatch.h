@@ -0,0 +1,55 @@
+#ifndef CEC_DISPATCH_H
+#define CEC_DISPATCH_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cec-protocol.h"
+
+/* Device side effects of the protocol logic, supplied by the caller. */
+typedef struct {
+  // transmit a frame, returns the acknowledge bit as seen on the bus
+  bool (*send)(void *arg, uint8_t *pld, uint8_t len);
+  // user control code pressed, or released with code 0
+  void (*user_control)(void *arg, uint8_t code, bool pressed);
+  // read the physical address from the sink, 0x0000 if unknown
+  uint16_t (*physical_address)(void *arg);
+} cec_dispatch_ops_t;
+
+typedef struct {
+  const cec_dispatch_ops_t *ops;
+  void *arg;
+
+  uint8_t laddr;
+  uint16_t paddr;
+  uint8_t power_status;
+  uint8_t deck_info;
+} cec_dispatch_t;
+
+/**
+ * Opcode name for logging, NULL where unknown.
+ */
+const char *cec_message(uint8_t opcode);
+
+/**
+ * Initialise the protocol state, no frames are sent.
+ */
+void cec_dispatch_init(cec_dispatch_t *dispatch, const cec_dispatch_ops_t *ops, void *arg);
+
+/**
+ * Read the physical address, allocate a logical address and announce both.
+ */
+void cec_dispatch_announce(cec_dispatch_t *dispatch);
+
+/**
+ * Take a physical address learnt after the announcement, reporting it if it
+ * changed.
+ */
+void cec_dispatch_set_physical_address(cec_dispatch_t *dispatch, uint16_t paddr);
+
+/**
+ * Act on a received frame, sending any replies.
+ */
+void cec_dispatch_frame(cec_dispatch_t *dispatch, const uint8_t *pld, uint8_t len);
+
+#endif
@@ -0,0 +1,71 @@
+#ifndef CEC_FILTER_H
+#define CEC_FILTER_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "cec-protocol.h"
+
+/* Receive filter decisions, taken in the edge interrupt as the header and
+ * opcode blocks of a frame arrive.  Free of the hardware, so the host checks
+ * run the same decisions. */
+
+/* Opcodes passed to the task, one bit each. */
+typedef struct {
+  uint32_t broadcast[256 / 32];
+  uint32_t directed[256 / 32];  // directed to another device
+} cec_filter_t;
+
+typedef enum {
+  CEC_FILTER_KEEP = 0,     // pass the frame, or decide at the next block
+  CEC_FILTER_DROP_POLL,    // header block only
+  CEC_FILTER_DROP_OTHER,   // directed to another device, of an unsubscribed opcode
+  CEC_FILTER_DROP_OPCODE,  // broadcast of an unsubscribed opcode
+} cec_filter_verdict_t;
+
+/**
+ * Subscribe only the opcodes the protocol logic and topology act on.
+ */
+void cec_filter_init(cec_filter_t *filter);
+
+/**
+ * Pass, or drop, an opcode broadcast or directed to another device.
+ */
+void cec_filter_set(cec_filter_t *filter, uint8_t opcode, bool directed, bool subscribed);
+
+static inline bool cec_filter_get(const cec_filter_t *filter, uint8_t opcode, bool directed) {
+  const uint32_t *set = directed ? filter->directed : filter->broadcast;
+
+  return set[opcode >> 5] & (1u << (opcode & 0x1f));
+}
+
+/**
+ * Decide on a frame once len blocks of data have arrived, eom set if the last
+ * was the end of the message.  Frames to an address in ack_mask are kept, the
+ * rest are decided at the opcode.
+ */
+static inline cec_filter_verdict_t cec_filter_check(const cec_filter_t *filter,
+                                                    const uint8_t *data,
+                                                    uint8_t len,
+                                                    bool eom,
+                                                    uint16_t ack_mask) {
+  uint8_t destination = data[0] & 0x0f;
+
+  if (len == 1) {
+    return eom ? CEC_FILTER_DROP_POLL : CEC_FILTER_KEEP;
+  } else if (len > 2) {
+    return CEC_FILTER_KEEP;
+  }
+
+  if (destination == 0x0f) {
+    return cec_filter_get(filter, data[1], false) ? CEC_FILTER_KEEP : CEC_FILTER_DROP_OPCODE;
+  } else if (ack_mask & (1 << destination)) {
+    return CEC_FILTER_KEEP;
+  } else if ((destination == 0x00) && (data[1] == CEC_ID_GIVE_DEVICE_POWER_STATUS)) {
+    // answered in place of an absent TV
+    return CEC_FILTER_KEEP;
+  }
+  return cec_filter_get(filter, data[1], true) ? CEC_FILTER_KEEP : CEC_FILTER_DROP_OTHER;
+}
+
+#endif
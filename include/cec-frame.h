@@ -0,0 +1,13 @@
+#ifndef CEC_FRAME_H
+#define CEC_FRAME_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/**
+ * Parse a frame written as colon separated hex bytes, eg. 4f:82:10:00, into
+ * pld, which holds 16 bytes.  Returns false if the string is anything else.
+ */
+bool cec_frame_parse(const char *str, uint8_t *pld, uint8_t *len);
+
+#endif
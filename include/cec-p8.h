@@ -0,0 +1,146 @@
+#ifndef CEC_P8_H
+#define CEC_P8_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+/* Pulse-Eight USB-CEC adapter serial protocol, as spoken by libcec and the
+ * Linux pulse8-cec driver.
+ *
+ * Messages are MSGSTART, a code byte, escaped parameters and MSGEND.  The top
+ * two bits of the code byte flag end of message and acknowledge on frame
+ * bytes.
+ */
+
+#define CEC_P8_MSGSTART (0xff)
+#define CEC_P8_MSGEND (0xfe)
+#define CEC_P8_MSGESC (0xfd)
+#define CEC_P8_ESCOFFSET (3)
+
+#define CEC_P8_FRAME_EOM (0x80)
+#define CEC_P8_FRAME_ACK (0x40)
+#define CEC_P8_CODE_MASK (0x3f)
+
+typedef enum {
+  CEC_P8_NOTHING = 0,
+  CEC_P8_PING = 1,
+  CEC_P8_TIMEOUT_ERROR = 2,
+  CEC_P8_HIGH_ERROR = 3,
+  CEC_P8_LOW_ERROR = 4,
+  CEC_P8_FRAME_START = 5,
+  CEC_P8_FRAME_DATA = 6,
+  CEC_P8_RECEIVE_FAILED = 7,
+  CEC_P8_COMMAND_ACCEPTED = 8,
+  CEC_P8_COMMAND_REJECTED = 9,
+  CEC_P8_SET_ACK_MASK = 10,
+  CEC_P8_TRANSMIT = 11,
+  CEC_P8_TRANSMIT_EOM = 12,
+  CEC_P8_TRANSMIT_IDLETIME = 13,
+  CEC_P8_TRANSMIT_ACK_POLARITY = 14,
+  CEC_P8_TRANSMIT_LINE_TIMEOUT = 15,
+  CEC_P8_TRANSMIT_SUCCEEDED = 16,
+  CEC_P8_TRANSMIT_FAILED_LINE = 17,
+  CEC_P8_TRANSMIT_FAILED_ACK = 18,
+  CEC_P8_TRANSMIT_FAILED_TIMEOUT_DATA = 19,
+  CEC_P8_TRANSMIT_FAILED_TIMEOUT_LINE = 20,
+  CEC_P8_FIRMWARE_VERSION = 21,
+  CEC_P8_START_BOOTLOADER = 22,
+  CEC_P8_GET_BUILDDATE = 23,
+  CEC_P8_SET_CONTROLLED = 24,
+  CEC_P8_GET_AUTO_ENABLED = 25,
+  CEC_P8_SET_AUTO_ENABLED = 26,
+  CEC_P8_GET_DEFAULT_LOGICAL_ADDRESS = 27,
+  CEC_P8_SET_DEFAULT_LOGICAL_ADDRESS = 28,
+  CEC_P8_GET_LOGICAL_ADDRESS_MASK = 29,
+  CEC_P8_SET_LOGICAL_ADDRESS_MASK = 30,
+  CEC_P8_GET_PHYSICAL_ADDRESS = 31,
+  CEC_P8_SET_PHYSICAL_ADDRESS = 32,
+  CEC_P8_GET_DEVICE_TYPE = 33,
+  CEC_P8_SET_DEVICE_TYPE = 34,
+  CEC_P8_GET_HDMI_VERSION = 35,
+  CEC_P8_SET_HDMI_VERSION = 36,
+  CEC_P8_GET_OSD_NAME = 37,
+  CEC_P8_SET_OSD_NAME = 38,
+  CEC_P8_WRITE_EEPROM = 39,
+  CEC_P8_GET_ADAPTER_TYPE = 40,
+  CEC_P8_SET_ACTIVE_SOURCE = 41,
+  CEC_P8_GET_AUTO_POWER_ON = 42,
+  CEC_P8_SET_AUTO_POWER_ON = 43,
+} cec_p8_code_t;
+
+/* Firmware version reported to the host, recent enough for every command above. */
+#define CEC_P8_FIRMWARE (12)
+
+/* Adapter type reported to the host, an external adapter. */
+#define CEC_P8_ADAPTER_EXTERNAL (1)
+
+/* Longest message, a code byte and an OSD name. */
+#define CEC_P8_MAX_MSG (16)
+
+/* Result of a transmission as reported to the host. */
+typedef enum {
+  CEC_P8_TX_OK = 0,
+  CEC_P8_TX_NACK = 1,
+  CEC_P8_TX_LINE = 2,  // lost arbitration or the bus never went idle
+} cec_p8_tx_t;
+
+/* Device side of the adapter, supplied by the caller. */
+typedef struct {
+  // send a frame on the bus and wait for the result
+  cec_p8_tx_t (*transmit)(void *arg, const uint8_t *pld, uint8_t len);
+  // write bytes to the host
+  void (*write)(void *arg, const uint8_t *data, size_t len);
+  // logical addresses to acknowledge for the host changed
+  void (*ack_mask)(void *arg, uint16_t mask);
+  // physical address read from the sink, 0x0000 if unknown
+  uint16_t (*physical_address)(void *arg);
+} cec_p8_ops_t;
+
+typedef struct {
+  const cec_p8_ops_t *ops;
+  void *arg;
+
+  // message being received from the host
+  uint8_t msg[CEC_P8_MAX_MSG];
+  uint8_t msg_len;
+  bool started;
+  bool escaped;
+
+  // frame being assembled for transmission
+  uint8_t tx[16];
+  uint8_t tx_len;
+
+  // configuration, kept for the session only
+  uint16_t ack_mask;
+  bool controlled;
+  bool auto_enabled;
+  bool auto_power_on;
+  uint8_t default_laddr;
+  uint16_t laddr_mask;
+  uint16_t paddr;
+  uint8_t device_type;
+  uint8_t hdmi_version;
+  uint8_t osd_name[14];
+  uint8_t osd_name_len;
+
+  uint32_t build_date;
+} cec_p8_t;
+
+/**
+ * Initialise the adapter state, build_date is reported to the host as seconds
+ * since the epoch.
+ */
+void cec_p8_init(cec_p8_t *p8, const cec_p8_ops_t *ops, void *arg, uint32_t build_date);
+
+/**
+ * Feed bytes received from the host, acting on each complete message.
+ */
+void cec_p8_input(cec_p8_t *p8, const uint8_t *data, size_t len);
+
+/**
+ * Pass a frame received from the bus to the host.
+ */
+void cec_p8_frame(cec_p8_t *p8, const uint8_t *pld, uint8_t len, bool ack);
+
+#endif
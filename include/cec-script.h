@@ -0,0 +1,55 @@
+#ifndef CEC_SCRIPT_H
+#define CEC_SCRIPT_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Number of stored scripts and the text space for each. */
+#define CEC_SCRIPT_MAX (4)
+#define CEC_SCRIPT_LEN (192)
+
+typedef void (*cec_script_print_t)(void *arg, const char *str);
+
+typedef struct {
+  uint32_t ok;
+  uint32_t failed;
+  uint32_t min_us;
+  uint32_t max_us;
+  uint64_t total_us;
+} cec_script_stats_t;
+
+/**
+ * Run a single step, one of:
+ *   tx <frame> [<opcode> [<timeout_ms>]]
+ *   wait <initiator> <opcode> [<timeout_ms>]
+ *   delay <ms>
+ *
+ * Returns 0 on success.  Latency is accumulated into stats if not NULL.
+ */
+int cec_script_step(int argc,
+                    const char **argv,
+                    cec_script_print_t print,
+                    void *arg,
+                    cec_script_stats_t *stats);
+
+/**
+ * Append a step to a stored script.
+ */
+bool cec_script_add(unsigned int n, int argc, const char **argv);
+
+/**
+ * Empty a stored script.
+ */
+void cec_script_clear(unsigned int n);
+
+/**
+ * Print the stored scripts.
+ */
+void cec_script_list(cec_script_print_t print, void *arg);
+
+/**
+ * Run a stored script count times and print the statistics.
+ */
+int cec_script_run(unsigned int n, unsigned int count, cec_script_print_t print, void *arg);
+
+#endif
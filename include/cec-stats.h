@@ -0,0 +1,54 @@
+#ifndef CEC_STATS_H
+#define CEC_STATS_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/* Bus, error and throughput counters.
+ *
+ * Counters are free running 32 bit values updated from the CEC interrupt
+ * handlers and tasks, readers take deltas so wrapping is harmless.
+ */
+typedef struct {
+  // receive
+  uint32_t rx_frames;
+  uint32_t rx_start_errors;   // start bit low time out of range
+  uint32_t rx_period_errors;  // bit period out of range
+  uint32_t rx_bit_errors;     // data bit low time out of range
+  uint32_t rx_ack_errors;     // acknowledge bit low time out of range
+  uint32_t rx_glitches;       // pulses ignored as too short
+  uint32_t rx_timeouts;       // next edge of a frame never came, line high
+  uint32_t line_low;          // line held low past any valid bit
+
+  // received, but dropped by the filter before waking the task
+  uint32_t rx_filtered_polls;
+  uint32_t rx_filtered_others;   // directed to another device
+  uint32_t rx_filtered_opcodes;  // broadcast of an unsubscribed opcode
+
+  // transmit
+  uint32_t tx_frames;
+  uint32_t tx_nacks;
+  uint32_t tx_retries;
+  uint32_t tx_collisions;  // lost arbitration or line held low
+  uint32_t tx_bus_busy;    // no signal free time within the timeout
+
+  // keys dropped on the way to the host
+  uint32_t hid_drops;
+
+  // time the bus carried a frame
+  uint32_t busy_us;
+
+  uint32_t initiator_frames[16];
+} cec_stats_t;
+
+extern volatile cec_stats_t cec_stats;
+
+/**
+ * Format a telemetry record as a single line of JSON.
+ *
+ * Totals are cumulative, utilisation and frame rates cover the time since the
+ * previous call.  Call from a single task only.
+ */
+int cec_stats_json(char *buf, size_t size, uint32_t now_ms);
+
+#endif
@@ -0,0 +1,99 @@
+#ifndef CEC_TIMING_H
+#define CEC_TIMING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Receive bit timing windows, in microseconds. */
+typedef struct {
+  uint16_t min;
+  uint16_t max;
+} cec_window_t;
+
+typedef struct {
+  cec_window_t start_low;     // start bit low time
+  cec_window_t start_period;  // start bit to first data bit
+  cec_window_t one_low;       // logical 1 low time
+  cec_window_t zero_low;      // logical 0 low time
+  cec_window_t period;        // data bit period
+  uint16_t glitch_us;         // low pulses shorter than this are ignored, 0 for off
+} cec_timing_t;
+
+typedef enum {
+  CEC_TIMING_SPEC = 0,     // receiver limits from the specification
+  CEC_TIMING_RELAXED = 1,  // wider windows and a glitch filter for marginal buses
+  CEC_TIMING_PROFILE_COUNT = 2,
+} cec_timing_profile_t;
+
+/* Index of the windows used until the initiator of a frame is known. */
+#define CEC_TIMING_UNKNOWN (16)
+
+/* Windows per bus and initiator, read by the receive interrupt handler. */
+extern cec_timing_t cec_timing[][CEC_TIMING_UNKNOWN + 1];
+
+extern const char *cec_timing_profile_name[CEC_TIMING_PROFILE_COUNT];
+
+/* Timings measured over one received frame. */
+typedef struct {
+  uint16_t start_low;
+  uint16_t ones;
+  uint16_t zeros;
+  uint16_t periods;
+  uint32_t one_sum;
+  uint32_t zero_sum;
+  uint32_t period_sum;
+} cec_timing_sample_t;
+
+/* Learnt timing of an initiator on a bus, averages in microseconds. */
+typedef struct {
+  uint32_t frames;
+  uint32_t errors;  // frames abandoned after the header
+  uint16_t start_low;
+  uint16_t one_low;
+  uint16_t zero_low;
+  uint16_t period;
+} cec_timing_stats_t;
+
+/**
+ * Select a tolerance profile, resetting the windows of every initiator on
+ * every bus.
+ */
+void cec_timing_set_profile(cec_timing_profile_t profile);
+
+cec_timing_profile_t cec_timing_get_profile(void);
+
+/**
+ * Set the glitch filter of every initiator, 0 for off.
+ */
+void cec_timing_set_glitch(uint16_t glitch_us);
+
+/**
+ * Recentre and widen each initiator's windows on its learnt timing on that
+ * bus, within safe limits.  Turning it off restores the profile windows.
+ */
+void cec_timing_set_adaptive(bool adaptive);
+
+bool cec_timing_get_adaptive(void);
+
+/**
+ * Fold the timing of a good frame into the initiator's statistics on the bus.
+ */
+void cec_timing_learn(uint8_t bus, uint8_t initiator, const cec_timing_sample_t *sample);
+
+/**
+ * Count a frame from the initiator on the bus abandoned part way through.
+ */
+void cec_timing_error(uint8_t bus, uint8_t initiator);
+
+/**
+ * Copy the statistics of an initiator on a bus, returns false if nothing was
+ * seen.
+ */
+bool cec_timing_stats(uint8_t bus, uint8_t initiator, cec_timing_stats_t *stats);
+
+/**
+ * Forget the learnt timings and restore the profile windows.
+ */
+void cec_timing_reset(void);
+
+#endif
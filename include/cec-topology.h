@@ -0,0 +1,70 @@
+#ifndef CEC_TOPOLOGY_H
+#define CEC_TOPOLOGY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Forget devices not heard from for this long. */
+#define CEC_TOPOLOGY_EXPIRY_MS (10 * 60 * 1000)
+
+#define CEC_TOPOLOGY_NUM_DEVICES (15)
+#define CEC_TOPOLOGY_OSD_NAME_LEN (14)
+
+/* Flags for the cached fields of a device. */
+#define CEC_DEVICE_PHYSICAL_ADDRESS (1 << 0)
+#define CEC_DEVICE_VENDOR_ID (1 << 1)
+#define CEC_DEVICE_OSD_NAME (1 << 2)
+#define CEC_DEVICE_POWER_STATUS (1 << 3)
+#define CEC_DEVICE_CEC_VERSION (1 << 4)
+
+typedef struct {
+  bool present;
+  uint8_t known;  // CEC_DEVICE_* flags
+  uint16_t physical_address;
+  uint8_t device_type;
+  uint32_t vendor_id;
+  char osd_name[CEC_TOPOLOGY_OSD_NAME_LEN + 1];
+  uint8_t power_status;
+  uint8_t cec_version;
+  uint32_t last_seen;  // ms since boot
+} cec_device_t;
+
+/**
+ * Learn from a frame observed on the bus.
+ */
+void cec_topology_observe(const uint8_t *pld, uint8_t len, uint32_t now);
+
+/**
+ * Note devices heard from in frames the receive filter dropped, a bit for
+ * each initiator.
+ */
+void cec_topology_seen(uint16_t initiators, uint32_t now);
+
+/**
+ * Drop devices not heard from within CEC_TOPOLOGY_EXPIRY_MS.
+ */
+void cec_topology_expire(uint32_t now);
+
+/**
+ * Copy the cached entry for a logical address, returns false if absent.
+ */
+bool cec_topology_get(uint8_t laddr, cec_device_t *device);
+
+/**
+ * Start an active scan of the bus, served by the CEC task.
+ */
+void cec_topology_scan(void);
+
+/**
+ * Fetch the next frame of an active scan to transmit.
+ *
+ * Returns false when there is nothing left to send.
+ */
+bool cec_topology_scan_next(uint8_t laddr, uint8_t *pld, uint8_t *len);
+
+/**
+ * Record the acknowledge result of a transmitted scan frame.
+ */
+void cec_topology_scan_result(const uint8_t *pld, bool ack, uint32_t now);
+
+#endif
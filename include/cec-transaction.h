@@ -0,0 +1,102 @@
+#ifndef CEC_TRANSACTION_H
+#define CEC_TRANSACTION_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+
+/* Maximum number of transactions outstanding at once. */
+#define CEC_TRANSACTION_MAX (4)
+
+/* Notification index used to wake a task blocked in cec_transact(), kept clear
+ * of the indices tasks use for their own events. */
+#define CEC_TRANSACTION_NOTIFY ((UBaseType_t)2)
+
+/* Transaction flags. */
+#define CEC_TRANSACTION_RAW (1 << 0)       // request includes the header block
+#define CEC_TRANSACTION_ACK_ONLY (1 << 1)  // complete on acknowledge, expect no response
+
+typedef enum {
+  CEC_TRANSACTION_QUEUED = 0,   // waiting for the bus
+  CEC_TRANSACTION_WAITING = 1,  // request sent, waiting for the response
+  CEC_TRANSACTION_OK = 2,       // response received
+  CEC_TRANSACTION_NACK = 3,     // request not acknowledged
+  CEC_TRANSACTION_ABORTED = 4,  // Feature Abort received
+  CEC_TRANSACTION_TIMEOUT = 5,  // no response in time
+  CEC_TRANSACTION_BUSY = 6,     // too many transactions outstanding
+} cec_transaction_status_t;
+
+typedef struct cec_transaction cec_transaction_t;
+
+struct cec_transaction {
+  // request, opcode and operands without the header block unless raw, an
+  // empty request only listens for the response
+  uint8_t flags;
+  uint8_t destination;
+  uint8_t request[16];
+  uint8_t request_len;
+
+  // expected response
+  uint8_t initiator;
+  uint8_t opcode;
+  uint32_t timeout_ms;
+
+  // completion callback, runs in the CEC task
+  void (*done)(cec_transaction_t *transaction);
+  void *arg;
+
+  // result
+  cec_transaction_status_t status;
+  uint8_t response[16];
+  uint8_t response_len;
+  uint8_t abort_reason;
+  uint32_t duration_us;  // request time on the wire
+
+  // private
+  uint32_t deadline;
+};
+
+/**
+ * Queue a transaction, completion is signalled through done().
+ *
+ * The transaction must stay valid until done() is called.  Returns false if
+ * too many transactions are outstanding.
+ */
+bool cec_transaction_submit(cec_transaction_t *transaction);
+
+/**
+ * Queue a transaction and block until it completes.
+ *
+ * Must not be called from the CEC task.
+ */
+cec_transaction_status_t cec_transact(cec_transaction_t *transaction);
+
+/**
+ * Fetch the next queued request to transmit, with its header block.
+ *
+ * Returns the transaction, or NULL if nothing is queued.
+ */
+cec_transaction_t *cec_transaction_next(uint8_t laddr, uint8_t *pld, uint8_t *len, uint32_t now);
+
+/**
+ * Record the acknowledge result and wire time of a transmitted request.
+ */
+void cec_transaction_sent(cec_transaction_t *transaction,
+                          bool ack,
+                          uint32_t duration_us,
+                          uint32_t now);
+
+/**
+ * Match a received frame against waiting transactions.
+ */
+void cec_transaction_receive(const uint8_t *pld, uint8_t len);
+
+/**
+ * Time out expired transactions.
+ *
+ * Returns milliseconds until the next deadline, or UINT32_MAX if none.
+ */
+uint32_t cec_transaction_expire(uint32_t now);
+
+#endif
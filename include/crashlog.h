@@ -0,0 +1,93 @@
+#ifndef CRASHLOG_H
+#define CRASHLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "pico/platform.h"
+
+#include "sched-trace.h"
+
+/* Post-mortem record of a HardFault or stack overflow.
+ *
+ * The fault handlers save the registers, the running task and the top of its
+ * stack, with the last frames on the buses and the last scheduler events,
+ * into RAM the runtime leaves uninitialised, then reboot through the
+ * watchdog.  The record survives the reboot, though not a power cycle, and
+ * is kept until cleared or overwritten by the next crash.
+ */
+
+/* Crash reasons. */
+typedef enum {
+  CRASHLOG_HARDFAULT = 0,
+  CRASHLOG_STACK_OVERFLOW = 1,
+  CRASHLOG_COUNT = 2,
+} crashlog_reason_t;
+
+/* Frames kept, oldest are overwritten. */
+#define CRASHLOG_FRAMES (16)
+
+/* Stack words saved from the stack pointer up. */
+#define CRASHLOG_STACK_WORDS (64)
+
+/* Scheduler events saved per core. */
+#define CRASHLOG_TRACE_EVENTS (32)
+
+typedef struct {
+  uint32_t time_ms;
+  uint8_t bus;
+  uint8_t flags;  // CAPTURE_FLAG_ values
+  uint8_t len;
+  uint8_t pld[16];
+} crashlog_frame_t;
+
+typedef struct {
+  uint32_t magic;
+  uint32_t reason;   // crashlog_reason_t
+  uint32_t time_ms;  // since boot
+  uint32_t boots;    // reboots since the crash
+  uint32_t core;
+  uint32_t ipsr;  // exception number running at the time, 0 in a task
+  char task[16];
+  // stacked by the exception entry, zero after a stack overflow
+  uint32_t r0, r1, r2, r3, r12, lr, pc, xpsr;
+  uint32_t sp;
+  uint32_t stack_words;
+  uint32_t stack[CRASHLOG_STACK_WORDS];
+  uint32_t num_frames;
+  crashlog_frame_t frames[CRASHLOG_FRAMES];  // oldest first
+  uint32_t num_events[NUM_CORES];
+  sched_trace_event_t events[NUM_CORES][CRASHLOG_TRACE_EVENTS];  // oldest first, per core
+  uint32_t checksum;
+} crashlog_t;
+
+extern const char *crashlog_reason_name[CRASHLOG_COUNT];
+
+/**
+ * Keep the record of a crash before the last reboot, or forget an invalid
+ * one.  Call once at startup, before anything can crash.
+ */
+void crashlog_init(void);
+
+/**
+ * Remember a frame received or sent, for the record.  Safe from tasks and
+ * interrupts.
+ */
+void crashlog_frame(uint8_t bus, const uint8_t *pld, uint8_t len, uint8_t flags);
+
+/**
+ * The record of the last crash, NULL if there is none.
+ */
+const crashlog_t *crashlog_get(void);
+
+/**
+ * Forget the last crash.
+ */
+void crashlog_clear(void);
+
+/**
+ * Save a stack overflow and reboot, from the FreeRTOS hook.
+ */
+void crashlog_stack_overflow(const char *task);
+
+#endif
@@ -0,0 +1,23 @@
+#ifndef EDID_H
+#define EDID_H
+
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+
+#define EDID_BLOCK_SIZE (128)
+
+/**
+ * Verify the checksum of each 128 byte block.
+ */
+bool edid_verify(const uint8_t *edid, size_t len);
+
+/**
+ * Find the HDMI physical address in the first CTA extension block.
+ *
+ * Returns 0x0000 if the EDID is malformed or carries no HDMI vendor specific
+ * data block.
+ */
+uint16_t edid_physical_address(const uint8_t *edid, size_t len);
+
+#endif
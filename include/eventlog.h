@@ -0,0 +1,115 @@
+#ifndef EVENTLOG_H
+#define EVENTLOG_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Long-duration log of the frames on the buses, kept in flash.
+ *
+ * Frames are encoded compactly, a tag byte for the length and flags, the time
+ * since the previous record in milliseconds as a variable length number, then
+ * the frame bytes as they went over the wire.  Records gather in RAM and are
+ * written a page at a time from a low priority task on the USB core, only once
+ * the buses have been quiet for a while.  The reserved region at the end of
+ * flash is used as a ring of sectors, each erased in turn, so wear is spread
+ * evenly and the oldest records are overwritten first.  The log survives
+ * reboots and power cycles, and is numbered by boot.
+ */
+
+/* Bytes of flash reserved at its end, a multiple of the sector size. */
+#ifndef EVENTLOG_SIZE
+#define EVENTLOG_SIZE (256 * 1024)
+#endif
+
+/* Entry types. */
+#define EVENTLOG_ENTRY_FRAME (0)
+#define EVENTLOG_ENTRY_BOOT (1)
+
+typedef struct {
+  uint8_t type;  // EVENTLOG_ENTRY_ values
+  uint8_t bus;
+  uint8_t flags;  // CAPTURE_FLAG_ values
+  uint8_t len;
+  uint32_t boot;     // boots since the log was first written
+  uint32_t time_ms;  // since that boot
+  uint8_t pld[16];
+} eventlog_entry_t;
+
+/* Position of a reader in the log. */
+typedef struct {
+  uint32_t seq;  // sector being read, counted since the log was first written
+  uint16_t offset;
+  uint8_t bus;
+  uint32_t boot;
+  uint32_t time_ms;
+} eventlog_cursor_t;
+
+typedef struct {
+  uint32_t offset;   // of the region in flash
+  uint32_t sectors;  // sectors started since the log was first written
+  uint32_t boot;
+  uint32_t pending;  // bytes waiting to be written
+  bool enabled;      // false if the image reaches into the region
+} eventlog_info_t;
+
+typedef struct {
+  uint32_t records;  // logged since boot
+  uint32_t bytes;    // written to flash since boot
+  uint32_t pages;    // programmed since boot
+  uint32_t erases;   // since boot
+  uint32_t dropped;  // records lost with the RAM buffers full
+} eventlog_stats_t;
+
+extern volatile eventlog_stats_t eventlog_stats;
+
+#if PICO_CEC_EVENTLOG
+
+/**
+ * Find the end of the log, record the boot and start the writer task.  Call
+ * once before the scheduler starts.
+ */
+void eventlog_start(void);
+
+/**
+ * Log a frame received or sent.  Task context only.
+ */
+void eventlog_frame(uint8_t bus, const uint8_t *pld, uint8_t len, uint8_t flags);
+
+/**
+ * Log a frame the receive interrupt dropped.  Interrupt context only.
+ */
+void eventlog_frame_from_isr(uint8_t bus, const uint8_t *pld, uint8_t len, uint8_t flags);
+
+/**
+ * Write everything logged so far now, without waiting for the buses to go
+ * quiet.
+ */
+void eventlog_flush(void);
+
+/**
+ * Start the log afresh.  The records before are left in flash, but no longer
+ * read, until overwritten.
+ */
+void eventlog_clear(void);
+
+/**
+ * Place a cursor on the oldest record since the last clear.
+ */
+void eventlog_first(eventlog_cursor_t *cursor);
+
+/**
+ * Copy out the entry at the cursor and move past it, returns false at the
+ * end of the log.  Records overwritten while reading are skipped.
+ */
+bool eventlog_next(eventlog_cursor_t *cursor, eventlog_entry_t *entry);
+
+void eventlog_get_info(eventlog_info_t *info);
+
+#else
+
+#define eventlog_frame(bus, pld, len, flags) ((void)0)
+#define eventlog_frame_from_isr(bus, pld, len, flags) ((void)0)
+
+#endif
+
+#endif
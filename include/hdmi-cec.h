@@ -6,16 +6,38 @@
 #include <stdlib.h>
 
 #include "task.h"
+
+#include "cec-dispatch.h"
+#include "cec-protocol.h"
+#include "cec-timing.h"
+#include "key-ring.h"
+
 #define CEC_TASK_NAME "cec"
 
 #ifndef CEC_PIN
 #define CEC_PIN 3  // GPIO3 == D10 (Seeed Studio XIAO RP2040)
 #endif
 
+/* Pins of further HDMI CEC buses served at the same time, comma separated,
+ * eg. -DCEC_EXTRA_PINS=4,5.
+ */
+#ifdef CEC_EXTRA_PINS
+#define CEC_PINS CEC_PIN, CEC_EXTRA_PINS
+#else
+#define CEC_PINS CEC_PIN
+#endif
+
+/* Number of buses, one per pin. */
+#define CEC_BUSES (sizeof((const uint8_t[]){CEC_PINS}))
+
 #ifndef CEC_PHYS_ADDR
 #define CEC_PHYS_ADDR (0x1000)  // Default to 1.0.0.0
 #endif
 
+/* Physical addresses of the further buses, one per pin of CEC_EXTRA_PINS,
+ * eg. -DCEC_EXTRA_PADDRS=0x2000,0x3000.  Buses without one use CEC_PHYS_ADDR.
+ */
+
 typedef struct {
   uint8_t *data;
   uint8_t len;
@@ -33,7 +55,10 @@ typedef enum {
   HDMI_FRAME_STATE_ACK_WAIT = 8,
   HDMI_FRAME_STATE_ACK_END = 9,
   HDMI_FRAME_STATE_END = 10,
-  HDMI_FRAME_STATE_ABORT = 11
+  HDMI_FRAME_STATE_ABORT = 11,
+  HDMI_FRAME_STATE_DATA_SAMPLE = 12,
+  HDMI_FRAME_STATE_HOLD_LOW = 13,   // after a rising edge too early for a bit
+  HDMI_FRAME_STATE_HOLD_HIGH = 14,  // after a falling edge too early for a bit
 } hdmi_frame_state_t;
 
 typedef struct {
@@ -41,15 +66,132 @@ typedef struct {
   unsigned int bit;
   unsigned int byte;
   uint64_t start;
+  uint64_t begin;
   bool first;
   bool eom;
   bool ack;
-  uint8_t address;
+  bool collision;
+  uint16_t ack_mask;           // logical addresses to acknowledge
+  bool filter;                 // drop frames the task has no use for
+  volatile uint32_t *dropped;  // filter counter of a frame being dropped, NULL to keep it
+  volatile uint32_t *held;     // error counter of a hold, counted unless it was a glitch
   hdmi_frame_state_t state;
 } hdmi_frame_t;
 
-extern TaskHandle_t xCECTask;
+/* Receive state before the last edge, restored if the pulse it started turns
+ * out to be a glitch.
+ */
+typedef struct {
+  hdmi_frame_state_t state;
+  uint64_t start;
+  uint64_t edge;  // when it was taken
+  unsigned int byte;
+  unsigned int bit;
+  uint8_t data;  // the byte being received
+  bool first;
+  bool eom;
+  bool ack;
+  volatile uint32_t *dropped;
+  cec_timing_sample_t sample;
+} hdmi_frame_undo_t;
+
+/* One HDMI CEC bus and the device this board presents on it. */
+typedef struct {
+  uint8_t index;
+  uint8_t pin;
+  TaskHandle_t task;
+  key_ring_t *keys;
+
+  // receiver, driven by the edge interrupt
+  hdmi_frame_t rx_frame;
+  hdmi_message_t rx_message;
+  uint8_t rx_buffer[16];
+  hdmi_frame_undo_t rx_undo;
+  cec_timing_sample_t rx_sample;  // timing of the frame, learnt from once complete
+  const cec_timing_t *rx_timing;  // windows of the bus, per initiator
+  volatile uint16_t rx_seen;      // initiators of dropped frames, for the topology
+  bool rx_watching;               // the alarm watching a frame in flight is set
+
+  // transmitter, driven by alarms
+  hdmi_frame_t *tx_frame;
+  uint32_t tx_duration_us;  // time on the wire of the last frame
+
+  cec_dispatch_t dispatch;
+} cec_bus_t;
+
+/* Task notified of every frame received, eg. to flash an activity LED. */
+extern TaskHandle_t xCECActivityTask;
+
+/**
+ * Set up bus index on its pin, passing user control keys to the ring.  Called
+ * before the scheduler starts on the core the CEC tasks are bound to, which
+ * takes the edge interrupts.  The caller then creates a task running
+ * cec_task() with the bus as its parameter and stores its handle in the bus.
+ */
+cec_bus_t *cec_bus_init(unsigned int index, key_ring_t *keys);
 
 void cec_task(void *data);
 
+/**
+ * Wake the CEC tasks to service work queued from another task.  Console
+ * transactions, topology scans and an attached host use the first bus.
+ */
+void cec_wake(void);
+
+/**
+ * Hand received frames to a host instead of the built in protocol logic,
+ * acknowledging frames to the logical addresses in ack_mask.  A NULL frame
+ * callback gives the bus back to this device.
+ */
+void cec_set_host(void (*frame)(const uint8_t *pld, uint8_t len, bool ack), uint16_t ack_mask);
+
+/**
+ * Logical and physical address and power status of the first bus, the logical
+ * address is 0x0f until allocated.
+ */
+void cec_get_status(uint8_t *laddr, uint16_t *paddr, uint8_t *power_status);
+
+/**
+ * Drop frames the protocol logic has no use for in the edge interrupt, so they
+ * never wake the CEC tasks: polls and frames of unsubscribed opcodes, broadcast
+ * or directed to other devices.  Dropped frames are still acknowledged
+ * and counted.  The filter stands aside while a host is attached, a capture
+ * is running or transactions are outstanding.  On by default.
+ */
+void cec_filter_enable(bool enabled);
+
+bool cec_filter_enabled(void);
+
+/**
+ * Pass, or drop, an opcode broadcast or directed to another device.  The
+ * opcodes the protocol logic and topology act on are subscribed at startup.
+ */
+void cec_filter_subscribe(uint8_t opcode, bool directed, bool subscribed);
+
+bool cec_filter_subscribed(uint8_t opcode, bool directed);
+
+/**
+ * Hooks for the bench command, on a private bus that shares no state with the
+ * real ones.  Receive edges and transmit phases run as they would in their
+ * interrupts, each returning the cycles taken.  cec_bench_start() returns
+ * false if no pin is free to put the bus on.
+ */
+bool cec_bench_start(void);
+
+uint32_t cec_bench_rx_edge(uint64_t now, bool high);
+
+/**
+ * Receive on the private bus with the glitch filter set, starting afresh, and
+ * read back the frame last received there, 0 long if none has completed.
+ */
+void cec_bench_rx_glitch(uint16_t glitch_us);
+
+uint8_t cec_bench_rx_frame(uint8_t *pld);
+
+uint32_t cec_bench_tx_step(void);
+
+uint32_t cec_bench_keymap(uint8_t code);
+
+void cec_bench_stop(void);
+
 #endif
@@ -4,6 +4,20 @@
 #include <inttypes.h>
 #include <stdint.h>
 
+/**
+ * Start reading the EDID in the background, on_change is called from the DDC
+ * task whenever the physical address read differs from the last.
+ */
+void ddc_start(void (*on_change)(void));
+
+/**
+ * Physical address from the last EDID read, 0x0000 until one succeeds.
+ */
 uint16_t ddc_get_physical_address(void);
 
+/**
+ * Read the EDID again, the sink may have moved.
+ */
+void ddc_refresh(void);
+
 #endif
@@ -0,0 +1,64 @@
+#ifndef HID_COMMAND_H
+#define HID_COMMAND_H
+
+#include <stdint.h>
+
+/* CEC commands from the host over vendor defined HID reports.
+ *
+ * Host software queues a frame by writing a command output report, and reads
+ * results and bus state from the status feature report, through the
+ * operating system's generic HID driver.  Both use REPORT_ID_CEC.  Commands
+ * run as transactions on the first bus, a few may be in flight at once.
+ * Results are kept in order of completion, each status read takes the oldest,
+ * or reports HID_STATUS_NONE with the bus state alone.  Multi-byte fields are
+ * little endian.
+ */
+
+/* Command flags. */
+#define HID_COMMAND_ACK_ONLY (1 << 0)  // done once acknowledged, no reply expected
+#define HID_COMMAND_RAW (1 << 1)       // frame includes the header block
+
+/* Status values besides those of cec_transaction_status_t. */
+#define HID_STATUS_INVALID (0xfe)  // malformed command, not sent
+#define HID_STATUS_NONE (0xff)     // no result waiting
+
+/* Reply timeout when the command gives none. */
+#define HID_COMMAND_TIMEOUT_MS (1000)
+
+/* Output report, a frame to send. */
+typedef struct __attribute__((packed)) {
+  uint8_t seq;          // echoed in the result
+  uint8_t flags;        // HID_COMMAND_ flags
+  uint8_t destination;  // unless raw
+  uint8_t opcode;       // reply awaited from the destination, unless ack only
+  uint16_t timeout_ms;  // for the reply, 0 for the default
+  uint8_t len;
+  uint8_t frame[16];  // opcode and operands, or the whole frame if raw
+} hid_command_t;
+
+/* Feature report, the oldest result and the bus state. */
+typedef struct __attribute__((packed)) {
+  uint8_t seq;
+  uint8_t status;  // cec_transaction_status_t, or a HID_STATUS_ value
+  uint8_t abort_reason;
+  uint8_t response_len;
+  uint8_t response[16];  // reply frame, with its header block
+  uint16_t duration_us;  // time the request took on the wire
+  uint8_t laddr;         // logical address, 0x0f until allocated
+  uint16_t paddr;
+  uint8_t power_status;
+  uint8_t results;  // results still waiting after this one
+  uint8_t queued;   // commands not yet complete
+} hid_status_t;
+
+/**
+ * Queue the command in an output report, or a result saying why not.
+ */
+void hid_command_output(const uint8_t *report, uint16_t len);
+
+/**
+ * Fill in a status feature report, returning its length.
+ */
+uint16_t hid_command_status(uint8_t *report, uint16_t len);
+
+#endif
@@ -0,0 +1,40 @@
+#ifndef KEY_RING_H
+#define KEY_RING_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+/* Ring size, a power of two. */
+#define KEY_RING_SIZE (16)
+
+/* Single producer, single consumer ring of HID key codes.
+ *
+ * The producer never blocks, so the CEC task can hand over a key straight
+ * from frame dispatch.  The consumer task is notified on every put.
+ */
+typedef struct {
+  uint8_t keys[KEY_RING_SIZE];
+  uint32_t head;  // written by the producer only
+  uint32_t tail;  // written by the consumer only
+  TaskHandle_t consumer;
+} key_ring_t;
+
+/**
+ * Add a key and wake the consumer, returns false if the ring is full.
+ */
+bool key_ring_put(key_ring_t *ring, uint8_t key);
+
+/**
+ * Look at the oldest key without removing it, returns false if empty.
+ */
+bool key_ring_peek(key_ring_t *ring, uint8_t *key);
+
+/**
+ * Remove the oldest key.
+ */
+void key_ring_pop(key_ring_t *ring);
+
+#endif
@@ -0,0 +1,76 @@
+#ifndef RECOVERY_H
+#define RECOVERY_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Reasons for resetting the CEC state machine or the whole device. */
+typedef enum {
+  RECOVERY_RX_TIMEOUT = 0,   // expected edge missing, line high
+  RECOVERY_LINE_LOW = 1,     // line held low past any valid bit
+  RECOVERY_TX_BUS_BUSY = 2,  // no signal free time before transmitting
+  RECOVERY_WATCHDOG = 3,     // a supervised task stopped making progress
+  RECOVERY_CRASH = 4,        // fault or stack overflow, see crashlog.h
+  RECOVERY_COUNT = 5,
+} recovery_reason_t;
+
+/* Tasks fed to the watchdog. */
+typedef enum {
+  RECOVERY_TASK_CEC = 0,
+  RECOVERY_TASK_USB = 1,
+  RECOVERY_TASK_COUNT = 2,
+} recovery_task_t;
+
+typedef struct {
+  uint32_t time_ms;
+  recovery_reason_t reason;
+  // receive state, the stalled task for a watchdog reset or the crash reason
+  uint32_t detail;
+} recovery_event_t;
+
+/* Number of events kept, oldest are overwritten. */
+#define RECOVERY_LOG_SIZE (8)
+
+extern const char *recovery_reason_name[RECOVERY_COUNT];
+extern const char *recovery_task_name[RECOVERY_TASK_COUNT];
+
+/**
+ * Record a recovery event.  Task context only.
+ */
+void recovery_log(recovery_reason_t reason, uint32_t detail);
+
+/**
+ * Copy the n-th most recent event, returns false past the end of the log.
+ */
+bool recovery_get(unsigned int n, recovery_event_t *event);
+
+/**
+ * Number of watchdog resets since power on.
+ */
+uint32_t recovery_resets(void);
+
+/**
+ * Reset the device through the watchdog now, the next boot adds the reason
+ * to the log.  Safe from a fault handler.
+ */
+void recovery_reboot(recovery_reason_t reason, uint32_t detail) __attribute__((noreturn));
+
+/**
+ * Supervise a task.  The ping is called periodically from the timer task and
+ * must cause the task to call recovery_progress() soon after, NULL if the task
+ * reports progress on its own.
+ */
+void recovery_watch(recovery_task_t task, void (*ping)(void));
+
+/**
+ * Report that a supervised task went round its loop.
+ */
+void recovery_progress(recovery_task_t task);
+
+/**
+ * Record the cause of any watchdog reset, then start the supervisor and the
+ * hardware watchdog.  Call before the scheduler starts.
+ */
+void recovery_start(void);
+
+#endif
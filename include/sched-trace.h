@@ -0,0 +1,89 @@
+#ifndef SCHED_TRACE_H
+#define SCHED_TRACE_H
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/* Scheduler event trace.
+ *
+ * The FreeRTOS trace hooks and the CEC interrupt handlers record events into a
+ * ring per core, overwriting the oldest.  Each record is a handful of stores
+ * with interrupts masked, cheap enough to leave on.  The console dumps the
+ * rings as text for scripts/sched-trace.py to turn into a timeline.
+ *
+ * Included from FreeRTOSConfig.h, so this header must not pull in FreeRTOS.
+ */
+
+/* Event types. */
+#define SCHED_TRACE_SWITCH_IN (1)        // arg is the task number
+#define SCHED_TRACE_NOTIFY (2)           // arg is the task number, index the notify index
+#define SCHED_TRACE_NOTIFY_FROM_ISR (3)  // as SCHED_TRACE_NOTIFY
+#define SCHED_TRACE_QUEUE_SEND (4)       // arg is the queue address, see SCHED_TRACE_QUEUE()
+#define SCHED_TRACE_QUEUE_SEND_FROM_ISR (5)
+#define SCHED_TRACE_QUEUE_RECEIVE (6)
+#define SCHED_TRACE_QUEUE_RECEIVE_FROM_ISR (7)
+#define SCHED_TRACE_QUEUE_BLOCK (8)  // about to block receiving
+#define SCHED_TRACE_ISR_ENTER (9)    // arg is one of the SCHED_TRACE_ISR_ ids
+#define SCHED_TRACE_ISR_EXIT (10)
+
+/* Interrupt handlers marking their entry and exit. */
+#define SCHED_TRACE_ISR_CEC_RX (0)
+#define SCHED_TRACE_ISR_CEC_TX (1)
+#define SCHED_TRACE_ISR_CEC_ACK (2)
+#define SCHED_TRACE_ISR_CEC_WATCH (3)
+
+/* Queues live in striped RAM, word aligned, so 16 bits identify one. */
+#define SCHED_TRACE_QUEUE(queue) ((uint16_t)((uintptr_t)(queue) >> 2))
+
+typedef struct {
+  uint32_t time_us;  // low 32 bits of the time since boot
+  uint8_t type;
+  uint8_t index;
+  uint16_t arg;
+} sched_trace_event_t;
+
+#if PICO_CEC_SCHED_TRACE
+
+/* Events kept per core, a power of two. */
+#ifndef SCHED_TRACE_EVENTS
+#define SCHED_TRACE_EVENTS (512)
+#endif
+
+/**
+ * Record an event on the calling core.  Safe from any context.
+ */
+void sched_trace_record(uint8_t type, uint8_t index, uint16_t arg);
+
+/**
+ * Stop or restart recording, the rings should only be read while stopped.
+ */
+void sched_trace_pause(bool paused);
+
+/**
+ * Number of events a core has recorded since the last clear, the latest
+ * SCHED_TRACE_EVENTS of them are kept.
+ */
+uint32_t sched_trace_recorded(unsigned int core);
+
+/**
+ * Copy out event number seq of a core, returns false if it has been
+ * overwritten or not recorded yet.
+ */
+bool sched_trace_get(unsigned int core, uint32_t seq, sched_trace_event_t *event);
+
+/**
+ * Discard everything recorded so far.
+ */
+void sched_trace_clear(void);
+
+#define sched_trace_isr_enter(isr) sched_trace_record(SCHED_TRACE_ISR_ENTER, 0, (isr))
+#define sched_trace_isr_exit(isr) sched_trace_record(SCHED_TRACE_ISR_EXIT, 0, (isr))
+
+#else
+
+#define sched_trace_isr_enter(isr) ((void)0)
+#define sched_trace_isr_exit(isr) ((void)0)
+
+#endif
+
+#endif
@@ -80,7 +80,9 @@ extern "C" {
  * - CFG_TUSB_MEM_ALIGN   : __attribute__ ((aligned(4)))
  */
 #ifndef CFG_TUSB_MEM_SECTION
-#define CFG_TUSB_MEM_SECTION
+// SCRATCH_X, alongside core 1's interrupt stack, so the USB task's buffer copies
+// stay off the striped banks the CEC core uses
+#define CFG_TUSB_MEM_SECTION __attribute__((section(".scratch_x.usb")))
 #endif
 
 #ifndef CFG_TUSB_MEM_ALIGN
@@ -102,8 +104,9 @@ extern "C" {
 #define CFG_TUD_MIDI 0
 #define CFG_TUD_VENDOR 0
 
-// HID buffer size Should be sufficient to hold ID (if any) + Data
-#define CFG_TUD_HID_EP_BUFSIZE 16
+// HID buffer size Should be sufficient to hold ID (if any) + Data, also the
+// largest feature or output report, see hid-command.h
+#define CFG_TUD_HID_EP_BUFSIZE 32
 
 // CDC buffer sizes
 #define CFG_TUD_CDC_RX_BUFSIZE (256)
@@ -25,6 +25,10 @@
 #ifndef USB_DESCRIPTORS_H_
 #define USB_DESCRIPTORS_H_
 
-enum { REPORT_ID_KEYBOARD = 1, REPORT_ID_COUNT };
+enum { REPORT_ID_KEYBOARD = 1, REPORT_ID_CEC, REPORT_ID_COUNT };
+
+/* Keys covered by the NKRO keyboard report's bitmap, the keyboard usages 0x00
+ * to 0x67. */
+#define NKRO_KEYS (104)
 
 #endif /* USB_DESCRIPTORS_H_ */
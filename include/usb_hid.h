@@ -1,7 +1,20 @@
 #ifndef USB_HID_H
 #define USB_HID_H
 
+#include <stdint.h>
+
 void usb_device_task(void *param);
 void hid_task(void *param);
 
+/**
+ * Have the device task report progress to the supervisor.
+ */
+void usb_device_ping(void);
+
+/**
+ * Hook for the bench command, submits a key release report and returns the
+ * cycles taken, or BENCH_SKIPPED if the host is not ready for one.
+ */
+uint32_t usb_hid_bench_report(void);
+
 #endif
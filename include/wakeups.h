@@ -0,0 +1,22 @@
+#ifndef WAKEUPS_H
+#define WAKEUPS_H
+
+#include <stdint.h>
+
+/* Tasks counting their wakeups. */
+typedef enum {
+  WAKEUP_CEC = 0,
+  WAKEUP_HID = 1,
+  WAKEUP_CDC = 2,
+  WAKEUP_BLINK = 3,
+  WAKEUP_LOG = 4,
+  WAKEUP_COUNT = 5,
+} wakeup_task_t;
+
+/* Times each task returned from blocking, to check the idle wake rate. */
+extern volatile uint32_t wakeups[WAKEUP_COUNT];
+
+/* Task names for display. */
+extern const char *wakeup_task_name[WAKEUP_COUNT];
+
+#endif
@@ -0,0 +1,209 @@
+#!/usr/bin/env python3
+"""Memory budget report for a firmware image.
+
+Reads the GNU ld map file written next to the ELF and reports, per memory
+region, how much each output section uses, then a table of bytes per module
+and output section.  Static objects larger than a threshold are flagged from
+the ELF symbol table.  Exits non-zero if a region goes over its budget.
+
+  memory-report.py --map pico-cec.elf.map --elf pico-cec.elf --nm arm-none-eabi-nm \
+      --budget SCRATCH_Y=2048
+"""
+
+import argparse
+import collections
+import os
+import re
+import subprocess
+import sys
+
+# Sections worth a column in the module table, anything else is summed as other.
+COLUMNS = ['.text', '.rodata', '.data', '.bss', '.scratch_x', '.scratch_y']
+
+# Third party code grouped by a path component.
+GROUPS = [
+    ('FreeRTOS-Kernel', 'FreeRTOS'),
+    ('tinyusb', 'tinyusb'),
+    ('pico-sdk', 'pico-sdk'),
+    ('tcli', 'tcli'),
+]
+
+OUTPUT_SECTION = re.compile(r'^(\.\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+load address 0x([0-9a-f]+))?')
+OUTPUT_SECTION_CONT = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(?:\s+load address 0x([0-9a-f]+))?')
+OUTPUT_SECTION_NAME = re.compile(r'^(\.\S+)\s*$')
+INPUT_SECTION = re.compile(r'^ (\.\S+|COMMON)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+INPUT_SECTION_NAME = re.compile(r'^ (\.\S+|COMMON)\s*$')
+INPUT_SECTION_CONT = re.compile(r'^\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)\s+(\S.*)$')
+# Not loaded, so not part of any region.
+UNLOADED = re.compile(r'^\.(debug|comment|stab|ARM\.attributes|gnu\.attributes)')
+REGION = re.compile(r'^(\S+)\s+0x([0-9a-f]+)\s+0x([0-9a-f]+)(\s+\S+)?\s*$')
+
+
+def module_name(path):
+    """Firmware sources by file, libraries by group."""
+    path = path.strip()
+    archive = re.match(r'(.*)\((.*)\)$', path)
+    if archive:
+        if 'libc' in archive.group(1) or 'libgcc' in archive.group(1) or 'libm' in archive.group(1):
+            return 'libc/libgcc'
+        path = archive.group(2) if '/' not in archive.group(2) else archive.group(1)
+    for key, group in GROUPS:
+        if key in path:
+            return group
+    if '/src/' in path or path.startswith('src/'):
+        base = os.path.basename(path)
+        return re.sub(r'\.(c|S)\.(obj|o)$', '', base)
+    if 'crt' in os.path.basename(path) or 'libgcc' in path or 'libc' in path:
+        return 'libc/libgcc'
+    return 'other'
+
+
+def add_section(sections, name, address, size, load):
+    """Record an output section, returning None for ones that are not loaded."""
+    if UNLOADED.match(name):
+        return None
+    sections.append((name, int(address, 16), int(size, 16)))
+    if load is not None and load != address:
+        sections.append((name + ' (load)', int(load, 16), int(size, 16)))
+    return name
+
+
+def parse_map(path):
+    regions = collections.OrderedDict()
+    sections = []  # (name, address, size), with a second entry at the load address of copied ones
+    usage = collections.defaultdict(lambda: collections.Counter())
+
+    with open(path) as f:
+        lines = f.read().splitlines()
+
+    i = 0
+    # memory regions
+    while i < len(lines) and not lines[i].startswith('Memory Configuration'):
+        i += 1
+    i += 1
+    while i < len(lines) and not lines[i].startswith('Linker script and memory map'):
+        m = REGION.match(lines[i])
+        if m and m.group(1) not in ('Name', '*default*'):
+            regions[m.group(1)] = (int(m.group(2), 16), int(m.group(3), 16))
+        i += 1
+
+    output = None
+    pending = None
+    for line in lines[i:]:
+        m = OUTPUT_SECTION.match(line)
+        if m:
+            output = add_section(sections, m.group(1), m.group(2), m.group(3), m.group(4))
+            pending = None
+            continue
+        m = OUTPUT_SECTION_NAME.match(line)
+        if m:
+            output = m.group(1)
+            pending = 'output'
+            continue
+        if pending == 'output':
+            m = OUTPUT_SECTION_CONT.match(line)
+            if m:
+                output = add_section(sections, output, m.group(1), m.group(2), m.group(3))
+            pending = None
+            continue
+
+        m = INPUT_SECTION.match(line)
+        if m:
+            if output is not None:
+                usage[module_name(m.group(4))][output] += int(m.group(3), 16)
+            pending = None
+            continue
+        if INPUT_SECTION_NAME.match(line):
+            pending = 'input'
+            continue
+        if pending == 'input':
+            m = INPUT_SECTION_CONT.match(line)
+            if m and output is not None:
+                usage[module_name(m.group(3))][output] += int(m.group(2), 16)
+            pending = None
+
+    return regions, sections, usage
+
+
+def large_objects(elf, nm, threshold):
+    try:
+        out = subprocess.run([nm, '-S', '--size-sort', '-C', elf], check=True,
+                             capture_output=True, text=True).stdout
+    except (OSError, subprocess.CalledProcessError) as e:
+        print('warning: %s: %s' % (nm, e), file=sys.stderr)
+        return []
+
+    objects = []
+    for line in out.splitlines():
+        fields = line.split()
+        if len(fields) != 4 or fields[2] not in 'bBdDrR':
+            continue
+        size = int(fields[1], 16)
+        if size >= threshold:
+            objects.append((size, fields[3], fields[2]))
+    return sorted(objects, reverse=True)
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--map', required=True, help='linker map file')
+    parser.add_argument('--elf', help='ELF image, for the large object list')
+    parser.add_argument('--nm', default='nm', help='nm for the target')
+    parser.add_argument('--large', type=int, default=512,
+                        help='flag static objects of at least this many bytes')
+    parser.add_argument('--budget', action='append', default=[], metavar='REGION=BYTES',
+                        help='fail if the sections in a region use more than this')
+    args = parser.parse_args()
+
+    regions, sections, usage = parse_map(args.map)
+
+    budgets = {}
+    for budget in args.budget:
+        name, _, size = budget.partition('=')
+        budgets[name] = int(size, 0)
+
+    over = False
+    print('Regions')
+    for name, (origin, length) in regions.items():
+        inside = [(s, size) for (s, address, size) in sections
+                  if origin <= address < origin + length and size > 0]
+        used = sum(size for _, size in inside)
+        line = '  %-10s %7d of %7d bytes (%3d%%)' % (name, used, length,
+                                                     (100 * used) // length if length else 0)
+        if name in budgets:
+            line += ', budget %d' % budgets[name]
+            if used > budgets[name]:
+                line += ' OVER'
+                over = True
+        print(line)
+        for s, size in inside:
+            print('    %-20s %7d' % (s, size))
+
+    print()
+    print('Modules')
+    print('  %-20s' % 'module' + ''.join('%11s' % c for c in COLUMNS) + '%9s%9s' % ('other', 'total'))
+    rows = []
+    for module, counts in usage.items():
+        cols = [counts.get(c, 0) for c in COLUMNS]
+        other = sum(v for k, v in counts.items() if k not in COLUMNS)
+        rows.append((sum(cols) + other, module, cols, other))
+    for total, module, cols, other in sorted(rows, reverse=True):
+        if total == 0:
+            continue
+        print('  %-20s' % module + ''.join('%11d' % v for v in cols) + '%9d%9d' % (other, total))
+
+    if args.elf:
+        objects = large_objects(args.elf, args.nm, args.large)
+        print()
+        print('Static objects of %d bytes or more' % args.large)
+        for size, name, kind in objects:
+            print('  %7d %s %s' % (size, kind, name))
+
+    if over:
+        print('memory budget exceeded', file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
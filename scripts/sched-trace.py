@@ -0,0 +1,192 @@
+#!/usr/bin/env python3
+"""Convert a scheduler trace dump to a timeline.
+
+Reads the output of the 'trace dump' console command, as saved from a serial
+terminal, and writes Chrome trace event JSON, which Perfetto
+(https://ui.perfetto.dev) and chrome://tracing open.  Each core gets a track
+for the task running on it and one for the CEC interrupt handlers, with
+notifications and queue operations as instants and an arrow from each
+notification to the target task running.  --latency also prints how long
+notified tasks took to run.
+
+  sched-trace.py dump.txt -o trace.json --latency
+"""
+
+import argparse
+import json
+import sys
+
+SWITCH_IN = 1
+NOTIFY = 2
+NOTIFY_FROM_ISR = 3
+QUEUE_SEND = 4
+QUEUE_SEND_FROM_ISR = 5
+QUEUE_RECEIVE = 6
+QUEUE_RECEIVE_FROM_ISR = 7
+QUEUE_BLOCK = 8
+ISR_ENTER = 9
+ISR_EXIT = 10
+
+QUEUE_EVENTS = {
+    QUEUE_SEND: 'queue send',
+    QUEUE_SEND_FROM_ISR: 'queue send from ISR',
+    QUEUE_RECEIVE: 'queue receive',
+    QUEUE_RECEIVE_FROM_ISR: 'queue receive from ISR',
+    QUEUE_BLOCK: 'queue block',
+}
+
+ISRS = ['cec rx', 'cec tx', 'cec ack', 'cec watch']
+
+# queues are identified by their word address in striped RAM
+SRAM_BASE = 0x20000000
+
+
+def read_dump(f):
+    tasks = {}
+    events = []
+    for line in f:
+        words = line.strip().split(None, 2)
+        if not words or words[0].startswith('#'):
+            continue
+        if words[0] == 'task' and len(words) == 3:
+            tasks[int(words[1])] = words[2]
+            continue
+        fields = line.split()
+        if len(fields) == 5 and all(w.isdigit() for w in fields):
+            events.append(tuple(int(w) for w in fields))
+    return tasks, events
+
+
+def unwrap(events):
+    """Events in time order with 64 bit times, the dump has 32 bit microseconds."""
+    by_core = {}
+    for core, time, kind, index, arg in events:
+        by_core.setdefault(core, []).append((time, kind, index, arg))
+
+    result = []
+    starts = {}
+    for core, core_events in by_core.items():
+        offset = 0
+        previous = None
+        for time, kind, index, arg in core_events:
+            if previous is not None and time < previous:
+                offset += 1 << 32
+            previous = time
+            result.append([time + offset, core, kind, index, arg])
+        starts[core] = core_events[0][0]
+
+    # line the cores up if one wrapped before the other's oldest event
+    first = min(starts.values(), default=0)
+    for event in result:
+        if starts[event[1]] - first > (1 << 31):
+            event[0] -= 1 << 32
+    result.sort(key=lambda e: e[0])
+    return result
+
+
+def task_name(tasks, number):
+    return tasks.get(number, 'task %d' % number)
+
+
+def timeline(tasks, events):
+    trace = [{'ph': 'M', 'pid': 0, 'name': 'process_name', 'args': {'name': 'pico-cec'}}]
+    cores = sorted({e[1] for e in events})
+    for core in cores:
+        trace.append({'ph': 'M', 'pid': 0, 'tid': core * 2, 'name': 'thread_name',
+                      'args': {'name': 'core %d' % core}})
+        trace.append({'ph': 'M', 'pid': 0, 'tid': core * 2 + 1, 'name': 'thread_name',
+                      'args': {'name': 'core %d interrupts' % core}})
+
+    end = events[-1][0] if events else 0
+    running = {}  # core -> (task, since)
+    flows = {}    # task -> [flow id]
+    latencies = {}  # task -> [us]
+    pending = {}  # task -> [notify time]
+    flow_id = 0
+
+    def close(core, now):
+        if core in running:
+            task, since = running.pop(core)
+            trace.append({'ph': 'X', 'pid': 0, 'tid': core * 2, 'ts': since, 'dur': now - since,
+                          'name': task_name(tasks, task)})
+
+    for time, core, kind, index, arg in events:
+        tid = core * 2
+        if kind == SWITCH_IN:
+            close(core, time)
+            running[core] = (arg, time)
+            for i in flows.pop(arg, []):
+                trace.append({'ph': 'f', 'bp': 'e', 'pid': 0, 'tid': tid, 'ts': time, 'id': i,
+                              'name': 'notify', 'cat': 'notify'})
+            for notified in pending.pop(arg, []):
+                latencies.setdefault(arg, []).append(time - notified)
+        elif kind in (NOTIFY, NOTIFY_FROM_ISR):
+            from_isr = kind == NOTIFY_FROM_ISR
+            name = 'notify %s[%d]' % (task_name(tasks, arg), index)
+            track = tid + 1 if from_isr else tid
+            trace.append({'ph': 'i', 's': 't', 'pid': 0, 'tid': track, 'ts': time, 'name': name})
+            if running.get(core, (None,))[0] == arg and not from_isr:
+                continue
+            flow_id += 1
+            flows.setdefault(arg, []).append(flow_id)
+            trace.append({'ph': 's', 'pid': 0, 'tid': track, 'ts': time, 'id': flow_id,
+                          'name': 'notify', 'cat': 'notify'})
+            if from_isr:
+                pending.setdefault(arg, []).append(time)
+        elif kind in QUEUE_EVENTS:
+            track = tid + 1 if kind in (QUEUE_SEND_FROM_ISR, QUEUE_RECEIVE_FROM_ISR) else tid
+            trace.append({'ph': 'i', 's': 't', 'pid': 0, 'tid': track, 'ts': time,
+                          'name': '%s 0x%08x' % (QUEUE_EVENTS[kind], SRAM_BASE | (arg << 2))})
+        elif kind in (ISR_ENTER, ISR_EXIT):
+            name = ISRS[arg] if arg < len(ISRS) else 'isr %d' % arg
+            trace.append({'ph': 'B' if kind == ISR_ENTER else 'E', 'pid': 0, 'tid': tid + 1,
+                          'ts': time, 'name': name})
+
+    for core in list(running):
+        close(core, end)
+
+    return trace, latencies
+
+
+def percentile(values, fraction):
+    return values[min(len(values) - 1, int(fraction * len(values)))]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('dump', nargs='?', help='trace dump, standard input if not given')
+    parser.add_argument('-o', '--output', help='JSON output, standard output if not given')
+    parser.add_argument('--latency', action='store_true',
+                        help='print notification from interrupt to task running times')
+    args = parser.parse_args()
+
+    if args.dump:
+        with open(args.dump) as f:
+            tasks, events = read_dump(f)
+    else:
+        tasks, events = read_dump(sys.stdin)
+    if not events:
+        sys.exit('no trace events found')
+
+    trace, latencies = timeline(tasks, unwrap(events))
+
+    out = open(args.output, 'w') if args.output else sys.stdout
+    json.dump({'traceEvents': trace, 'displayTimeUnit': 'ns'}, out)
+    out.write('\n')
+    if args.output:
+        out.close()
+
+    if args.latency:
+        report = sys.stderr if not args.output else sys.stdout
+        print('%-16s %7s %7s %7s %7s %7s' % ('task', 'count', 'min', 'median', '99%', 'max'),
+              file=report)
+        for task, values in sorted(latencies.items()):
+            values.sort()
+            print('%-16s %7d %7d %7d %7d %7d' % (
+                task_name(tasks, task), len(values), values[0], percentile(values, 0.5),
+                percentile(values, 0.99), values[-1]), file=report)
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
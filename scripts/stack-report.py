@@ -0,0 +1,330 @@
+#!/usr/bin/env python3
+"""Worst-case stack report for a firmware image.
+
+Reads the call graph GCC writes with -fcallgraph-info=su (a .ci file beside
+each object, carrying the -fstack-usage frame sizes) and works out the deepest
+path from each task entry point and interrupt handler.  Task entry points and
+their stack sizes are found from the xTaskCreateStatic() calls in the given
+sources.  Calls through function pointers, and the other roots, are listed in
+a calls file.  Exits non-zero if a task or handler goes over its budget, or a
+root reaches recursion or an unbounded dynamic frame.
+
+  stack-report.py --ci CMakeFiles/pico-cec.dir --tasks src/main.c \\
+      --defines include/FreeRTOSConfig.h --calls scripts/stack-calls.txt
+"""
+
+import argparse
+import ast
+import fnmatch
+import operator
+import os
+import re
+import sys
+
+WORD = 4
+
+NODE = re.compile(r'^node: \{ title: "([^"]*)" label: "([^"]*)"')
+EDGE = re.compile(r'^edge: \{ sourcename: "([^"]*)" targetname: "([^"]*)"')
+FRAME = re.compile(r'\\n(\d+) bytes \(([a-z,]+)\)')
+CLONE = re.compile(r'\.(isra|constprop|part|cold|lto_priv)(\.\d+)?')
+DEFINE = re.compile(r'^\s*#define\s+(\w+)\s+(.+?)\s*(//.*|/\*.*)?$', re.M)
+TASK = re.compile(r'xTaskCreateStatic\(\s*(\w+)\s*,\s*[^,]+,\s*(\w+)\s*,')
+
+INDIRECT = '__indirect_call'
+
+
+class Function:
+    def __init__(self, title):
+        self.title = title
+        path, _, name = title.rpartition(':')
+        self.name = CLONE.sub('', name)
+        self.file = os.path.basename(path) if path else None
+        self.frame = None  # None until a definition is seen
+        self.dynamic = False
+        self.calls = set()
+        self.indirect = False
+
+    def matches(self, pattern):
+        names = [self.name, self.title]
+        if self.file:
+            names.append('%s:%s' % (self.file, self.name))
+        return any(fnmatch.fnmatchcase(n, pattern) for n in names)
+
+
+def read_graph(dirs):
+    functions = {}
+
+    def function(title):
+        if title not in functions:
+            functions[title] = Function(title)
+        return functions[title]
+
+    for top in dirs:
+        for root, _, files in os.walk(top):
+            for name in sorted(files):
+                if not name.endswith('.ci'):
+                    continue
+                with open(os.path.join(root, name)) as f:
+                    for line in f:
+                        m = NODE.match(line)
+                        if m:
+                            frame = FRAME.search(m.group(2))
+                            if frame and m.group(1) != INDIRECT:
+                                fn = function(m.group(1))
+                                fn.frame = max(fn.frame or 0, int(frame.group(1)))
+                                fn.dynamic |= (frame.group(2) == 'dynamic')
+                            continue
+                        m = EDGE.match(line)
+                        if m:
+                            caller = function(m.group(1))
+                            if m.group(2) == INDIRECT:
+                                caller.indirect = True
+                            else:
+                                caller.calls.add(m.group(2))
+    functions.pop(INDIRECT, None)
+    return functions
+
+
+def read_defines(paths):
+    defines = {}
+    for path in paths:
+        with open(path) as f:
+            for m in DEFINE.finditer(f.read()):
+                defines.setdefault(m.group(1), m.group(2))
+    return defines
+
+
+def evaluate(expr, defines, depth=0):
+    """Integer value of a macro expression, resolving other macros."""
+    if depth > 16:
+        raise ValueError(expr)
+    expr = re.sub(r'\b([A-Za-z_]\w*)\b',
+                  lambda m: '(%d)' % evaluate(defines[m.group(1)], defines, depth + 1)
+                  if m.group(1) in defines else m.group(1), expr)
+    expr = re.sub(r'(?<=\d)[uUlL]+\b', '', expr)
+
+    ops = {ast.Add: operator.add, ast.Sub: operator.sub, ast.Mult: operator.mul,
+           ast.FloorDiv: operator.floordiv, ast.Div: operator.floordiv,
+           ast.LShift: operator.lshift, ast.RShift: operator.rshift}
+
+    def walk(node):
+        if isinstance(node, ast.Expression):
+            return walk(node.body)
+        if isinstance(node, ast.Constant) and isinstance(node.value, int):
+            return node.value
+        if isinstance(node, ast.BinOp) and type(node.op) in ops:
+            return ops[type(node.op)](walk(node.left), walk(node.right))
+        raise ValueError(expr)
+
+    return walk(ast.parse(expr, mode='eval'))
+
+
+def read_tasks(paths, defines):
+    tasks = []
+    for path in paths:
+        with open(path) as f:
+            source = f.read()
+        local = dict(defines)
+        local.update((m.group(1), m.group(2)) for m in DEFINE.finditer(source))
+        for m in TASK.finditer(source):
+            tasks.append((m.group(1), evaluate(m.group(2), local) * WORD))
+    return tasks
+
+
+def read_calls(path, defines):
+    """Parse the calls file: indirect call targets, extra roots and estimates."""
+    calls = []
+    cuts = []
+    tasks = []
+    isrs = []
+    assume = []
+    with open(path) as f:
+        for number, line in enumerate(f, 1):
+            words = line.split('#', 1)[0].split()
+            if not words:
+                continue
+            try:
+                if words[0] == 'call' and '->' in words:
+                    arrow = words.index('->')
+                    calls.append((words[1:arrow], words[arrow + 1:]))
+                elif words[0] == 'cut' and '->' in words:
+                    arrow = words.index('->')
+                    cuts.append((words[1:arrow], words[arrow + 1:]))
+                elif words[0] == 'task' and len(words) == 3:
+                    tasks.append((words[1], evaluate(words[2], defines) * WORD))
+                elif words[0] == 'isr' and len(words) in (2, 3):
+                    isrs.append((words[1], words[2] if len(words) == 3 else None))
+                elif words[0] == 'assume' and len(words) == 3:
+                    assume.append((words[1], int(words[2], 0)))
+                else:
+                    raise ValueError(line)
+            except (ValueError, KeyError, SyntaxError):
+                sys.exit('%s:%d: cannot parse: %s' % (path, number, line.strip()))
+    return calls, cuts, tasks, isrs, assume
+
+
+def find(functions, pattern):
+    return [fn for fn in functions.values() if fn.matches(pattern)]
+
+
+class Walker:
+    def __init__(self, functions):
+        self.functions = functions
+        self.depth = {}  # title -> (bytes, path)
+        self.active = set()
+        self.recursion = set()
+        self.unknown = set()
+        self.unresolved = set()
+        self.dynamic = set()
+
+    def walk(self, title):
+        """Deepest stack below and including the function, and the path to it."""
+        if title in self.depth:
+            return self.depth[title]
+        if title in self.active:
+            self.recursion.add(title)
+            return (0, [title])
+        fn = self.functions.get(title)
+        if fn is None or fn.frame is None:
+            self.unknown.add(title)
+            return (0, [title])
+        if fn.indirect:
+            self.unresolved.add(title)
+        if fn.dynamic:
+            self.dynamic.add(title)
+
+        self.active.add(title)
+        deepest = (0, [])
+        for callee in sorted(fn.calls):
+            result = self.walk(callee)
+            if result[0] > deepest[0] or not deepest[1]:
+                deepest = result
+        self.active.discard(title)
+
+        result = (fn.frame + deepest[0], [title] + deepest[1])
+        self.depth[title] = result
+        return result
+
+
+def short(title):
+    return title.rpartition(':')[2]
+
+
+def main():
+    parser = argparse.ArgumentParser(description=__doc__.splitlines()[0])
+    parser.add_argument('--ci', action='append', required=True,
+                        help='directory searched for .ci call graph files')
+    parser.add_argument('--tasks', action='append', default=[],
+                        help='source creating tasks with xTaskCreateStatic()')
+    parser.add_argument('--defines', action='append', default=[],
+                        help='header to take stack size macros from')
+    parser.add_argument('--calls', help='indirect calls, extra roots and estimates')
+    parser.add_argument('--task-overhead', type=int, default=64,
+                        help='bytes of saved context on a switched out task stack')
+    parser.add_argument('--isr-overhead', type=int, default=32,
+                        help='bytes of exception frame stacked on interrupt entry')
+    parser.add_argument('--isr-budget', type=int, default=2048,
+                        help='bytes of main stack shared by the interrupt handlers')
+    parser.add_argument('--verbose', action='store_true', help='print the deepest call paths')
+    args = parser.parse_args()
+
+    functions = read_graph(args.ci)
+    if not functions:
+        sys.exit('no call graph found, build with -fcallgraph-info=su')
+
+    defines = read_defines(args.defines)
+    tasks = read_tasks(args.tasks, defines)
+    calls, cuts, extra_tasks, isrs, assume = ([], [], [], [], [])
+    if args.calls:
+        calls, cuts, extra_tasks, isrs, assume = read_calls(args.calls, defines)
+
+    for pattern, frame in assume:
+        matched = find(functions, pattern)
+        for fn in matched:
+            if fn.frame is None:
+                fn.frame = frame
+        if not matched:
+            functions[pattern] = Function(pattern)
+            functions[pattern].frame = frame
+
+    for callers, callees in calls:
+        targets = [fn.title for pattern in callees for fn in find(functions, pattern)
+                   if fn.frame is not None]
+        for pattern in callers:
+            for fn in find(functions, pattern):
+                if fn.indirect:
+                    fn.calls.update(targets)
+                    fn.indirect = False
+
+    for callers, callees in cuts:
+        for pattern in callers:
+            for fn in find(functions, pattern):
+                fn.calls = {t for t in fn.calls
+                            if not any(functions[t].matches(c) for c in callees
+                                       if t in functions)}
+
+    walker = Walker(functions)
+    failed = False
+
+    def root(name):
+        matched = [fn for fn in find(functions, name) if fn.frame is not None]
+        if not matched:
+            print('  %-24s not in the call graph' % name)
+        return matched
+
+    def report(name, used, budget, path):
+        nonlocal failed
+        line = '  %-24s %6d of %6d bytes' % (name, used, budget)
+        if used > budget:
+            line += '  OVER'
+            failed = True
+        print(line)
+        if args.verbose:
+            print('    ' + ' > '.join(short(t) for t in path))
+
+    print('Tasks (including %d bytes of saved context)' % args.task_overhead)
+    seen = set()
+    for name, budget in tasks + extra_tasks:
+        if name in seen:
+            continue
+        seen.add(name)
+        for fn in root(name):
+            depth, path = walker.walk(fn.title)
+            report(name, depth + args.task_overhead, budget, path)
+
+    print()
+    print('Interrupt handlers (including %d bytes of exception frame)' % args.isr_overhead)
+    for name, via in isrs:
+        for fn in root(name):
+            depth, path = walker.walk(fn.title)
+            if via is not None:
+                dispatch = [d for d in find(functions, via) if d.frame is not None]
+                if dispatch:
+                    depth += max(d.frame for d in dispatch)
+                    path = [dispatch[0].title] + path
+                else:
+                    print('  %-24s dispatcher %s not in the call graph' % (name, via))
+            report(name, depth + args.isr_overhead, args.isr_budget, path)
+
+    def listing(title, titles):
+        if titles:
+            print()
+            print(title)
+            for t in sorted(titles):
+                print('  ' + t)
+
+    listing('Recursion, depth not bounded', walker.recursion)
+    listing('Dynamic frames, depth not bounded', walker.dynamic)
+    listing('Indirect calls not in the calls file, counted as nothing', walker.unresolved)
+    listing('No stack usage known, counted as nothing', walker.unknown)
+
+    if walker.recursion or walker.dynamic:
+        failed = True
+    if failed:
+        print('stack budget exceeded or unbounded', file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
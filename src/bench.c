@@ -0,0 +1,333 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "bench.h"
+#include "cec-dispatch.h"
+#include "edid.h"
+#include "hdmi-cec.h"
+#include "usb_hid.h"
+
+#define ENDLINE "\r\n"
+
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
+/* Samples kept per benchmark, the most runs there can be. */
+#define BENCH_MAX_RUNS (255)
+
+/* Nominal bit timing in microseconds, for the synthetic receive edges. */
+#define START_LOW_US (3700)
+#define START_PERIOD_US (4500)
+#define ONE_LOW_US (600)
+#define ZERO_LOW_US (1500)
+#define PERIOD_US (2400)
+
+/* Spikes put into the glitched frame, and the glitch filter it is received with. */
+#define SPIKE_US (50)
+#define GLITCH_US (100)
+
+typedef struct {
+  const char *name;
+  // cycles taken by the run, or BENCH_SKIPPED
+  uint32_t (*run)(unsigned int i);
+  bool bus;  // needs the private bus
+} bench_t;
+
+/* Edges of a frame from the TV to a playback device, acknowledged by it.
+ * Every edge of the frame runs through the receive interrupt once per frame.
+ */
+static const uint8_t rx_frame[] = {0x04, 0x44, 0x41};
+
+typedef struct {
+  uint32_t time_us;  // since the start bit
+  bool high;
+} edge_t;
+
+static edge_t rx_edges[2 + ARRAY_SIZE(rx_frame) * 10 * 2];
+static unsigned int num_rx_edges;
+static uint64_t rx_base_us;
+
+/* The same frame with a spike in the middle of two bits of the header: high
+ * within the low pulse of its first bit, a 0, and low within the high part of
+ * its sixth, a 1.  Each must be ignored for the frame to be received.
+ */
+static edge_t rx_glitch_edges[ARRAY_SIZE(rx_edges) + 4];
+static unsigned int num_rx_glitch_edges;
+static unsigned int glitch_frames;
+static unsigned int glitch_lost;
+
+static uint8_t edid[2 * EDID_BLOCK_SIZE];
+
+static uint32_t samples[BENCH_MAX_RUNS];
+static volatile uint32_t sink;
+
+static void add_bit(edge_t *edges, unsigned int *num, uint32_t *time_us, bool one, bool spike) {
+  uint32_t low_us = one ? ONE_LOW_US : ZERO_LOW_US;
+
+  edges[(*num)++] = (edge_t){*time_us, false};
+  if (spike && !one) {
+    edges[(*num)++] = (edge_t){*time_us + low_us / 2, true};
+    edges[(*num)++] = (edge_t){*time_us + low_us / 2 + SPIKE_US, false};
+  }
+  edges[(*num)++] = (edge_t){*time_us + low_us, true};
+  if (spike && one) {
+    uint32_t mid_us = *time_us + (low_us + PERIOD_US) / 2;
+    edges[(*num)++] = (edge_t){mid_us, false};
+    edges[(*num)++] = (edge_t){mid_us + SPIKE_US, true};
+  }
+  *time_us += PERIOD_US;
+}
+
+static void make_rx_edges(edge_t *edges, unsigned int *num, bool spikes) {
+  uint32_t time_us = START_PERIOD_US;
+
+  *num = 0;
+  edges[(*num)++] = (edge_t){0, false};
+  edges[(*num)++] = (edge_t){START_LOW_US, true};
+  for (unsigned int i = 0; i < ARRAY_SIZE(rx_frame); i++) {
+    for (int bit = 7; bit >= 0; bit--) {
+      bool spike = spikes && (i == 0) && ((bit == 7) || (bit == 2));
+      add_bit(edges, num, &time_us, rx_frame[i] & (1 << bit), spike);
+    }
+    add_bit(edges, num, &time_us, i == (ARRAY_SIZE(rx_frame) - 1), false);
+    // the follower acknowledges with a 0
+    add_bit(edges, num, &time_us, false, false);
+  }
+}
+
+/**
+ * An EDID with a CTA extension whose HDMI vendor specific data block follows
+ * a video data block, as most sinks lay it out.
+ */
+static void make_edid(void) {
+  static const uint8_t header[] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+  static const uint8_t blocks[] = {
+      0x44, 0x10, 0x04, 0x03, 0x05,        // video, 4 short descriptors
+      0x65, 0x03, 0x0c, 0x00, 0x10, 0x00,  // HDMI, physical address 1.0.0.0
+  };
+  uint8_t *cta = &edid[EDID_BLOCK_SIZE];
+
+  memset(edid, 0, sizeof(edid));
+  memcpy(edid, header, sizeof(header));
+  edid[126] = 1;
+  cta[0] = 0x02;
+  cta[1] = 0x03;
+  cta[2] = 4 + sizeof(blocks);
+  memcpy(&cta[4], blocks, sizeof(blocks));
+
+  for (unsigned int block = 0; block < sizeof(edid); block += EDID_BLOCK_SIZE) {
+    uint8_t sum = 0;
+    for (unsigned int i = 0; i < EDID_BLOCK_SIZE - 1; i++) {
+      sum += edid[block + i];
+    }
+    edid[block + EDID_BLOCK_SIZE - 1] = -sum;
+  }
+}
+
+static uint32_t run_empty(unsigned int i) {
+  bench_mark_t start = bench_mark();
+  return bench_cycles(start);
+}
+
+static uint32_t run_rx_edge(unsigned int i) {
+  const edge_t *edge = &rx_edges[i % num_rx_edges];
+
+  if ((i % num_rx_edges) == 0) {
+    // the next frame, after the signal free time
+    rx_base_us += rx_edges[num_rx_edges - 1].time_us + 7 * PERIOD_US;
+  }
+
+  return cec_bench_rx_edge(rx_base_us + edge->time_us, edge->high);
+}
+
+/**
+ * As run_rx_edge(), through the glitched frame, checking each frame is
+ * received intact.
+ */
+static uint32_t run_rx_glitch(unsigned int i) {
+  unsigned int n = i % num_rx_glitch_edges;
+  const edge_t *edge = &rx_glitch_edges[n];
+
+  if (n == 0) {
+    if (i == 0) {
+      cec_bench_rx_glitch(GLITCH_US);
+    }
+    rx_base_us += rx_glitch_edges[num_rx_glitch_edges - 1].time_us + 7 * PERIOD_US;
+  }
+
+  uint32_t cycles = cec_bench_rx_edge(rx_base_us + edge->time_us, edge->high);
+  if (n == num_rx_glitch_edges - 1) {
+    uint8_t pld[16];
+    glitch_frames++;
+    if ((cec_bench_rx_frame(pld) != sizeof(rx_frame))
+        || (memcmp(pld, rx_frame, sizeof(rx_frame)) != 0)) {
+      glitch_lost++;
+    }
+  }
+  return cycles;
+}
+
+static uint32_t run_tx_step(unsigned int i) {
+  return cec_bench_tx_step();
+}
+
+static bool dispatch_send(void *arg, uint8_t *pld, uint8_t len) {
+  sink = pld[0];
+  return true;
+}
+
+static void dispatch_user_control(void *arg, uint8_t code, bool pressed) {
+  sink = code;
+}
+
+static uint16_t dispatch_physical_address(void *arg) {
+  return 0x1000;
+}
+
+static const cec_dispatch_ops_t dispatch_ops = {
+    .send = dispatch_send,
+    .user_control = dispatch_user_control,
+    .physical_address = dispatch_physical_address,
+};
+
+/**
+ * Alternate a query that is answered with a key press, each directed to a
+ * private dispatch whose ops go nowhere.
+ */
+static uint32_t run_dispatch(unsigned int i) {
+  static const uint8_t frames[][3] = {{0x04, 0x8f}, {0x04, 0x44, 0x01}};
+  static const uint8_t lens[] = {2, 3};
+  cec_dispatch_t dispatch;
+
+  cec_dispatch_init(&dispatch, &dispatch_ops, NULL);
+  dispatch.laddr = 0x04;
+
+  bench_mark_t start = bench_mark();
+  cec_dispatch_frame(&dispatch, frames[i % 2], lens[i % 2]);
+  return bench_cycles(start);
+}
+
+/**
+ * Look up each user control code in turn, mapped or not.
+ */
+static uint32_t run_keymap(unsigned int i) {
+  return cec_bench_keymap(i % 0x80);
+}
+
+static uint32_t run_edid(unsigned int i) {
+  bench_mark_t start = bench_mark();
+  sink = edid_verify(edid, sizeof(edid)) ? edid_physical_address(edid, sizeof(edid)) : 0;
+  return bench_cycles(start);
+}
+
+static uint32_t run_hid_report(unsigned int i) {
+  return usb_hid_bench_report();
+}
+
+static const bench_t benches[] = {
+    {"rx edge", run_rx_edge, true},
+    {"rx glitch", run_rx_glitch, true},
+    {"tx step", run_tx_step, true},
+    {"dispatch", run_dispatch, false},
+    {"keymap", run_keymap, false},
+    {"edid parse", run_edid, false},
+    {"hid report", run_hid_report, false},
+};
+
+/**
+ * Sort samples in place, there are few enough for an insertion sort.
+ */
+static void sort(uint32_t *values, unsigned int count) {
+  for (unsigned int i = 1; i < count; i++) {
+    uint32_t value = values[i];
+    unsigned int j = i;
+    for (; (j > 0) && (values[j - 1] > value); j--) {
+      values[j] = values[j - 1];
+    }
+    values[j] = value;
+  }
+}
+
+/**
+ * Run a benchmark, leaving the measured samples sorted, returns their count.
+ */
+static unsigned int measure(uint32_t (*run)(unsigned int i),
+                            unsigned int runs,
+                            uint32_t overhead) {
+  unsigned int count = 0;
+
+  for (unsigned int i = 0; i < runs; i++) {
+    uint32_t cycles = run(i);
+    if (cycles != BENCH_SKIPPED) {
+      samples[count++] = (cycles > overhead) ? (cycles - overhead) : 0;
+    }
+    // let the CEC tasks and USB keep up between runs
+    if ((i % 16) == 15) {
+      taskYIELD();
+    }
+  }
+  sort(samples, count);
+
+  return count;
+}
+
+static void format_time(char *str, size_t size, uint32_t cycles, uint32_t mhz) {
+  uint32_t ns = (uint32_t)(((uint64_t)cycles * 1000) / mhz);
+  snprintf(str, size, "%lu.%02lu", (unsigned long)(ns / 1000), (unsigned long)((ns % 1000) / 10));
+}
+
+void bench_run(unsigned int runs, bench_print_t print, void *arg) {
+  uint32_t mhz = clock_get_hz(clk_sys) / 1000000;
+  char line[96];
+
+  if (runs > BENCH_MAX_RUNS) {
+    runs = BENCH_MAX_RUNS;
+  }
+
+  make_rx_edges(rx_edges, &num_rx_edges, false);
+  make_rx_edges(rx_glitch_edges, &num_rx_glitch_edges, true);
+  make_edid();
+  rx_base_us = 0;
+  glitch_frames = 0;
+  glitch_lost = 0;
+
+  // the cost of taking the measurement itself, taken off every sample
+  measure(run_empty, runs, 0);
+  uint32_t overhead = samples[0];
+
+  bool started = cec_bench_start();
+  print(arg, "BENCH        RUNS  MIN us   MED us   MAX us   MIN   MED   MAX cycles" ENDLINE);
+  for (unsigned int b = 0; b < ARRAY_SIZE(benches); b++) {
+    const bench_t *bench = &benches[b];
+    unsigned int count = 0;
+
+    if (started || !bench->bus) {
+      count = measure(bench->run, runs, overhead);
+    }
+    if (count == 0) {
+      snprintf(line, sizeof(line), "%-12s 0     -" ENDLINE, bench->name);
+      print(arg, line);
+      continue;
+    }
+
+    uint32_t min = samples[0];
+    uint32_t med = samples[count / 2];
+    uint32_t max = samples[count - 1];
+    char min_us[12], med_us[12], max_us[12];
+    format_time(min_us, sizeof(min_us), min, mhz);
+    format_time(med_us, sizeof(med_us), med, mhz);
+    format_time(max_us, sizeof(max_us), max, mhz);
+    snprintf(line, sizeof(line), "%-12s %-5u %-8s %-8s %-8s %-5lu %-5lu %lu" ENDLINE, bench->name,
+             count, min_us, med_us, max_us, (unsigned long)min, (unsigned long)med,
+             (unsigned long)max);
+    print(arg, line);
+  }
+  if (started) {
+    cec_bench_stop();
+    snprintf(line, sizeof(line), "rx glitch: %u of %u frames lost" ENDLINE, glitch_lost,
+             glitch_frames);
+    print(arg, line);
+  }
+}
@@ -0,0 +1,25 @@
+#include "pico/time.h"
+
+#include "boot-time.h"
+
+static volatile uint32_t times_ms[BOOT_COUNT];
+
+const char *boot_step_name[BOOT_COUNT] = {
+    [BOOT_LINE_IDLE] = "line idle",
+    [BOOT_ADDRESS] = "address",
+    [BOOT_EDID] = "edid",
+    [BOOT_USB_MOUNTED] = "usb mounted",
+    [BOOT_FIRST_KEY] = "first key",
+};
+
+void boot_mark(boot_step_t step) {
+  if (times_ms[step] == 0) {
+    // nothing is reached within the first millisecond, so 0 stays free
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    times_ms[step] = (now > 0) ? now : 1;
+  }
+}
+
+uint32_t boot_time_ms(boot_step_t step) {
+  return times_ms[step];
+}
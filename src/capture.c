@@ -0,0 +1,146 @@
+#include <string.h>
+
+#include "hardware/sync.h"
+
+#include "capture.h"
+
+/* Double buffered capture ring.
+ *
+ * Records are written straight into one half while the USB stack sends the
+ * other from where it lies, so nothing is copied after a record is made.  The
+ * halves swap when the USB task takes the filled one, either when the first
+ * record arrives with nothing in flight or when the previous transfer ends.
+ * A record that does not fit is counted and reported by an overrun record in
+ * front of the next one that does.
+ */
+
+volatile capture_stats_t capture_stats;
+
+static uint8_t buffers[2][CAPTURE_BUF_SIZE] __attribute__((aligned(4)));
+static uint16_t fill_len;  // bytes used in buffers[fill]
+static uint8_t fill;       // half being filled
+static bool busy;          // the other half is with the USB stack
+static bool kicked;        // the USB task has been asked to take the filled half
+static uint32_t dropped;   // records lost since the last overrun record
+
+static volatile uint8_t mode = CAPTURE_MODE_OFF;
+static spin_lock_t *lock;
+static void (*kick)(bool in_isr);
+
+static void put(uint8_t bus,
+                uint8_t type,
+                uint8_t flags,
+                uint32_t time_us,
+                const uint8_t *payload,
+                uint8_t len,
+                bool in_isr) {
+  capture_record_t record = {
+      .type = type, .flags = flags, .len = len, .bus = bus, .time_us = time_us};
+  uint16_t need = sizeof(record) + len;
+
+  uint32_t save = spin_lock_blocking(lock);
+  if (dropped > 0) {
+    need += sizeof(record) + sizeof(dropped);
+  }
+  if (fill_len + need > CAPTURE_BUF_SIZE) {
+    dropped++;
+    capture_stats.overruns++;
+    spin_unlock(lock, save);
+    return;
+  }
+
+  if ((fill_len == 0) && busy) {
+    capture_stats.flow_waits++;
+  }
+
+  uint8_t *p = &buffers[fill][fill_len];
+  if (dropped > 0) {
+    capture_record_t overrun = {
+        .type = CAPTURE_OVERRUN, .len = sizeof(dropped), .time_us = time_us};
+    memcpy(p, &overrun, sizeof(overrun));
+    memcpy(p + sizeof(overrun), &dropped, sizeof(dropped));
+    p += sizeof(overrun) + sizeof(dropped);
+    dropped = 0;
+  }
+  memcpy(p, &record, sizeof(record));
+  if (len > 0) {
+    memcpy(p + sizeof(record), payload, len);
+  }
+  fill_len += need;
+  capture_stats.records++;
+
+  bool start = !busy && !kicked;
+  kicked = kicked || start;
+  spin_unlock(lock, save);
+
+  if (start && (kick != NULL)) {
+    kick(in_isr);
+  }
+}
+
+void capture_frame(uint8_t bus, uint64_t time_us, const uint8_t *pld, uint8_t len, uint8_t flags) {
+  if (mode == CAPTURE_MODE_OFF) {
+    return;
+  }
+
+  put(bus, CAPTURE_FRAME, flags, time_us, pld, len, false);
+}
+
+void capture_edge(uint8_t bus, uint64_t time_us, bool high) {
+  if (mode != CAPTURE_MODE_EDGES) {
+    return;
+  }
+
+  put(bus, CAPTURE_EDGE, high ? CAPTURE_FLAG_HIGH : 0, time_us, NULL, 0, true);
+}
+
+void capture_set_mode(uint8_t m) {
+  mode = (m <= CAPTURE_MODE_EDGES) ? m : CAPTURE_MODE_OFF;
+}
+
+uint8_t capture_get_mode(void) {
+  return mode;
+}
+
+void capture_set_kick(void (*k)(bool in_isr)) {
+  if (lock == NULL) {
+    lock = spin_lock_instance(spin_lock_claim_unused(true));
+  }
+  kick = k;
+}
+
+uint8_t *capture_take(uint16_t *len) {
+  uint8_t *buffer = NULL;
+
+  uint32_t save = spin_lock_blocking(lock);
+  if (!busy && (fill_len > 0)) {
+    buffer = buffers[fill];
+    *len = fill_len;
+    fill ^= 1;
+    fill_len = 0;
+    busy = true;
+    capture_stats.transfers++;
+    capture_stats.bytes += *len;
+  }
+  kicked = false;
+  spin_unlock(lock, save);
+
+  return buffer;
+}
+
+void capture_release(void) {
+  uint32_t save = spin_lock_blocking(lock);
+  busy = false;
+  spin_unlock(lock, save);
+}
+
+void capture_reset(void) {
+  mode = CAPTURE_MODE_OFF;
+
+  uint32_t save = spin_lock_blocking(lock);
+  fill_len = 0;
+  busy = false;
+  kicked = false;
+  dropped = 0;
+  spin_unlock(lock, save);
+}
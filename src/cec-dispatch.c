@@ -0,0 +1,556 @@
+#include <stdio.h>
+
+#include "cec-dispatch.h"
+
+/* CEC protocol logic for a playback device.
+ *
+ * Decides how to answer each received frame and which user control codes to
+ * pass on, with all bus and host access going through the caller's ops so the
+ * same logic runs on the board and in host tools.
+ */
+
+/* Opcode names for logging, sorted by opcode.  Searched rather than indexed,
+ * a table indexed by opcode would be mostly empty.
+ */
+static const struct {
+  uint8_t opcode;
+  const char *name;
+} messages[] = {
+    {CEC_ID_FEATURE_ABORT, "Feature Abort"},
+    {CEC_ID_IMAGE_VIEW_ON, "Image View On"},
+    {CEC_ID_TEXT_VIEW_ON, "Text View On"},
+    {CEC_ID_GIVE_DECK_STATUS, "Give Deck Status"},
+    {CEC_ID_DECK_STATUS, "Deck Status"},
+    {CEC_ID_STANDBY, "Standby"},
+    {CEC_ID_PLAY, "Play"},
+    {CEC_ID_DECK_CONTROL, "Deck Control"},
+    {CEC_ID_USER_CONTROL_PRESSED, "User Control Pressed"},
+    {CEC_ID_USER_CONTROL_RELEASED, "User Control Released"},
+    {CEC_ID_GIVE_OSD_NAME, "Give OSD Name"},
+    {CEC_ID_SET_OSD_NAME, "Set OSD Name"},
+    {CEC_ID_SYSTEM_AUDIO_MODE_REQUEST, "System Audio Mode Request"},
+    {CEC_ID_GIVE_AUDIO_STATUS, "Give Audio Status"},
+    {CEC_ID_SET_SYSTEM_AUDIO_MODE, "Set System Audio Mode"},
+    {CEC_ID_GIVE_SYSTEM_AUDIO_MODE_STATUS, "Give System Audio Mode"},
+    {CEC_ID_SYSTEM_AUDIO_MODE_STATUS, "System Audio Mode Status"},
+    {CEC_ID_ROUTING_CHANGE, "Routing Change"},
+    {CEC_ID_GET_MENU_LANGUAGE, "Get Menu Language"},
+    {CEC_ID_ACTIVE_SOURCE, "Active Source"},
+    {CEC_ID_GIVE_PHYSICAL_ADDRESS, "Give Physical Address"},
+    {CEC_ID_REPORT_PHYSICAL_ADDRESS, "Report Physical Address"},
+    {CEC_ID_REQUEST_ACTIVE_SOURCE, "Request Active Source"},
+    {CEC_ID_SET_STREAM_PATH, "Set Stream Path"},
+    {CEC_ID_DEVICE_VENDOR_ID, "Device Vendor ID"},
+    {CEC_ID_GIVE_DEVICE_VENDOR_ID, "Give Device Vendor ID"},
+    {CEC_ID_MENU_STATUS, "Menu Status"},
+    {CEC_ID_GIVE_DEVICE_POWER_STATUS, "Give Device Power Status"},
+    {CEC_ID_REPORT_POWER_STATUS, "Report Power Status"},
+    {CEC_ID_CEC_VERSION, "CEC Version"},
+    {CEC_ID_GET_CEC_VERSION, "Get CEC Version"},
+    {CEC_ID_VENDOR_COMMAND_WITH_ID, "Vendor Command With ID"},
+    {CEC_ID_GIVE_FEATURES, "Give Features"},
+    {CEC_ID_REPORT_FEATURES, "Report Features"},
+    {CEC_ID_ABORT, "Abort"},
+};
+
+const char *cec_message(uint8_t opcode) {
+  unsigned int lo = 0;
+  unsigned int hi = sizeof(messages) / sizeof(messages[0]);
+
+  while (lo < hi) {
+    unsigned int mid = (lo + hi) / 2;
+    if (messages[mid].opcode == opcode) {
+      return messages[mid].name;
+    } else if (messages[mid].opcode < opcode) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return NULL;
+}
+
+#define DEFAULT_TYPE 0x04  // HDMI Playback 1
+
+/* Feature Abort reasons. */
+#define ABORT_UNRECOGNIZED_OPCODE (0x00)
+#define ABORT_INVALID_OPERAND (0x03)
+
+/* Power status operand values. */
+#define POWER_STATUS_ON (0x00)
+#define POWER_STATUS_STANDBY (0x01)
+#define POWER_STATUS_TO_ON (0x02)
+#define POWER_STATUS_TO_STANDBY (0x03)
+
+/* Deck Control modes and Deck Status info. */
+#define DECK_CONTROL_SKIP_FORWARD (0x01)
+#define DECK_CONTROL_SKIP_REVERSE (0x02)
+#define DECK_CONTROL_STOP (0x03)
+#define DECK_INFO_PLAY (0x11)
+#define DECK_INFO_STILL (0x14)
+#define DECK_INFO_STOP (0x1a)
+#define DECK_INFO_SKIP_FORWARD (0x1b)
+#define DECK_INFO_SKIP_REVERSE (0x1c)
+
+/* Play modes. */
+#define PLAY_FORWARD (0x24)
+#define PLAY_STILL (0x25)
+
+/* CEC 2.0 Report Features operands. */
+#define FEATURES_DEVICE_TYPES (0x10)     // Playback Device
+#define FEATURES_RC_PROFILE (0x40)       // Source, no menu keys
+#define FEATURES_DEVICE_FEATURES (0x10)  // Supports Deck Control
+
+/* User Control power codes. */
+#define UI_POWER (0x40)
+#define UI_POWER_TOGGLE (0x6b)
+#define UI_POWER_OFF (0x6c)
+#define UI_POWER_ON (0x6d)
+
+/* User Control codes for volume, and those generated for Deck Control and Play. */
+#define UI_VOLUME_UP (0x41)
+#define UI_VOLUME_DOWN (0x42)
+#define UI_PLAY (0x44)
+#define UI_STOP (0x45)
+#define UI_PAUSE (0x46)
+#define UI_REWIND (0x48)
+#define UI_FAST_FORWARD (0x49)
+
+// HDMI Playback logical addresses
+#define NUM_ADDRESS 4
+static const uint8_t address[NUM_ADDRESS] = {0x04, 0x08, 0x0b, 0x0f};
+
+/* Construct the frame address header. */
+#define HEADER0(iaddr, daddr) ((iaddr << 4) | daddr)
+
+static bool send_frame(cec_dispatch_t *dispatch, uint8_t pldcnt, uint8_t *pld) {
+  return dispatch->ops->send(dispatch->arg, pld, pldcnt);
+}
+
+/**
+ * Press and release a user control code.
+ */
+static void send_key(cec_dispatch_t *dispatch, uint8_t code) {
+  dispatch->ops->user_control(dispatch->arg, code, true);
+  dispatch->ops->user_control(dispatch->arg, 0, false);
+}
+
+static void device_vendor_id(cec_dispatch_t *dispatch,
+                             uint8_t initiator,
+                             uint8_t destination,
+                             uint32_t vendor_id) {
+  uint8_t pld[5] = {(initiator << 4) | destination, 0x87, (vendor_id >> 16) & 0x0ff,
+                    (vendor_id >> 8) & 0x0ff, (vendor_id >> 0) & 0x0ff};
+
+  send_frame(dispatch, 5, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_DEVICE_VENDOR_ID));
+}
+
+static void report_power_status(cec_dispatch_t *dispatch,
+                                uint8_t initiator,
+                                uint8_t destination,
+                                uint8_t power_status) {
+  uint8_t pld[3] = {(initiator << 4) | destination, 0x90, power_status};
+
+  send_frame(dispatch, 3, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_REPORT_POWER_STATUS));
+}
+
+static void set_system_audio_mode(cec_dispatch_t *dispatch,
+                                  uint8_t initiator,
+                                  uint8_t destination,
+                                  uint8_t system_audio_mode) {
+  uint8_t pld[3];
+
+  pld[0] = (initiator << 4) | destination;
+  pld[1] = CEC_ID_SET_SYSTEM_AUDIO_MODE;
+  pld[2] = system_audio_mode;
+
+  send_frame(dispatch, 3, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_SET_SYSTEM_AUDIO_MODE));
+}
+
+static void report_audio_status(cec_dispatch_t *dispatch,
+                                uint8_t initiator,
+                                uint8_t destination,
+                                uint8_t audio_status) {
+  uint8_t pld[3];
+
+  pld[0] = (initiator << 4) | destination;
+  pld[1] = CEC_ID_REPORT_AUDIO_STATUS;
+  pld[2] = audio_status;
+
+  send_frame(dispatch, 3, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_REPORT_AUDIO_STATUS));
+}
+
+static void system_audio_mode_status(cec_dispatch_t *dispatch,
+                                     uint8_t initiator,
+                                     uint8_t destination,
+                                     uint8_t system_audio_mode_status) {
+  uint8_t pld[3];
+
+  pld[0] = (initiator << 4) | destination;
+  pld[1] = CEC_ID_SYSTEM_AUDIO_MODE_STATUS;
+  pld[2] = system_audio_mode_status;
+
+  send_frame(dispatch, 3, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_SYSTEM_AUDIO_MODE_STATUS));
+}
+
+static void set_osd_name(cec_dispatch_t *dispatch, uint8_t initiator, uint8_t destination) {
+  uint8_t pld[10] = {
+      (initiator << 4) | destination, CEC_ID_SET_OSD_NAME, 'P', 'i', 'c', 'o', '-', 'C', 'E', 'C'};
+
+  send_frame(dispatch, 10, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_SET_OSD_NAME));
+}
+
+static void report_physical_address(cec_dispatch_t *dispatch,
+                                    uint8_t initiator,
+                                    uint8_t destination,
+                                    uint16_t physical_address,
+                                    uint8_t device_type) {
+  uint8_t pld[5] = {(initiator << 4) | destination, CEC_ID_REPORT_PHYSICAL_ADDRESS,
+                    (physical_address >> 8) & 0x0ff, (physical_address >> 0) & 0x0ff, device_type};
+
+  send_frame(dispatch, 5, pld);
+  printf("\n<-- %02x:%02x [%s] %02x%02x", pld[0], pld[1],
+         cec_message(CEC_ID_REPORT_PHYSICAL_ADDRESS), pld[2], pld[3]);
+}
+
+static void report_cec_version(cec_dispatch_t *dispatch, uint8_t initiator, uint8_t destination) {
+  uint8_t pld[3] = {HEADER0(initiator, destination), CEC_ID_CEC_VERSION, CEC_VERSION};
+  send_frame(dispatch, 3, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_CEC_VERSION));
+}
+
+static void report_features(cec_dispatch_t *dispatch, uint8_t initiator) {
+  uint8_t pld[6] = {HEADER0(initiator, 0x0f), CEC_ID_REPORT_FEATURES, CEC_VERSION,
+                    FEATURES_DEVICE_TYPES, FEATURES_RC_PROFILE, FEATURES_DEVICE_FEATURES};
+
+  send_frame(dispatch, 6, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_REPORT_FEATURES));
+}
+
+static void feature_abort(cec_dispatch_t *dispatch,
+                          uint8_t initiator,
+                          uint8_t destination,
+                          uint8_t opcode,
+                          uint8_t reason) {
+  uint8_t pld[4] = {HEADER0(initiator, destination), CEC_ID_FEATURE_ABORT, opcode, reason};
+
+  send_frame(dispatch, 4, pld);
+  printf("\n<-- %02x:%02x [%s] %02x", pld[0], pld[1], cec_message(CEC_ID_FEATURE_ABORT), opcode);
+}
+
+static void deck_status(cec_dispatch_t *dispatch,
+                        uint8_t initiator,
+                        uint8_t destination,
+                        uint8_t info) {
+  uint8_t pld[3] = {HEADER0(initiator, destination), CEC_ID_DECK_STATUS, info};
+
+  send_frame(dispatch, 3, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_DECK_STATUS));
+}
+
+static void image_view_on(cec_dispatch_t *dispatch, uint8_t initiator, uint8_t destination) {
+  uint8_t pld[2] = {HEADER0(initiator, destination), CEC_ID_IMAGE_VIEW_ON};
+
+  send_frame(dispatch, 2, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_IMAGE_VIEW_ON));
+}
+
+static void active_source(cec_dispatch_t *dispatch, uint8_t initiator, uint16_t physical_address) {
+  uint8_t pld[4] = {HEADER0(initiator, 0x0f), CEC_ID_ACTIVE_SOURCE, (physical_address >> 8) & 0x0ff,
+                    (physical_address >> 0) & 0x0ff};
+
+  send_frame(dispatch, 4, pld);
+  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(CEC_ID_ACTIVE_SOURCE));
+}
+
+/**
+ * Move to a new power status.
+ *
+ * CEC 2.0 requires a broadcast Report Power Status on every change, so
+ * announce the transitional state followed by the final one.
+ */
+static void set_power_status(cec_dispatch_t *dispatch, uint8_t status) {
+  if (status == dispatch->power_status) {
+    return;
+  }
+
+  if (CEC_VERSION >= CEC_VERSION_2_0) {
+    uint8_t transition =
+        (status == POWER_STATUS_STANDBY) ? POWER_STATUS_TO_STANDBY : POWER_STATUS_TO_ON;
+    report_power_status(dispatch, dispatch->laddr, 0x0f, transition);
+    report_power_status(dispatch, dispatch->laddr, 0x0f, status);
+  }
+  dispatch->power_status = status;
+}
+
+static bool ping(cec_dispatch_t *dispatch, uint8_t destination) {
+  uint8_t pld[1] = {HEADER0(destination, destination)};
+
+  return send_frame(dispatch, 1, pld);
+}
+
+static uint8_t allocate_logical_address(cec_dispatch_t *dispatch) {
+  uint8_t a;
+  for (unsigned int i = 0; i < NUM_ADDRESS; i++) {
+    a = address[i];
+    printf("\nAttempting to allocate logical address 0x%02x\n", a);
+    if (!ping(dispatch, a)) {
+      break;
+    }
+  }
+
+  printf("Allocated logical address 0x%02x\n", a);
+  return a;
+}
+
+void cec_dispatch_init(cec_dispatch_t *dispatch, const cec_dispatch_ops_t *ops, void *arg) {
+  dispatch->ops = ops;
+  dispatch->arg = arg;
+  dispatch->laddr = address[0];
+  dispatch->paddr = 0x0000;
+  dispatch->power_status = POWER_STATUS_ON;
+  dispatch->deck_info = DECK_INFO_STOP;
+}
+
+/**
+ * Broadcast the physical address, and features for CEC 2.0, once it is known.
+ */
+static void report_address(cec_dispatch_t *dispatch) {
+  if (dispatch->paddr != 0x0000) {
+    report_physical_address(dispatch, dispatch->laddr, 0x0f, dispatch->paddr, DEFAULT_TYPE);
+    if (CEC_VERSION >= CEC_VERSION_2_0) {
+      report_features(dispatch, dispatch->laddr);
+    }
+  }
+}
+
+void cec_dispatch_announce(cec_dispatch_t *dispatch) {
+  dispatch->paddr = dispatch->ops->physical_address(dispatch->arg);
+  dispatch->laddr = allocate_logical_address(dispatch);
+  report_address(dispatch);
+}
+
+void cec_dispatch_set_physical_address(cec_dispatch_t *dispatch, uint16_t paddr) {
+  if (paddr != dispatch->paddr) {
+    dispatch->paddr = paddr;
+    report_address(dispatch);
+  }
+}
+
+/**
+ * Act on a User Control Pressed code.
+ */
+static void user_control_pressed(cec_dispatch_t *dispatch, uint8_t code) {
+  switch (code) {
+    case UI_POWER:
+    case UI_POWER_ON:
+      set_power_status(dispatch, POWER_STATUS_ON);
+      break;
+    case UI_POWER_OFF:
+      set_power_status(dispatch, POWER_STATUS_STANDBY);
+      break;
+    case UI_POWER_TOGGLE:
+      set_power_status(dispatch, (dispatch->power_status == POWER_STATUS_ON)
+                                     ? POWER_STATUS_STANDBY
+                                     : POWER_STATUS_ON);
+      break;
+    case UI_VOLUME_UP:
+      printf("[User Control Volume Up]");
+      break;
+    case UI_VOLUME_DOWN:
+      printf("[User Control Volume Down]");
+      break;
+    default:
+      dispatch->ops->user_control(dispatch->arg, code, true);
+      break;
+  }
+}
+
+void cec_dispatch_frame(cec_dispatch_t *dispatch, const uint8_t *pld, uint8_t pldcnt) {
+  uint8_t initiator = (pld[0] & 0xf0) >> 4;
+  uint8_t destination = pld[0] & 0x0f;
+  uint8_t laddr = dispatch->laddr;
+  uint16_t paddr = dispatch->paddr;
+
+  printf("%02x -> %02x: ", initiator, destination);
+
+  if (pldcnt < 2) {
+    // single byte polling message
+    printf("[Polling Message]: 0x%01x -> 0x%01x\n", initiator, destination);
+    return;
+  }
+
+  printf("[%s]", cec_message(pld[1]));
+  switch (pld[1]) {
+    case CEC_ID_IMAGE_VIEW_ON:
+      break;
+    case CEC_ID_TEXT_VIEW_ON:
+      break;
+    case CEC_ID_STANDBY:
+      printf("<*> [Turn the display OFF]");
+      if (destination == laddr || destination == 0x0f)
+        set_power_status(dispatch, POWER_STATUS_STANDBY);
+      break;
+    case CEC_ID_GIVE_DECK_STATUS:
+      if (destination == laddr)
+        deck_status(dispatch, laddr, initiator, dispatch->deck_info);
+      break;
+    case CEC_ID_DECK_CONTROL:
+      if (destination != laddr)
+        break;
+      switch (pld[2]) {
+        case DECK_CONTROL_SKIP_FORWARD:
+          send_key(dispatch, UI_FAST_FORWARD);
+          dispatch->deck_info = DECK_INFO_SKIP_FORWARD;
+          break;
+        case DECK_CONTROL_SKIP_REVERSE:
+          send_key(dispatch, UI_REWIND);
+          dispatch->deck_info = DECK_INFO_SKIP_REVERSE;
+          break;
+        case DECK_CONTROL_STOP:
+          send_key(dispatch, UI_STOP);
+          dispatch->deck_info = DECK_INFO_STOP;
+          break;
+        default:
+          feature_abort(dispatch, laddr, initiator, pld[1], ABORT_INVALID_OPERAND);
+          break;
+      }
+      break;
+    case CEC_ID_PLAY:
+      if (destination != laddr)
+        break;
+      if (pld[2] == PLAY_FORWARD) {
+        send_key(dispatch, UI_PLAY);
+        dispatch->deck_info = DECK_INFO_PLAY;
+      } else if (pld[2] == PLAY_STILL) {
+        send_key(dispatch, UI_PAUSE);
+        dispatch->deck_info = DECK_INFO_STILL;
+      } else {
+        feature_abort(dispatch, laddr, initiator, pld[1], ABORT_INVALID_OPERAND);
+      }
+      break;
+    case CEC_ID_SYSTEM_AUDIO_MODE_REQUEST:
+      if (destination == laddr)
+        set_system_audio_mode(dispatch, laddr, 0x0f, 1);
+      break;
+    case CEC_ID_GIVE_AUDIO_STATUS:
+      if (destination == laddr)
+        report_audio_status(dispatch, laddr, initiator, 0x32);  // volume 50%, mute off
+      break;
+    case CEC_ID_SET_SYSTEM_AUDIO_MODE:
+      break;
+    case CEC_ID_GIVE_SYSTEM_AUDIO_MODE_STATUS:
+      if (destination == laddr)
+        system_audio_mode_status(dispatch, laddr, initiator, 1);
+      break;
+    case CEC_ID_SYSTEM_AUDIO_MODE_STATUS:
+      break;
+    case CEC_ID_ROUTING_CHANGE:
+      paddr = dispatch->paddr = dispatch->ops->physical_address(dispatch->arg);
+      image_view_on(dispatch, laddr, 0x00);
+      if (paddr != 0x0000 && pldcnt >= 6 && ((pld[4] << 8) | pld[5]) == paddr)
+        set_power_status(dispatch, POWER_STATUS_ON);
+      break;
+    case CEC_ID_ACTIVE_SOURCE:
+      printf("<*> [Turn the display ON]");
+      break;
+    case CEC_ID_REPORT_PHYSICAL_ADDRESS:
+      printf("  %02x%02x", pld[2], pld[3]);
+      // On broadcast receive, do the same
+      if ((initiator == 0x00) && (destination == 0x0f)) {
+        cec_dispatch_announce(dispatch);
+      }
+      break;
+    case CEC_ID_REQUEST_ACTIVE_SOURCE:
+      break;
+    case CEC_ID_SET_STREAM_PATH:
+      if (paddr != 0x0000) {
+        active_source(dispatch, laddr, paddr);
+        if (pldcnt >= 4 && ((pld[2] << 8) | pld[3]) == paddr)
+          set_power_status(dispatch, POWER_STATUS_ON);
+      }
+      break;
+    case CEC_ID_DEVICE_VENDOR_ID:
+      // On broadcast receive, do the same
+      if ((initiator == 0x00) && (destination == 0x0f)) {
+        device_vendor_id(dispatch, laddr, 0x0f, 0x0010FA);
+      }
+      break;
+    case CEC_ID_GIVE_DEVICE_VENDOR_ID:
+      if (destination == laddr)
+        device_vendor_id(dispatch, laddr, 0x0f, 0x0010FA);
+      break;
+    case CEC_ID_MENU_STATUS:
+      break;
+    case CEC_ID_GIVE_DEVICE_POWER_STATUS:
+      if (destination == laddr)
+        report_power_status(dispatch, laddr, initiator, dispatch->power_status);
+      /* Hack for Google Chromecast to force it sending V+/V- if no CEC TV is present */
+      if (destination == 0)
+        report_power_status(dispatch, 0, initiator, 0x00);
+      break;
+    case CEC_ID_REPORT_POWER_STATUS:
+      break;
+    case CEC_ID_GET_MENU_LANGUAGE:
+      break;
+    case CEC_ID_INACTIVE_SOURCE:
+      break;
+    case CEC_ID_CEC_VERSION:
+      break;
+    case CEC_ID_GET_CEC_VERSION:
+      if (destination == laddr) {
+        report_cec_version(dispatch, laddr, initiator);
+      }
+      break;
+    case CEC_ID_GIVE_FEATURES:
+      if (destination == laddr) {
+        if (CEC_VERSION >= CEC_VERSION_2_0) {
+          report_features(dispatch, laddr);
+        } else {
+          feature_abort(dispatch, laddr, initiator, pld[1], ABORT_UNRECOGNIZED_OPCODE);
+        }
+      }
+      break;
+    case CEC_ID_FEATURE_ABORT:
+      break;
+    case CEC_ID_GIVE_OSD_NAME:
+      if (destination == laddr)
+        set_osd_name(dispatch, laddr, initiator);
+      break;
+    case CEC_ID_SET_OSD_NAME:
+      break;
+    case CEC_ID_GIVE_PHYSICAL_ADDRESS:
+      if (destination == laddr && paddr != 0x0000)
+        report_physical_address(dispatch, laddr, 0x0f, paddr, DEFAULT_TYPE);
+      break;
+    case CEC_ID_USER_CONTROL_PRESSED:
+      user_control_pressed(dispatch, pld[2]);
+      break;
+    case CEC_ID_USER_CONTROL_RELEASED:
+      dispatch->ops->user_control(dispatch->arg, 0, false);
+      break;
+    case CEC_ID_ABORT:
+      printf("[Abort]");
+      break;
+    case CEC_ID_VENDOR_COMMAND_WITH_ID:
+      printf("[Vendor Command with ID]");
+      for (int i = 0; i < pldcnt; i++) {
+        printf(" %02x", pld[i]);
+      }
+      printf("\n");
+      break;
+    default:
+      printf("???: %x", pld[1]);  // undecoded command
+      if (destination == laddr)
+        feature_abort(dispatch, laddr, initiator, pld[1], ABORT_UNRECOGNIZED_OPCODE);
+      break;
+  }
+  printf("\n");
+}
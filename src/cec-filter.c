@@ -0,0 +1,33 @@
+#include <string.h>
+
+#include "cec-filter.h"
+
+/* Broadcasts the protocol logic and topology act on. */
+static const uint8_t broadcast_defaults[] = {
+    CEC_ID_STANDBY, CEC_ID_SET_SYSTEM_AUDIO_MODE, CEC_ID_ROUTING_CHANGE, CEC_ID_ACTIVE_SOURCE,
+    CEC_ID_REPORT_PHYSICAL_ADDRESS, CEC_ID_REQUEST_ACTIVE_SOURCE, CEC_ID_SET_STREAM_PATH,
+    CEC_ID_DEVICE_VENDOR_ID, CEC_ID_REPORT_POWER_STATUS, CEC_ID_REPORT_FEATURES};
+
+/* Replies between other devices the topology learns from. */
+static const uint8_t directed_defaults[] = {CEC_ID_SET_OSD_NAME, CEC_ID_REPORT_POWER_STATUS,
+                                            CEC_ID_CEC_VERSION};
+
+void cec_filter_init(cec_filter_t *filter) {
+  memset(filter, 0, sizeof(cec_filter_t));
+  for (unsigned int i = 0; i < sizeof(broadcast_defaults); i++) {
+    cec_filter_set(filter, broadcast_defaults[i], false, true);
+  }
+  for (unsigned int i = 0; i < sizeof(directed_defaults); i++) {
+    cec_filter_set(filter, directed_defaults[i], true, true);
+  }
+}
+
+void cec_filter_set(cec_filter_t *filter, uint8_t opcode, bool directed, bool subscribed) {
+  uint32_t *set = directed ? filter->directed : filter->broadcast;
+
+  if (subscribed) {
+    set[opcode >> 5] |= 1u << (opcode & 0x1f);
+  } else {
+    set[opcode >> 5] &= ~(1u << (opcode & 0x1f));
+  }
+}
@@ -0,0 +1,28 @@
+#include <stdlib.h>
+
+#include "cec-frame.h"
+
+/* Frames as text, shared by the console and the host tools so a frame typed at
+ * one is read the same way by the others.
+ */
+
+bool cec_frame_parse(const char *str, uint8_t *pld, uint8_t *len) {
+  *len = 0;
+  while (*str != '\0') {
+    char *end;
+    unsigned long byte = strtoul(str, &end, 16);
+    if ((end == str) || (byte > 0xff) || (*len >= 16)) {
+      return false;
+    }
+    pld[(*len)++] = byte;
+
+    if (*end == ':') {
+      end++;
+    } else if (*end != '\0') {
+      return false;
+    }
+    str = end;
+  }
+
+  return (*len > 0);
+}
@@ -0,0 +1,268 @@
+#include <string.h>
+
+#include "cec-p8.h"
+
+/* Pulse-Eight adapter emulation.
+ *
+ * Every command is answered with COMMAND_ACCEPTED or COMMAND_REJECTED naming
+ * it, queries are answered with their own code and the value.  A frame to send
+ * arrives a byte at a time and goes out on TRANSMIT_EOM, followed by its
+ * result.  Settings the real adapter keeps in EEPROM only last until the
+ * adapter is closed.
+ */
+
+#define DEFAULT_LADDR (0x04)        // Playback 1
+#define DEFAULT_DEVICE_TYPE (0x04)  // Playback Device
+#define DEFAULT_HDMI_VERSION (0x05) // CEC 1.4
+
+static void write_msg(cec_p8_t *p8, uint8_t code, const uint8_t *param, uint8_t len) {
+  // start, code, every parameter escaped, end
+  uint8_t buf[3 + 2 * CEC_P8_MAX_MSG];
+  uint8_t n = 0;
+
+  buf[n++] = CEC_P8_MSGSTART;
+  buf[n++] = code;
+  for (uint8_t i = 0; (i < len) && (i < CEC_P8_MAX_MSG); i++) {
+    if (param[i] >= CEC_P8_MSGESC) {
+      buf[n++] = CEC_P8_MSGESC;
+      buf[n++] = param[i] - CEC_P8_ESCOFFSET;
+    } else {
+      buf[n++] = param[i];
+    }
+  }
+  buf[n++] = CEC_P8_MSGEND;
+
+  p8->ops->write(p8->arg, buf, n);
+}
+
+static void reply(cec_p8_t *p8, bool accepted, uint8_t code) {
+  write_msg(p8, accepted ? CEC_P8_COMMAND_ACCEPTED : CEC_P8_COMMAND_REJECTED, &code, 1);
+}
+
+static void reply_u8(cec_p8_t *p8, uint8_t code, uint8_t value) {
+  write_msg(p8, code, &value, 1);
+}
+
+static void reply_u16(cec_p8_t *p8, uint8_t code, uint16_t value) {
+  uint8_t param[2] = {value >> 8, value & 0xff};
+
+  write_msg(p8, code, param, sizeof(param));
+}
+
+static uint16_t get_u16(const uint8_t *param) {
+  return (param[0] << 8) | param[1];
+}
+
+static void transmit(cec_p8_t *p8) {
+  uint8_t result;
+
+  switch (p8->ops->transmit(p8->arg, p8->tx, p8->tx_len)) {
+    case CEC_P8_TX_OK:
+      result = CEC_P8_TRANSMIT_SUCCEEDED;
+      break;
+    case CEC_P8_TX_NACK:
+      result = CEC_P8_TRANSMIT_FAILED_ACK;
+      break;
+    default:
+      result = CEC_P8_TRANSMIT_FAILED_LINE;
+  }
+  p8->tx_len = 0;
+
+  write_msg(p8, result, NULL, 0);
+}
+
+/**
+ * Act on a complete message from the host, msg[0] is the code.
+ */
+static void command(cec_p8_t *p8) {
+  uint8_t code = p8->msg[0] & CEC_P8_CODE_MASK;
+  const uint8_t *param = &p8->msg[1];
+  uint8_t len = p8->msg_len - 1;
+
+  switch (code) {
+    case CEC_P8_PING:
+      reply(p8, true, code);
+      break;
+    case CEC_P8_SET_ACK_MASK:
+      if (len < 2) {
+        reply(p8, false, code);
+        break;
+      }
+      p8->ack_mask = get_u16(param);
+      p8->ops->ack_mask(p8->arg, p8->ack_mask);
+      reply(p8, true, code);
+      break;
+    case CEC_P8_TRANSMIT_IDLETIME:
+    case CEC_P8_TRANSMIT_ACK_POLARITY:
+      // sent ahead of each frame, bus idle time and broadcast acks are handled
+      // by the transmitter itself
+      p8->tx_len = 0;
+      reply(p8, true, code);
+      break;
+    case CEC_P8_TRANSMIT_LINE_TIMEOUT:
+      reply(p8, true, code);
+      break;
+    case CEC_P8_TRANSMIT:
+    case CEC_P8_TRANSMIT_EOM:
+      if ((len < 1) || (p8->tx_len >= sizeof(p8->tx))) {
+        p8->tx_len = 0;
+        reply(p8, false, code);
+        break;
+      }
+      p8->tx[p8->tx_len++] = param[0];
+      reply(p8, true, code);
+      if (code == CEC_P8_TRANSMIT_EOM) {
+        transmit(p8);
+      }
+      break;
+    case CEC_P8_FIRMWARE_VERSION:
+      reply_u16(p8, code, CEC_P8_FIRMWARE);
+      break;
+    case CEC_P8_GET_BUILDDATE: {
+      uint8_t date[4] = {p8->build_date >> 24, p8->build_date >> 16, p8->build_date >> 8,
+                         p8->build_date};
+      write_msg(p8, code, date, sizeof(date));
+    } break;
+    case CEC_P8_SET_CONTROLLED:
+      p8->controlled = (len > 0) && param[0];
+      reply(p8, true, code);
+      break;
+    case CEC_P8_GET_AUTO_ENABLED:
+      reply_u8(p8, code, p8->auto_enabled);
+      break;
+    case CEC_P8_SET_AUTO_ENABLED:
+      p8->auto_enabled = (len > 0) && param[0];
+      reply(p8, true, code);
+      break;
+    case CEC_P8_GET_DEFAULT_LOGICAL_ADDRESS:
+      reply_u8(p8, code, p8->default_laddr);
+      break;
+    case CEC_P8_SET_DEFAULT_LOGICAL_ADDRESS:
+      if (len > 0) {
+        p8->default_laddr = param[0] & 0x0f;
+      }
+      reply(p8, len > 0, code);
+      break;
+    case CEC_P8_GET_LOGICAL_ADDRESS_MASK:
+      reply_u16(p8, code, p8->laddr_mask);
+      break;
+    case CEC_P8_SET_LOGICAL_ADDRESS_MASK:
+      if (len >= 2) {
+        p8->laddr_mask = get_u16(param);
+      }
+      reply(p8, len >= 2, code);
+      break;
+    case CEC_P8_GET_PHYSICAL_ADDRESS:
+      if (p8->paddr == 0x0000) {
+        p8->paddr = p8->ops->physical_address(p8->arg);
+      }
+      reply_u16(p8, code, p8->paddr);
+      break;
+    case CEC_P8_SET_PHYSICAL_ADDRESS:
+      if (len >= 2) {
+        p8->paddr = get_u16(param);
+      }
+      reply(p8, len >= 2, code);
+      break;
+    case CEC_P8_GET_DEVICE_TYPE:
+      reply_u8(p8, code, p8->device_type);
+      break;
+    case CEC_P8_SET_DEVICE_TYPE:
+      if (len > 0) {
+        p8->device_type = param[0];
+      }
+      reply(p8, len > 0, code);
+      break;
+    case CEC_P8_GET_HDMI_VERSION:
+      reply_u8(p8, code, p8->hdmi_version);
+      break;
+    case CEC_P8_SET_HDMI_VERSION:
+      if (len > 0) {
+        p8->hdmi_version = param[0];
+      }
+      reply(p8, len > 0, code);
+      break;
+    case CEC_P8_GET_OSD_NAME:
+      write_msg(p8, code, p8->osd_name, p8->osd_name_len);
+      break;
+    case CEC_P8_SET_OSD_NAME:
+      p8->osd_name_len = (len < sizeof(p8->osd_name)) ? len : sizeof(p8->osd_name);
+      memcpy(p8->osd_name, param, p8->osd_name_len);
+      reply(p8, true, code);
+      break;
+    case CEC_P8_WRITE_EEPROM:
+      // nothing to persist, settings last until the adapter is closed
+      reply(p8, true, code);
+      break;
+    case CEC_P8_GET_ADAPTER_TYPE:
+      reply_u8(p8, code, CEC_P8_ADAPTER_EXTERNAL);
+      break;
+    case CEC_P8_SET_ACTIVE_SOURCE:
+      reply(p8, true, code);
+      break;
+    case CEC_P8_GET_AUTO_POWER_ON:
+      reply_u8(p8, code, p8->auto_power_on);
+      break;
+    case CEC_P8_SET_AUTO_POWER_ON:
+      p8->auto_power_on = (len > 0) && param[0];
+      reply(p8, true, code);
+      break;
+    default:
+      // including START_BOOTLOADER, the board has its own way into BOOTSEL
+      reply(p8, false, code);
+  }
+}
+
+void cec_p8_init(cec_p8_t *p8, const cec_p8_ops_t *ops, void *arg, uint32_t build_date) {
+  memset(p8, 0, sizeof(cec_p8_t));
+  p8->ops = ops;
+  p8->arg = arg;
+  p8->build_date = build_date;
+  p8->default_laddr = DEFAULT_LADDR;
+  p8->laddr_mask = 1 << DEFAULT_LADDR;
+  p8->device_type = DEFAULT_DEVICE_TYPE;
+  p8->hdmi_version = DEFAULT_HDMI_VERSION;
+  memcpy(p8->osd_name, "Pico-CEC", 8);
+  p8->osd_name_len = 8;
+}
+
+void cec_p8_input(cec_p8_t *p8, const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    uint8_t c = data[i];
+
+    if (c == CEC_P8_MSGSTART) {
+      // a new message abandons any partial one
+      p8->started = true;
+      p8->escaped = false;
+      p8->msg_len = 0;
+    } else if (!p8->started) {
+      continue;
+    } else if (c == CEC_P8_MSGEND) {
+      p8->started = false;
+      if (p8->msg_len > 0) {
+        command(p8);
+      }
+    } else if (c == CEC_P8_MSGESC) {
+      p8->escaped = true;
+    } else if (p8->msg_len >= sizeof(p8->msg)) {
+      // too long for any command, drop it
+      p8->started = false;
+    } else {
+      p8->msg[p8->msg_len++] = p8->escaped ? c + CEC_P8_ESCOFFSET : c;
+      p8->escaped = false;
+    }
+  }
+}
+
+void cec_p8_frame(cec_p8_t *p8, const uint8_t *pld, uint8_t len, bool ack) {
+  for (uint8_t i = 0; i < len; i++) {
+    uint8_t code = (i == 0) ? CEC_P8_FRAME_START : CEC_P8_FRAME_DATA;
+    if (i == len - 1) {
+      code |= CEC_P8_FRAME_EOM;
+    }
+    if (ack) {
+      code |= CEC_P8_FRAME_ACK;
+    }
+    write_msg(p8, code, &pld[i], 1);
+  }
+}
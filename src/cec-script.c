@@ -0,0 +1,286 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "hardware/timer.h"
+
+#include "cec-frame.h"
+#include "cec-script.h"
+#include "cec-transaction.h"
+
+/* Frame injection and stored multi-step CEC sequences.
+ *
+ * Steps run in the calling task through the transaction layer, so latency
+ * covers waiting for the bus, the transmission and any response.
+ */
+
+#define ENDLINE "\r\n"
+#define DEFAULT_TIMEOUT_MS (1000)
+#define MAX_ARGS (6)
+
+static char scripts[CEC_SCRIPT_MAX][CEC_SCRIPT_LEN];
+
+static const char *status_name[] = {
+    [CEC_TRANSACTION_QUEUED] = "QUEUED",
+    [CEC_TRANSACTION_WAITING] = "WAITING",
+    [CEC_TRANSACTION_OK] = "OK",
+    [CEC_TRANSACTION_NACK] = "NACK",
+    [CEC_TRANSACTION_ABORTED] = "ABORT",
+    [CEC_TRANSACTION_TIMEOUT] = "TIMEOUT",
+    [CEC_TRANSACTION_BUSY] = "BUSY",
+};
+
+static bool parse_number(const char *str, int base, unsigned long max, unsigned long *value) {
+  char *end;
+
+  *value = strtoul(str, &end, base);
+  return (end != str) && (*end == '\0') && (*value <= max);
+}
+
+static int format_frame(char *buffer, size_t size, const uint8_t *pld, uint8_t len) {
+  int n = 0;
+
+  for (uint8_t i = 0; (i < len) && (n < (int)size); i++) {
+    n += snprintf(&buffer[n], size - n, (i == 0) ? "%02x" : ":%02x", pld[i]);
+  }
+
+  return (n < (int)size) ? n : (int)size - 1;
+}
+
+static void record(cec_script_stats_t *stats, bool ok, uint32_t latency_us) {
+  if (stats == NULL) {
+    return;
+  }
+
+  if (!ok) {
+    stats->failed++;
+    return;
+  }
+
+  stats->ok++;
+  stats->total_us += latency_us;
+  if (latency_us < stats->min_us) {
+    stats->min_us = latency_us;
+  }
+  if (latency_us > stats->max_us) {
+    stats->max_us = latency_us;
+  }
+}
+
+/**
+ * Run a transaction and print the result line.
+ */
+static int run(cec_transaction_t *transaction,
+               const char *step,
+               cec_script_print_t print,
+               void *arg,
+               cec_script_stats_t *stats) {
+  uint64_t start = time_us_64();
+  cec_transaction_status_t status = cec_transact(transaction);
+  uint32_t latency_us = time_us_64() - start;
+
+  const char *result = status_name[status];
+  if ((status == CEC_TRANSACTION_OK) && (transaction->flags & CEC_TRANSACTION_ACK_ONLY)) {
+    result = "ACK";
+  }
+
+  char line[160];
+  int n = snprintf(line, sizeof(line), "%s %s %lu us", step, result, (unsigned long)latency_us);
+  if (transaction->duration_us != 0) {
+    n += snprintf(&line[n], sizeof(line) - n, " (wire %lu us)",
+                  (unsigned long)transaction->duration_us);
+  }
+  if (transaction->response_len > 0) {
+    n += snprintf(&line[n], sizeof(line) - n, " <- ");
+    n += format_frame(&line[n], sizeof(line) - n, transaction->response,
+                      transaction->response_len);
+  }
+  snprintf(&line[n], sizeof(line) - n, ENDLINE);
+  print(arg, line);
+
+  bool ok = (status == CEC_TRANSACTION_OK);
+  record(stats, ok, latency_us);
+
+  return ok ? 0 : -1;
+}
+
+static int step_tx(int argc,
+                   const char **argv,
+                   cec_script_print_t print,
+                   void *arg,
+                   cec_script_stats_t *stats) {
+  cec_transaction_t transaction = {.flags = CEC_TRANSACTION_RAW};
+  unsigned long opcode = 0;
+  unsigned long timeout = DEFAULT_TIMEOUT_MS;
+
+  if ((argc < 2) || (argc > 4)
+      || !cec_frame_parse(argv[1], transaction.request, &transaction.request_len)
+      || ((argc >= 3) && !parse_number(argv[2], 16, 0xff, &opcode))
+      || ((argc >= 4) && !parse_number(argv[3], 10, 60000, &timeout))) {
+    print(arg, "usage: tx <frame> [<opcode> [<timeout_ms>]]" ENDLINE);
+    return -1;
+  }
+
+  if (argc >= 3) {
+    // expect a response from the destination
+    transaction.initiator = transaction.request[0] & 0x0f;
+    transaction.opcode = opcode;
+    transaction.timeout_ms = timeout;
+  } else {
+    transaction.flags |= CEC_TRANSACTION_ACK_ONLY;
+  }
+
+  char step[56];
+  int n = snprintf(step, sizeof(step), "tx ");
+  format_frame(&step[n], sizeof(step) - n, transaction.request, transaction.request_len);
+
+  return run(&transaction, step, print, arg, stats);
+}
+
+static int step_wait(int argc,
+                     const char **argv,
+                     cec_script_print_t print,
+                     void *arg,
+                     cec_script_stats_t *stats) {
+  cec_transaction_t transaction = {0};
+  unsigned long initiator = 0;
+  unsigned long opcode = 0;
+  unsigned long timeout = DEFAULT_TIMEOUT_MS;
+
+  if ((argc < 3) || (argc > 4) || !parse_number(argv[1], 16, 0x0f, &initiator)
+      || !parse_number(argv[2], 16, 0xff, &opcode)
+      || ((argc >= 4) && !parse_number(argv[3], 10, 60000, &timeout))) {
+    print(arg, "usage: wait <initiator> <opcode> [<timeout_ms>]" ENDLINE);
+    return -1;
+  }
+
+  transaction.initiator = initiator;
+  transaction.opcode = opcode;
+  transaction.timeout_ms = timeout;
+
+  char step[24];
+  snprintf(step, sizeof(step), "wait %lx:%02lx", initiator, opcode);
+
+  return run(&transaction, step, print, arg, stats);
+}
+
+static int step_delay(int argc, const char **argv, cec_script_print_t print, void *arg) {
+  unsigned long ms = 0;
+
+  if ((argc != 2) || !parse_number(argv[1], 10, 60000, &ms)) {
+    print(arg, "usage: delay <ms>" ENDLINE);
+    return -1;
+  }
+
+  vTaskDelay(pdMS_TO_TICKS(ms));
+  return 0;
+}
+
+int cec_script_step(int argc,
+                    const char **argv,
+                    cec_script_print_t print,
+                    void *arg,
+                    cec_script_stats_t *stats) {
+  if (strcmp(argv[0], "tx") == 0) {
+    return step_tx(argc, argv, print, arg, stats);
+  } else if (strcmp(argv[0], "wait") == 0) {
+    return step_wait(argc, argv, print, arg, stats);
+  } else if (strcmp(argv[0], "delay") == 0) {
+    return step_delay(argc, argv, print, arg);
+  }
+
+  print(arg, "unknown step: ");
+  print(arg, argv[0]);
+  print(arg, ENDLINE);
+  return -1;
+}
+
+bool cec_script_add(unsigned int n, int argc, const char **argv) {
+  if ((n >= CEC_SCRIPT_MAX) || (argc < 1)) {
+    return false;
+  }
+
+  char *script = scripts[n];
+  size_t len = strlen(script);
+  size_t needed = (len > 0) ? 2 : 0;
+  for (int i = 0; i < argc; i++) {
+    needed += strlen(argv[i]) + 1;
+  }
+  if (len + needed >= CEC_SCRIPT_LEN) {
+    return false;
+  }
+
+  if (len > 0) {
+    strcat(script, "; ");
+  }
+  for (int i = 0; i < argc; i++) {
+    if (i > 0) {
+      strcat(script, " ");
+    }
+    strcat(script, argv[i]);
+  }
+
+  return true;
+}
+
+void cec_script_clear(unsigned int n) {
+  if (n < CEC_SCRIPT_MAX) {
+    scripts[n][0] = '\0';
+  }
+}
+
+void cec_script_list(cec_script_print_t print, void *arg) {
+  for (unsigned int i = 0; i < CEC_SCRIPT_MAX; i++) {
+    char prefix[8];
+    snprintf(prefix, sizeof(prefix), "%u: ", i);
+    print(arg, prefix);
+    print(arg, scripts[i]);
+    print(arg, ENDLINE);
+  }
+}
+
+int cec_script_run(unsigned int n, unsigned int count, cec_script_print_t print, void *arg) {
+  if ((n >= CEC_SCRIPT_MAX) || (scripts[n][0] == '\0')) {
+    print(arg, "empty script" ENDLINE);
+    return -1;
+  }
+
+  cec_script_stats_t stats = {.min_us = UINT32_MAX};
+  for (unsigned int i = 0; i < count; i++) {
+    char buffer[CEC_SCRIPT_LEN];
+    char *steps;
+    strcpy(buffer, scripts[n]);
+
+    for (char *step = strtok_r(buffer, ";", &steps); step != NULL;
+         step = strtok_r(NULL, ";", &steps)) {
+      const char *argv[MAX_ARGS];
+      int argc = 0;
+      char *tokens;
+
+      for (char *token = strtok_r(step, " ", &tokens); (token != NULL) && (argc < MAX_ARGS);
+           token = strtok_r(NULL, " ", &tokens)) {
+        argv[argc++] = token;
+      }
+      if (argc > 0) {
+        cec_script_step(argc, argv, print, arg, &stats);
+      }
+    }
+  }
+
+  char line[128];
+  uint32_t steps = stats.ok + stats.failed;
+  snprintf(line, sizeof(line), "runs %u, steps %lu, ok %lu, failed %lu" ENDLINE, count,
+           (unsigned long)steps, (unsigned long)stats.ok, (unsigned long)stats.failed);
+  print(arg, line);
+  if (stats.ok > 0) {
+    snprintf(line, sizeof(line), "latency min/avg/max %lu/%lu/%lu us" ENDLINE,
+             (unsigned long)stats.min_us, (unsigned long)(stats.total_us / stats.ok),
+             (unsigned long)stats.max_us);
+    print(arg, line);
+  }
+
+  return (stats.failed == 0) ? 0 : -1;
+}
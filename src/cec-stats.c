@@ -0,0 +1,67 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "cec-stats.h"
+
+volatile cec_stats_t cec_stats;
+
+/* Snapshot taken by the previous telemetry record. */
+static cec_stats_t last;
+static uint32_t last_ms;
+
+int cec_stats_json(char *buf, size_t size, uint32_t now_ms) {
+  cec_stats_t now;
+  memcpy(&now, (const void *)&cec_stats, sizeof(now));
+
+  uint32_t interval_ms = now_ms - last_ms;
+  if (interval_ms == 0) {
+    interval_ms = 1;
+  }
+
+  // utilisation in tenths of a percent
+  uint32_t busy_us = now.busy_us - last.busy_us;
+  uint32_t util = (uint32_t)(((uint64_t)busy_us) / interval_ms);
+  if (util > 1000) {
+    util = 1000;
+  }
+
+  int n = snprintf(buf, size,
+                   "{\"t\":%lu,\"rx\":%lu,\"tx\":%lu,"
+                   "\"rx_err\":{\"start\":%lu,\"period\":%lu,\"bit\":%lu,\"ack\":%lu,"
+                   "\"glitch\":%lu,\"timeout\":%lu},"
+                   "\"filtered\":{\"poll\":%lu,\"others\":%lu,\"opcode\":%lu},"
+                   "\"line_low\":%lu,\"tx_nack\":%lu,\"tx_retry\":%lu,\"tx_collision\":%lu,"
+                   "\"tx_busy\":%lu,\"hid_drop\":%lu,\"util\":%lu.%lu,\"fps\":{",
+                   (unsigned long)now_ms, (unsigned long)now.rx_frames,
+                   (unsigned long)now.tx_frames, (unsigned long)now.rx_start_errors,
+                   (unsigned long)now.rx_period_errors, (unsigned long)now.rx_bit_errors,
+                   (unsigned long)now.rx_ack_errors, (unsigned long)now.rx_glitches,
+                   (unsigned long)now.rx_timeouts, (unsigned long)now.rx_filtered_polls,
+                   (unsigned long)now.rx_filtered_others, (unsigned long)now.rx_filtered_opcodes,
+                   (unsigned long)now.line_low, (unsigned long)now.tx_nacks,
+                   (unsigned long)now.tx_retries, (unsigned long)now.tx_collisions,
+                   (unsigned long)now.tx_bus_busy, (unsigned long)now.hid_drops,
+                   (unsigned long)(util / 10), (unsigned long)(util % 10));
+
+  // frames per second in tenths, only for initiators seen in the interval
+  const char *sep = "";
+  for (unsigned int i = 0; (i < 16) && (n < (int)size); i++) {
+    uint32_t frames = now.initiator_frames[i] - last.initiator_frames[i];
+    if (frames == 0) {
+      continue;
+    }
+
+    uint32_t fps = (uint32_t)(((uint64_t)frames * 10000) / interval_ms);
+    n += snprintf(&buf[n], size - n, "%s\"%x\":%lu.%lu", sep, i, (unsigned long)(fps / 10),
+                  (unsigned long)(fps % 10));
+    sep = ",";
+  }
+  if (n < (int)size) {
+    n += snprintf(&buf[n], size - n, "}}");
+  }
+
+  last = now;
+  last_ms = now_ms;
+
+  return (n < (int)size) ? n : (int)size - 1;
+}
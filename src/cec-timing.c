@@ -0,0 +1,195 @@
+#include <string.h>
+
+#include "pico/platform.h"
+
+#include "cec-timing.h"
+#include "hdmi-cec.h"
+
+/* Receive tolerance profiles and per-initiator timing.
+ *
+ * The receive interrupt handler checks every pulse against the windows of the
+ * frame's initiator on its bus.  Good frames feed a running average of each
+ * initiator's timing, which in adaptive mode moves that initiator's windows
+ * onto what it actually sends.  Buses are kept apart, as the same logical
+ * address is a different device on each.  Adapted windows always cover the
+ * profile windows and never leave the safe limits, so a logical 0 can not be
+ * taken for a 1.
+ */
+
+/* Frames from an initiator before its windows are adapted. */
+#define ADAPT_MIN_FRAMES (16)
+
+/* Weight of a new frame in the running averages, as a shift. */
+#define AVERAGE_SHIFT (3)
+
+static const cec_timing_t profiles[CEC_TIMING_PROFILE_COUNT] = {
+    [CEC_TIMING_SPEC] =
+        {
+            .start_low = {3500, 3900},
+            .start_period = {4300, 4700},
+            .one_low = {400, 800},
+            .zero_low = {1300, 1700},
+            .period = {2050, 2750},
+            .glitch_us = 0,
+        },
+    [CEC_TIMING_RELAXED] =
+        {
+            .start_low = {3300, 4100},
+            .start_period = {4100, 4900},
+            .one_low = {300, 950},
+            .zero_low = {1150, 1850},
+            .period = {1900, 2950},
+            .glitch_us = 100,
+        },
+};
+
+/* Bounds adapted windows never cross. */
+static const cec_timing_t limits = {
+    .start_low = {3200, 4200},
+    .start_period = {4000, 5000},
+    .one_low = {200, 1000},
+    .zero_low = {1050, 2000},
+    .period = {1800, 3000},
+};
+
+const char *cec_timing_profile_name[CEC_TIMING_PROFILE_COUNT] = {
+    [CEC_TIMING_SPEC] = "spec",
+    [CEC_TIMING_RELAXED] = "relaxed",
+};
+
+// read on every edge, kept in SCRATCH_Y with the receive interrupt
+__scratch_y("cec_data") cec_timing_t cec_timing[CEC_BUSES][CEC_TIMING_UNKNOWN + 1];
+
+static cec_timing_profile_t profile = CEC_TIMING_SPEC;
+static uint16_t glitch_us;
+static bool adaptive = false;
+static cec_timing_stats_t stats[CEC_BUSES][16];
+
+/**
+ * Widen a window to take in the learnt mean with the same margin either side.
+ */
+static cec_window_t adapt(cec_window_t window, uint16_t mean, cec_window_t limit) {
+  if (mean == 0) {
+    return window;
+  }
+
+  int32_t half = (window.max - window.min) / 2;
+  int32_t min = mean - half;
+  int32_t max = mean + half;
+
+  if (min > window.min) {
+    min = window.min;
+  }
+  if (min < limit.min) {
+    min = limit.min;
+  }
+  if (max < window.max) {
+    max = window.max;
+  }
+  if (max > limit.max) {
+    max = limit.max;
+  }
+
+  return (cec_window_t){min, max};
+}
+
+/**
+ * Set the windows of an initiator on a bus from the profile and, if adaptive,
+ * its learnt timing.
+ */
+static void apply(unsigned int bus, unsigned int initiator) {
+  cec_timing_t timing = profiles[profile];
+
+  timing.glitch_us = glitch_us;
+  if (adaptive && (initiator < CEC_TIMING_UNKNOWN)
+      && (stats[bus][initiator].frames >= ADAPT_MIN_FRAMES)) {
+    const cec_timing_stats_t *s = &stats[bus][initiator];
+    timing.start_low = adapt(timing.start_low, s->start_low, limits.start_low);
+    timing.one_low = adapt(timing.one_low, s->one_low, limits.one_low);
+    timing.zero_low = adapt(timing.zero_low, s->zero_low, limits.zero_low);
+    timing.period = adapt(timing.period, s->period, limits.period);
+  }
+
+  cec_timing[bus][initiator] = timing;
+}
+
+static void apply_all(void) {
+  for (unsigned int bus = 0; bus < CEC_BUSES; bus++) {
+    for (unsigned int i = 0; i <= CEC_TIMING_UNKNOWN; i++) {
+      apply(bus, i);
+    }
+  }
+}
+
+void cec_timing_set_profile(cec_timing_profile_t p) {
+  if (p >= CEC_TIMING_PROFILE_COUNT) {
+    return;
+  }
+
+  profile = p;
+  glitch_us = profiles[p].glitch_us;
+  apply_all();
+}
+
+cec_timing_profile_t cec_timing_get_profile(void) {
+  return profile;
+}
+
+void cec_timing_set_glitch(uint16_t us) {
+  glitch_us = us;
+  apply_all();
+}
+
+void cec_timing_set_adaptive(bool on) {
+  adaptive = on;
+  apply_all();
+}
+
+bool cec_timing_get_adaptive(void) {
+  return adaptive;
+}
+
+static uint16_t average(uint16_t avg, uint32_t value) {
+  if (avg == 0) {
+    return value;
+  }
+
+  return avg + (((int32_t)value - (int32_t)avg) >> AVERAGE_SHIFT);
+}
+
+void cec_timing_learn(uint8_t bus, uint8_t initiator, const cec_timing_sample_t *sample) {
+  cec_timing_stats_t *s = &stats[bus][initiator & 0x0f];
+
+  s->frames++;
+  if (sample->start_low > 0) {
+    s->start_low = average(s->start_low, sample->start_low);
+  }
+  if (sample->ones > 0) {
+    s->one_low = average(s->one_low, sample->one_sum / sample->ones);
+  }
+  if (sample->zeros > 0) {
+    s->zero_low = average(s->zero_low, sample->zero_sum / sample->zeros);
+  }
+  if (sample->periods > 0) {
+    s->period = average(s->period, sample->period_sum / sample->periods);
+  }
+
+  if (adaptive && (s->frames >= ADAPT_MIN_FRAMES)) {
+    apply(bus, initiator & 0x0f);
+  }
+}
+
+void cec_timing_error(uint8_t bus, uint8_t initiator) {
+  stats[bus][initiator & 0x0f].errors++;
+}
+
+bool cec_timing_stats(uint8_t bus, uint8_t initiator, cec_timing_stats_t *s) {
+  *s = stats[bus][initiator & 0x0f];
+
+  return (s->frames > 0) || (s->errors > 0);
+}
+
+void cec_timing_reset(void) {
+  memset(stats, 0, sizeof(stats));
+  apply_all();
+}
@@ -0,0 +1,212 @@
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cec-topology.h"
+#include "hdmi-cec.h"
+
+/* Bus topology cache, keyed by logical address.
+ *
+ * Filled passively from every frame seen on the bus, and actively by a scan
+ * which polls each logical address then asks present devices for whatever
+ * is not yet cached.  The scan queries are pipelined: the CEC task sends the
+ * next query as soon as the bus is free rather than waiting on each reply,
+ * and replies are picked up by cec_topology_observe().
+ */
+
+typedef enum {
+  SCAN_IDLE = 0,
+  SCAN_POLL = 1,
+  SCAN_QUERY = 2,
+} scan_state_t;
+
+typedef struct {
+  uint8_t opcode;
+  uint8_t known;
+} query_t;
+
+static const query_t queries[] = {
+    {CEC_ID_GIVE_PHYSICAL_ADDRESS, CEC_DEVICE_PHYSICAL_ADDRESS},
+    {CEC_ID_GIVE_DEVICE_VENDOR_ID, CEC_DEVICE_VENDOR_ID},
+    {CEC_ID_GIVE_OSD_NAME, CEC_DEVICE_OSD_NAME},
+    {CEC_ID_GIVE_DEVICE_POWER_STATUS, CEC_DEVICE_POWER_STATUS},
+    {CEC_ID_GET_CEC_VERSION, CEC_DEVICE_CEC_VERSION},
+};
+
+#define NUM_QUERIES (sizeof(queries) / sizeof(queries[0]))
+
+static cec_device_t devices[CEC_TOPOLOGY_NUM_DEVICES];
+
+static struct {
+  scan_state_t state;
+  uint8_t target;
+  uint8_t query;
+} scan;
+
+void cec_topology_observe(const uint8_t *pld, uint8_t len, uint32_t now) {
+  if (len == 0) {
+    return;
+  }
+
+  uint8_t initiator = (pld[0] & 0xf0) >> 4;
+  if (initiator >= CEC_TOPOLOGY_NUM_DEVICES) {
+    // unregistered devices are not tracked
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  cec_device_t *device = &devices[initiator];
+  device->present = true;
+  device->last_seen = now;
+
+  if (len > 1) {
+    switch (pld[1]) {
+      case CEC_ID_REPORT_PHYSICAL_ADDRESS:
+        if (len >= 5) {
+          device->physical_address = (pld[2] << 8) | pld[3];
+          device->device_type = pld[4];
+          device->known |= CEC_DEVICE_PHYSICAL_ADDRESS;
+        }
+        break;
+      case CEC_ID_ACTIVE_SOURCE:
+        if (len >= 4) {
+          device->physical_address = (pld[2] << 8) | pld[3];
+          device->known |= CEC_DEVICE_PHYSICAL_ADDRESS;
+        }
+        device->power_status = 0x00;  // an active source must be on
+        device->known |= CEC_DEVICE_POWER_STATUS;
+        break;
+      case CEC_ID_DEVICE_VENDOR_ID:
+        if (len >= 5) {
+          device->vendor_id = (pld[2] << 16) | (pld[3] << 8) | pld[4];
+          device->known |= CEC_DEVICE_VENDOR_ID;
+        }
+        break;
+      case CEC_ID_SET_OSD_NAME: {
+        uint8_t n = len - 2;
+        if (n > CEC_TOPOLOGY_OSD_NAME_LEN) {
+          n = CEC_TOPOLOGY_OSD_NAME_LEN;
+        }
+        memcpy(device->osd_name, &pld[2], n);
+        device->osd_name[n] = '\0';
+        device->known |= CEC_DEVICE_OSD_NAME;
+      } break;
+      case CEC_ID_REPORT_POWER_STATUS:
+        if (len >= 3) {
+          device->power_status = pld[2];
+          device->known |= CEC_DEVICE_POWER_STATUS;
+        }
+        break;
+      case CEC_ID_CEC_VERSION:
+      case CEC_ID_REPORT_FEATURES:
+        if (len >= 3) {
+          device->cec_version = pld[2];
+          device->known |= CEC_DEVICE_CEC_VERSION;
+        }
+        break;
+      default:
+        break;
+    }
+  }
+  taskEXIT_CRITICAL();
+}
+
+void cec_topology_seen(uint16_t initiators, uint32_t now) {
+  taskENTER_CRITICAL();
+  for (unsigned int i = 0; i < CEC_TOPOLOGY_NUM_DEVICES; i++) {
+    if (initiators & (1 << i)) {
+      devices[i].present = true;
+      devices[i].last_seen = now;
+    }
+  }
+  taskEXIT_CRITICAL();
+}
+
+void cec_topology_expire(uint32_t now) {
+  taskENTER_CRITICAL();
+  for (unsigned int i = 0; i < CEC_TOPOLOGY_NUM_DEVICES; i++) {
+    if (devices[i].present && (now - devices[i].last_seen) > CEC_TOPOLOGY_EXPIRY_MS) {
+      memset(&devices[i], 0, sizeof(cec_device_t));
+    }
+  }
+  taskEXIT_CRITICAL();
+}
+
+bool cec_topology_get(uint8_t laddr, cec_device_t *device) {
+  if (laddr >= CEC_TOPOLOGY_NUM_DEVICES) {
+    return false;
+  }
+
+  taskENTER_CRITICAL();
+  *device = devices[laddr];
+  taskEXIT_CRITICAL();
+
+  return device->present;
+}
+
+void cec_topology_scan(void) {
+  taskENTER_CRITICAL();
+  // a scan is a full refresh, start from a clean table
+  memset(devices, 0, sizeof(devices));
+  scan.state = SCAN_POLL;
+  scan.target = 0;
+  scan.query = 0;
+  taskEXIT_CRITICAL();
+
+  cec_wake();
+}
+
+bool cec_topology_scan_next(uint8_t laddr, uint8_t *pld, uint8_t *len) {
+  bool found = false;
+
+  taskENTER_CRITICAL();
+  while (!found && scan.state != SCAN_IDLE) {
+    if (scan.target >= CEC_TOPOLOGY_NUM_DEVICES) {
+      // Ask every device the same question before moving to the next, so
+      // one device's reply overlaps our query to the next.
+      scan.target = 0;
+      if (scan.state == SCAN_POLL) {
+        scan.state = SCAN_QUERY;
+      } else if (++scan.query >= NUM_QUERIES) {
+        scan.state = SCAN_IDLE;
+      }
+      continue;
+    }
+
+    uint8_t target = scan.target++;
+    if (target == laddr) {
+      continue;
+    }
+
+    pld[0] = (laddr << 4) | target;
+    if (scan.state == SCAN_POLL) {
+      *len = 1;
+      found = true;
+    } else if (devices[target].present && !(devices[target].known & queries[scan.query].known)) {
+      pld[1] = queries[scan.query].opcode;
+      *len = 2;
+      found = true;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  return found;
+}
+
+void cec_topology_scan_result(const uint8_t *pld, bool ack, uint32_t now) {
+  uint8_t destination = pld[0] & 0x0f;
+  if (destination >= CEC_TOPOLOGY_NUM_DEVICES) {
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  if (ack) {
+    devices[destination].present = true;
+    devices[destination].last_seen = now;
+  } else {
+    // nobody acknowledged, whatever we knew is stale
+    memset(&devices[destination], 0, sizeof(cec_device_t));
+  }
+  taskEXIT_CRITICAL();
+}
@@ -0,0 +1,194 @@
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cec-transaction.h"
+#include "hdmi-cec.h"
+
+/* Request/response transactions.
+ *
+ * Other tasks queue a request along with the response they expect.  The CEC
+ * task transmits the request when the bus is free and matches the response
+ * from the frames it receives, so several transactions can be outstanding
+ * without holding up the receive loop.
+ */
+
+static cec_transaction_t *transactions[CEC_TRANSACTION_MAX];
+
+/**
+ * Remove a transaction from the table and signal its completion.
+ *
+ * Called from the CEC task with the table unlocked.
+ */
+static void complete(cec_transaction_t *transaction, cec_transaction_status_t status) {
+  taskENTER_CRITICAL();
+  for (unsigned int i = 0; i < CEC_TRANSACTION_MAX; i++) {
+    if (transactions[i] == transaction) {
+      transactions[i] = NULL;
+    }
+  }
+  transaction->status = status;
+  taskEXIT_CRITICAL();
+
+  if (transaction->done != NULL) {
+    transaction->done(transaction);
+  }
+}
+
+bool cec_transaction_submit(cec_transaction_t *transaction) {
+  bool queued = false;
+
+  transaction->status = CEC_TRANSACTION_QUEUED;
+  transaction->response_len = 0;
+  transaction->abort_reason = 0;
+  transaction->duration_us = 0;
+
+  taskENTER_CRITICAL();
+  for (unsigned int i = 0; i < CEC_TRANSACTION_MAX; i++) {
+    if (transactions[i] == NULL) {
+      transactions[i] = transaction;
+      queued = true;
+      break;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  if (!queued) {
+    transaction->status = CEC_TRANSACTION_BUSY;
+    return false;
+  }
+
+  cec_wake();
+  return true;
+}
+
+static void wake_waiter(cec_transaction_t *transaction) {
+  xTaskNotifyGiveIndexed((TaskHandle_t)transaction->arg, CEC_TRANSACTION_NOTIFY);
+}
+
+cec_transaction_status_t cec_transact(cec_transaction_t *transaction) {
+  transaction->done = wake_waiter;
+  transaction->arg = xTaskGetCurrentTaskHandle();
+
+  // only this transaction's completion may end the wait
+  ulTaskNotifyValueClearIndexed(NULL, CEC_TRANSACTION_NOTIFY, UINT32_MAX);
+  if (cec_transaction_submit(transaction)) {
+    ulTaskNotifyTakeIndexed(CEC_TRANSACTION_NOTIFY, pdTRUE, portMAX_DELAY);
+  }
+
+  return transaction->status;
+}
+
+cec_transaction_t *cec_transaction_next(uint8_t laddr, uint8_t *pld, uint8_t *len, uint32_t now) {
+  cec_transaction_t *next = NULL;
+
+  taskENTER_CRITICAL();
+  for (unsigned int i = 0; i < CEC_TRANSACTION_MAX; i++) {
+    cec_transaction_t *transaction = transactions[i];
+    if ((transaction == NULL) || (transaction->status != CEC_TRANSACTION_QUEUED)) {
+      continue;
+    }
+
+    if (transaction->request_len == 0) {
+      // nothing to send, just listen
+      transaction->deadline = now + transaction->timeout_ms;
+      transaction->status = CEC_TRANSACTION_WAITING;
+    } else if (next == NULL) {
+      next = transaction;
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  if (next == NULL) {
+    return NULL;
+  }
+
+  if (next->flags & CEC_TRANSACTION_RAW) {
+    memcpy(pld, next->request, next->request_len);
+    *len = next->request_len;
+  } else {
+    pld[0] = (laddr << 4) | (next->destination & 0x0f);
+    memcpy(&pld[1], next->request, next->request_len);
+    *len = next->request_len + 1;
+  }
+
+  return next;
+}
+
+void cec_transaction_sent(cec_transaction_t *transaction,
+                          bool ack,
+                          uint32_t duration_us,
+                          uint32_t now) {
+  uint8_t destination = (transaction->flags & CEC_TRANSACTION_RAW) ? transaction->request[0]
+                                                                    : transaction->destination;
+
+  transaction->duration_us = duration_us;
+
+  // broadcast frames are acknowledged unless a follower pulls the line low
+  if ((destination & 0x0f) == 0x0f) {
+    ack = !ack;
+  }
+
+  if (!ack) {
+    complete(transaction, CEC_TRANSACTION_NACK);
+    return;
+  }
+
+  if (transaction->flags & CEC_TRANSACTION_ACK_ONLY) {
+    complete(transaction, CEC_TRANSACTION_OK);
+    return;
+  }
+
+  taskENTER_CRITICAL();
+  transaction->deadline = now + transaction->timeout_ms;
+  transaction->status = CEC_TRANSACTION_WAITING;
+  taskEXIT_CRITICAL();
+}
+
+void cec_transaction_receive(const uint8_t *pld, uint8_t len) {
+  if (len < 2) {
+    return;
+  }
+
+  uint8_t initiator = (pld[0] & 0xf0) >> 4;
+  for (unsigned int i = 0; i < CEC_TRANSACTION_MAX; i++) {
+    cec_transaction_t *transaction = transactions[i];
+    if ((transaction == NULL) || (transaction->status != CEC_TRANSACTION_WAITING)
+        || (transaction->initiator != initiator)) {
+      continue;
+    }
+
+    uint8_t opcode = (transaction->flags & CEC_TRANSACTION_RAW) ? transaction->request[1]
+                                                                : transaction->request[0];
+    if (pld[1] == transaction->opcode) {
+      memcpy(transaction->response, pld, len);
+      transaction->response_len = len;
+      complete(transaction, CEC_TRANSACTION_OK);
+    } else if ((transaction->request_len > 0) && (pld[1] == CEC_ID_FEATURE_ABORT) && (len >= 4)
+               && (pld[2] == opcode)) {
+      transaction->abort_reason = pld[3];
+      complete(transaction, CEC_TRANSACTION_ABORTED);
+    }
+  }
+}
+
+uint32_t cec_transaction_expire(uint32_t now) {
+  uint32_t next = UINT32_MAX;
+
+  for (unsigned int i = 0; i < CEC_TRANSACTION_MAX; i++) {
+    cec_transaction_t *transaction = transactions[i];
+    if ((transaction == NULL) || (transaction->status != CEC_TRANSACTION_WAITING)) {
+      continue;
+    }
+
+    int32_t remaining = (int32_t)(transaction->deadline - now);
+    if (remaining <= 0) {
+      complete(transaction, CEC_TRANSACTION_TIMEOUT);
+    } else if ((uint32_t)remaining < next) {
+      next = remaining;
+    }
+  }
+
+  return next;
+}
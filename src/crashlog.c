@@ -0,0 +1,209 @@
+#include <stddef.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "hardware/regs/addressmap.h"
+#include "hardware/sync.h"
+#include "pico/platform.h"
+#include "pico/time.h"
+
+#include "crashlog.h"
+#include "recovery.h"
+
+/* The record lives in .uninitialized_data, which the runtime neither loads nor
+ * zeroes, so a watchdog reboot leaves it as the fault handler wrote it.  Frames
+ * go to a ring in ordinary RAM as they pass, only copied into the record at
+ * the crash, so the record is written just once.
+ */
+
+#define CRASHLOG_MAGIC (0x43525348)
+
+const char *crashlog_reason_name[CRASHLOG_COUNT] = {
+    [CRASHLOG_HARDFAULT] = "hardfault",
+    [CRASHLOG_STACK_OVERFLOW] = "stack overflow",
+};
+
+static crashlog_t __uninitialized_ram(record);
+static bool valid;
+
+static crashlog_frame_t frames[CRASHLOG_FRAMES];
+static uint32_t num_frames;
+static spin_lock_t *lock;
+
+/* Set by the first core to crash, the other only waits for the reset. */
+static volatile bool crashing;
+
+static uint32_t checksum(const crashlog_t *log) {
+  const uint32_t *words = (const uint32_t *)log;
+  uint32_t sum = CRASHLOG_MAGIC;
+
+  for (size_t i = 0; i < offsetof(crashlog_t, checksum) / sizeof(uint32_t); i++) {
+    sum = (sum << 1 | sum >> 31) ^ words[i];
+  }
+
+  return sum;
+}
+
+void crashlog_init(void) {
+  lock = spin_lock_instance(spin_lock_claim_unused(true));
+  valid = (record.magic == CRASHLOG_MAGIC) && (record.checksum == checksum(&record));
+  if (valid) {
+    record.boots++;
+    record.checksum = checksum(&record);
+  } else {
+    record.magic = 0;
+  }
+}
+
+void crashlog_frame(uint8_t bus, const uint8_t *pld, uint8_t len, uint8_t flags) {
+  uint32_t now = to_ms_since_boot(get_absolute_time());
+
+  uint32_t save = spin_lock_blocking(lock);
+  crashlog_frame_t *frame = &frames[num_frames++ % CRASHLOG_FRAMES];
+  frame->time_ms = now;
+  frame->bus = bus;
+  frame->flags = flags;
+  frame->len = (len > sizeof(frame->pld)) ? sizeof(frame->pld) : len;
+  memcpy(frame->pld, pld, frame->len);
+  spin_unlock(lock, save);
+}
+
+const crashlog_t *crashlog_get(void) {
+  return valid ? &record : NULL;
+}
+
+void crashlog_clear(void) {
+  valid = false;
+  record.magic = 0;
+}
+
+/**
+ * Whether a stack pointer lies in RAM, so reading up from it cannot fault
+ * again.
+ */
+static bool in_ram(uint32_t sp) {
+  return (sp >= SRAM_BASE) && (sp < SRAM_END) && !(sp & 3);
+}
+
+/**
+ * Fill in everything but the registers, then reboot.  Runs with interrupts
+ * disabled on the crashing core, the other carries on until the reset.  A
+ * second fault in here locks the core up, which the watchdog then resets.
+ */
+static void __attribute__((noreturn)) save(crashlog_reason_t reason,
+                                           const char *task,
+                                           uint32_t ipsr,
+                                           uint32_t sp) {
+  record.reason = reason;
+  record.time_ms = to_ms_since_boot(get_absolute_time());
+  record.boots = 0;
+  record.core = get_core_num();
+  record.ipsr = ipsr;
+
+  memset(record.task, 0, sizeof(record.task));
+  if (task != NULL) {
+    strncpy(record.task, task, sizeof(record.task) - 1);
+  }
+
+  record.sp = sp;
+  record.stack_words = 0;
+  if (in_ram(sp)) {
+    uint32_t room = (SRAM_END - sp) / sizeof(uint32_t);
+    record.stack_words = (room < CRASHLOG_STACK_WORDS) ? room : CRASHLOG_STACK_WORDS;
+    memcpy(record.stack, (const void *)(uintptr_t)sp, record.stack_words * sizeof(uint32_t));
+  }
+
+  record.num_frames = (num_frames < CRASHLOG_FRAMES) ? num_frames : CRASHLOG_FRAMES;
+  for (uint32_t i = 0; i < record.num_frames; i++) {
+    record.frames[i] = frames[(num_frames - record.num_frames + i) % CRASHLOG_FRAMES];
+  }
+
+  memset(record.num_events, 0, sizeof(record.num_events));
+#if PICO_CEC_SCHED_TRACE
+  sched_trace_pause(true);
+  for (unsigned int core = 0; core < NUM_CORES; core++) {
+    uint32_t recorded = sched_trace_recorded(core);
+    uint32_t seq = (recorded > CRASHLOG_TRACE_EVENTS) ? (recorded - CRASHLOG_TRACE_EVENTS) : 0;
+    for (; sched_trace_get(core, seq, &record.events[core][record.num_events[core]]); seq++) {
+      record.num_events[core]++;
+    }
+  }
+#endif
+
+  record.magic = CRASHLOG_MAGIC;
+  record.checksum = checksum(&record);
+
+  recovery_reboot(RECOVERY_CRASH, reason);
+}
+
+/**
+ * Called from isr_hardfault() with the exception frame, on whichever stack
+ * was in use when the fault was taken.
+ */
+static void __attribute__((used, noreturn)) hardfault(uint32_t *frame) {
+  if (crashing) {
+    while (true) {
+      // the other core is saving its crash
+    }
+  }
+  crashing = true;
+
+  bool stacked = in_ram((uintptr_t)frame);
+  record.r0 = stacked ? frame[0] : 0;
+  record.r1 = stacked ? frame[1] : 0;
+  record.r2 = stacked ? frame[2] : 0;
+  record.r3 = stacked ? frame[3] : 0;
+  record.r12 = stacked ? frame[4] : 0;
+  record.lr = stacked ? frame[5] : 0;
+  record.pc = stacked ? frame[6] : 0;
+  record.xpsr = stacked ? frame[7] : 0;
+
+  // the task switched in on this core, whatever was running on top of it
+  TaskHandle_t task = xTaskGetCurrentTaskHandle();
+
+  // the stack as it was before the exception pushed its frame
+  save(CRASHLOG_HARDFAULT, (task != NULL) ? pcTaskGetName(task) : NULL, record.xpsr & 0x3f,
+       (uintptr_t)frame + 8 * sizeof(uint32_t));
+}
+
+/**
+ * Replaces the SDK's breakpoint.  Bit 2 of EXC_RETURN tells whether the fault
+ * was taken from a task, on the process stack, or from the main stack.
+ */
+void __attribute__((naked)) isr_hardfault(void) {
+  __asm volatile(
+      "movs r0, #4\n"
+      "mov r1, lr\n"
+      "tst r0, r1\n"
+      "beq 1f\n"
+      "mrs r0, psp\n"
+      "b 2f\n"
+      "1:\n"
+      "mrs r0, msp\n"
+      "2:\n"
+      "ldr r1, =hardfault\n"
+      "bx r1\n"
+      ".align 2\n"
+      ".ltorg\n");
+}
+
+void crashlog_stack_overflow(const char *task) {
+  uint32_t sp;
+
+  taskDISABLE_INTERRUPTS();
+  if (crashing) {
+    while (true) {
+      // the other core is saving its crash
+    }
+  }
+  crashing = true;
+
+  // the hook runs in the context switch, the overflowing task's stack is the
+  // process stack
+  __asm volatile("mrs %0, psp" : "=r"(sp));
+  record.r0 = record.r1 = record.r2 = record.r3 = 0;
+  record.r12 = record.lr = record.pc = record.xpsr = 0;
+  save(CRASHLOG_STACK_OVERFLOW, task, __get_current_exception(), sp);
+}
@@ -7,35 +7,44 @@
 #include "hardware/timer.h"
 #include "pico/stdlib.h"
 
+#include "crashlog.h"
 #include "hdmi-cec.h"
+#include "hdmi-ddc.h"
+#include "key-ring.h"
+#include "recovery.h"
+#include "wakeups.h"
 
 #define BLINK_STACK_SIZE (128)
 #define CEC_STACK_SIZE (512)
-#define CEC_QUEUE_LENGTH (16)
 
-void blink_task(void *param) {
-  static uint32_t blink_delay = 1000;
-  static bool state = true;
+#define BLINK_MS (50)
 
+/**
+ * Flash the LED for each CEC frame received, sleeping while the bus is idle.
+ */
+void blink_task(void *param) {
   while (true) {
-    gpio_put(PICO_DEFAULT_LED_PIN, state);
-    state = !state;
-    vTaskDelay(pdMS_TO_TICKS(blink_delay));
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    wakeups[WAKEUP_BLINK]++;
+    gpio_put(PICO_DEFAULT_LED_PIN, true);
+    vTaskDelay(pdMS_TO_TICKS(BLINK_MS));
+    gpio_put(PICO_DEFAULT_LED_PIN, false);
   }
 }
 
 int main() {
-  static StaticQueue_t xStaticCECQueue;
-  static uint8_t storageCECQueue[CEC_QUEUE_LENGTH * sizeof(uint8_t)];
+  static key_ring_t keys[CEC_BUSES];
 
   static StackType_t stackBlink[BLINK_STACK_SIZE];
-  static StackType_t stackCEC[CEC_STACK_SIZE];
+  static StackType_t stackCEC[CEC_BUSES][CEC_STACK_SIZE];
 
   static StaticTask_t xBlinkTCB;
-  static StaticTask_t xCECTCB;
+  static StaticTask_t xCECTCB[CEC_BUSES];
 
   static TaskHandle_t xBlinkTask;
 
+  crashlog_init();
+
   stdio_init_all();
 
   alarm_pool_init_default();
@@ -43,19 +52,25 @@ int main() {
   gpio_init(PICO_DEFAULT_LED_PIN);
   gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
 
-  // HID key queue
-  QueueHandle_t cec_q =
-      xQueueCreateStatic(CEC_QUEUE_LENGTH, sizeof(uint8_t), &storageCECQueue[0], &xStaticCECQueue);
-
   xBlinkTask = xTaskCreateStatic(blink_task, "Blink Task", BLINK_STACK_SIZE, NULL, 1,
                                  &stackBlink[0], &xBlinkTCB);
-  xCECTask = xTaskCreateStatic(cec_task, CEC_TASK_NAME, CEC_STACK_SIZE, &cec_q,
-                               configMAX_PRIORITIES - 1, &stackCEC[0], &xCECTCB);
+  xCECActivityTask = xBlinkTask;
+  for (unsigned int i = 0; i < CEC_BUSES; i++) {
+    cec_bus_t *bus = cec_bus_init(i, &keys[i]);
+    bus->task = xTaskCreateStatic(cec_task, CEC_TASK_NAME, CEC_STACK_SIZE, bus,
+                                  configMAX_PRIORITIES - 1, &stackCEC[i][0], &xCECTCB[i]);
+    vTaskCoreAffinitySet(bus->task, (1 << 0));
+  }
 
   // bind CEC, blink and HID to core 0
-  vTaskCoreAffinitySet(xCECTask, (1 << 0));
   vTaskCoreAffinitySet(xBlinkTask, (1 << 0));
 
+  // EDID in the background, the CEC tasks announce the address when it is read
+  ddc_start(cec_wake);
+
+  recovery_watch(RECOVERY_TASK_CEC, cec_wake);
+  recovery_start();
+
   vTaskStartScheduler();
 
   return 0;
@@ -0,0 +1,96 @@
+#include <string.h>
+
+#include "edid.h"
+
+/* EDID parsing, kept free of hardware dependencies so it also builds on the
+ * host.  All lengths come from the sink and are checked against the block.
+ */
+
+#define EDID_EXTENSION_COUNT (126)
+#define EDID_CTA_DTD_START (0x02)
+#define EDID_CTA_DBC_OFFSET (0x04)
+
+/* CTA data block tag for vendor specific data. */
+#define CTA_DB_TAG_VENDOR (0x03)
+
+static const uint8_t header[8] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
+static const uint8_t ctahdr[2] = {0x02, 0x03};
+static const uint8_t hdmi_oui[3] = {0x03, 0x0c, 0x00};
+
+bool edid_verify(const uint8_t *edid, size_t len) {
+  if ((len == 0) || (len % EDID_BLOCK_SIZE)) {
+    return false;
+  }
+
+  for (size_t block = 0; block < len; block += EDID_BLOCK_SIZE) {
+    uint8_t cksum = 0x00;
+    for (size_t i = 0; i < EDID_BLOCK_SIZE; i++) {
+      cksum += edid[block + i];
+    }
+    if (cksum != 0x00) {
+      return false;
+    }
+  }
+
+  return true;
+}
+
+/**
+ * Parse a data block and return the physical address if found.
+ *
+ * Returns 0x0000 if the block is not an HDMI vendor specific data block.
+ */
+static uint16_t find_physical_address(const uint8_t *db, uint8_t len) {
+  if (((db[0] >> 5) != CTA_DB_TAG_VENDOR) || (len < 5)) {
+    // not a vendor block, or too short for the OUI and physical address
+    return 0x0000;
+  }
+
+  if (memcmp(&db[1], hdmi_oui, 3) == 0) {
+    // HDMI Licensing, LLC block
+    return (db[4] << 8) | db[5];
+  }
+
+  return 0x0000;
+}
+
+uint16_t edid_physical_address(const uint8_t *edid, size_t len) {
+  if ((len < 2 * EDID_BLOCK_SIZE) || memcmp(edid, header, 8)) {
+    // no room for a CTA extension, or not an EDID
+    return 0x0000;
+  }
+
+  if (edid[EDID_EXTENSION_COUNT] == 0x00) {
+    return 0x0000;
+  }
+
+  const uint8_t *cta = &edid[EDID_BLOCK_SIZE];
+  if (memcmp(cta, ctahdr, 2)) {
+    return 0x0000;
+  }
+
+  // data blocks run up to the first detailed timing descriptor, which must
+  // lie within the block before the checksum byte
+  size_t end = cta[EDID_CTA_DTD_START];
+  if (end > EDID_BLOCK_SIZE - 1) {
+    return 0x0000;
+  }
+
+  for (size_t i = EDID_CTA_DBC_OFFSET; i < end;) {
+    const uint8_t *db = &cta[i];
+    uint8_t len = (db[0] & 0x1f);
+    if (i + 1 + len > end) {
+      // payload overruns the data block collection
+      return 0x0000;
+    }
+
+    uint16_t addr = find_physical_address(db, len);
+    if (addr != 0x0000) {
+      return addr;
+    }
+
+    i += len + 1;  // payload + header
+  }
+
+  return 0x0000;
+}
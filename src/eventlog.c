@@ -0,0 +1,633 @@
+#include <stdio.h>
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "semphr.h"
+#include "task.h"
+
+#include "hardware/flash.h"
+#include "hardware/regs/addressmap.h"
+#include "hardware/sync.h"
+#include "pico/time.h"
+
+#include "eventlog.h"
+#include "wakeups.h"
+
+/* Each sector starts with a header giving its place in the ring and the boot,
+ * time and bus the first record counts on from, so it can be read without the
+ * sectors before it, then records up to the first erased byte.  A sector's
+ * sequence number modulo the number of sectors is its place in the region, the
+ * highest is the one being written and the next one along is the next erased.
+ *
+ * Records are a tag, the time since the previous record as 7-bit groups, least
+ * significant first with the top bit set on all but the last, then a payload.
+ * A tag's top five bits are the record type, types up to 16 being frames of
+ * that length, and its bottom three bits a frame's CAPTURE_FLAG_ values.  A
+ * 4-byte frame, such as a key press, takes 6 or 7 bytes.
+ *
+ * The image runs from RAM, so neither core fetches from flash while it is
+ * erased or programmed, and only this file reads the region, under the mutex
+ * the writer holds.  Programming only clears bits, so a part page is written
+ * as it is, and written again as it fills with the earlier bytes unchanged.
+ */
+
+#define EVENTLOG_STACK_SIZE (256)
+
+#define EVENTLOG_OFFSET (PICO_FLASH_SIZE_BYTES - EVENTLOG_SIZE)
+#define EVENTLOG_SECTORS (EVENTLOG_SIZE / FLASH_SECTOR_SIZE)
+
+_Static_assert((EVENTLOG_SIZE % FLASH_SECTOR_SIZE) == 0,
+               "EVENTLOG_SIZE must be a multiple of the flash sector size");
+
+/* Quiet time on the buses before the writer starts. */
+#define EVENTLOG_IDLE_MS (200)
+
+/* Longest time records wait in RAM for a page to fill. */
+#define EVENTLOG_FLUSH_MS (30 * 1000)
+
+/* Size of each half of the RAM double buffer. */
+#define EVENTLOG_BUF_SIZE (1024)
+
+#define EVENTLOG_MAGIC (0x474c4543)
+
+#define TAG(type, flags) ((uint8_t)((type) << 3 | (flags)))
+#define TAG_TYPE(tag) ((tag) >> 3)
+#define TAG_FLAGS(tag) ((tag) & 0x07)
+
+/* Record types after the frames. */
+#define TYPE_FRAME_MAX (16)
+#define TYPE_BOOT (17)   // payload is the boot number as a variable length number, time restarts
+#define TYPE_BUS (18)    // payload is the bus of the frames that follow, 0 after a boot
+#define TYPE_CLEAR (19)  // no payload, readers start after the last one
+#define TYPE_END (31)    // erased flash
+
+/* Tag, a 32-bit time and the longest frame. */
+#define RECORD_MAX (1 + 5 + 16)
+
+typedef struct {
+  uint32_t magic;
+  uint32_t seq;
+  uint32_t boot;
+  uint32_t time_ms;
+  uint8_t bus;
+  uint8_t reserved[3];
+} sector_t;
+
+typedef struct {
+  uint8_t type;
+  uint8_t flags;
+  uint32_t delta_ms;
+  uint32_t value;  // boot number or bus
+  const uint8_t *pld;
+  uint8_t len;
+} record_t;
+
+volatile eventlog_stats_t eventlog_stats;
+
+static bool enabled;
+static uint32_t boot;
+
+/* Records on their way to the flash, filled under the spin lock. */
+static uint8_t buffers[2][EVENTLOG_BUF_SIZE];
+static uint16_t fill_len;  // bytes used in buffers[fill]
+static uint8_t fill;       // half being filled
+static uint32_t last_ms;   // time of the last record buffered
+static uint8_t last_bus;
+static uint32_t pending_ms;  // time the oldest record waiting was buffered
+static spin_lock_t *lock;
+
+/* Writer position and the page at it as in flash, under the mutex. */
+static SemaphoreHandle_t mutex;
+static bool have_sector;
+static eventlog_cursor_t writer;
+static uint8_t page[FLASH_PAGE_SIZE];
+static bool page_dirty;
+
+static TaskHandle_t xLogTask;
+
+static uint32_t now_ms(void) {
+  return to_ms_since_boot(get_absolute_time());
+}
+
+static uint32_t sector_offset(uint32_t seq) {
+  return EVENTLOG_OFFSET + (seq % EVENTLOG_SECTORS) * FLASH_SECTOR_SIZE;
+}
+
+static const uint8_t *flash(uint32_t offset) {
+  return (const uint8_t *)(XIP_BASE + offset);
+}
+
+/**
+ * Header of sector seq, NULL if it was never written or has been overwritten.
+ */
+static const sector_t *sector(uint32_t seq) {
+  const sector_t *header = (const sector_t *)flash(sector_offset(seq));
+
+  return ((header->magic == EVENTLOG_MAGIC) && (header->seq == seq)) ? header : NULL;
+}
+
+static size_t put_varint(uint8_t *p, uint32_t value) {
+  size_t n = 0;
+
+  while (value >= 0x80) {
+    p[n++] = (value & 0x7f) | 0x80;
+    value >>= 7;
+  }
+  p[n++] = value;
+
+  return n;
+}
+
+static size_t get_varint(const uint8_t *p, size_t avail, uint32_t *value) {
+  *value = 0;
+  for (size_t i = 0; (i < avail) && (i < 5); i++) {
+    *value |= (uint32_t)(p[i] & 0x7f) << (7 * i);
+    if (!(p[i] & 0x80)) {
+      return i + 1;
+    }
+  }
+
+  return 0;
+}
+
+static size_t encode(uint8_t *p, uint8_t tag, uint32_t delta_ms, const uint8_t *pld, uint8_t len) {
+  size_t n = 0;
+
+  p[n++] = tag;
+  n += put_varint(&p[n], delta_ms);
+  if (len > 0) {
+    memcpy(&p[n], pld, len);
+  }
+
+  return n + len;
+}
+
+/**
+ * Decode the record at p, returns its size, or 0 at erased flash or anything
+ * that is not a whole record.
+ */
+static size_t decode(const uint8_t *p, size_t avail, record_t *rec) {
+  if (avail == 0) {
+    return 0;
+  }
+
+  rec->type = TAG_TYPE(p[0]);
+  rec->flags = TAG_FLAGS(p[0]);
+  rec->len = 0;
+  rec->value = 0;
+
+  size_t n = get_varint(&p[1], avail - 1, &rec->delta_ms);
+  if (n == 0) {
+    return 0;
+  }
+  n++;
+
+  if (rec->type <= TYPE_FRAME_MAX) {
+    rec->pld = &p[n];
+    rec->len = rec->type;
+  } else if (rec->type == TYPE_BOOT) {
+    size_t m = get_varint(&p[n], avail - n, &rec->value);
+    if (m == 0) {
+      return 0;
+    }
+    n += m;
+  } else if ((rec->type == TYPE_BUS) && (n < avail)) {
+    rec->value = p[n++];
+  } else if (rec->type != TYPE_CLEAR) {
+    return 0;
+  }
+
+  return ((n + rec->len) <= avail) ? (n + rec->len) : 0;
+}
+
+/**
+ * Move a position on past a record.
+ */
+static void apply(eventlog_cursor_t *pos, const record_t *rec) {
+  if (rec->type == TYPE_BOOT) {
+    pos->boot = rec->value;
+    pos->time_ms = rec->delta_ms;
+    pos->bus = 0;
+  } else {
+    pos->time_ms += rec->delta_ms;
+    if (rec->type == TYPE_BUS) {
+      pos->bus = rec->value;
+    }
+  }
+}
+
+/**
+ * Append encoded records to the half being filled, dropping them if there is
+ * no room.  Spin lock held.
+ */
+static bool put(const uint8_t *record, size_t len, uint32_t now) {
+  if (fill_len + len > EVENTLOG_BUF_SIZE) {
+    eventlog_stats.dropped++;
+    return false;
+  }
+
+  if (fill_len == 0) {
+    pending_ms = now;
+  }
+  memcpy(&buffers[fill][fill_len], record, len);
+  fill_len += len;
+  last_ms = now;
+  eventlog_stats.records++;
+
+  return true;
+}
+
+static bool crossed(uint16_t before, uint16_t level) {
+  return (before < level) && (fill_len >= level);
+}
+
+/**
+ * Whether the writer should look again after a record was added to before
+ * bytes, to start the flush timer, because a page is ready or because the
+ * buffer is filling up.  Spin lock held.
+ */
+static bool wake_writer(uint16_t before) {
+  return (before == 0) || crossed(before, FLASH_PAGE_SIZE)
+         || crossed(before, EVENTLOG_BUF_SIZE / 2);
+}
+
+static void log_frame(uint8_t bus, const uint8_t *pld, uint8_t len, uint8_t flags, bool in_isr) {
+  uint8_t record[2 * RECORD_MAX];
+  uint32_t now = now_ms();
+
+  if (!enabled) {
+    return;
+  }
+  if (len > TYPE_FRAME_MAX) {
+    len = TYPE_FRAME_MAX;
+  }
+
+  uint32_t save = spin_lock_blocking(lock);
+  size_t n = 0;
+  if (bus != last_bus) {
+    n += encode(&record[n], TAG(TYPE_BUS, 0), now - last_ms, &bus, 1);
+  }
+  n += encode(&record[n], TAG(len, TAG_FLAGS(flags)), (n > 0) ? 0 : (now - last_ms), pld, len);
+  uint16_t before = fill_len;
+  bool wake = false;
+  if (put(record, n, now)) {
+    last_bus = bus;
+    wake = wake_writer(before);
+  }
+  spin_unlock(lock, save);
+
+  if (wake && (xLogTask != NULL)) {
+    if (in_isr) {
+      vTaskNotifyGiveFromISR(xLogTask, NULL);
+    } else {
+      xTaskNotifyGive(xLogTask);
+    }
+  }
+}
+
+void eventlog_frame(uint8_t bus, const uint8_t *pld, uint8_t len, uint8_t flags) {
+  log_frame(bus, pld, len, flags, false);
+}
+
+void eventlog_frame_from_isr(uint8_t bus, const uint8_t *pld, uint8_t len, uint8_t flags) {
+  log_frame(bus, pld, len, flags, true);
+}
+
+/**
+ * Hand over the half being filled and start filling the other, which the
+ * writer has finished with.
+ */
+static uint8_t *take(uint16_t *len) {
+  uint32_t save = spin_lock_blocking(lock);
+  uint8_t *buffer = buffers[fill];
+  *len = fill_len;
+  fill ^= 1;
+  fill_len = 0;
+  spin_unlock(lock, save);
+
+  return buffer;
+}
+
+/**
+ * Program the page at pos in the writer's sector, with its bytes so far.
+ */
+static void program_page(uint32_t pos) {
+  flash_range_program(sector_offset(writer.seq) + pos, page, FLASH_PAGE_SIZE);
+  eventlog_stats.pages++;
+  page_dirty = false;
+}
+
+/**
+ * Erase the oldest sector and start writing it, its header taking the
+ * writer's position.
+ */
+static void open_sector(void) {
+  sector_t header = {
+      .magic = EVENTLOG_MAGIC,
+      .seq = have_sector ? (writer.seq + 1) : 0,
+      .boot = writer.boot,
+      .time_ms = writer.time_ms,
+      .bus = writer.bus,
+  };
+
+  flash_range_erase(sector_offset(header.seq), FLASH_SECTOR_SIZE);
+  eventlog_stats.erases++;
+
+  memset(page, 0xff, sizeof(page));
+  memcpy(page, &header, sizeof(header));
+  page_dirty = true;
+  have_sector = true;
+  writer.seq = header.seq;
+  writer.offset = sizeof(header);
+}
+
+static void append(const uint8_t *data, size_t len) {
+  for (size_t i = 0; i < len; i++) {
+    page[writer.offset % FLASH_PAGE_SIZE] = data[i];
+    page_dirty = true;
+    if ((++writer.offset % FLASH_PAGE_SIZE) == 0) {
+      program_page(writer.offset - FLASH_PAGE_SIZE);
+      memset(page, 0xff, sizeof(page));
+    }
+  }
+}
+
+/**
+ * Write records taken from the RAM buffer, none straddles two sectors.
+ * Mutex held.
+ */
+static void write_records(const uint8_t *data, uint16_t len) {
+  record_t rec;
+  size_t n;
+
+  for (uint16_t i = 0; i < len; i += n) {
+    n = decode(&data[i], len - i, &rec);
+    if (n == 0) {
+      // buffered records are always whole
+      break;
+    }
+    if (writer.offset + n > FLASH_SECTOR_SIZE) {
+      if (page_dirty) {
+        program_page(writer.offset & ~(FLASH_PAGE_SIZE - 1));
+      }
+      open_sector();
+    }
+    append(&data[i], n);
+    apply(&writer, &rec);
+    eventlog_stats.bytes += n;
+  }
+
+  if (page_dirty) {
+    program_page(writer.offset & ~(FLASH_PAGE_SIZE - 1));
+  }
+}
+
+void eventlog_flush(void) {
+  uint16_t len;
+
+  if (!enabled) {
+    return;
+  }
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  uint8_t *buffer = take(&len);
+  if (len > 0) {
+    write_records(buffer, len);
+  }
+  xSemaphoreGive(mutex);
+}
+
+void eventlog_clear(void) {
+  uint8_t record[RECORD_MAX];
+  uint32_t now = now_ms();
+
+  if (!enabled) {
+    return;
+  }
+
+  // make room for the marker
+  eventlog_flush();
+
+  uint32_t save = spin_lock_blocking(lock);
+  put(record, encode(record, TAG(TYPE_CLEAR, 0), now - last_ms, NULL, 0), now);
+  spin_unlock(lock, save);
+
+  eventlog_flush();
+}
+
+/**
+ * Ticks until the writer should run, 0 for now.  A page waiting, or any
+ * record waiting for EVENTLOG_FLUSH_MS, is written once no frame has been
+ * logged for EVENTLOG_IDLE_MS, or straight away with the buffer half full.
+ */
+static TickType_t write_due(void) {
+  uint32_t save = spin_lock_blocking(lock);
+  uint16_t pending = fill_len;
+  uint32_t since = pending_ms;
+  uint32_t quiet = last_ms + EVENTLOG_IDLE_MS;
+  spin_unlock(lock, save);
+
+  if (pending == 0) {
+    return portMAX_DELAY;
+  } else if (pending >= (EVENTLOG_BUF_SIZE / 2)) {
+    // rather than drop records if the buses never go quiet
+    return 0;
+  }
+
+  uint32_t now = now_ms();
+  uint32_t due = (pending >= FLASH_PAGE_SIZE) ? now : (since + EVENTLOG_FLUSH_MS);
+  if ((int32_t)(quiet - due) > 0) {
+    due = quiet;
+  }
+
+  int32_t wait = due - now;
+  return (wait <= 0) ? 0 : (pdMS_TO_TICKS(wait) + 1);
+}
+
+static void eventlog_task(void *param) {
+  while (true) {
+    TickType_t wait = write_due();
+    if (wait == 0) {
+      eventlog_flush();
+      continue;
+    }
+
+    ulTaskNotifyTake(pdTRUE, wait);
+    wakeups[WAKEUP_LOG]++;
+  }
+}
+
+/**
+ * Find the newest sector and the end of the records in it.
+ */
+static void find_end(void) {
+  for (uint32_t seq = 0; seq < EVENTLOG_SECTORS; seq++) {
+    const sector_t *header = (const sector_t *)flash(sector_offset(seq));
+    if ((header->magic == EVENTLOG_MAGIC) && ((header->seq % EVENTLOG_SECTORS) == seq)
+        && (!have_sector || (header->seq > writer.seq))) {
+      have_sector = true;
+      writer.seq = header->seq;
+    }
+  }
+
+  writer.offset = FLASH_SECTOR_SIZE;
+  if (!have_sector) {
+    return;
+  }
+
+  const sector_t *header = sector(writer.seq);
+  const uint8_t *base = (const uint8_t *)header;
+  record_t rec;
+  size_t n;
+
+  writer.boot = header->boot;
+  writer.time_ms = header->time_ms;
+  writer.bus = header->bus;
+  writer.offset = sizeof(*header);
+  while ((n = decode(&base[writer.offset], FLASH_SECTOR_SIZE - writer.offset, &rec)) > 0) {
+    apply(&writer, &rec);
+    writer.offset += n;
+  }
+
+  // appending needs the rest erased, after a torn write start the next sector
+  if (writer.offset == FLASH_SECTOR_SIZE) {
+    return;
+  }
+  for (uint32_t i = writer.offset; i < FLASH_SECTOR_SIZE; i++) {
+    if (base[i] != 0xff) {
+      writer.offset = FLASH_SECTOR_SIZE;
+      return;
+    }
+  }
+  memcpy(page, &base[writer.offset & ~(FLASH_PAGE_SIZE - 1)], FLASH_PAGE_SIZE);
+}
+
+void eventlog_start(void) {
+  extern char __flash_binary_end;
+  static StackType_t stackLog[EVENTLOG_STACK_SIZE];
+  static StaticTask_t xLogTCB;
+  static StaticSemaphore_t mutex_buffer;
+
+  lock = spin_lock_instance(spin_lock_claim_unused(true));
+  mutex = xSemaphoreCreateMutexStatic(&mutex_buffer);
+
+  if ((uintptr_t)&__flash_binary_end > (XIP_BASE + EVENTLOG_OFFSET)) {
+    printf("Image overlaps the event log at 0x%08lx\n", (unsigned long)EVENTLOG_OFFSET);
+    return;
+  }
+
+  find_end();
+  boot = have_sector ? (writer.boot + 1) : 0;
+  enabled = true;
+
+  uint8_t record[RECORD_MAX];
+  uint8_t value[5];
+  uint32_t now = now_ms();
+  uint32_t save = spin_lock_blocking(lock);
+  put(record, encode(record, TAG(TYPE_BOOT, 0), now, value, put_varint(value, boot)), now);
+  spin_unlock(lock, save);
+
+  xLogTask = xTaskCreateStatic(eventlog_task, "log", EVENTLOG_STACK_SIZE, NULL, 1, &stackLog[0],
+                               &xLogTCB);
+  // flash waits are polled, keep them off the CEC core
+  vTaskCoreAffinitySet(xLogTask, (1 << 1));
+}
+
+/**
+ * Read the record at the cursor and move past it, false at the end of the
+ * log.  Mutex held.
+ */
+static bool step(eventlog_cursor_t *cursor, record_t *rec) {
+  while (have_sector && (cursor->seq <= writer.seq)) {
+    const sector_t *header = sector(cursor->seq);
+    if (header == NULL) {
+      // never written, or overwritten since the cursor was placed
+      cursor->seq++;
+      cursor->offset = 0;
+      continue;
+    }
+
+    if (cursor->offset == 0) {
+      cursor->offset = sizeof(*header);
+      cursor->boot = header->boot;
+      cursor->time_ms = header->time_ms;
+      cursor->bus = header->bus;
+    }
+
+    const uint8_t *base = (const uint8_t *)header;
+    size_t n = decode(&base[cursor->offset], FLASH_SECTOR_SIZE - cursor->offset, rec);
+    if (n > 0) {
+      apply(cursor, rec);
+      cursor->offset += n;
+      return true;
+    }
+    if (cursor->seq == writer.seq) {
+      break;
+    }
+    cursor->seq++;
+    cursor->offset = 0;
+  }
+
+  return false;
+}
+
+void eventlog_first(eventlog_cursor_t *cursor) {
+  record_t rec;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  memset(cursor, 0, sizeof(*cursor));
+  if (have_sector && (writer.seq >= EVENTLOG_SECTORS)) {
+    cursor->seq = writer.seq - EVENTLOG_SECTORS + 1;
+  }
+
+  eventlog_cursor_t scan = *cursor;
+  while (step(&scan, &rec)) {
+    if (rec.type == TYPE_CLEAR) {
+      *cursor = scan;
+    }
+  }
+  xSemaphoreGive(mutex);
+}
+
+bool eventlog_next(eventlog_cursor_t *cursor, eventlog_entry_t *entry) {
+  record_t rec;
+  bool found = false;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  while (!found && step(cursor, &rec)) {
+    if (rec.type <= TYPE_FRAME_MAX) {
+      entry->type = EVENTLOG_ENTRY_FRAME;
+      entry->flags = rec.flags;
+      entry->len = rec.len;
+      memcpy(entry->pld, rec.pld, rec.len);
+      found = true;
+    } else if (rec.type == TYPE_BOOT) {
+      entry->type = EVENTLOG_ENTRY_BOOT;
+      entry->flags = 0;
+      entry->len = 0;
+      found = true;
+    }
+  }
+  if (found) {
+    entry->bus = cursor->bus;
+    entry->boot = cursor->boot;
+    entry->time_ms = cursor->time_ms;
+  }
+  xSemaphoreGive(mutex);
+
+  return found;
+}
+
+void eventlog_get_info(eventlog_info_t *info) {
+  info->offset = EVENTLOG_OFFSET;
+  info->enabled = enabled;
+  info->boot = boot;
+
+  xSemaphoreTake(mutex, portMAX_DELAY);
+  info->sectors = have_sector ? (writer.seq + 1) : 0;
+  xSemaphoreGive(mutex);
+
+  uint32_t save = spin_lock_blocking(lock);
+  info->pending = fill_len;
+  spin_unlock(lock, save);
+}
@@ -27,15 +27,14 @@
 // INCLUDE
 //--------------------------------------------------------------------+
 #include "FreeRTOS.h"
-#include "common/tusb_common.h"
 #include "task.h"
 
+#include "crashlog.h"
+
 void vApplicationStackOverflowHook(xTaskHandle pxTask, char *pcTaskName) {
   (void)pxTask;
-  (void)pcTaskName;
 
-  taskDISABLE_INTERRUPTS();
-  TU_ASSERT(false, );
+  crashlog_stack_overflow(pcTaskName);
 }
 
 /* configSUPPORT_STATIC_ALLOCATION is set to 1, so the application must provide an
@@ -4,12 +4,29 @@
 #include "queue.h"
 #include "task.h"
 
+#include "hardware/sync.h"
 #include "hardware/timer.h"
+#include "pico/platform.h"
 #include "pico/stdlib.h"
 #include "tusb.h"
 
+#include "bench.h"
+#include "boot-time.h"
+#include "capture.h"
+#include "cec-dispatch.h"
+#include "cec-filter.h"
+#include "cec-stats.h"
+#include "cec-timing.h"
+#include "cec-topology.h"
+#include "cec-transaction.h"
+#include "crashlog.h"
+#include "eventlog.h"
 #include "hdmi-cec.h"
 #include "hdmi-ddc.h"
+#include "key-ring.h"
+#include "recovery.h"
+#include "sched-trace.h"
+#include "wakeups.h"
 
 /* Intercept HDMI CEC commands, convert to a keypress and send to HID task
  * handler.
@@ -20,293 +37,597 @@
  * https://github.com/tsowell/avr-hdmi-cec-volume/tree/master
  */
 
+#define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
+
 #define NOTIFY_RX ((UBaseType_t)0)
 #define NOTIFY_TX ((UBaseType_t)1)
 
+/* Notification bits on NOTIFY_RX. */
+#define EVENT_RX (1 << 0)     // frame received or aborted
+#define EVENT_WORK (1 << 1)   // work queued by another task
+#define EVENT_STALL (1 << 2)  // frame in flight without an edge for RX_EDGE_TIMEOUT_MS
+
+/* Signal free time in bit periods before a new frame and before a retry. */
+#define IDLE_BITS_NEW (7)
+#define IDLE_BITS_RETRY (3)
+
+/* Retransmissions of a directed frame that was not acknowledged. */
+#define TX_RETRIES (2)
+
+/* Longest wait for the next edge of a frame, above the 4.7ms start bit period. */
+#define RX_EDGE_TIMEOUT_MS (5)
+
+/* Longest wait for the signal free time before giving up on a transmission. */
+#define TX_BUS_TIMEOUT_MS (500)
+
+/* Bus idle time after our transmission before sending the next pipelined frame. */
+#define PIPELINE_GAP_MS (30)
+
+/* The edge interrupt, the transmit alarms and the state they touch live in
+ * SCRATCH_Y.  Core 0 runs the CEC tasks and takes its interrupts on a stack in
+ * that bank, so timing a bit never waits on the striped banks that core 1
+ * copies USB data through.
+ */
+#define CEC_ISR_FUNC __scratch_y("cec_func")
+#define CEC_ISR_DATA __scratch_y("cec_data")
+
 typedef struct {
-  const char *name;
+  uint8_t code;
   uint8_t key;
+  const char *name;
 } command_t;
 
 /*
- * Key mapping from HDMI user control to HID keyboard entry.
+ * Key mapping from HDMI user control to HID keyboard entry, sorted by code.
+ * Searched on each key press rather than indexed, to keep it small in RAM.
  */
-const command_t keymap[256] = {[0x00] = {"User Control Select", HID_KEY_ENTER},
-                               [0x01] = {"User Control Up", HID_KEY_ARROW_UP},
-                               [0x02] = {"User Control Down", HID_KEY_ARROW_DOWN},
-                               [0x03] = {"User Control Left", HID_KEY_ARROW_LEFT},
-                               [0x04] = {"User Control Right", HID_KEY_ARROW_RIGHT},
-                               [0x0a] = {"User Control Options", HID_KEY_C},
-                               [0x0d] = {"User Control Exit", HID_KEY_BACKSPACE},
-                               [0x20] = {"User Control 0", HID_KEY_0},
-                               [0x21] = {"User Control 1", HID_KEY_1},
-                               [0x22] = {"User Control 2", HID_KEY_2},
-                               [0x23] = {"User Control 3", HID_KEY_3},
-                               [0x24] = {"User Control 4", HID_KEY_4},
-                               [0x25] = {"User Control 5", HID_KEY_5},
-                               [0x26] = {"User Control 6", HID_KEY_6},
-                               [0x27] = {"User Control 7", HID_KEY_7},
-                               [0x28] = {"User Control 8", HID_KEY_8},
-                               [0x29] = {"User Control 9", HID_KEY_9},
-                               [0x35] = {"User Control Display Information", HID_KEY_I},
-                               [0x44] = {"User Control Play", HID_KEY_P},
-                               [0x45] = {"User Control Stop", HID_KEY_X},
-                               [0x46] = {"User Control Pause", HID_KEY_SPACE},
-                               [0x48] = {"User Control Rewind", HID_KEY_R},
-                               [0x49] = {"User Control Fast Forward", HID_KEY_F},
-                               [0x51] = {"User Control Subtitle", HID_KEY_L}};
-
-typedef enum {
-  CEC_ID_IMAGE_VIEW_ON = 0x04,
-  CEC_ID_TEXT_VIEW_ON = 0x0d,
-  CEC_ID_STANDBY = 0x36,
-  CEC_ID_USER_CONTROL_PRESSED = 0x44,
-  CEC_ID_USER_CONTROL_RELEASED = 0x45,
-  CEC_ID_GIVE_OSD_NAME = 0x46,
-  CEC_ID_SET_OSD_NAME = 0x47,
-  CEC_ID_SYSTEM_AUDIO_MODE_REQUEST = 0x70,
-  CEC_ID_GIVE_AUDIO_STATUS = 0x71,
-  CEC_ID_SET_SYSTEM_AUDIO_MODE = 0x72,
-  CEC_ID_GIVE_SYSTEM_AUDIO_MODE_STATUS = 0x7d,
-  CEC_ID_SYSTEM_AUDIO_MODE_STATUS = 0x7e,
-  CEC_ID_REPORT_AUDIO_STATUS = 0x7a,
-  CEC_ID_ROUTING_CHANGE = 0x80,
-  CEC_ID_ACTIVE_SOURCE = 0x82,
-  CEC_ID_GIVE_PHYSICAL_ADDRESS = 0x83,
-  CEC_ID_REPORT_PHYSICAL_ADDRESS = 0x84,
-  CEC_ID_REQUEST_ACTIVE_SOURCE = 0x85,
-  CEC_ID_SET_STREAM_PATH = 0x86,
-  CEC_ID_DEVICE_VENDOR_ID = 0x87,
-  CEC_ID_GIVE_DEVICE_VENDOR_ID = 0x8c,
-  CEC_ID_MENU_STATUS = 0x8e,
-  CEC_ID_GIVE_DEVICE_POWER_STATUS = 0x8f,
-  CEC_ID_REPORT_POWER_STATUS = 0x90,
-  CEC_ID_GET_MENU_LANGUAGE = 0x81,
-  CEC_ID_INACTIVE_SOURCE = 0x9d,
-  CEC_ID_CEC_VERSION = 0x9e,
-  CEC_ID_GET_CEC_VERSION = 0x9f,
-  CEC_ID_VENDOR_COMMAND_WITH_ID = 0xa0,
-  CEC_ID_ABORT = 0xff,
-} cec_id_t;
-
-const char *cec_message[] = {
-    [CEC_ID_IMAGE_VIEW_ON] = "Image View On",
-    [CEC_ID_TEXT_VIEW_ON] = "Text View On",
-    [CEC_ID_STANDBY] = "Standby",
-    [CEC_ID_USER_CONTROL_PRESSED] = "User Control Pressed",
-    [CEC_ID_USER_CONTROL_RELEASED] = "User Control Released",
-    [CEC_ID_SET_OSD_NAME] = "Set OSD Name",
-    [CEC_ID_SYSTEM_AUDIO_MODE_REQUEST] = "System Audio Mode Request",
-    [CEC_ID_GIVE_AUDIO_STATUS] = "Give Audio Status",
-    [CEC_ID_SET_SYSTEM_AUDIO_MODE] = "Set System Audio Mode",
-    [CEC_ID_GIVE_SYSTEM_AUDIO_MODE_STATUS] = "Give System Audio Mode",
-    [CEC_ID_SYSTEM_AUDIO_MODE_STATUS] = "System Audio Mode Status",
-    [CEC_ID_ROUTING_CHANGE] = "Routing Change",
-    [CEC_ID_ACTIVE_SOURCE] = "Active Source",
-    [CEC_ID_GIVE_PHYSICAL_ADDRESS] = "Give Physical Address",
-    [CEC_ID_REPORT_PHYSICAL_ADDRESS] = "Report Physical Address",
-    [CEC_ID_REQUEST_ACTIVE_SOURCE] = "Request Active Source",
-    [CEC_ID_SET_STREAM_PATH] = "Set Stream Path",
-    [CEC_ID_DEVICE_VENDOR_ID] = "Device Vendor ID",
-    [CEC_ID_GIVE_DEVICE_VENDOR_ID] = "Give Device Vendor ID",
-    [CEC_ID_MENU_STATUS] = "Menu Status",
-    [CEC_ID_GIVE_DEVICE_POWER_STATUS] = "Give Device Power Status",
-    [CEC_ID_REPORT_POWER_STATUS] = "Report Power Status",
-    [CEC_ID_GET_MENU_LANGUAGE] = "Get Menu Language",
-    [CEC_ID_CEC_VERSION] = "CEC Version",
-    [CEC_ID_GET_CEC_VERSION] = "Get CEC Version",
-    [CEC_ID_VENDOR_COMMAND_WITH_ID] = "Vendor Command With ID",
-    [CEC_ID_ABORT] = "Abort",
+static const command_t keymap[] = {
+    {0x00, HID_KEY_ENTER, "User Control Select"},
+    {0x01, HID_KEY_ARROW_UP, "User Control Up"},
+    {0x02, HID_KEY_ARROW_DOWN, "User Control Down"},
+    {0x03, HID_KEY_ARROW_LEFT, "User Control Left"},
+    {0x04, HID_KEY_ARROW_RIGHT, "User Control Right"},
+    {0x0a, HID_KEY_C, "User Control Options"},
+    {0x0d, HID_KEY_BACKSPACE, "User Control Exit"},
+    {0x20, HID_KEY_0, "User Control 0"},
+    {0x21, HID_KEY_1, "User Control 1"},
+    {0x22, HID_KEY_2, "User Control 2"},
+    {0x23, HID_KEY_3, "User Control 3"},
+    {0x24, HID_KEY_4, "User Control 4"},
+    {0x25, HID_KEY_5, "User Control 5"},
+    {0x26, HID_KEY_6, "User Control 6"},
+    {0x27, HID_KEY_7, "User Control 7"},
+    {0x28, HID_KEY_8, "User Control 8"},
+    {0x29, HID_KEY_9, "User Control 9"},
+    {0x35, HID_KEY_I, "User Control Display Information"},
+    {0x44, HID_KEY_P, "User Control Play"},
+    {0x45, HID_KEY_X, "User Control Stop"},
+    {0x46, HID_KEY_SPACE, "User Control Pause"},
+    {0x48, HID_KEY_R, "User Control Rewind"},
+    {0x49, HID_KEY_F, "User Control Fast Forward"},
+    {0x51, HID_KEY_L, "User Control Subtitle"},
 };
 
-#define DEFAULT_TYPE 0x04  // HDMI Playback 1
+TaskHandle_t xCECActivityTask;
+
+CEC_ISR_DATA static cec_bus_t cec_buses[CEC_BUSES];
 
-// HDMI Playback logical addresses
-#define NUM_ADDRESS 4
-static const uint8_t address[NUM_ADDRESS] = {0x04, 0x08, 0x0b, 0x0f};
+/* Bus on each pin, for the shared GPIO interrupt. */
+CEC_ISR_DATA static cec_bus_t *bus_by_pin[NUM_BANK0_GPIOS];
 
-/* The HDMI address for this device.  Respond to CEC sent to this address. */
-static uint8_t laddr = address[0];
+/* Buses gone round their loop since the supervisor last heard of progress. */
+static uint32_t progress_mask;
 
-/* Construct the frame address header. */
-#define HEADER0(iaddr, daddr) ((iaddr << 4) | daddr)
+/* Host driving the first bus through the adapter emulation, in place of dispatch. */
+static void (*volatile host_frame)(const uint8_t *pld, uint8_t len, bool ack);
+static volatile uint16_t host_ack_mask;
 
-TaskHandle_t xCECTask;
+/* Receive filter, opcodes passed to the task. */
+static volatile bool filter_enabled = true;
+CEC_ISR_DATA static cec_filter_t filter_opcodes;
 
 /**
  * Calculate next offset as time since boot.
  */
-static uint64_t time_next(uint64_t start, uint64_t next) {
+CEC_ISR_FUNC static uint64_t time_next(uint64_t start, uint64_t next) {
   return (next - (time_us_64() - start));
 }
 
 /**
  * Pull the CEC line high at the specified time.
  */
-static int64_t ack_high(alarm_id_t alarm, void *user_data) {
-  gpio_set_dir(CEC_PIN, GPIO_IN);
+CEC_ISR_FUNC static int64_t ack_high(alarm_id_t alarm, void *user_data) {
+  cec_bus_t *bus = (cec_bus_t *)user_data;
+
+  sched_trace_isr_enter(SCHED_TRACE_ISR_CEC_ACK);
+  gpio_set_dir(bus->pin, GPIO_IN);
+  sched_trace_isr_exit(SCHED_TRACE_ISR_CEC_ACK);
 
   return 0;
 }
 
-uint8_t rx_buffer[16] = {0x0};
-hdmi_message_t rx_message = {.data = &rx_buffer[0], .len = 0};
-hdmi_frame_t rx_frame = {.message = &rx_message};
+/**
+ * Watch a frame in flight from its start bit, waking the task once no edge has
+ * arrived for RX_EDGE_TIMEOUT_MS so it abandons the frame, even while it waits
+ * for an idle bus without a timeout.
+ */
+CEC_ISR_FUNC static int64_t rx_watch(alarm_id_t alarm, void *user_data) {
+  cec_bus_t *bus = (cec_bus_t *)user_data;
+  hdmi_frame_t *frame = &bus->rx_frame;
+  int64_t next = RX_EDGE_TIMEOUT_MS * 1000;
+
+  sched_trace_isr_enter(SCHED_TRACE_ISR_CEC_WATCH);
+  if ((frame->state == HDMI_FRAME_STATE_START_LOW) || (frame->state == HDMI_FRAME_STATE_END)
+      || (frame->state == HDMI_FRAME_STATE_ABORT)) {
+    // received, dropped or aborted
+    next = 0;
+  } else if ((time_us_64() - frame->start) > (RX_EDGE_TIMEOUT_MS * 1000)) {
+    xTaskNotifyIndexedFromISR(bus->task, NOTIFY_RX, EVENT_STALL, eSetBits, NULL);
+    next = 0;
+  }
+  bus->rx_watching = (next != 0);
+  sched_trace_isr_exit(SCHED_TRACE_ISR_CEC_WATCH);
+
+  return next;
+}
+
+/**
+ * Abandon the frame being received and count the error.
+ */
+CEC_ISR_FUNC static void rx_abort(cec_bus_t *bus, volatile uint32_t *counter) {
+  (*counter)++;
+  cec_stats.busy_us += time_us_64() - bus->rx_frame.begin;
+  bus->rx_frame.state = HDMI_FRAME_STATE_ABORT;
+  xTaskNotifyIndexedFromISR(bus->task, NOTIFY_RX, EVENT_RX, eSetBits, NULL);
+}
+
+/**
+ * Abandon a frame whose next edge never came and go back to hunting for a
+ * start bit.  A line still low is stuck, one that is high missed an edge.
+ */
+static void rx_resync(cec_bus_t *bus, hdmi_frame_state_t state) {
+  gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  cec_stats.busy_us += time_us_64() - bus->rx_frame.begin;
+  if (bus->rx_frame.byte > 0) {
+    cec_timing_error(bus->index, bus->rx_buffer[0] >> 4);
+  }
+  if (gpio_get(bus->pin)) {
+    cec_stats.rx_timeouts++;
+    recovery_log(RECOVERY_RX_TIMEOUT, state);
+  } else {
+    cec_stats.line_low++;
+    recovery_log(RECOVERY_LINE_LOW, state);
+  }
+}
+
+/**
+ * Decide, at the end of the header and then the opcode block, whether the task
+ * needs the frame.  The rest of a dropped frame is still received and
+ * acknowledged, only the wakeup at its end is saved.
+ */
+CEC_ISR_FUNC static void rx_filter(cec_bus_t *bus) {
+  hdmi_frame_t *frame = &bus->rx_frame;
+
+  if (capture_get_mode() != CAPTURE_MODE_OFF) {
+    // captures record every frame
+    return;
+  }
+  switch (cec_filter_check(&filter_opcodes, frame->message->data, frame->byte, frame->eom,
+                           frame->ack_mask)) {
+    case CEC_FILTER_DROP_POLL:
+      frame->dropped = &cec_stats.rx_filtered_polls;
+      break;
+    case CEC_FILTER_DROP_OTHER:
+      frame->dropped = &cec_stats.rx_filtered_others;
+      break;
+    case CEC_FILTER_DROP_OPCODE:
+      frame->dropped = &cec_stats.rx_filtered_opcodes;
+      break;
+    default:
+      break;
+  }
+}
+
+/**
+ * Count and log a dropped frame and listen for the next without waking the
+ * task.
+ */
+CEC_ISR_FUNC static void rx_drop(cec_bus_t *bus) {
+  hdmi_frame_t *frame = &bus->rx_frame;
+  const uint8_t *data = frame->message->data;
+  uint8_t initiator = data[0] >> 4;
+  uint8_t flags = frame->ack ? CAPTURE_FLAG_ACK : 0;
+
+  (*frame->dropped)++;
+  cec_stats.rx_frames++;
+  cec_stats.initiator_frames[initiator]++;
+  bus->rx_seen |= 1 << initiator;
+  crashlog_frame(bus->index, data, frame->byte, flags);
+  eventlog_frame_from_isr(bus->index, data, frame->byte, flags);
+
+  frame->dropped = NULL;
+  frame->state = HDMI_FRAME_STATE_START_LOW;
+  frame->byte = 0;
+  frame->ack = false;
+  gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_FALL, true);
+}
+
+static inline bool in_window(uint64_t us, cec_window_t window) {
+  return (us >= window.min) && (us <= window.max);
+}
+
+/**
+ * Whether the receive state waits for a falling edge, otherwise a rising one.
+ */
+static inline bool rx_falling(hdmi_frame_state_t state) {
+  return (state == HDMI_FRAME_STATE_START_LOW) || (state == HDMI_FRAME_STATE_DATA_LOW)
+         || (state == HDMI_FRAME_STATE_EOM_LOW) || (state == HDMI_FRAME_STATE_ACK_LOW)
+         || (state == HDMI_FRAME_STATE_HOLD_LOW);
+}
+
+/**
+ * Keep the receive state from before an edge, to go back to if the pulse the
+ * edge starts turns out to be a glitch.
+ */
+CEC_ISR_FUNC static void rx_save(cec_bus_t *bus, uint64_t now) {
+  hdmi_frame_t *frame = &bus->rx_frame;
+  hdmi_frame_undo_t *undo = &bus->rx_undo;
+
+  undo->state = frame->state;
+  undo->start = frame->start;
+  undo->edge = now;
+  undo->byte = frame->byte;
+  undo->bit = frame->bit;
+  undo->data = (frame->byte < sizeof(bus->rx_buffer)) ? bus->rx_buffer[frame->byte] : 0;
+  undo->first = frame->first;
+  undo->eom = frame->eom;
+  undo->ack = frame->ack;
+  undo->dropped = frame->dropped;
+  undo->sample = bus->rx_sample;
+}
+
+/**
+ * Ignore a pulse too short to be part of a bit, undoing the edge that started
+ * it if it had already been taken.  The last acknowledge bit of a frame ends
+ * it, so a glitch within that bit cannot be undone.
+ */
+CEC_ISR_FUNC static void rx_glitch(cec_bus_t *bus, bool undo) {
+  hdmi_frame_t *frame = &bus->rx_frame;
+
+  cec_stats.rx_glitches++;
+  if (undo) {
+    frame->state = bus->rx_undo.state;
+    frame->start = bus->rx_undo.start;
+    frame->byte = bus->rx_undo.byte;
+    frame->bit = bus->rx_undo.bit;
+    if (frame->byte < sizeof(bus->rx_buffer)) {
+      bus->rx_buffer[frame->byte] = bus->rx_undo.data;
+    }
+    frame->first = bus->rx_undo.first;
+    frame->eom = bus->rx_undo.eom;
+    frame->ack = bus->rx_undo.ack;
+    frame->dropped = bus->rx_undo.dropped;
+    bus->rx_sample = bus->rx_undo.sample;
+  }
+  uint32_t edge = rx_falling(frame->state) ? GPIO_IRQ_EDGE_FALL : GPIO_IRQ_EDGE_RISE;
+  gpio_set_irq_enabled(bus->pin, edge, true);
+}
+
+/**
+ * Hold back the error of an edge too early for a bit, with the glitch filter
+ * on, until the next edge shows whether the pulse it started was a glitch.
+ */
+CEC_ISR_FUNC static void rx_hold(cec_bus_t *bus, volatile uint32_t *counter) {
+  hdmi_frame_t *frame = &bus->rx_frame;
+
+  frame->held = counter;
+  if (rx_falling(frame->state)) {
+    frame->state = HDMI_FRAME_STATE_HOLD_HIGH;
+    gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_RISE, true);
+  } else {
+    frame->state = HDMI_FRAME_STATE_HOLD_LOW;
+    gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_FALL, true);
+  }
+}
 
-static void hdmi_rx_frame_isr(uint gpio, uint32_t events) {
+/**
+ * Advance the receive state machine of a bus on an edge of its line, now at
+ * the given level.
+ */
+CEC_ISR_FUNC static void rx_edge(cec_bus_t *bus, uint64_t now, bool high) {
+  hdmi_frame_t *frame = &bus->rx_frame;
+  cec_timing_sample_t *sample = &bus->rx_sample;
   uint64_t low_time = 0;
-  gpio_acknowledge_irq(gpio, events);
-  gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
-  // printf("state = %d, byte = %d, bit = %d\n", rx_frame.state, rx_frame.byte, rx_frame.bit);
-  switch (rx_frame.state) {
+  // header bits are checked against the common windows until the initiator is known
+  const cec_timing_t *timing =
+      &bus->rx_timing[(frame->byte > 0) ? (bus->rx_buffer[0] >> 4) : CEC_TIMING_UNKNOWN];
+
+  gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  capture_edge(bus->index, now, high);
+  if (high == rx_falling(frame->state)) {
+    // the line is already back where it was
+    rx_glitch(bus, false);
+    return;
+  }
+  if (timing->glitch_us > 0) {
+    // a low or high pulse since the last edge too short to be part of a bit
+    if ((frame->state != HDMI_FRAME_STATE_START_LOW)
+        && (now - bus->rx_undo.edge < timing->glitch_us)) {
+      rx_glitch(bus, true);
+      return;
+    }
+    rx_save(bus, now);
+  }
+  if (high) {
+    low_time = now - frame->start;
+  }
+
+  switch (frame->state) {
+    case HDMI_FRAME_STATE_HOLD_LOW:
+    case HDMI_FRAME_STATE_HOLD_HIGH:
+      // the pulse after the early edge was no glitch either
+      rx_abort(bus, frame->held);
+      return;
     case HDMI_FRAME_STATE_START_LOW:
-      rx_frame.start = time_us_64();
-      rx_frame.state = HDMI_FRAME_STATE_START_HIGH;
-      gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_RISE, true);
+      frame->start = now;
+      frame->begin = now;
+      frame->state = HDMI_FRAME_STATE_START_HIGH;
+      *sample = (cec_timing_sample_t){0};
+      gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_RISE, true);
+      if (!bus->rx_watching) {
+        bus->rx_watching = (add_alarm_in_ms(RX_EDGE_TIMEOUT_MS, rx_watch, bus, true) > 0);
+      }
       return;
     case HDMI_FRAME_STATE_START_HIGH:
-      low_time = time_us_64() - rx_frame.start;
-      if (low_time >= 3500 && low_time <= 3900) {
-        rx_frame.first = true;
-        rx_frame.byte = 0;
-        rx_frame.bit = 0;
-        rx_frame.state = HDMI_FRAME_STATE_DATA_LOW;
-        gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_FALL, true);
+      if (in_window(low_time, timing->start_low)) {
+        sample->start_low = low_time;
+        frame->first = true;
+        frame->byte = 0;
+        frame->bit = 0;
+        frame->state = HDMI_FRAME_STATE_DATA_LOW;
+        gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_FALL, true);
+      } else if ((timing->glitch_us > 0) && (low_time < timing->start_low.min)) {
+        rx_hold(bus, &cec_stats.rx_start_errors);
       } else {
-        rx_frame.state = HDMI_FRAME_STATE_ABORT;
-        xTaskNotifyIndexedFromISR(xCECTask, NOTIFY_RX, 0, eNoAction, NULL);
+        rx_abort(bus, &cec_stats.rx_start_errors);
       }
       return;
     case HDMI_FRAME_STATE_EOM_LOW:
-      rx_frame.byte++;
-      rx_frame.bit = 0;
+      frame->byte++;
+      frame->bit = 0;
     case HDMI_FRAME_STATE_DATA_LOW: {
-      uint64_t min_time = rx_frame.first ? 4300 : 2050;
-      uint64_t max_time = rx_frame.first ? 4700 : 2750;
-      uint64_t bit_time = time_us_64() - rx_frame.start;
-      if (bit_time >= min_time && bit_time <= max_time) {
-        rx_frame.start = time_us_64();
-        if (rx_frame.state == HDMI_FRAME_STATE_EOM_LOW) {
-          rx_frame.state = HDMI_FRAME_STATE_EOM_HIGH;
+      uint64_t bit_time = now - frame->start;
+      cec_window_t period = frame->first ? timing->start_period : timing->period;
+      if (in_window(bit_time, period)) {
+        if (!frame->first) {
+          sample->period_sum += bit_time;
+          sample->periods++;
+        }
+        frame->start = now;
+        if (frame->state == HDMI_FRAME_STATE_EOM_LOW) {
+          frame->state = HDMI_FRAME_STATE_EOM_HIGH;
         } else {
-          rx_frame.state = HDMI_FRAME_STATE_DATA_HIGH;
+          frame->state = HDMI_FRAME_STATE_DATA_HIGH;
         }
-        rx_frame.first = false;
-        gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_RISE, true);
+        frame->first = false;
+        gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_RISE, true);
+      } else if ((timing->glitch_us > 0) && (bit_time < period.min)) {
+        rx_hold(bus, &cec_stats.rx_period_errors);
       } else {
-        rx_frame.state = HDMI_FRAME_STATE_ABORT;
-        xTaskNotifyIndexedFromISR(xCECTask, NOTIFY_RX, 0, eNoAction, NULL);
+        rx_abort(bus, &cec_stats.rx_period_errors);
       }
     }
       return;
     case HDMI_FRAME_STATE_EOM_HIGH:
-    case HDMI_FRAME_STATE_DATA_HIGH:
-      low_time = time_us_64() - rx_frame.start;
+    case HDMI_FRAME_STATE_DATA_HIGH: {
       uint8_t bit = false;
-      if (low_time >= 400 && low_time <= 800) {
+      if (in_window(low_time, timing->one_low)) {
         bit = true;
-      } else if (low_time >= 1300 && low_time <= 1700) {
+        sample->one_sum += low_time;
+        sample->ones++;
+      } else if (in_window(low_time, timing->zero_low)) {
         bit = false;
+        sample->zero_sum += low_time;
+        sample->zeros++;
+      } else if ((timing->glitch_us > 0) && (low_time < timing->zero_low.min)) {
+        rx_hold(bus, &cec_stats.rx_bit_errors);
+        return;
       } else {
-        rx_frame.state = HDMI_FRAME_STATE_ABORT;
-        xTaskNotifyIndexedFromISR(xCECTask, NOTIFY_RX, 0, eNoAction, NULL);
+        rx_abort(bus, &cec_stats.rx_bit_errors);
         return;
       }
-      if (rx_frame.state == HDMI_FRAME_STATE_EOM_HIGH) {
-        rx_frame.eom = bit;
-        rx_frame.state = HDMI_FRAME_STATE_ACK_LOW;
+      if (frame->state == HDMI_FRAME_STATE_EOM_HIGH) {
+        frame->eom = bit;
+        frame->state = HDMI_FRAME_STATE_ACK_LOW;
+        if (frame->filter && (frame->dropped == NULL)) {
+          rx_filter(bus);
+        }
       } else {
-        rx_frame.message->data[rx_frame.byte] <<= 1;
-        rx_frame.message->data[rx_frame.byte] |= bit ? 0x01 : 0x00;
-        rx_frame.bit++;
-        if (rx_frame.bit > 7) {
-          rx_frame.state = HDMI_FRAME_STATE_EOM_LOW;
+        frame->message->data[frame->byte] <<= 1;
+        frame->message->data[frame->byte] |= bit ? 0x01 : 0x00;
+        frame->bit++;
+        if (frame->bit > 7) {
+          frame->state = HDMI_FRAME_STATE_EOM_LOW;
         } else {
-          rx_frame.state = HDMI_FRAME_STATE_DATA_LOW;
+          frame->state = HDMI_FRAME_STATE_DATA_LOW;
         }
       }
-      gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_FALL, true);
+      gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_FALL, true);
+    }
       return;
     case HDMI_FRAME_STATE_ACK_LOW:
-      rx_frame.start = time_us_64();
+      frame->start = now;
       // send ack by changing ack from 1 to 0
-      uint8_t tgt_addr = rx_frame.message->data[0] & 0x0f;
-      if ((tgt_addr != 0x0f) && (tgt_addr == rx_frame.address)) {
-        rx_frame.state = HDMI_FRAME_STATE_ACK_END;
-        gpio_set_dir(CEC_PIN, GPIO_OUT);  // pull low, then schedule pull high
-        add_alarm_at(from_us_since_boot(rx_frame.start + 1500), ack_high, NULL, true);
-        rx_frame.ack = true;
+      uint8_t tgt_addr = frame->message->data[0] & 0x0f;
+      if ((tgt_addr != 0x0f) && (frame->ack_mask & (1 << tgt_addr))) {
+        frame->state = HDMI_FRAME_STATE_ACK_END;
+        gpio_set_dir(bus->pin, GPIO_OUT);  // pull low, then schedule pull high
+        add_alarm_at(from_us_since_boot(frame->start + 1500), ack_high, bus, true);
+        frame->ack = true;
       }
-      rx_frame.state = HDMI_FRAME_STATE_ACK_HIGH;
-      gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_RISE, true);
+      frame->state = HDMI_FRAME_STATE_ACK_HIGH;
+      gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_RISE, true);
       return;
     case HDMI_FRAME_STATE_ACK_HIGH:
-      low_time = time_us_64() - rx_frame.start;
-      if ((low_time >= 400 && low_time <= 800) || (low_time >= 1300 && low_time <= 1700)) {
-        rx_frame.state = HDMI_FRAME_STATE_ACK_END;
+      if (in_window(low_time, timing->one_low) || in_window(low_time, timing->zero_low)) {
+        // a follower holds the line for a logical 0
+        frame->ack = in_window(low_time, timing->zero_low);
+        frame->state = HDMI_FRAME_STATE_ACK_END;
+      } else if ((timing->glitch_us > 0) && (low_time < timing->zero_low.min)) {
+        rx_hold(bus, &cec_stats.rx_ack_errors);
+        return;
       } else {
-        rx_frame.state = HDMI_FRAME_STATE_ABORT;
-        xTaskNotifyIndexedFromISR(xCECTask, NOTIFY_RX, 0, eNoAction, NULL);
+        rx_abort(bus, &cec_stats.rx_ack_errors);
         return;
       }
       // fall through
     case HDMI_FRAME_STATE_ACK_END:
-      if (rx_frame.eom) {
-        rx_frame.state = HDMI_FRAME_STATE_END;
+      if (frame->eom) {
+        frame->state = HDMI_FRAME_STATE_END;
       } else {
-        rx_frame.state = HDMI_FRAME_STATE_DATA_LOW;
-        gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_FALL, true);
+        frame->state = HDMI_FRAME_STATE_DATA_LOW;
+        gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_FALL, true);
         return;
       }
       // finish receiving frame
     case HDMI_FRAME_STATE_END:
     default:
-      rx_frame.message->len = rx_frame.byte;
-      xTaskNotifyIndexedFromISR(xCECTask, NOTIFY_RX, 0, eNoAction, NULL);
+      frame->message->len = frame->byte;
+      cec_stats.busy_us += now - frame->begin;
+      if (frame->dropped != NULL) {
+        rx_drop(bus);
+        return;
+      }
+      xTaskNotifyIndexedFromISR(bus->task, NOTIFY_RX, EVENT_RX, eSetBits, NULL);
   }
 }
 
-static uint8_t recv_frame(uint8_t *pld, uint8_t address) {
-  // printf("recv_frame\n");
-  rx_frame.address = address;
-  rx_frame.state = HDMI_FRAME_STATE_START_LOW;
-  rx_frame.ack = false;
-  memset(&rx_frame.message->data[0], 0, 16);
-  gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_FALL, true);
-  ulTaskNotifyTakeIndexed(NOTIFY_RX, pdTRUE, portMAX_DELAY);
-  memcpy(pld, rx_frame.message->data, rx_frame.message->len);
-  // printf("high water mark = %lu\n", uxTaskGetStackHighWaterMark(xCECTask));
+CEC_ISR_FUNC static void hdmi_rx_frame_isr(uint gpio, uint32_t events) {
+  uint64_t now = time_us_64();
+
+  sched_trace_isr_enter(SCHED_TRACE_ISR_CEC_RX);
+  gpio_acknowledge_irq(gpio, events);
+  cec_bus_t *bus = bus_by_pin[gpio];
+  if (bus != NULL) {
+    rx_edge(bus, now, gpio_get(gpio));
+  }
+  sched_trace_isr_exit(SCHED_TRACE_ISR_CEC_RX);
+}
+
+/**
+ * Receive a frame, giving up after timeout or on queued work if no frame has
+ * started yet.  With filter set, frames the task has no use for are dropped
+ * by the edge interrupt.
+ *
+ * Returns the frame length, or 0 on abort, timeout or work.  A frame that
+ * stops short is abandoned once no edge has arrived for RX_EDGE_TIMEOUT_MS.
+ */
+static uint8_t recv_frame(cec_bus_t *bus,
+                          uint8_t *pld,
+                          uint16_t ack_mask,
+                          bool filter,
+                          TickType_t timeout) {
+  hdmi_frame_t *frame = &bus->rx_frame;
+  uint32_t events = 0;
+
+  frame->ack_mask = ack_mask;
+  frame->filter = filter;
+  frame->dropped = NULL;
+  frame->state = HDMI_FRAME_STATE_START_LOW;
+  frame->byte = 0;
+  frame->ack = false;
+  memset(&frame->message->data[0], 0, 16);
+  // discard any stale completion or stall from a previously abandoned frame
+  ulTaskNotifyValueClearIndexed(NULL, NOTIFY_RX, EVENT_RX | EVENT_STALL);
+  gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_FALL, true);
+  while (!(events & EVENT_RX)) {
+    BaseType_t notified = xTaskNotifyWaitIndexed(NOTIFY_RX, 0, EVENT_RX | EVENT_WORK | EVENT_STALL,
+                                                 &events, timeout);
+    wakeups[WAKEUP_CEC]++;
+    if ((notified == pdFALSE) || (events & (EVENT_WORK | EVENT_STALL))) {
+      // snapshot the ISR state, the start time is not written atomically, and
+      // stop listening while no frame has started so none starts unseen
+      uint32_t irq = save_and_disable_interrupts();
+      hdmi_frame_state_t state = frame->state;
+      uint64_t last_edge = frame->start;
+      if (state == HDMI_FRAME_STATE_START_LOW) {
+        gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+      }
+      restore_interrupts(irq);
+
+      if (state == HDMI_FRAME_STATE_START_LOW) {
+        return 0;
+      }
+      if ((time_us_64() - last_edge) > (RX_EDGE_TIMEOUT_MS * 1000)) {
+        rx_resync(bus, state);
+        return 0;
+      }
+      // a frame is in flight, see it through
+      timeout = pdMS_TO_TICKS(RX_EDGE_TIMEOUT_MS);
+    }
+  }
+  memcpy(pld, frame->message->data, frame->message->len);
 
-  if (rx_frame.state == HDMI_FRAME_STATE_ABORT) {
+  if (frame->state == HDMI_FRAME_STATE_ABORT) {
     // printf("ABORT\n");
+    if (frame->byte > 0) {
+      cec_timing_error(bus->index, frame->message->data[0] >> 4);
+    }
+    capture_frame(bus->index, frame->begin, frame->message->data, frame->byte, CAPTURE_FLAG_ERROR);
+    crashlog_frame(bus->index, frame->message->data, frame->byte, CAPTURE_FLAG_ERROR);
+    eventlog_frame(bus->index, frame->message->data, frame->byte, CAPTURE_FLAG_ERROR);
     return 0;
   }
 
-  return rx_frame.message->len;
+  cec_stats.rx_frames++;
+  cec_stats.initiator_frames[(pld[0] & 0xf0) >> 4]++;
+  cec_timing_learn(bus->index, pld[0] >> 4, &bus->rx_sample);
+  capture_frame(bus->index, frame->begin, pld, frame->message->len,
+                frame->ack ? CAPTURE_FLAG_ACK : 0);
+  crashlog_frame(bus->index, pld, frame->message->len, frame->ack ? CAPTURE_FLAG_ACK : 0);
+  eventlog_frame(bus->index, pld, frame->message->len, frame->ack ? CAPTURE_FLAG_ACK : 0);
+
+  return frame->message->len;
 }
 
-static int64_t hdmi_tx_callback(alarm_id_t alarm, void *user_data) {
-  hdmi_frame_t *frame = (hdmi_frame_t *)user_data;
+/**
+ * Drive the next transmit bit phase, returning the delay to the one after.
+ */
+CEC_ISR_FUNC static int64_t tx_step(cec_bus_t *bus) {
+  hdmi_frame_t *frame = bus->tx_frame;
 
   uint64_t low_time = 0;
   switch (frame->state) {
     case HDMI_FRAME_STATE_START_LOW:
-      gpio_set_dir(CEC_PIN, GPIO_OUT);
+      gpio_set_dir(bus->pin, GPIO_OUT);
       frame->start = time_us_64();
       frame->state = HDMI_FRAME_STATE_START_HIGH;
       return time_next(frame->start, 3700);
     case HDMI_FRAME_STATE_START_HIGH:
-      gpio_set_dir(CEC_PIN, GPIO_IN);
+      gpio_set_dir(bus->pin, GPIO_IN);
       frame->state = HDMI_FRAME_STATE_DATA_LOW;
       return time_next(frame->start, 4500);
     case HDMI_FRAME_STATE_DATA_LOW:
-      gpio_set_dir(CEC_PIN, GPIO_OUT);
+      gpio_set_dir(bus->pin, GPIO_OUT);
       frame->start = time_us_64();
       low_time = (frame->message->data[frame->byte] & (1 << frame->bit)) ? 600 : 1500;
       frame->state = HDMI_FRAME_STATE_DATA_HIGH;
       return time_next(frame->start, low_time);
     case HDMI_FRAME_STATE_DATA_HIGH:
-      gpio_set_dir(CEC_PIN, GPIO_IN);
+      gpio_set_dir(bus->pin, GPIO_IN);
+      if (frame->message->data[frame->byte] & (1 << frame->bit)) {
+        // a logical 1 must read back high once released, at the latest 0
+        // sample point, otherwise another initiator is driving the bus
+        frame->state = HDMI_FRAME_STATE_DATA_SAMPLE;
+        return time_next(frame->start, 1050);
+      }
+      // fall through
+    case HDMI_FRAME_STATE_DATA_SAMPLE:
+      if ((frame->state == HDMI_FRAME_STATE_DATA_SAMPLE) && (gpio_get(bus->pin) == false)) {
+        frame->collision = true;
+        xTaskNotifyIndexedFromISR(bus->task, NOTIFY_TX, 0, eNoAction, NULL);
+        return 0;
+      }
       if (frame->bit--) {
         frame->state = HDMI_FRAME_STATE_DATA_LOW;
       } else {
@@ -315,22 +636,22 @@ static int64_t hdmi_tx_callback(alarm_id_t alarm, void *user_data) {
       }
       return time_next(frame->start, 2400);
     case HDMI_FRAME_STATE_EOM_LOW:
-      gpio_set_dir(CEC_PIN, GPIO_OUT);
+      gpio_set_dir(bus->pin, GPIO_OUT);
       low_time = (frame->byte < frame->message->len) ? 1500 : 600;
       frame->start = time_us_64();
       frame->state = HDMI_FRAME_STATE_EOM_HIGH;
       return time_next(frame->start, low_time);
     case HDMI_FRAME_STATE_EOM_HIGH:
-      gpio_set_dir(CEC_PIN, GPIO_IN);
+      gpio_set_dir(bus->pin, GPIO_IN);
       frame->state = HDMI_FRAME_STATE_ACK_LOW;
       return time_next(frame->start, 2400);
     case HDMI_FRAME_STATE_ACK_LOW:
-      gpio_set_dir(CEC_PIN, GPIO_OUT);
+      gpio_set_dir(bus->pin, GPIO_OUT);
       frame->start = time_us_64();
       frame->state = HDMI_FRAME_STATE_ACK_HIGH;
       return time_next(frame->start, 600);
     case HDMI_FRAME_STATE_ACK_HIGH:
-      gpio_set_dir(CEC_PIN, GPIO_IN);
+      gpio_set_dir(bus->pin, GPIO_IN);
       if (frame->byte < frame->message->len) {
         frame->bit = 7;
         frame->state = HDMI_FRAME_STATE_DATA_LOW;
@@ -342,25 +663,39 @@ static int64_t hdmi_tx_callback(alarm_id_t alarm, void *user_data) {
       }
     case HDMI_FRAME_STATE_ACK_WAIT:
       // handle follower sending ack
-      if (gpio_get(CEC_PIN) == false) {
+      if (gpio_get(bus->pin) == false) {
         frame->ack = true;
       }
       frame->state = HDMI_FRAME_STATE_END;
       return time_next(frame->start, 2400);
     case HDMI_FRAME_STATE_END:
     default:
-      xTaskNotifyIndexedFromISR(xCECTask, NOTIFY_TX, 0, eNoAction, NULL);
+      xTaskNotifyIndexedFromISR(bus->task, NOTIFY_TX, 0, eNoAction, NULL);
       return 0;
   }
 }
 
-static bool hdmi_tx_frame(uint8_t *data, uint8_t len) {
-  unsigned char i = 0;
+CEC_ISR_FUNC static int64_t hdmi_tx_callback(alarm_id_t alarm, void *user_data) {
+  sched_trace_isr_enter(SCHED_TRACE_ISR_CEC_TX);
+  int64_t next = tx_step((cec_bus_t *)user_data);
+  sched_trace_isr_exit(SCHED_TRACE_ISR_CEC_TX);
+
+  return next;
+}
+
+/**
+ * Wait for the signal free time, giving up if the bus never goes quiet.
+ */
+static bool wait_bus_free(cec_bus_t *bus, unsigned int idle_bits) {
+  uint64_t deadline = time_us_64() + (TX_BUS_TIMEOUT_MS * 1000);
+  unsigned int i = 0;
 
-  // wait 7 bit times of idle before sending
-  while (i < 7) {
+  while (i < idle_bits) {
+    if (time_us_64() > deadline) {
+      return false;
+    }
     vTaskDelay(pdMS_TO_TICKS(2.4));
-    if (gpio_get(CEC_PIN)) {
+    if (gpio_get(bus->pin)) {
       i++;
     } else {
       // reset
@@ -368,306 +703,485 @@ static bool hdmi_tx_frame(uint8_t *data, uint8_t len) {
     }
   }
 
+  return true;
+}
+
+static bool hdmi_tx_frame(cec_bus_t *bus, uint8_t *data, uint8_t len, bool *collision) {
   hdmi_message_t message = {data, len};
   hdmi_frame_t frame = {.message = &message,
                         .bit = 7,
                         .byte = 0,
                         .start = 0,
                         .ack = false,
+                        .collision = false,
                         .state = HDMI_FRAME_STATE_START_LOW};
-  add_alarm_at(from_us_since_boot(time_us_64()), hdmi_tx_callback, &frame, true);
+  uint64_t start = time_us_64();
+  bus->tx_frame = &frame;
+  add_alarm_at(from_us_since_boot(start), hdmi_tx_callback, bus, true);
   ulTaskNotifyTakeIndexed(NOTIFY_TX, pdTRUE, portMAX_DELAY);
-  // printf("high water mark = %lu\n", uxTaskGetStackHighWaterMark(xCECTask));
+  bus->tx_duration_us = time_us_64() - start;
+  *collision = frame.collision;
   return frame.ack;
 }
 
-static bool send_frame(uint8_t pldcnt, uint8_t *pld) {
+/**
+ * Send a frame, retrying directed messages that are not acknowledged and any
+ * frame that loses arbitration.
+ */
+static bool send_frame(cec_bus_t *bus, uint8_t pldcnt, uint8_t *pld) {
+  bool broadcast = ((pld[0] & 0x0f) == 0x0f);
+  unsigned int idle_bits = IDLE_BITS_NEW;
+  bool ack = false;
+
   // disable GPIO ISR for sending
-  gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
-  return hdmi_tx_frame(pld, pldcnt);
+  gpio_set_irq_enabled(bus->pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  for (unsigned int attempt = 0; attempt <= TX_RETRIES; attempt++) {
+    bool collision = false;
+
+    if (!wait_bus_free(bus, idle_bits)) {
+      // a line held low looks the same as endless traffic from here
+      cec_stats.tx_bus_busy++;
+      recovery_log(gpio_get(bus->pin) ? RECOVERY_TX_BUS_BUSY : RECOVERY_LINE_LOW, attempt);
+      break;
+    }
+    if (attempt > 0) {
+      cec_stats.tx_retries++;
+    }
+    ack = hdmi_tx_frame(bus, pld, pldcnt, &collision);
+    cec_stats.tx_frames++;
+    cec_stats.busy_us += bus->tx_duration_us;
+    uint8_t flags = CAPTURE_FLAG_TX | (ack ? CAPTURE_FLAG_ACK : 0)
+                    | (collision ? CAPTURE_FLAG_ERROR : 0);
+    capture_frame(bus->index, time_us_64() - bus->tx_duration_us, pld, pldcnt, flags);
+    crashlog_frame(bus->index, pld, pldcnt, flags);
+    eventlog_frame(bus->index, pld, pldcnt, flags);
+
+    if (collision) {
+      cec_stats.tx_collisions++;
+    } else if (broadcast || ack) {
+      break;
+    } else {
+      cec_stats.tx_nacks++;
+      // polling messages are expected to go unanswered
+      if (pldcnt < 2) {
+        break;
+      }
+    }
+    idle_bits = IDLE_BITS_RETRY;
+  }
+
+  return ack;
 }
 
-static void device_vendor_id(uint8_t initiator, uint8_t destination, uint32_t vendor_id) {
-  uint8_t pld[5] = {(initiator << 4) | destination, 0x87, (vendor_id >> 16) & 0x0ff,
-                    (vendor_id >> 8) & 0x0ff, (vendor_id >> 0) & 0x0ff};
+/**
+ * Pass a key to the HID task without blocking, counting it if the ring is full.
+ */
+static void queue_key(key_ring_t *keys, uint8_t key) {
+  if (!key_ring_put(keys, key)) {
+    cec_stats.hid_drops++;
+  }
+}
 
-  send_frame(5, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_DEVICE_VENDOR_ID]);
+static uint32_t now_ms(void) {
+  return to_ms_since_boot(get_absolute_time());
 }
 
-static void report_power_status(uint8_t initiator, uint8_t destination, uint8_t power_status) {
-  uint8_t pld[3] = {(initiator << 4) | destination, 0x90, power_status};
+/**
+ * Send the next frame of an active topology scan, if any.
+ */
+static bool service_scan(cec_bus_t *bus) {
+  uint8_t pld[2];
+  uint8_t len;
+
+  if (!cec_topology_scan_next(bus->dispatch.laddr, pld, &len)) {
+    return false;
+  }
 
-  send_frame(3, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_REPORT_POWER_STATUS]);
+  bool ack = send_frame(bus, len, pld);
+  cec_topology_scan_result(pld, ack, now_ms());
+  if (len > 1) {
+    printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(pld[1]));
+  }
+
+  return true;
 }
 
-static void set_system_audio_mode(uint8_t initiator,
-                                  uint8_t destination,
-                                  uint8_t system_audio_mode) {
-  uint8_t pld[3];
+/**
+ * Send the next queued transaction request, if any.
+ */
+static bool service_transaction(cec_bus_t *bus) {
+  uint8_t pld[16];
+  uint8_t len;
 
-  pld[0] = (initiator << 4) | destination;
-  pld[1] = CEC_ID_SET_SYSTEM_AUDIO_MODE;
-  pld[2] = system_audio_mode;
+  cec_transaction_t *transaction =
+      cec_transaction_next(bus->dispatch.laddr, pld, &len, now_ms());
+  if (transaction == NULL) {
+    return false;
+  }
+
+  bool ack = send_frame(bus, len, pld);
+  cec_transaction_sent(transaction, ack, bus->tx_duration_us, now_ms());
+  if (len > 1) {
+    printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message(pld[1]));
+  }
 
-  send_frame(3, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_SET_SYSTEM_AUDIO_MODE]);
+  return true;
 }
 
-static void report_audio_status(uint8_t initiator, uint8_t destination, uint8_t audio_status) {
-  uint8_t pld[3];
+/**
+ * Service queued work, returning how long to wait for the next frame.
+ */
+static TickType_t service(cec_bus_t *bus) {
+  // transactions and scans all go out on the first bus
+  if (bus->index != 0) {
+    return portMAX_DELAY;
+  }
+
+  // the EDID is read in the background, report the address once it arrives
+  cec_dispatch_set_physical_address(&bus->dispatch, ddc_get_physical_address());
 
-  pld[0] = (initiator << 4) | destination;
-  pld[1] = CEC_ID_REPORT_AUDIO_STATUS;
-  pld[2] = audio_status;
+  // Pipelined work goes out whenever the bus has been quiet for a while,
+  // without waiting for replies to earlier frames.
+  if (service_transaction(bus) || service_scan(bus)) {
+    return pdMS_TO_TICKS(PIPELINE_GAP_MS);
+  }
 
-  send_frame(3, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_REPORT_AUDIO_STATUS]);
+  uint32_t next = cec_transaction_expire(now_ms());
+  return (next == UINT32_MAX) ? portMAX_DELAY : pdMS_TO_TICKS(next);
 }
 
-static void system_audio_mode_status(uint8_t initiator,
-                                     uint8_t destination,
-                                     uint8_t system_audio_mode_status) {
-  uint8_t pld[3];
+/**
+ * Collect the initiators of frames dropped since the last call.
+ */
+static uint16_t take_seen(cec_bus_t *bus) {
+  uint32_t irq = save_and_disable_interrupts();
+  uint16_t seen = bus->rx_seen;
+  bus->rx_seen = 0;
+  restore_interrupts(irq);
+
+  return seen;
+}
+
+/**
+ * Report progress to the supervisor once every bus has gone round its loop,
+ * so one stuck bus is not hidden by the others.
+ */
+static void progress(cec_bus_t *bus) {
+  bool all;
+
+  taskENTER_CRITICAL();
+  progress_mask |= 1 << bus->index;
+  all = (progress_mask == ((1 << CEC_BUSES) - 1));
+  if (all) {
+    progress_mask = 0;
+  }
+  taskEXIT_CRITICAL();
 
-  pld[0] = (initiator << 4) | destination;
-  pld[1] = CEC_ID_SYSTEM_AUDIO_MODE_STATUS;
-  pld[2] = system_audio_mode_status;
+  if (all) {
+    recovery_progress(RECOVERY_TASK_CEC);
+  }
+}
 
-  send_frame(3, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_SYSTEM_AUDIO_MODE_STATUS]);
+void cec_set_host(void (*frame)(const uint8_t *pld, uint8_t len, bool ack), uint16_t ack_mask) {
+  host_ack_mask = ack_mask;
+  host_frame = frame;
+  cec_wake();
 }
 
-static void set_osd_name(uint8_t initiator, uint8_t destination) {
-  uint8_t pld[10] = {
-      (initiator << 4) | destination, CEC_ID_SET_OSD_NAME, 'P', 'i', 'c', 'o', '-', 'C', 'E', 'C'};
+void cec_get_status(uint8_t *laddr, uint16_t *paddr, uint8_t *power_status) {
+  const cec_dispatch_t *dispatch = &cec_buses[0].dispatch;
 
-  send_frame(10, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_SET_OSD_NAME]);
+  // the address is not allocated until the task has joined the bus
+  *laddr = (dispatch->ops != NULL) ? dispatch->laddr : 0x0f;
+  *paddr = dispatch->paddr;
+  *power_status = dispatch->power_status;
 }
 
-static void report_physical_address(uint8_t initiator,
-                                    uint8_t destination,
-                                    uint16_t physical_address,
-                                    uint8_t device_type) {
-  uint8_t pld[5] = {(initiator << 4) | destination, CEC_ID_REPORT_PHYSICAL_ADDRESS,
-                    (physical_address >> 8) & 0x0ff, (physical_address >> 0) & 0x0ff, device_type};
+void cec_filter_enable(bool enabled) {
+  filter_enabled = enabled;
+  cec_wake();
+}
 
-  send_frame(5, pld);
-  printf("\n<-- %02x:%02x [%s] %02x%02x", pld[0], pld[1],
-         cec_message[CEC_ID_REPORT_PHYSICAL_ADDRESS], pld[2], pld[3]);
+bool cec_filter_enabled(void) {
+  return filter_enabled;
 }
 
-static void report_cec_version(uint8_t initiator, uint8_t destination) {
-  // 0x04 = 1.3a
-  uint8_t pld[3] = {HEADER0(initiator, destination), CEC_ID_CEC_VERSION, 0x04};
-  send_frame(3, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_CEC_VERSION]);
+void cec_filter_subscribe(uint8_t opcode, bool directed, bool subscribed) {
+  uint32_t irq = save_and_disable_interrupts();
+  cec_filter_set(&filter_opcodes, opcode, directed, subscribed);
+  restore_interrupts(irq);
 }
 
-static bool ping(uint8_t destination) {
-  uint8_t pld[1] = {HEADER0(destination, destination)};
+bool cec_filter_subscribed(uint8_t opcode, bool directed) {
+  return cec_filter_get(&filter_opcodes, opcode, directed);
+}
 
-  return send_frame(1, pld);
+void cec_wake(void) {
+  for (unsigned int i = 0; i < CEC_BUSES; i++) {
+    if (cec_buses[i].task != NULL) {
+      xTaskNotifyIndexed(cec_buses[i].task, NOTIFY_RX, EVENT_WORK, eSetBits);
+    }
+  }
 }
 
-static void image_view_on(uint8_t initiator, uint8_t destination) {
-  uint8_t pld[2] = {HEADER0(initiator, destination), CEC_ID_IMAGE_VIEW_ON};
+static const command_t *find_command(uint8_t code) {
+  unsigned int lo = 0;
+  unsigned int hi = ARRAY_SIZE(keymap);
 
-  send_frame(2, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_IMAGE_VIEW_ON]);
+  while (lo < hi) {
+    unsigned int mid = (lo + hi) / 2;
+    if (keymap[mid].code == code) {
+      return &keymap[mid];
+    } else if (keymap[mid].code < code) {
+      lo = mid + 1;
+    } else {
+      hi = mid;
+    }
+  }
+
+  return NULL;
 }
 
-static void active_source(uint8_t initiator, uint16_t physical_address) {
-  uint8_t pld[4] = {HEADER0(initiator, 0x0f), CEC_ID_ACTIVE_SOURCE, (physical_address >> 8) & 0x0ff,
-                    (physical_address >> 0) & 0x0ff};
+/**
+ * Pass user control codes from the protocol logic to the HID task.
+ */
+static void user_control(void *arg, uint8_t code, bool pressed) {
+  cec_bus_t *bus = (cec_bus_t *)arg;
+
+  if (!pressed) {
+    queue_key(bus->keys, HID_KEY_NONE);
+    return;
+  }
 
-  send_frame(4, pld);
-  printf("\n<-- %02x:%02x [%s]", pld[0], pld[1], cec_message[CEC_ID_ACTIVE_SOURCE]);
+  const command_t *command = find_command(code);
+  if (command != NULL) {
+    printf(command->name);
+    queue_key(bus->keys, command->key);
+  } else {
+    printf("Unmapped command: 0x%02x\n", code);
+  }
 }
 
-static uint8_t allocate_logical_address(void) {
-  uint8_t a;
-  for (unsigned int i = 0; i < NUM_ADDRESS; i++) {
-    a = address[i];
-    printf("\nAttempting to allocate logical address 0x%02x\n", a);
-    if (!ping(a)) {
-      break;
+static bool send(void *arg, uint8_t *pld, uint8_t len) {
+  return send_frame((cec_bus_t *)arg, len, pld);
+}
+
+static uint16_t physical_address(void *arg) {
+  cec_bus_t *bus = (cec_bus_t *)arg;
+
+  // only the first bus has its sink's DDC wired up
+  if (bus->index != 0) {
+#ifdef CEC_EXTRA_PADDRS
+    static const uint16_t paddrs[] = {CEC_EXTRA_PADDRS};
+
+    if (bus->index <= (sizeof(paddrs) / sizeof(paddrs[0]))) {
+      return paddrs[bus->index - 1];
     }
+#endif
+    return CEC_PHYS_ADDR;
   }
 
-  printf("Allocated logical address 0x%02x\n", a);
-  return a;
+  // asked when the topology may have changed, look again but do not wait
+  ddc_refresh();
+  return ddc_get_physical_address();
 }
 
-void cec_task(void *data) {
-  QueueHandle_t *q = (QueueHandle_t *)data;
+static const cec_dispatch_ops_t dispatch_ops = {
+    .send = send,
+    .user_control = user_control,
+    .physical_address = physical_address,
+};
+
+/* Private bus for the bench command.  Its pin is one no peripheral drives
+ * through SIO, so edge interrupts and direction changes on it have no effect
+ * outside.  The transmitted frame is all zero bits so it never samples the
+ * line for arbitration.
+ */
+static cec_bus_t bench_bus;
+static cec_timing_t bench_timing[CEC_TIMING_UNKNOWN + 1];
+static uint8_t bench_tx_data[2];
+static hdmi_message_t bench_tx_message = {bench_tx_data, sizeof(bench_tx_data)};
+static hdmi_frame_t bench_tx_frame;
+static bool bench_tx_restart;
+static volatile uint8_t bench_key;
+
+bool cec_bench_start(void) {
+  unsigned int pin = 0;
+  while ((pin < NUM_BANK0_GPIOS)
+         && ((bus_by_pin[pin] != NULL) || (gpio_get_function(pin) == GPIO_FUNC_SIO))) {
+    pin++;
+  }
+  if (pin == NUM_BANK0_GPIOS) {
+    return false;
+  }
 
-  // pause 5000ms
-  vTaskDelay(pdMS_TO_TICKS(5000));
+  // received with a copy of the first bus's windows, learning nothing
+  memcpy(bench_timing, cec_timing[0], sizeof(bench_timing));
+  bench_bus = (cec_bus_t){.index = CEC_BUSES, .pin = pin, .rx_timing = bench_timing};
+  // frame completions wake the caller, which sees them as spurious wakeups
+  bench_bus.task = xTaskGetCurrentTaskHandle();
+  bench_bus.rx_message.data = bench_bus.rx_buffer;
+  bench_bus.rx_frame.message = &bench_bus.rx_message;
+  bench_bus.rx_frame.state = HDMI_FRAME_STATE_START_LOW;
+  bench_bus.tx_frame = &bench_tx_frame;
+  bench_tx_restart = true;
+
+  return true;
+}
 
-  gpio_init(CEC_PIN);
-  gpio_disable_pulls(CEC_PIN);
-  gpio_set_dir(CEC_PIN, GPIO_IN);
+uint32_t cec_bench_rx_edge(uint64_t now, bool high) {
+  hdmi_frame_t *frame = &bench_bus.rx_frame;
 
-  gpio_set_irq_callback(&hdmi_rx_frame_isr);
-  irq_set_enabled(IO_IRQ_BANK0, true);
-  gpio_set_irq_enabled(CEC_PIN, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  if ((frame->state == HDMI_FRAME_STATE_END) || (frame->state == HDMI_FRAME_STATE_ABORT)) {
+    // as the task does before each frame
+    frame->state = HDMI_FRAME_STATE_START_LOW;
+    frame->byte = 0;
+    frame->ack = false;
+  }
+
+  uint32_t irq = save_and_disable_interrupts();
+  // the edge counts towards the bus statistics, put them back afterwards
+  cec_stats_t stats = cec_stats;
+
+  bench_mark_t start = bench_mark();
+  rx_edge(&bench_bus, now, high);
+  uint32_t cycles = bench_cycles(start);
+
+  cec_stats = stats;
+  gpio_set_irq_enabled(bench_bus.pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  restore_interrupts(irq);
+
+  return cycles;
+}
+
+void cec_bench_rx_glitch(uint16_t glitch_us) {
+  for (unsigned int i = 0; i <= CEC_TIMING_UNKNOWN; i++) {
+    bench_timing[i].glitch_us = glitch_us;
+  }
+  bench_bus.rx_frame.state = HDMI_FRAME_STATE_START_LOW;
+  bench_bus.rx_frame.byte = 0;
+  bench_bus.rx_frame.ack = false;
+}
+
+uint8_t cec_bench_rx_frame(uint8_t *pld) {
+  if (bench_bus.rx_frame.state != HDMI_FRAME_STATE_END) {
+    return 0;
+  }
+  memcpy(pld, bench_bus.rx_buffer, bench_bus.rx_message.len);
+  return bench_bus.rx_message.len;
+}
+
+uint32_t cec_bench_tx_step(void) {
+  if (bench_tx_restart) {
+    bench_tx_frame = (hdmi_frame_t){
+        .message = &bench_tx_message, .bit = 7, .state = HDMI_FRAME_STATE_START_LOW};
+  }
 
-  uint16_t paddr = ddc_get_physical_address();
-  laddr = allocate_logical_address();
+  uint32_t irq = save_and_disable_interrupts();
+  bench_mark_t start = bench_mark();
+  bench_tx_restart = (tx_step(&bench_bus) == 0);
+  uint32_t cycles = bench_cycles(start);
+  restore_interrupts(irq);
+
+  return cycles;
+}
+
+uint32_t cec_bench_keymap(uint8_t code) {
+  uint32_t irq = save_and_disable_interrupts();
+  bench_mark_t start = bench_mark();
+  const command_t *command = find_command(code);
+  bench_key = (command != NULL) ? command->key : HID_KEY_NONE;
+  uint32_t cycles = bench_cycles(start);
+  restore_interrupts(irq);
+
+  return cycles;
+}
+
+void cec_bench_stop(void) {
+  gpio_set_irq_enabled(bench_bus.pin, GPIO_IRQ_EDGE_RISE | GPIO_IRQ_EDGE_FALL, false);
+  gpio_set_dir(bench_bus.pin, GPIO_IN);
+}
+
+cec_bus_t *cec_bus_init(unsigned int index, key_ring_t *keys) {
+  static const uint8_t pins[] = {CEC_PINS};
+  cec_bus_t *bus = &cec_buses[index];
+
+  bus->index = index;
+  bus->pin = pins[index];
+  bus->keys = keys;
+  bus->rx_timing = cec_timing[index];
+  bus->rx_message.data = bus->rx_buffer;
+  bus->rx_frame.message = &bus->rx_message;
+  bus_by_pin[bus->pin] = bus;
+
+  gpio_init(bus->pin);
+  gpio_disable_pulls(bus->pin);
+  gpio_set_dir(bus->pin, GPIO_IN);
+
+  if (index == 0) {
+    // one interrupt handler for every bus, on the core running the CEC tasks
+    cec_timing_set_profile(CEC_TIMING_SPEC);
+    cec_filter_init(&filter_opcodes);
+    gpio_set_irq_callback(&hdmi_rx_frame_isr);
+    irq_set_enabled(IO_IRQ_BANK0, true);
+  }
+
+  return bus;
+}
+
+/**
+ * Wait for the line to be released and stay idle for the signal free time
+ * before joining the bus, reporting progress so a bus with the sink powered
+ * off is not taken for a stuck task.
+ */
+static void wait_line_idle(cec_bus_t *bus) {
+  while (!wait_bus_free(bus, IDLE_BITS_NEW)) {
+    progress(bus);
+  }
+}
+
+void cec_task(void *data) {
+  cec_bus_t *bus = (cec_bus_t *)data;
+
+  // the physical address follows from the DDC task when the EDID has been read
+  wait_line_idle(bus);
+  if (bus->index == 0) {
+    boot_mark(BOOT_LINE_IDLE);
+  }
+
+  cec_dispatch_init(&bus->dispatch, &dispatch_ops, bus);
+  cec_dispatch_announce(&bus->dispatch);
+  if (bus->index == 0) {
+    boot_mark(BOOT_ADDRESS);
+  }
 
   while (true) {
     uint8_t pld[16] = {0x0};
-    uint8_t pldcnt, pldcntrcvd;
-    uint8_t initiator, destination;
-    uint8_t key = HID_KEY_NONE;
-
-    pldcnt = recv_frame(pld, laddr);
-    // printf("pldcnt = %u\n", pldcnt);
-    pldcntrcvd = pldcnt;
-    initiator = (pld[0] & 0xf0) >> 4;
-    destination = pld[0] & 0x0f;
-    printf("%02x -> %02x: ", initiator, destination);
-
-    if ((pldcnt > 1)) {
-      printf("[%s]", cec_message[pld[1]]);
-      switch (pld[1]) {
-        case CEC_ID_IMAGE_VIEW_ON:
-          break;
-        case CEC_ID_TEXT_VIEW_ON:
-          break;
-        case CEC_ID_STANDBY:
-          printf("<*> [Turn the display OFF]");
-          break;
-        case CEC_ID_SYSTEM_AUDIO_MODE_REQUEST:
-          if (destination == laddr)
-            set_system_audio_mode(laddr, 0x0f, 1);
-          break;
-        case CEC_ID_GIVE_AUDIO_STATUS:
-          if (destination == laddr)
-            report_audio_status(laddr, initiator, 0x32);  // volume 50%, mute off
-          break;
-        case CEC_ID_SET_SYSTEM_AUDIO_MODE:
-          break;
-        case CEC_ID_GIVE_SYSTEM_AUDIO_MODE_STATUS:
-          if (destination == laddr)
-            system_audio_mode_status(laddr, initiator, 1);
-          break;
-        case CEC_ID_SYSTEM_AUDIO_MODE_STATUS:
-          break;
-        case CEC_ID_ROUTING_CHANGE:
-          paddr = ddc_get_physical_address();
-          image_view_on(laddr, 0x00);
-          break;
-        case CEC_ID_ACTIVE_SOURCE:
-          printf("<*> [Turn the display ON]");
-          break;
-        case CEC_ID_REPORT_PHYSICAL_ADDRESS:
-          printf("  %02x%02x", pld[2], pld[3]);
-          // On broadcast receive, do the same
-          if ((initiator == 0x00) && (destination == 0x0f)) {
-            paddr = ddc_get_physical_address();
-            laddr = allocate_logical_address();
-            if (paddr != 0x0000) {
-              report_physical_address(laddr, 0x0f, paddr, DEFAULT_TYPE);
-            }
-          }
-          break;
-        case CEC_ID_REQUEST_ACTIVE_SOURCE:
-          break;
-        case CEC_ID_SET_STREAM_PATH:
-          if (paddr != 0x0000) {
-            active_source(laddr, paddr);
-          }
-          break;
-        case CEC_ID_DEVICE_VENDOR_ID:
-          // On broadcast receive, do the same
-          if ((initiator == 0x00) && (destination == 0x0f)) {
-            device_vendor_id(laddr, 0x0f, 0x0010FA);
-          }
-          break;
-        case CEC_ID_GIVE_DEVICE_VENDOR_ID:
-          if (destination == laddr)
-            device_vendor_id(laddr, 0x0f, 0x0010FA);
-          break;
-        case CEC_ID_MENU_STATUS:
-          break;
-        case CEC_ID_GIVE_DEVICE_POWER_STATUS:
-          if (destination == laddr)
-            report_power_status(laddr, initiator, 0x00);
-          /* Hack for Google Chromecast to force it sending V+/V- if no CEC TV is present */
-          if (destination == 0)
-            report_power_status(0, initiator, 0x00);
-          break;
-        case CEC_ID_REPORT_POWER_STATUS:
-          break;
-        case CEC_ID_GET_MENU_LANGUAGE:
-          break;
-        case CEC_ID_INACTIVE_SOURCE:
-          break;
-        case CEC_ID_CEC_VERSION:
-          break;
-        case CEC_ID_GET_CEC_VERSION:
-          if (destination == laddr) {
-            report_cec_version(laddr, initiator);
-          }
-          break;
-        case CEC_ID_GIVE_OSD_NAME:
-          if (destination == laddr)
-            set_osd_name(laddr, initiator);
-          break;
-        case CEC_ID_SET_OSD_NAME:
-          break;
-        case CEC_ID_GIVE_PHYSICAL_ADDRESS:
-          if (destination == laddr && paddr != 0x0000)
-            report_physical_address(laddr, 0x0f, paddr, DEFAULT_TYPE);
-          break;
-        case CEC_ID_USER_CONTROL_PRESSED:
-          gpio_put(PICO_DEFAULT_LED_PIN, true);
-          switch (pld[2]) {
-            case 0x41:
-              printf("[User Control Volume Up]");
-              break;
-            case 0x42:
-              printf("[User Control Volume Down]");
-              break;
-            default: {
-              command_t command = keymap[pld[2]];
-              if (command.name != NULL) {
-                printf(command.name);
-                xQueueSend(*q, &command.key, pdMS_TO_TICKS(10));
-              } else {
-                printf("Unmapped command: 0x%02x\n", pld[2]);
-              }
-            }
-          }
-          break;
-        case CEC_ID_USER_CONTROL_RELEASED:
-          gpio_put(PICO_DEFAULT_LED_PIN, false);
-          key = HID_KEY_NONE;
-          xQueueSend(*q, &key, pdMS_TO_TICKS(10));
-          break;
-        case CEC_ID_ABORT:
-          printf("[Abort]");
-          break;
-        case CEC_ID_VENDOR_COMMAND_WITH_ID:
-          printf("[Vendor Command with ID]");
-          for (int i = 0; i < pldcnt; i++) {
-            printf(" %02x", pld[i]);
-          }
-          printf("\n");
-          break;
-        default:
-          if (pldcntrcvd > 1)
-            printf("???: %x", pld[1]);  // undecoded command
-          break;
-      }
-      printf("\n");
+    uint8_t pldcnt;
+
+    progress(bus);
+    void (*host)(const uint8_t *, uint8_t, bool) = (bus->index == 0) ? host_frame : NULL;
+    uint16_t ack_mask = (host != NULL) ? host_ack_mask : (1 << bus->dispatch.laddr);
+    TickType_t timeout = service(bus);
+    // a host sees all traffic, and outstanding work may wait on any frame
+    bool filter = filter_enabled && (host == NULL) && (timeout == portMAX_DELAY);
+    pldcnt = recv_frame(bus, pld, ack_mask, filter, timeout);
+    if (pldcnt == 0) {
+      continue;
+    }
+    if (xCECActivityTask != NULL) {
+      xTaskNotifyGive(xCECActivityTask);
+    }
+    if (bus->index == 0) {
+      cec_topology_seen(take_seen(bus), now_ms());
+      cec_topology_observe(pld, pldcnt, now_ms());
+      cec_transaction_receive(pld, pldcnt);
+      cec_topology_expire(now_ms());
+    }
+    if (host != NULL) {
+      host(pld, pldcnt, bus->rx_frame.ack);
     } else {
-      // single byte polling message
-      printf("[Polling Message]: 0x%01x -> 0x%01x\n", initiator, destination);
+      cec_dispatch_frame(&bus->dispatch, pld, pldcnt);
     }
   }
 }
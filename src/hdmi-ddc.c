@@ -1,10 +1,26 @@
 #include <stdio.h>
 #include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
 #include "hardware/i2c.h"
 #include "pico/stdlib.h"
 
+#include "boot-time.h"
+#include "edid.h"
 #include "hdmi-ddc.h"
 
+#define DDC_STACK_SIZE (256)
+
+/* Retry a failed read after this, doubling up to DDC_RETRY_MAX_MS. */
+#define DDC_RETRY_MS (50)
+#define DDC_RETRY_MAX_MS (2000)
+
+static TaskHandle_t xDDCTask;
+static volatile uint16_t physical_address = 0x0000;
+static void (*changed)(void);
+
 static void ddc_init() {
   i2c_init(i2c_default, 100 * 1000);
   gpio_set_function(PICO_DEFAULT_I2C_SDA_PIN, GPIO_FUNC_I2C);
@@ -17,30 +33,9 @@ static void ddc_exit() {
   i2c_deinit(i2c_default);
 }
 
-#define EDID_BLOCK_SIZE (128)
 #define EDID_I2C_TIMEOUT_US (100 * 1000)
 #define EDID_I2C_ADDR (0x50)
 #define EDID_I2C_READ_SIZE (EDID_BLOCK_SIZE * 2)
-#define EDID_CTA_DTD_START (0x02)
-#define EDID_CTA_DBC_OFFSET (0x04)
-
-const uint8_t header[8] = {0x00, 0xff, 0xff, 0xff, 0xff, 0xff, 0xff, 0x00};
-const uint8_t ctahdr[2] = {0x02, 0x03};
-const uint8_t vsbhdr[3] = {0x03, 0x0c, 0x00};
-
-/**
- * Calculate and verify EDID checksum.
- */
-static int verify(uint8_t *edid, size_t len) {
-  uint16_t cksum = 0x0000;
-
-  for (size_t i = 0; i < len; i++) {
-    printf("[%d] %02x\n", i, edid[i]);
-    cksum += edid[i];
-  }
-
-  return ((cksum & 0x00ff) == 0x00 ? PICO_ERROR_NONE : PICO_ERROR_GENERIC);
-}
 
 /**
  * Read a 256 byte block and verify the EDID block checksums.
@@ -52,7 +47,7 @@ static int read_edid_block(uint8_t *edid, size_t len) {
     return PICO_ERROR_GENERIC;
   }
 
-  if (verify(edid, len)) {
+  if (!edid_verify(edid, len)) {
     printf("Failed to verify EDID block checksum\n");
     return PICO_ERROR_GENERIC;
   }
@@ -62,89 +57,89 @@ static int read_edid_block(uint8_t *edid, size_t len) {
   return PICO_ERROR_NONE;
 }
 
-/**
- * Parse a data block and return the physical address if found.
- *
- * Returns 0x0000 if the block is not a vendor specific data block or the
- * physical address is not found.
- */
-static uint16_t find_physical_address(uint8_t *block, size_t len) {
-  if (len < 4) {
-    // Too short for Vendor Specific Data Block
-    return 0x0000;
-  }
+static bool get_physical_address(uint16_t *address) {
+  // only the DDC task reads, keep the block off its stack
+  static uint8_t edid[EDID_I2C_READ_SIZE];
 
-  if (memcmp(&block[1], vsbhdr, 3) == 0) {
-    // HDMI Licensing, LLC block
-    uint16_t addr = (block[4] << 8) | block[3];
-    printf("  physical address = %04x\n", addr);
-    return addr;
+  memset(edid, 0, sizeof(edid));
+  if (read_edid_block(edid, EDID_I2C_READ_SIZE)) {
+    return false;
   }
 
-  return 0x0000;
-}
+  *address = edid_physical_address(edid, EDID_I2C_READ_SIZE);
+  printf("  physical address = %04x\n", *address);
 
-static uint16_t get_physical_address(void) {
-  uint8_t edid[EDID_I2C_READ_SIZE] = {0};
+  return true;
+}
 
-  if (read_edid_block(edid, EDID_I2C_READ_SIZE)) {
-    return 0x0000;
-  }
+/**
+ * Read the physical address from the sink's EDID, false if the sink did not
+ * answer.
+ */
+static bool read_physical_address(uint16_t *address) {
+  uint8_t zero = 0x00;
+  bool ok = false;
 
-  if (memcmp(edid, header, 8)) {
-    // not an EDID block
-    return 0x0000;
-  }
+  ddc_init();
 
-  printf(" EDID header\n");
-  if (edid[126] == 0x00) {
-    printf("Missing CTA extensions\n");
-    return 0x0000;
+  // issue a DDC reset
+  int ret = i2c_write_timeout_us(i2c_default, EDID_I2C_ADDR, &zero, 1, true, EDID_I2C_TIMEOUT_US);
+  if (ret != 1) {
+    printf("Failed to write DDC reset\n");
+  } else {
+    ok = get_physical_address(address);
   }
+  ddc_exit();
 
-  uint8_t *cta = &edid[EDID_BLOCK_SIZE];
-  if (memcmp(cta, ctahdr, 2) == 0) {
-    // Valid CTA extension block
-    printf(" CTA Extension\n");
-    printf("    DTD start: 0x%02x\n", cta[EDID_CTA_DTD_START]);
-
-    uint8_t offset = EDID_CTA_DBC_OFFSET;
-    for (uint8_t i = offset; i < cta[EDID_CTA_DTD_START];) {
-      uint8_t *db = &cta[i];
-      uint8_t len = (db[0] & 0x1f);
-      printf("  [%u](%u) data block: %02x\n", i, len, db[0]);
-      if (len == 0x00) {
-        i++;
-        continue;
-      }
+  return ok;
+}
 
-      uint16_t addr = find_physical_address(db, len);
-      if (addr != 0x0000) {
-        return addr;
+/**
+ * Read the EDID as soon as the sink answers, then again whenever asked, so
+ * the CEC tasks never wait on the I2C bus.
+ */
+static void ddc_task(void *param) {
+  TickType_t retry_ms = DDC_RETRY_MS;
+
+  while (true) {
+    uint16_t address;
+    TickType_t wait = portMAX_DELAY;
+
+    if (read_physical_address(&address)) {
+      boot_mark(BOOT_EDID);
+      retry_ms = DDC_RETRY_MS;
+      if (address != physical_address) {
+        physical_address = address;
+        if (changed != NULL) {
+          changed();
+        }
       }
-
-      i += len + 1;  // payload + header
+    } else {
+      // sink not powered or not plugged in yet
+      wait = pdMS_TO_TICKS(retry_ms);
+      retry_ms = (retry_ms * 2 < DDC_RETRY_MAX_MS) ? (retry_ms * 2) : DDC_RETRY_MAX_MS;
     }
+
+    ulTaskNotifyTake(pdTRUE, wait);
   }
+}
 
-  return 0x0000;
+void ddc_start(void (*on_change)(void)) {
+  static StackType_t stackDDC[DDC_STACK_SIZE];
+  static StaticTask_t xDDCTCB;
+
+  changed = on_change;
+  xDDCTask = xTaskCreateStatic(ddc_task, "ddc", DDC_STACK_SIZE, NULL, 1, &stackDDC[0], &xDDCTCB);
+  // I2C waits are polled, keep them off the USB core
+  vTaskCoreAffinitySet(xDDCTask, (1 << 0));
 }
 
 uint16_t ddc_get_physical_address(void) {
-  uint8_t zero = 0x00;
-  uint16_t address = 0x0000;
-
-  ddc_init();
+  return physical_address;
+}
 
-  // issue a DDC reset
-  int ret = i2c_write_timeout_us(i2c_default, EDID_I2C_ADDR, &zero, 1, true, EDID_I2C_TIMEOUT_US);
-  if (ret != 1) {
-    printf("Failed to write DDC reset\n");
-    return 0x0000;
+void ddc_refresh(void) {
+  if (xDDCTask != NULL) {
+    xTaskNotifyGive(xDDCTask);
   }
-
-  address = get_physical_address();
-  ddc_exit();
-
-  return address;
 }
@@ -0,0 +1,157 @@
+#include <string.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+
+#include "cec-transaction.h"
+#include "hdmi-cec.h"
+#include "hid-command.h"
+
+/* Commands from the HID vendor reports.
+ *
+ * Output reports arrive in the USB task, which queues them as transactions
+ * without waiting.  Completions run in the CEC task and leave their result in
+ * a ring for the next status feature report, so neither task blocks on the
+ * other.
+ */
+
+/* Results kept for the host, a power of two. */
+#define HID_RESULTS (8)
+
+typedef struct {
+  cec_transaction_t transaction;
+  uint8_t seq;
+  bool busy;
+} command_slot_t;
+
+static command_slot_t slots[CEC_TRANSACTION_MAX];
+
+static hid_status_t results[HID_RESULTS];
+static uint32_t results_head;  // next to write
+static uint32_t results_tail;  // next to read
+
+/**
+ * Keep a result for the host, dropping the oldest if it has not kept up.
+ * Called with the critical section held.
+ */
+static hid_status_t *push_result(uint8_t seq, uint8_t status) {
+  if ((results_head - results_tail) == HID_RESULTS) {
+    results_tail++;
+  }
+  hid_status_t *result = &results[results_head++ % HID_RESULTS];
+  memset(result, 0, sizeof(*result));
+  result->seq = seq;
+  result->status = status;
+
+  return result;
+}
+
+/**
+ * Runs in the CEC task when a command's transaction completes.
+ */
+static void command_done(cec_transaction_t *transaction) {
+  command_slot_t *slot = (command_slot_t *)transaction->arg;
+
+  taskENTER_CRITICAL();
+  hid_status_t *result = push_result(slot->seq, transaction->status);
+  result->abort_reason = transaction->abort_reason;
+  result->response_len = transaction->response_len;
+  memcpy(result->response, transaction->response, transaction->response_len);
+  result->duration_us =
+      (transaction->duration_us > UINT16_MAX) ? UINT16_MAX : transaction->duration_us;
+  slot->busy = false;
+  taskEXIT_CRITICAL();
+}
+
+void hid_command_output(const uint8_t *report, uint16_t len) {
+  hid_command_t command;
+  command_slot_t *slot = NULL;
+
+  if (len < sizeof(command)) {
+    return;
+  }
+  memcpy(&command, report, sizeof(command));
+
+  // without the raw flag the header block takes one of the frame's bytes
+  uint8_t max_len = (command.flags & HID_COMMAND_RAW) ? sizeof(command.frame)
+                                                      : sizeof(command.frame) - 1;
+
+  taskENTER_CRITICAL();
+  if ((command.len == 0) || (command.len > max_len)) {
+    push_result(command.seq, HID_STATUS_INVALID);
+  } else {
+    for (unsigned int i = 0; i < CEC_TRANSACTION_MAX; i++) {
+      if (!slots[i].busy) {
+        slot = &slots[i];
+        slot->busy = true;
+        break;
+      }
+    }
+    if (slot == NULL) {
+      push_result(command.seq, CEC_TRANSACTION_BUSY);
+    }
+  }
+  taskEXIT_CRITICAL();
+
+  if (slot == NULL) {
+    return;
+  }
+
+  cec_transaction_t *transaction = &slot->transaction;
+  memset(transaction, 0, sizeof(*transaction));
+  slot->seq = command.seq;
+  transaction->destination = command.destination & 0x0f;
+  if (command.flags & HID_COMMAND_RAW) {
+    transaction->flags |= CEC_TRANSACTION_RAW;
+    transaction->destination = command.frame[0] & 0x0f;
+  }
+  if (command.flags & HID_COMMAND_ACK_ONLY) {
+    transaction->flags |= CEC_TRANSACTION_ACK_ONLY;
+  }
+  memcpy(transaction->request, command.frame, command.len);
+  transaction->request_len = command.len;
+  transaction->initiator = transaction->destination;
+  transaction->opcode = command.opcode;
+  transaction->timeout_ms =
+      (command.timeout_ms != 0) ? command.timeout_ms : HID_COMMAND_TIMEOUT_MS;
+  transaction->done = command_done;
+  transaction->arg = slot;
+
+  if (!cec_transaction_submit(transaction)) {
+    // the console or a script holds the other transactions
+    command_done(transaction);
+  }
+}
+
+uint16_t hid_command_status(uint8_t *report, uint16_t len) {
+  hid_status_t status;
+  unsigned int queued = 0;
+
+  if (len < sizeof(status)) {
+    return 0;
+  }
+
+  taskENTER_CRITICAL();
+  if (results_tail != results_head) {
+    status = results[results_tail++ % HID_RESULTS];
+  } else {
+    memset(&status, 0, sizeof(status));
+    status.status = HID_STATUS_NONE;
+  }
+  status.results = results_head - results_tail;
+  for (unsigned int i = 0; i < CEC_TRANSACTION_MAX; i++) {
+    queued += slots[i].busy ? 1 : 0;
+  }
+  taskEXIT_CRITICAL();
+
+  uint8_t laddr, power_status;
+  uint16_t paddr;
+  cec_get_status(&laddr, &paddr, &power_status);
+  status.queued = queued;
+  status.laddr = laddr;
+  status.paddr = paddr;
+  status.power_status = power_status;
+  memcpy(report, &status, sizeof(status));
+
+  return sizeof(status);
+}
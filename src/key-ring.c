@@ -0,0 +1,39 @@
+#include "key-ring.h"
+
+/* Head and tail are free running, each only written by one side.  The
+ * release store publishes the slot contents before the index moves.
+ */
+
+bool key_ring_put(key_ring_t *ring, uint8_t key) {
+  uint32_t head = ring->head;
+  uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+
+  if ((head - tail) >= KEY_RING_SIZE) {
+    return false;
+  }
+
+  ring->keys[head % KEY_RING_SIZE] = key;
+  __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+  if (ring->consumer != NULL) {
+    xTaskNotifyGive(ring->consumer);
+  }
+
+  return true;
+}
+
+bool key_ring_peek(key_ring_t *ring, uint8_t *key) {
+  uint32_t tail = ring->tail;
+  uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+
+  if (head == tail) {
+    return false;
+  }
+
+  *key = ring->keys[tail % KEY_RING_SIZE];
+  return true;
+}
+
+void key_ring_pop(key_ring_t *ring) {
+  __atomic_store_n(&ring->tail, ring->tail + 1, __ATOMIC_RELEASE);
+}
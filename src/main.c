@@ -8,7 +8,13 @@
 #include "hardware/timer.h"
 #include "pico/stdlib.h"
 
+#include "crashlog.h"
+#include "eventlog.h"
 #include "hdmi-cec.h"
+#include "hdmi-ddc.h"
+#include "key-ring.h"
+#include "recovery.h"
+#include "wakeups.h"
 #include "usb_hid.h"
 
 #define USBD_STACK_SIZE (512)
@@ -16,33 +22,35 @@
 #define CDC_STACK_SIZE (768)
 #define BLINK_STACK_SIZE (128)
 #define CEC_STACK_SIZE (512)
-#define CEC_QUEUE_LENGTH (16)
 
-void blink_task(void *param) {
-  static uint32_t blink_delay = 1000;
-  static bool state = true;
+#define BLINK_MS (50)
 
+/**
+ * Flash the LED for each CEC frame received, sleeping while the bus is idle.
+ */
+void blink_task(void *param) {
   while (true) {
-    gpio_put(PICO_DEFAULT_LED_PIN, state);
-    state = !state;
-    vTaskDelay(pdMS_TO_TICKS(blink_delay));
+    ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+    wakeups[WAKEUP_BLINK]++;
+    gpio_put(PICO_DEFAULT_LED_PIN, true);
+    vTaskDelay(pdMS_TO_TICKS(BLINK_MS));
+    gpio_put(PICO_DEFAULT_LED_PIN, false);
   }
 }
 
 void cdc_task(void *param);
 
 int main() {
-  static StaticQueue_t xStaticCECQueue;
-  static uint8_t storageCECQueue[CEC_QUEUE_LENGTH * sizeof(uint8_t)];
+  static key_ring_t keys[CEC_BUSES];
 
   static StackType_t stackBlink[BLINK_STACK_SIZE];
-  static StackType_t stackCEC[CEC_STACK_SIZE];
+  static StackType_t stackCEC[CEC_BUSES][CEC_STACK_SIZE];
   static StackType_t stackHID[HID_STACK_SIZE];
   static StackType_t stackCDC[CDC_STACK_SIZE];
   static StackType_t stackUSBD[USBD_STACK_SIZE];
 
   static StaticTask_t xBlinkTCB;
-  static StaticTask_t xCECTCB;
+  static StaticTask_t xCECTCB[CEC_BUSES];
   static StaticTask_t xHIDTCB;
   static StaticTask_t xUSBDTCB;
   static StaticTask_t xCDCTCB;
@@ -52,6 +60,9 @@ int main() {
   static TaskHandle_t xHIDTask;
   static TaskHandle_t xCDCTask;
 
+  // before anything can crash and overwrite the last record
+  crashlog_init();
+
   stdio_init_all();
   board_init();
 
@@ -60,23 +71,26 @@ int main() {
   gpio_init(PICO_DEFAULT_LED_PIN);
   gpio_set_dir(PICO_DEFAULT_LED_PIN, GPIO_OUT);
 
-  // HID key queue
-  QueueHandle_t cec_q =
-      xQueueCreateStatic(CEC_QUEUE_LENGTH, sizeof(uint8_t), &storageCECQueue[0], &xStaticCECQueue);
-
   xBlinkTask = xTaskCreateStatic(blink_task, "Blink Task", BLINK_STACK_SIZE, NULL, 1,
                                  &stackBlink[0], &xBlinkTCB);
-  xCECTask = xTaskCreateStatic(cec_task, CEC_TASK_NAME, CEC_STACK_SIZE, &cec_q,
-                               configMAX_PRIORITIES - 1, &stackCEC[0], &xCECTCB);
-  xHIDTask = xTaskCreateStatic(hid_task, "hid", HID_STACK_SIZE, &cec_q, configMAX_PRIORITIES - 2,
+  xCECActivityTask = xBlinkTask;
+  for (unsigned int i = 0; i < CEC_BUSES; i++) {
+    cec_bus_t *bus = cec_bus_init(i, &keys[i]);
+    bus->task = xTaskCreateStatic(cec_task, CEC_TASK_NAME, CEC_STACK_SIZE, bus,
+                                  configMAX_PRIORITIES - 1, &stackCEC[i][0], &xCECTCB[i]);
+    vTaskCoreAffinitySet(bus->task, (1 << 0));
+  }
+  xHIDTask = xTaskCreateStatic(hid_task, "hid", HID_STACK_SIZE, keys, configMAX_PRIORITIES - 2,
                                &stackHID[0], &xHIDTCB);
+  for (unsigned int i = 0; i < CEC_BUSES; i++) {
+    keys[i].consumer = xHIDTask;
+  }
   xUSBDTask = xTaskCreateStatic(usb_device_task, "usbd", USBD_STACK_SIZE, NULL,
                                 configMAX_PRIORITIES - 3, &stackUSBD[0], &xUSBDTCB);
   xCDCTask = xTaskCreateStatic(cdc_task, "cdc", CDC_STACK_SIZE, NULL, configMAX_PRIORITIES - 4,
                                &stackCDC[0], &xCDCTCB);
 
   // bind CEC, blink, HID and CDC to core 0
-  vTaskCoreAffinitySet(xCECTask, (1 << 0));
   vTaskCoreAffinitySet(xBlinkTask, (1 << 0));
   vTaskCoreAffinitySet(xHIDTask, (1 << 0));
   vTaskCoreAffinitySet(xCDCTask, (1 << 0));
@@ -84,6 +98,18 @@ int main() {
   // bind USBD to core 1
   vTaskCoreAffinitySet(xUSBDTask, (1 << 1));
 
+  // EDID in the background, the CEC tasks announce the address when it is read
+  ddc_start(cec_wake);
+
+#if PICO_CEC_EVENTLOG
+  // frames are logged to flash from here on
+  eventlog_start();
+#endif
+
+  recovery_watch(RECOVERY_TASK_CEC, cec_wake);
+  recovery_watch(RECOVERY_TASK_USB, usb_device_ping);
+  recovery_start();
+
   vTaskStartScheduler();
 
   return 0;
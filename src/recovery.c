@@ -0,0 +1,155 @@
+#include <stdio.h>
+
+#include "FreeRTOS.h"
+#include "task.h"
+#include "timers.h"
+
+#include "hardware/watchdog.h"
+#include "pico/time.h"
+
+#include "recovery.h"
+
+/* Watchdog supervision of the CEC and USB tasks.
+ *
+ * A timer pings each supervised task and only feeds the hardware watchdog if
+ * every task has since gone round its loop.  When one has not, the reason is
+ * left in the watchdog scratch registers and the watchdog is allowed to reset
+ * the device, the next boot adds it to the recovery log.
+ */
+
+#define SUPERVISOR_PERIOD_MS (2000)
+#define WATCHDOG_TIMEOUT_MS (5000)
+
+/* Watchdog scratch registers 0-3 are free for applications, 4-7 belong to the SDK. */
+#define SCRATCH_MAGIC (0)
+#define SCRATCH_TASK (1)
+#define SCRATCH_RESETS (2)
+#define SCRATCH_REASON (3)
+#define RECOVERY_MAGIC (0x52435652)
+
+const char *recovery_reason_name[RECOVERY_COUNT] = {
+    [RECOVERY_RX_TIMEOUT] = "rx timeout",
+    [RECOVERY_LINE_LOW] = "line low",
+    [RECOVERY_TX_BUS_BUSY] = "bus busy",
+    [RECOVERY_WATCHDOG] = "watchdog",
+    [RECOVERY_CRASH] = "crash",
+};
+
+const char *recovery_task_name[RECOVERY_TASK_COUNT] = {
+    [RECOVERY_TASK_CEC] = "cec",
+    [RECOVERY_TASK_USB] = "usb",
+};
+
+static recovery_event_t events[RECOVERY_LOG_SIZE];
+static unsigned int num_events;
+static uint32_t resets;
+
+static void (*pings[RECOVERY_TASK_COUNT])(void);
+static volatile bool watched[RECOVERY_TASK_COUNT];
+static volatile bool progress[RECOVERY_TASK_COUNT];
+static bool stalled;
+
+static void append(recovery_reason_t reason, uint32_t detail) {
+  recovery_event_t *event = &events[num_events % RECOVERY_LOG_SIZE];
+
+  event->time_ms = to_ms_since_boot(get_absolute_time());
+  event->reason = reason;
+  event->detail = detail;
+  num_events++;
+}
+
+void recovery_log(recovery_reason_t reason, uint32_t detail) {
+  taskENTER_CRITICAL();
+  append(reason, detail);
+  taskEXIT_CRITICAL();
+
+  printf("recovery: %s (%lu)\n", recovery_reason_name[reason], (unsigned long)detail);
+}
+
+bool recovery_get(unsigned int n, recovery_event_t *event) {
+  bool found = false;
+
+  taskENTER_CRITICAL();
+  if ((n < num_events) && (n < RECOVERY_LOG_SIZE)) {
+    *event = events[(num_events - 1 - n) % RECOVERY_LOG_SIZE];
+    found = true;
+  }
+  taskEXIT_CRITICAL();
+
+  return found;
+}
+
+uint32_t recovery_resets(void) {
+  return resets;
+}
+
+void recovery_reboot(recovery_reason_t reason, uint32_t detail) {
+  watchdog_hw->scratch[SCRATCH_MAGIC] = RECOVERY_MAGIC;
+  watchdog_hw->scratch[SCRATCH_REASON] = reason;
+  watchdog_hw->scratch[SCRATCH_TASK] = detail;
+  watchdog_hw->scratch[SCRATCH_RESETS] = resets + 1;
+  watchdog_reboot(0, 0, 0);
+
+  while (true) {
+    // wait for the reset
+  }
+}
+
+void recovery_watch(recovery_task_t task, void (*ping)(void)) {
+  pings[task] = ping;
+}
+
+void recovery_progress(recovery_task_t task) {
+  // tasks are only held to account once they have started their loop
+  watched[task] = true;
+  progress[task] = true;
+}
+
+static void supervise(TimerHandle_t timer) {
+  if (stalled) {
+    return;
+  }
+
+  for (unsigned int i = 0; i < RECOVERY_TASK_COUNT; i++) {
+    if (watched[i] && !progress[i]) {
+      // stop feeding and let the watchdog reset the device
+      watchdog_hw->scratch[SCRATCH_MAGIC] = RECOVERY_MAGIC;
+      watchdog_hw->scratch[SCRATCH_REASON] = RECOVERY_WATCHDOG;
+      watchdog_hw->scratch[SCRATCH_TASK] = i;
+      watchdog_hw->scratch[SCRATCH_RESETS] = resets + 1;
+      stalled = true;
+      printf("recovery: %s task stalled\n", recovery_task_name[i]);
+      return;
+    }
+  }
+
+  watchdog_update();
+
+  for (unsigned int i = 0; i < RECOVERY_TASK_COUNT; i++) {
+    progress[i] = false;
+    if (pings[i] != NULL) {
+      pings[i]();
+    }
+  }
+}
+
+void recovery_start(void) {
+  static StaticTimer_t xSupervisorTimer;
+
+  if (watchdog_caused_reboot() && (watchdog_hw->scratch[SCRATCH_MAGIC] == RECOVERY_MAGIC)
+      && (watchdog_hw->scratch[SCRATCH_REASON] < RECOVERY_COUNT)) {
+    resets = watchdog_hw->scratch[SCRATCH_RESETS];
+    append(watchdog_hw->scratch[SCRATCH_REASON], watchdog_hw->scratch[SCRATCH_TASK]);
+  } else if (!watchdog_caused_reboot()) {
+    // power on, forget resets from before
+    watchdog_hw->scratch[SCRATCH_RESETS] = 0;
+  } else {
+    resets = watchdog_hw->scratch[SCRATCH_RESETS];
+  }
+  watchdog_hw->scratch[SCRATCH_MAGIC] = 0;
+
+  TimerHandle_t timer = xTimerCreateStatic("supervisor", pdMS_TO_TICKS(SUPERVISOR_PERIOD_MS),
+                                           pdTRUE, NULL, supervise, &xSupervisorTimer);
+  xTimerStart(timer, 0);
+  watchdog_enable(WATCHDOG_TIMEOUT_MS, true);
+}
@@ -0,0 +1,68 @@
+#include <string.h>
+
+#include "hardware/structs/timer.h"
+#include "hardware/sync.h"
+#include "pico/platform.h"
+
+#include "sched-trace.h"
+
+_Static_assert((SCHED_TRACE_EVENTS & (SCHED_TRACE_EVENTS - 1)) == 0,
+               "SCHED_TRACE_EVENTS must be a power of two");
+
+/* One ring per core, only ever written by its own core with interrupts
+ * masked, so recording needs no lock.  The counts run on past the ring size,
+ * the slot is the count modulo the size.
+ */
+static sched_trace_event_t rings[NUM_CORES][SCHED_TRACE_EVENTS];
+static volatile uint32_t recorded[NUM_CORES];
+static volatile bool paused;
+
+void sched_trace_record(uint8_t type, uint8_t index, uint16_t arg) {
+  if (paused) {
+    return;
+  }
+
+  uint32_t save = save_and_disable_interrupts();
+  unsigned int core = get_core_num();
+  uint32_t n = recorded[core];
+  sched_trace_event_t *event = &rings[core][n & (SCHED_TRACE_EVENTS - 1)];
+  event->time_us = timer_hw->timerawl;
+  event->type = type;
+  event->index = index;
+  event->arg = arg;
+  recorded[core] = n + 1;
+  restore_interrupts(save);
+}
+
+void sched_trace_pause(bool p) {
+  paused = p;
+}
+
+uint32_t sched_trace_recorded(unsigned int core) {
+  return (core < NUM_CORES) ? recorded[core] : 0;
+}
+
+bool sched_trace_get(unsigned int core, uint32_t seq, sched_trace_event_t *event) {
+  if (core >= NUM_CORES) {
+    return false;
+  }
+
+  uint32_t n = recorded[core];
+  if ((seq >= n) || ((n - seq) > SCHED_TRACE_EVENTS)) {
+    return false;
+  }
+  *event = rings[core][seq & (SCHED_TRACE_EVENTS - 1)];
+
+  return true;
+}
+
+void sched_trace_clear(void) {
+  bool was = paused;
+
+  paused = true;
+  for (unsigned int core = 0; core < NUM_CORES; core++) {
+    recorded[core] = 0;
+  }
+  memset(rings, 0, sizeof(rings));
+  paused = was;
+}
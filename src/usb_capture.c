@@ -0,0 +1,109 @@
+#include "device/usbd_pvt.h"
+#include "tusb.h"
+
+#include "capture.h"
+
+/* Vendor class driver streaming the capture ring over a bulk IN endpoint.
+ *
+ * The stock vendor class copies through its own FIFO, this one passes the
+ * capture buffers to the endpoint as they are.  Mode bytes from the host
+ * arrive on the bulk OUT endpoint.
+ */
+
+static uint8_t rhport_capture;
+static uint8_t ep_in;
+static uint8_t ep_out;
+CFG_TUSB_MEM_SECTION static uint8_t out_buf[64] __attribute__((aligned(4)));
+
+/**
+ * Start sending the filled half of the ring, if the endpoint is free.
+ */
+static void send_next(void *param) {
+  (void)param;
+  uint16_t len;
+
+  if ((ep_in == 0) || usbd_edpt_busy(rhport_capture, ep_in)) {
+    return;
+  }
+
+  uint8_t *buffer = capture_take(&len);
+  if (buffer != NULL) {
+    usbd_edpt_xfer(rhport_capture, ep_in, buffer, len);
+  }
+}
+
+static void kick(bool in_isr) {
+  usbd_defer_func(send_next, NULL, in_isr);
+}
+
+static void capture_driver_init(void) {
+  capture_set_kick(kick);
+}
+
+static void capture_driver_reset(uint8_t rhport) {
+  (void)rhport;
+
+  capture_reset();
+  ep_in = 0;
+  ep_out = 0;
+}
+
+static uint16_t capture_driver_open(uint8_t rhport,
+                                    tusb_desc_interface_t const *desc_itf,
+                                    uint16_t max_len) {
+  uint16_t const len = sizeof(tusb_desc_interface_t) + 2 * sizeof(tusb_desc_endpoint_t);
+
+  TU_VERIFY(desc_itf->bInterfaceClass == TUSB_CLASS_VENDOR_SPECIFIC, 0);
+  TU_VERIFY(max_len >= len, 0);
+  TU_VERIFY(usbd_open_edpt_pair(rhport, tu_desc_next(desc_itf), 2, TUSB_XFER_BULK, &ep_out,
+                                &ep_in),
+            0);
+
+  rhport_capture = rhport;
+  usbd_edpt_xfer(rhport, ep_out, out_buf, sizeof(out_buf));
+
+  return len;
+}
+
+static bool capture_driver_control_xfer_cb(uint8_t rhport,
+                                           uint8_t stage,
+                                           tusb_control_request_t const *request) {
+  // no class requests
+  return false;
+}
+
+static bool capture_driver_xfer_cb(uint8_t rhport,
+                                   uint8_t ep_addr,
+                                   xfer_result_t result,
+                                   uint32_t xferred_bytes) {
+  if (ep_addr == ep_out) {
+    // the last mode byte written wins
+    if ((result == XFER_RESULT_SUCCESS) && (xferred_bytes > 0)) {
+      capture_set_mode(out_buf[xferred_bytes - 1]);
+    }
+    usbd_edpt_xfer(rhport, ep_out, out_buf, sizeof(out_buf));
+  } else if (ep_addr == ep_in) {
+    capture_release();
+    send_next(NULL);
+  }
+
+  return true;
+}
+
+static usbd_class_driver_t const capture_driver = {
+#if CFG_TUSB_DEBUG >= 2
+    .name = "CAPTURE",
+#endif
+    .init = capture_driver_init,
+    .reset = capture_driver_reset,
+    .open = capture_driver_open,
+    .control_xfer_cb = capture_driver_control_xfer_cb,
+    .xfer_cb = capture_driver_xfer_cb,
+    .sof = NULL,
+};
+
+// Invoked by the device stack to add application class drivers
+usbd_class_driver_t const *usbd_app_driver_get_cb(uint8_t *driver_count) {
+  *driver_count = 1;
+  return &capture_driver;
+}
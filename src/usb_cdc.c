@@ -1,18 +1,93 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
 #include <hardware/watchdog.h>
 #include <pico/bootrom.h>
+#include <pico/time.h>
 #include <tusb.h>
 
+#include "FreeRTOS.h"
+#include "queue.h"
+#include "task.h"
 #include "tclie.h"
 
+#include "bench.h"
+#include "boot-time.h"
+#include "capture.h"
+#include "cec-p8.h"
+#include "cec-script.h"
+#include "cec-stats.h"
+#include "cec-timing.h"
+#include "cec-topology.h"
+#include "cec-transaction.h"
+#include "crashlog.h"
+#include "eventlog.h"
+#include "hdmi-cec.h"
+#include "hdmi-ddc.h"
+#include "recovery.h"
+#include "sched-trace.h"
+#include "wakeups.h"
+
 #ifndef PICO_CEC_VERSION
 #define PICO_CEC_VERSION "unknown"
 #endif
 
+#ifndef PICO_CEC_BUILD_DATE
+#define PICO_CEC_BUILD_DATE (0)
+#endif
+
 #define ARRAY_SIZE(x) (sizeof(x) / sizeof((x)[0]))
 #define _ENDLINE_SEQ "\r\n"
 
+#define TELEMETRY_DEFAULT_PERIOD_MS (1000)
+
+/* Runs of each benchmark, odd so the median is a sample. */
+#define BENCH_DEFAULT_RUNS (101)
+
+/* Period of the telemetry stream, 0 when off. */
+static uint32_t telemetry_period_ms = 0;
+static uint32_t telemetry_last_ms = 0;
+
+/* Notification indices on the CDC task, cec_transact() waits on
+ * CEC_TRANSACTION_NOTIFY. */
+#define NOTIFY_CDC_RX ((UBaseType_t)0)
+#define NOTIFY_CDC_TX ((UBaseType_t)1)
+
+/* Longest wait for the host to drain the transmit FIFO. */
+#define CDC_TX_TIMEOUT_MS (10)
+
+static TaskHandle_t xCDCTask;
+
+/* Frames received while a Pulse-Eight host is attached, on their way from the
+ * CEC task. */
+typedef struct {
+  uint8_t pld[16];
+  uint8_t len;
+  bool ack;
+} p8_frame_t;
+
+#define P8_QUEUE_LENGTH (8)
+
+static cec_p8_t p8;
+static bool p8_mode = false;
+static QueueHandle_t p8_queue;
+static StaticQueue_t p8_queue_buffer;
+static uint8_t p8_queue_storage[P8_QUEUE_LENGTH * sizeof(p8_frame_t)];
+
 static void print(void *arg, const char *str) {
-  tud_cdc_write_str(str);
+  uint32_t len = strlen(str);
+
+  // flush as we go so long output is not truncated by the FIFO
+  while ((len > 0) && tud_cdc_connected()) {
+    uint32_t n = tud_cdc_write(str, len);
+    str += n;
+    len -= n;
+    if (len > 0) {
+      tud_cdc_write_flush();
+      ulTaskNotifyTakeIndexed(NOTIFY_CDC_TX, pdTRUE, pdMS_TO_TICKS(CDC_TX_TIMEOUT_MS));
+    }
+  }
 }
 
 static int exec_reboot(void *arg, int argc, const char **argv) {
@@ -32,33 +107,756 @@ static int exec_version(void *arg, int argc, const char **argv) {
   return 0;
 }
 
+static const char *power_status_name(uint8_t power_status) {
+  static const char *names[] = {"on", "standby", "->on", "->stby"};
+  return (power_status < ARRAY_SIZE(names)) ? names[power_status] : "?";
+}
+
+static const char *cec_version_name(uint8_t cec_version) {
+  switch (cec_version) {
+    case 0x04:
+      return "1.3a";
+    case 0x05:
+      return "1.4";
+    case 0x06:
+      return "2.0";
+    default:
+      return "?";
+  }
+}
+
+static int exec_devices(void *arg, int argc, const char **argv) {
+  if ((argc == 2) && (strcmp(argv[1], "scan") == 0)) {
+    cec_topology_scan();
+    print(arg, "Scanning, run 'devices' again for results."_ENDLINE_SEQ);
+    return 0;
+  }
+
+  uint32_t now = to_ms_since_boot(get_absolute_time());
+  cec_topology_expire(now);
+
+  print(arg, "LA PHYS    TYPE VENDOR PWR     VER  NAME           AGE"_ENDLINE_SEQ);
+  for (uint8_t i = 0; i < CEC_TOPOLOGY_NUM_DEVICES; i++) {
+    cec_device_t device;
+    if (!cec_topology_get(i, &device)) {
+      continue;
+    }
+
+    char paddr[8] = "-";
+    char type[4] = "-";
+    char vendor[8] = "-";
+    if (device.known & CEC_DEVICE_PHYSICAL_ADDRESS) {
+      uint16_t pa = device.physical_address;
+      snprintf(paddr, sizeof(paddr), "%x.%x.%x.%x", (pa >> 12) & 0xf, (pa >> 8) & 0xf,
+               (pa >> 4) & 0xf, pa & 0xf);
+      snprintf(type, sizeof(type), "%u", device.device_type);
+    }
+    if (device.known & CEC_DEVICE_VENDOR_ID) {
+      snprintf(vendor, sizeof(vendor), "%06lx", (unsigned long)device.vendor_id);
+    }
+
+    char line[80];
+    snprintf(line, sizeof(line), "%-2x %-7s %-4s %-6s %-7s %-4s %-14s %lus" _ENDLINE_SEQ, i, paddr,
+             type, vendor,
+             (device.known & CEC_DEVICE_POWER_STATUS) ? power_status_name(device.power_status)
+                                                      : "-",
+             (device.known & CEC_DEVICE_CEC_VERSION) ? cec_version_name(device.cec_version) : "-",
+             (device.known & CEC_DEVICE_OSD_NAME) ? device.osd_name : "-",
+             (unsigned long)((now - device.last_seen) / 1000));
+    print(arg, line);
+  }
+
+  return 0;
+}
+
+static int exec_step(void *arg, int argc, const char **argv) {
+  return cec_script_step(argc, argv, print, arg, NULL);
+}
+
+static int exec_script(void *arg, int argc, const char **argv) {
+  unsigned int n = (argc >= 3) ? strtoul(argv[2], NULL, 10) : 0;
+
+  if (argc == 1) {
+    cec_script_list(print, arg);
+    return 0;
+  } else if ((argc >= 4) && (strcmp(argv[1], "add") == 0)) {
+    if (!cec_script_add(n, argc - 3, &argv[3])) {
+      print(arg, "script full"_ENDLINE_SEQ);
+      return -1;
+    }
+    return 0;
+  } else if ((argc == 3) && (strcmp(argv[1], "clear") == 0)) {
+    cec_script_clear(n);
+    return 0;
+  } else if ((argc >= 3) && (argc <= 4) && (strcmp(argv[1], "run") == 0)) {
+    unsigned int count = (argc == 4) ? strtoul(argv[3], NULL, 10) : 1;
+    return cec_script_run(n, count, print, arg);
+  }
+
+  print(arg, "usage: script [add <n> <step>|clear <n>|run <n> [<count>]]"_ENDLINE_SEQ);
+  return -1;
+}
+
+static void print_telemetry(void *arg, uint32_t now) {
+  char line[384];
+
+  cec_stats_json(line, sizeof(line) - 2, now);
+  strcat(line, _ENDLINE_SEQ);
+  print(arg, line);
+}
+
+static int exec_telemetry(void *arg, int argc, const char **argv) {
+  uint32_t now = to_ms_since_boot(get_absolute_time());
+
+  if (argc == 1) {
+    print_telemetry(arg, now);
+    return 0;
+  } else if ((argc <= 3) && (strcmp(argv[1], "on") == 0)) {
+    unsigned long period = (argc == 3) ? strtoul(argv[2], NULL, 10) : TELEMETRY_DEFAULT_PERIOD_MS;
+    if (period >= 100) {
+      telemetry_period_ms = period;
+      telemetry_last_ms = now;
+      return 0;
+    }
+  } else if ((argc == 2) && (strcmp(argv[1], "off") == 0)) {
+    telemetry_period_ms = 0;
+    return 0;
+  }
+
+  print(arg, "usage: telemetry [on [<period_ms>]|off]"_ENDLINE_SEQ);
+  return -1;
+}
+
+static int exec_wakeups(void *arg, int argc, const char **argv) {
+  static uint32_t last[WAKEUP_COUNT];
+  static uint32_t last_ms;
+  uint32_t now = to_ms_since_boot(get_absolute_time());
+  uint32_t interval_ms = now - last_ms;
+  if (interval_ms == 0) {
+    interval_ms = 1;
+  }
+
+  print(arg, "TASK   WAKEUPS    PER SEC"_ENDLINE_SEQ);
+  for (unsigned int i = 0; i < WAKEUP_COUNT; i++) {
+    uint32_t count = wakeups[i];
+    uint32_t rate = (uint32_t)(((uint64_t)(count - last[i]) * 10000) / interval_ms);
+    char line[48];
+
+    snprintf(line, sizeof(line), "%-6s %-10lu %lu.%lu" _ENDLINE_SEQ, wakeup_task_name[i],
+             (unsigned long)count, (unsigned long)(rate / 10), (unsigned long)(rate % 10));
+    print(arg, line);
+    last[i] = count;
+  }
+  last_ms = now;
+
+  return 0;
+}
+
+static int exec_recovery(void *arg, int argc, const char **argv) {
+  char line[96];
+
+  snprintf(line, sizeof(line),
+           "watchdog resets %lu, rx timeouts %lu, line low %lu, tx bus busy %lu" _ENDLINE_SEQ,
+           (unsigned long)recovery_resets(), (unsigned long)cec_stats.rx_timeouts,
+           (unsigned long)cec_stats.line_low, (unsigned long)cec_stats.tx_bus_busy);
+  print(arg, line);
+
+  recovery_event_t event;
+  for (unsigned int i = 0; recovery_get(i, &event); i++) {
+    const char *detail = "";
+    char state[12];
+    if ((event.reason == RECOVERY_WATCHDOG) && (event.detail < RECOVERY_TASK_COUNT)) {
+      detail = recovery_task_name[event.detail];
+    } else if ((event.reason == RECOVERY_CRASH) && (event.detail < CRASHLOG_COUNT)) {
+      detail = crashlog_reason_name[event.detail];
+    } else {
+      snprintf(state, sizeof(state), "%lu", (unsigned long)event.detail);
+      detail = state;
+    }
+
+    snprintf(line, sizeof(line), "%10lu ms %-10s %s" _ENDLINE_SEQ, (unsigned long)event.time_ms,
+             recovery_reason_name[event.reason], detail);
+    print(arg, line);
+  }
+
+  return 0;
+}
+
+static void print_crashlog(void *arg, const crashlog_t *log) {
+  char line[96];
+
+  snprintf(line, sizeof(line), "%s %lu boots ago, at %lu ms" _ENDLINE_SEQ,
+           crashlog_reason_name[log->reason % CRASHLOG_COUNT], (unsigned long)log->boots,
+           (unsigned long)log->time_ms);
+  print(arg, line);
+  snprintf(line, sizeof(line), "core %lu, exception %lu, task %s" _ENDLINE_SEQ,
+           (unsigned long)log->core, (unsigned long)log->ipsr,
+           (log->task[0] != '\0') ? log->task : "-");
+  print(arg, line);
+  snprintf(line, sizeof(line), "r0  %08lx r1 %08lx r2 %08lx r3   %08lx r12 %08lx" _ENDLINE_SEQ,
+           (unsigned long)log->r0, (unsigned long)log->r1, (unsigned long)log->r2,
+           (unsigned long)log->r3, (unsigned long)log->r12);
+  print(arg, line);
+  snprintf(line, sizeof(line), "pc  %08lx lr %08lx sp %08lx xpsr %08lx" _ENDLINE_SEQ,
+           (unsigned long)log->pc, (unsigned long)log->lr, (unsigned long)log->sp,
+           (unsigned long)log->xpsr);
+  print(arg, line);
+
+  // 8 words a line, addressed from the stack pointer
+  for (uint32_t i = 0; i < log->stack_words; i += 8) {
+    int n = snprintf(line, sizeof(line), "%08lx:", (unsigned long)(log->sp + i * 4));
+    for (uint32_t j = i; (j < (i + 8)) && (j < log->stack_words); j++) {
+      n += snprintf(&line[n], sizeof(line) - n, " %08lx", (unsigned long)log->stack[j]);
+    }
+    snprintf(&line[n], sizeof(line) - n, _ENDLINE_SEQ);
+    print(arg, line);
+  }
+
+  for (uint32_t i = 0; i < log->num_frames; i++) {
+    const crashlog_frame_t *frame = &log->frames[i];
+    int n = snprintf(line, sizeof(line), "%10lu ms %u %s %-4s", (unsigned long)frame->time_ms,
+                     frame->bus, (frame->flags & CAPTURE_FLAG_TX) ? "tx" : "rx",
+                     (frame->flags & CAPTURE_FLAG_ERROR) ? "err"
+                     : (frame->flags & CAPTURE_FLAG_ACK) ? "ack"
+                                                         : "nack");
+    for (uint8_t j = 0; j < frame->len; j++) {
+      n += snprintf(&line[n], sizeof(line) - n, (j == 0) ? " %02x" : ":%02x", frame->pld[j]);
+    }
+    snprintf(&line[n], sizeof(line) - n, _ENDLINE_SEQ);
+    print(arg, line);
+  }
+
+  // in the format of 'trace dump', less the task names
+  for (unsigned int core = 0; core < NUM_CORES; core++) {
+    for (uint32_t i = 0; i < log->num_events[core]; i++) {
+      const sched_trace_event_t *event = &log->events[core][i];
+      snprintf(line, sizeof(line), "%u %lu %u %u %u" _ENDLINE_SEQ, core,
+               (unsigned long)event->time_us, event->type, event->index, event->arg);
+      print(arg, line);
+    }
+  }
+}
+
+static int exec_crashlog(void *arg, int argc, const char **argv) {
+  const crashlog_t *log = crashlog_get();
+
+  if (argc == 1) {
+    if (log == NULL) {
+      print(arg, "no crash recorded"_ENDLINE_SEQ);
+    } else {
+      print_crashlog(arg, log);
+    }
+    return 0;
+  } else if ((argc == 2) && (strcmp(argv[1], "clear") == 0)) {
+    crashlog_clear();
+    return 0;
+  }
+
+  print(arg, "usage: crashlog [clear]"_ENDLINE_SEQ);
+  return -1;
+}
+
+#if PICO_CEC_EVENTLOG
+/**
+ * Print an entry in the format of the frames in 'crashlog', after the boot.
+ */
+static void print_eventlog_entry(void *arg, const eventlog_entry_t *entry) {
+  char line[96];
+
+  int n = snprintf(line, sizeof(line), "%4lu %10lu ms ", (unsigned long)entry->boot,
+                   (unsigned long)entry->time_ms);
+  if (entry->type == EVENTLOG_ENTRY_BOOT) {
+    snprintf(&line[n], sizeof(line) - n, "boot" _ENDLINE_SEQ);
+    print(arg, line);
+    return;
+  }
+
+  n += snprintf(&line[n], sizeof(line) - n, "%u %s %-4s", entry->bus,
+                (entry->flags & CAPTURE_FLAG_TX) ? "tx" : "rx",
+                (entry->flags & CAPTURE_FLAG_ERROR) ? "err"
+                : (entry->flags & CAPTURE_FLAG_ACK) ? "ack"
+                                                    : "nack");
+  for (uint8_t i = 0; i < entry->len; i++) {
+    n += snprintf(&line[n], sizeof(line) - n, (i == 0) ? " %02x" : ":%02x", entry->pld[i]);
+  }
+  snprintf(&line[n], sizeof(line) - n, _ENDLINE_SEQ);
+  print(arg, line);
+}
+
+/**
+ * Print the log since the last clear, only the last count entries if count is
+ * not 0.
+ */
+static void print_eventlog(void *arg, unsigned long count) {
+  eventlog_cursor_t cursor;
+  eventlog_entry_t entry;
+
+  // include what is still waiting in RAM
+  eventlog_flush();
+  eventlog_first(&cursor);
+
+  if (count > 0) {
+    eventlog_cursor_t end = cursor;
+    unsigned long total = 0;
+    while (eventlog_next(&end, &entry)) {
+      total++;
+    }
+    for (; total > count; total--) {
+      eventlog_next(&cursor, &entry);
+    }
+  }
+
+  while (eventlog_next(&cursor, &entry)) {
+    print_eventlog_entry(arg, &entry);
+  }
+}
+
+static int exec_eventlog(void *arg, int argc, const char **argv) {
+  char line[128];
+
+  if (argc == 1) {
+    eventlog_info_t info;
+    eventlog_get_info(&info);
+    if (!info.enabled) {
+      print(arg, "disabled, the image reaches into the log region"_ENDLINE_SEQ);
+      return 0;
+    }
+
+    snprintf(line, sizeof(line),
+             "%lu KB at 0x%06lx, sectors written %lu, boot %lu, pending %lu bytes" _ENDLINE_SEQ,
+             (unsigned long)(EVENTLOG_SIZE / 1024), (unsigned long)info.offset,
+             (unsigned long)info.sectors, (unsigned long)info.boot, (unsigned long)info.pending);
+    print(arg, line);
+    snprintf(line, sizeof(line),
+             "records %lu, bytes %lu, pages %lu, erases %lu, dropped %lu" _ENDLINE_SEQ,
+             (unsigned long)eventlog_stats.records, (unsigned long)eventlog_stats.bytes,
+             (unsigned long)eventlog_stats.pages, (unsigned long)eventlog_stats.erases,
+             (unsigned long)eventlog_stats.dropped);
+    print(arg, line);
+    return 0;
+  } else if ((argc <= 3) && (strcmp(argv[1], "dump") == 0)) {
+    char *end = NULL;
+    unsigned long count = (argc == 3) ? strtoul(argv[2], &end, 10) : 0;
+    if ((end == NULL) || (*end == '\0')) {
+      print_eventlog(arg, count);
+      return 0;
+    }
+  } else if ((argc == 2) && (strcmp(argv[1], "clear") == 0)) {
+    eventlog_clear();
+    return 0;
+  }
+
+  print(arg, "usage: eventlog [dump [<n>]|clear]"_ENDLINE_SEQ);
+  return -1;
+}
+#endif
+
+static void print_timing(void *arg) {
+  char line[96];
+
+  snprintf(line, sizeof(line), "profile %s, glitch filter %u us, adaptive %s" _ENDLINE_SEQ,
+           cec_timing_profile_name[cec_timing_get_profile()],
+           cec_timing[0][CEC_TIMING_UNKNOWN].glitch_us, cec_timing_get_adaptive() ? "on" : "off");
+  print(arg, line);
+
+  print(arg, "BUS IN FRAMES     ERRORS START ONE  ZERO PERIOD ONE WINDOW ZERO WINDOW"_ENDLINE_SEQ);
+  for (uint8_t bus = 0; bus < CEC_BUSES; bus++) {
+    for (uint8_t i = 0; i < 16; i++) {
+      cec_timing_stats_t stats;
+      if (!cec_timing_stats(bus, i, &stats)) {
+        continue;
+      }
+
+      const cec_timing_t *timing = &cec_timing[bus][i];
+      snprintf(line, sizeof(line),
+               "%-3u %-2x %-10lu %-6lu %-5u %-4u %-4u %-6u %4u-%-5u %4u-%-5u" _ENDLINE_SEQ, bus, i,
+               (unsigned long)stats.frames, (unsigned long)stats.errors, stats.start_low,
+               stats.one_low, stats.zero_low, stats.period, timing->one_low.min,
+               timing->one_low.max, timing->zero_low.min, timing->zero_low.max);
+      print(arg, line);
+    }
+  }
+}
+
+static int exec_timing(void *arg, int argc, const char **argv) {
+  if (argc == 1) {
+    print_timing(arg);
+    return 0;
+  } else if ((argc == 3) && (strcmp(argv[1], "profile") == 0)) {
+    for (unsigned int i = 0; i < CEC_TIMING_PROFILE_COUNT; i++) {
+      if (strcmp(argv[2], cec_timing_profile_name[i]) == 0) {
+        cec_timing_set_profile(i);
+        return 0;
+      }
+    }
+  } else if ((argc == 3) && (strcmp(argv[1], "glitch") == 0)) {
+    char *end;
+    unsigned long us = strtoul(argv[2], &end, 10);
+    // stay well clear of the shortest valid pulse
+    if ((*end == '\0') && (us <= 300)) {
+      cec_timing_set_glitch(us);
+      return 0;
+    }
+  } else if ((argc == 3) && (strcmp(argv[1], "adaptive") == 0)) {
+    if ((strcmp(argv[2], "on") == 0) || (strcmp(argv[2], "off") == 0)) {
+      cec_timing_set_adaptive(strcmp(argv[2], "on") == 0);
+      return 0;
+    }
+  } else if ((argc == 2) && (strcmp(argv[1], "reset") == 0)) {
+    cec_timing_reset();
+    return 0;
+  }
+
+  print(arg, "usage: timing [profile spec|relaxed|glitch <us>|adaptive on|off|reset]"_ENDLINE_SEQ);
+  return -1;
+}
+
+static int exec_capture(void *arg, int argc, const char **argv) {
+  static const char *modes[] = {"off", "frames", "edges"};
+  char line[128];
+
+  snprintf(line, sizeof(line),
+           "mode %s, records %lu, transfers %lu, bytes %lu, flow waits %lu, overruns %lu"
+           _ENDLINE_SEQ,
+           modes[capture_get_mode()], (unsigned long)capture_stats.records,
+           (unsigned long)capture_stats.transfers, (unsigned long)capture_stats.bytes,
+           (unsigned long)capture_stats.flow_waits, (unsigned long)capture_stats.overruns);
+  print(arg, line);
+
+  return 0;
+}
+
+static int exec_boot(void *arg, int argc, const char **argv) {
+  char line[48];
+
+  for (unsigned int i = 0; i < BOOT_COUNT; i++) {
+    uint32_t ms = boot_time_ms(i);
+    if (ms > 0) {
+      snprintf(line, sizeof(line), "%-12s %6lu ms" _ENDLINE_SEQ, boot_step_name[i],
+               (unsigned long)ms);
+    } else {
+      snprintf(line, sizeof(line), "%-12s      -" _ENDLINE_SEQ, boot_step_name[i]);
+    }
+    print(arg, line);
+  }
+
+  return 0;
+}
+
+static int exec_filter(void *arg, int argc, const char **argv) {
+  char line[96];
+
+  if (argc == 1) {
+    snprintf(line, sizeof(line), "%s, dropped polls %lu, others %lu, opcodes %lu" _ENDLINE_SEQ,
+             cec_filter_enabled() ? "on" : "off", (unsigned long)cec_stats.rx_filtered_polls,
+             (unsigned long)cec_stats.rx_filtered_others,
+             (unsigned long)cec_stats.rx_filtered_opcodes);
+    print(arg, line);
+    // broadcasts, then those directed to other devices
+    for (unsigned int directed = 0; directed < 2; directed++) {
+      for (unsigned int opcode = 0; opcode < 256; opcode++) {
+        if (cec_filter_subscribed(opcode, directed)) {
+          const char *name = cec_message(opcode);
+          snprintf(line, sizeof(line), "  %02x %s%s" _ENDLINE_SEQ, opcode,
+                   (name != NULL) ? name : "?", directed ? ", directed" : "");
+          print(arg, line);
+        }
+      }
+    }
+    return 0;
+  } else if ((argc == 2) && ((strcmp(argv[1], "on") == 0) || (strcmp(argv[1], "off") == 0))) {
+    cec_filter_enable(strcmp(argv[1], "on") == 0);
+    return 0;
+  } else if (((argc == 3) || ((argc == 4) && (strcmp(argv[3], "directed") == 0)))
+             && ((strcmp(argv[1], "subscribe") == 0) || (strcmp(argv[1], "unsubscribe") == 0))) {
+    char *end;
+    unsigned long opcode = strtoul(argv[2], &end, 16);
+    if ((*end == '\0') && (opcode <= 0xff)) {
+      cec_filter_subscribe(opcode, argc == 4, strcmp(argv[1], "subscribe") == 0);
+      return 0;
+    }
+  }
+
+  print(arg, "usage: filter [on|off|subscribe <opcode> [directed]|unsubscribe <opcode> "
+             "[directed]]"_ENDLINE_SEQ);
+  return -1;
+}
+
+static int exec_bench(void *arg, int argc, const char **argv) {
+  unsigned long runs = BENCH_DEFAULT_RUNS;
+  char line[96];
+
+  if (argc == 2) {
+    char *end;
+    runs = strtoul(argv[1], &end, 10);
+    if ((*end != '\0') || (runs == 0) || (runs > 255)) {
+      print(arg, "usage: bench [<runs>]"_ENDLINE_SEQ);
+      return -1;
+    }
+  }
+  if (capture_get_mode() != CAPTURE_MODE_OFF) {
+    // the synthetic edges would be captured too
+    print(arg, "stop the capture first"_ENDLINE_SEQ);
+    return -1;
+  }
+
+  snprintf(line, sizeof(line), "version %s, built %lu, clk_sys %lu MHz" _ENDLINE_SEQ,
+           PICO_CEC_VERSION, (unsigned long)PICO_CEC_BUILD_DATE,
+           (unsigned long)(clock_get_hz(clk_sys) / 1000000));
+  print(arg, line);
+  bench_run(runs, print, arg);
+
+  return 0;
+}
+
+#if PICO_CEC_SCHED_TRACE
+#define TRACE_MAX_TASKS (16)
+
+/**
+ * Print the task names and the events of both cores, in the text format
+ * scripts/sched-trace.py reads.
+ */
+static void print_trace(void *arg) {
+  static TaskStatus_t tasks[TRACE_MAX_TASKS];
+  char line[64];
+
+  print(arg, "# pico-cec sched-trace 1"_ENDLINE_SEQ);
+  UBaseType_t count = uxTaskGetSystemState(tasks, TRACE_MAX_TASKS, NULL);
+  for (UBaseType_t i = 0; i < count; i++) {
+    snprintf(line, sizeof(line), "task %lu %s" _ENDLINE_SEQ, (unsigned long)tasks[i].xTaskNumber,
+             tasks[i].pcTaskName);
+    print(arg, line);
+  }
+
+  for (unsigned int core = 0; core < NUM_CORES; core++) {
+    uint32_t recorded = sched_trace_recorded(core);
+    uint32_t seq = (recorded > SCHED_TRACE_EVENTS) ? (recorded - SCHED_TRACE_EVENTS) : 0;
+    sched_trace_event_t event;
+
+    for (; sched_trace_get(core, seq, &event); seq++) {
+      snprintf(line, sizeof(line), "%u %lu %u %u %u" _ENDLINE_SEQ, core,
+               (unsigned long)event.time_us, event.type, event.index, event.arg);
+      print(arg, line);
+    }
+  }
+}
+
+static int exec_trace(void *arg, int argc, const char **argv) {
+  char line[96];
+
+  if (argc == 1) {
+    for (unsigned int core = 0; core < NUM_CORES; core++) {
+      uint32_t recorded = sched_trace_recorded(core);
+      uint32_t lost = (recorded > SCHED_TRACE_EVENTS) ? (recorded - SCHED_TRACE_EVENTS) : 0;
+      snprintf(line, sizeof(line), "core %u: %lu events, %lu overwritten" _ENDLINE_SEQ, core,
+               (unsigned long)recorded, (unsigned long)lost);
+      print(arg, line);
+    }
+    return 0;
+  } else if ((argc == 2) && (strcmp(argv[1], "dump") == 0)) {
+    // hold the rings still while they are printed
+    sched_trace_pause(true);
+    print_trace(arg);
+    sched_trace_pause(false);
+    return 0;
+  } else if ((argc == 2) && (strcmp(argv[1], "clear") == 0)) {
+    sched_trace_clear();
+    return 0;
+  }
+
+  print(arg, "usage: trace [dump|clear]"_ENDLINE_SEQ);
+  return -1;
+}
+#endif
+
 static const tclie_cmd_t cmds[] = {
     {"version", exec_version, "Display version.", "version"},
     {"reboot", exec_reboot, "Reboot system.", "reboot [bootsel]"},
+    {"devices", exec_devices, "Display or scan the CEC bus topology.", "devices [scan]"},
+    {"tx", exec_step, "Transmit a CEC frame, optionally waiting for a response.",
+     "tx <frame> [<opcode> [<timeout_ms>]]"},
+    {"wait", exec_step, "Wait for a CEC frame.", "wait <initiator> <opcode> [<timeout_ms>]"},
+    {"script", exec_script, "List, edit or run CEC scripts.",
+     "script [add <n> <step>|clear <n>|run <n> [<count>]]"},
+    {"telemetry", exec_telemetry, "Display or stream bus statistics as JSON.",
+     "telemetry [on [<period_ms>]|off]"},
+    {"wakeups", exec_wakeups, "Display task wakeups, rates since the last call.", "wakeups"},
+    {"recovery", exec_recovery, "Display bus recoveries and the reason for watchdog resets.",
+     "recovery"},
+    {"crashlog", exec_crashlog, "Display or clear the record of the last crash.",
+     "crashlog [clear]"},
+#if PICO_CEC_EVENTLOG
+    {"eventlog", exec_eventlog, "Display, dump or clear the frame log kept in flash.",
+     "eventlog [dump [<n>]|clear]"},
+#endif
+    {"capture", exec_capture, "Display USB bus capture counters.", "capture"},
+    {"timing", exec_timing, "Display per-initiator bit timing or set the receive tolerance.",
+     "timing [profile spec|relaxed|glitch <us>|adaptive on|off|reset]"},
+    {"boot", exec_boot, "Display the time from reset to each startup step.", "boot"},
+    {"filter", exec_filter, "Display or set the receive filter, opcodes in hex.",
+     "filter [on|off|subscribe <opcode> [directed]|unsubscribe <opcode> [directed]]"},
+    {"bench", exec_bench, "Time the firmware's hot paths on this board.", "bench [<runs>]"},
+#if PICO_CEC_SCHED_TRACE
+    {"trace", exec_trace, "Display or dump the scheduler event trace.", "trace [dump|clear]"},
+#endif
+};
+
+/**
+ * Send a frame for the host and wait for the CEC task to report it, woken on
+ * CEC_TRANSACTION_NOTIFY so the flushes that come before cannot end the wait.
+ */
+static cec_p8_tx_t p8_transmit(void *arg, const uint8_t *pld, uint8_t len) {
+  cec_transaction_t transaction = {
+      .flags = CEC_TRANSACTION_RAW | CEC_TRANSACTION_ACK_ONLY,
+      .request_len = len,
+  };
+
+  memcpy(transaction.request, pld, len);
+  switch (cec_transact(&transaction)) {
+    case CEC_TRANSACTION_OK:
+      return CEC_P8_TX_OK;
+    case CEC_TRANSACTION_NACK:
+      return CEC_P8_TX_NACK;
+    default:
+      return CEC_P8_TX_LINE;
+  }
+}
+
+static void p8_write(void *arg, const uint8_t *data, size_t len) {
+  while ((len > 0) && tud_cdc_connected()) {
+    uint32_t n = tud_cdc_write(data, len);
+    data += n;
+    len -= n;
+    if (len > 0) {
+      tud_cdc_write_flush();
+      ulTaskNotifyTakeIndexed(NOTIFY_CDC_TX, pdTRUE, pdMS_TO_TICKS(CDC_TX_TIMEOUT_MS));
+    }
+  }
+}
+
+/**
+ * Runs in the CEC task, passes a received frame to the CDC task.
+ */
+static void p8_host_frame(const uint8_t *pld, uint8_t len, bool ack) {
+  p8_frame_t frame = {.len = len, .ack = ack};
+
+  memcpy(frame.pld, pld, len);
+  if (xQueueSend(p8_queue, &frame, 0) == pdTRUE) {
+    xTaskNotifyGiveIndexed(xCDCTask, NOTIFY_CDC_RX);
+  }
+}
+
+static void p8_ack_mask(void *arg, uint16_t mask) {
+  cec_set_host(p8_host_frame, mask);
+}
+
+static uint16_t p8_physical_address(void *arg) {
+  return ddc_get_physical_address();
+}
+
+static const cec_p8_ops_t p8_ops = {
+    .transmit = p8_transmit,
+    .write = p8_write,
+    .ack_mask = p8_ack_mask,
+    .physical_address = p8_physical_address,
 };
 
+/**
+ * Hand the bus to a Pulse-Eight host, frames go to it instead of the built in
+ * protocol logic until the port is closed.
+ */
+static void p8_start(void) {
+  p8_mode = true;
+  telemetry_period_ms = 0;
+  xQueueReset(p8_queue);
+  cec_p8_init(&p8, &p8_ops, NULL, PICO_CEC_BUILD_DATE);
+  cec_set_host(p8_host_frame, 0);
+}
+
+static void p8_stop(void) {
+  p8_mode = false;
+  cec_set_host(NULL, 0);
+}
+
+/**
+ * Time until the next telemetry record is due.
+ */
+static TickType_t telemetry_timeout(uint32_t now) {
+  if (telemetry_period_ms == 0) {
+    return portMAX_DELAY;
+  }
+
+  uint32_t elapsed = now - telemetry_last_ms;
+  return (elapsed >= telemetry_period_ms) ? 0 : pdMS_TO_TICKS(telemetry_period_ms - elapsed);
+}
+
 void cdc_task(void *params) {
   (void)params;
 
   tclie_t tclie;
 
+  xCDCTask = xTaskGetCurrentTaskHandle();
+  p8_queue = xQueueCreateStatic(P8_QUEUE_LENGTH, sizeof(p8_frame_t), p8_queue_storage,
+                                &p8_queue_buffer);
   tclie_init(&tclie, print, NULL);
   tclie_reg_cmds(&tclie, cmds, ARRAY_SIZE(cmds));
 
   while (1) {
+    // sleep until input arrives or telemetry is due
+    uint32_t now = to_ms_since_boot(get_absolute_time());
+    ulTaskNotifyTakeIndexed(NOTIFY_CDC_RX, pdTRUE, telemetry_timeout(now));
+    wakeups[WAKEUP_CDC]++;
+
     // connected() check for DTR bit
     // Most but not all terminal client set this when making connection
     if (tud_cdc_connected()) {
       // There are data available
       while (tud_cdc_available()) {
         uint8_t c = tud_cdc_read_char();
-        tclie_input_char(&tclie, c);
+        if (!p8_mode && (c == CEC_P8_MSGSTART)) {
+          // no terminal sends this, it can only be a Pulse-Eight host
+          p8_start();
+        }
+        if (p8_mode) {
+          cec_p8_input(&p8, &c, 1);
+        } else {
+          tclie_input_char(&tclie, c);
+        }
+      }
+
+      p8_frame_t frame;
+      while (p8_mode && (xQueueReceive(p8_queue, &frame, 0) == pdTRUE)) {
+        cec_p8_frame(&p8, frame.pld, frame.len, frame.ack);
+      }
+
+      now = to_ms_since_boot(get_absolute_time());
+      if ((telemetry_period_ms > 0) && ((now - telemetry_last_ms) >= telemetry_period_ms)) {
+        telemetry_last_ms = now;
+        print_telemetry(NULL, now);
       }
 
       tud_cdc_write_flush();
+    } else if (p8_mode) {
+      p8_stop();
     }
+  }
+}
+
+// Invoked when CDC interface received data from host
+void tud_cdc_rx_cb(uint8_t itf) {
+  (void)itf;
 
-    vTaskDelay(1);
+  if (xCDCTask != NULL) {
+    xTaskNotifyGiveIndexed(xCDCTask, NOTIFY_CDC_RX);
+  }
+}
+
+// Invoked when a transfer to the host completes
+void tud_cdc_tx_complete_cb(uint8_t itf) {
+  (void)itf;
+
+  if (xCDCTask != NULL) {
+    xTaskNotifyGiveIndexed(xCDCTask, NOTIFY_CDC_TX);
   }
 }
 
@@ -67,10 +865,15 @@ void tud_cdc_line_state_cb(uint8_t itf, bool dtr, bool rts) {
   (void)rts;
 
   if (dtr) {
-    // Terminal connected
+    // Terminal connected, a Pulse-Eight host skips this until its first message
     tud_cdc_write_str("Connected"_ENDLINE_SEQ);
   } else {
     // Terminal disconnected
     tud_cdc_write_str("Disconnected"_ENDLINE_SEQ);
   }
+
+  // let the CDC task give the bus back if a Pulse-Eight host went away
+  if (xCDCTask != NULL) {
+    xTaskNotifyGiveIndexed(xCDCTask, NOTIFY_CDC_RX);
+  }
 }
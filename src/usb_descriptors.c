@@ -24,6 +24,7 @@
  */
 
 #include "usb_descriptors.h"
+#include "hid-command.h"
 #include "tusb.h"
 
 /* A combination of interfaces must have a unique product id, since PC will save device driver after
@@ -31,12 +32,12 @@
  * possibly cause system error on PC.
  *
  * Auto ProductID layout's Bitmap:
- *   [MSB]         HID | MSC | CDC          [LSB]
+ *   [MSB]         CAPTURE | VENDOR | MIDI | HID | MSC | CDC          [LSB]
  */
 #define _PID_MAP(itf, n) ((CFG_TUD_##itf) << (n))
 #define USB_PID                                                                        \
   (0x4000 | _PID_MAP(CDC, 0) | _PID_MAP(MSC, 1) | _PID_MAP(HID, 2) | _PID_MAP(MIDI, 3) \
-   | _PID_MAP(VENDOR, 4))
+   | _PID_MAP(VENDOR, 4) | (1 << 5))
 
 #define USB_VID 0xCafe
 #define USB_BCD 0x0200
@@ -51,6 +52,14 @@
 #define USBD_CDC_EP_IN (0x82)
 #define USBD_CDC_IN_OUT_MAX_SIZE (64)
 
+/**
+ * Capture vendor interface constants.
+ */
+#define USBD_STR_CAPTURE (0x05)
+#define USBD_CAPTURE_EP_OUT (0x03)
+#define USBD_CAPTURE_EP_IN (0x83)
+#define USBD_CAPTURE_MAX_SIZE (64)
+
 //--------------------------------------------------------------------+
 // Device Descriptors
 //--------------------------------------------------------------------+
@@ -82,7 +91,49 @@ uint8_t const *tud_descriptor_device_cb(void) {
 // HID Report Descriptor
 //--------------------------------------------------------------------+
 
-uint8_t const desc_hid_report[] = {TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(REPORT_ID_KEYBOARD))};
+/* Vendor defined collection for CEC commands from the host, the command
+ * output report queues a frame and the status feature report reads results,
+ * see hid-command.h. */
+#define DESC_HID_CEC                                                               \
+  HID_USAGE_PAGE_N(HID_USAGE_PAGE_VENDOR, 2), HID_USAGE(0x01),                     \
+      HID_COLLECTION(HID_COLLECTION_APPLICATION), HID_REPORT_ID(REPORT_ID_CEC)     \
+      HID_LOGICAL_MIN(0), HID_LOGICAL_MAX_N(0xff, 2), HID_REPORT_SIZE(8),          \
+      HID_USAGE(0x02), HID_REPORT_COUNT(sizeof(hid_command_t)),                    \
+      HID_OUTPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), HID_USAGE(0x03),         \
+      HID_REPORT_COUNT(sizeof(hid_status_t)),                                      \
+      HID_FEATURE(HID_DATA | HID_VARIABLE | HID_ABSOLUTE), HID_COLLECTION_END
+
+#if HID_NKRO
+/* N-key rollover keyboard, a modifier byte then one bit for each of the
+ * NKRO_KEYS keyboard usages. */
+uint8_t const desc_hid_report[] = {
+    HID_USAGE_PAGE(HID_USAGE_PAGE_DESKTOP),
+    HID_USAGE(HID_USAGE_DESKTOP_KEYBOARD),
+    HID_COLLECTION(HID_COLLECTION_APPLICATION),
+    HID_REPORT_ID(REPORT_ID_KEYBOARD)
+    // modifiers
+    HID_USAGE_PAGE(HID_USAGE_PAGE_KEYBOARD),
+    HID_USAGE_MIN(224),
+    HID_USAGE_MAX(231),
+    HID_LOGICAL_MIN(0),
+    HID_LOGICAL_MAX(1),
+    HID_REPORT_COUNT(8),
+    HID_REPORT_SIZE(1),
+    HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+    // key bitmap
+    HID_USAGE_MIN(0),
+    HID_USAGE_MAX(NKRO_KEYS - 1),
+    HID_LOGICAL_MIN(0),
+    HID_LOGICAL_MAX(1),
+    HID_REPORT_COUNT(NKRO_KEYS),
+    HID_REPORT_SIZE(1),
+    HID_INPUT(HID_DATA | HID_VARIABLE | HID_ABSOLUTE),
+    HID_COLLECTION_END,
+    DESC_HID_CEC};
+#else
+uint8_t const desc_hid_report[] = {TUD_HID_REPORT_DESC_KEYBOARD(HID_REPORT_ID(REPORT_ID_KEYBOARD)),
+                                   DESC_HID_CEC};
+#endif
 
 // Invoked when received GET HID REPORT DESCRIPTOR
 // Application return pointer to descriptor
@@ -96,12 +147,16 @@ uint8_t const *tud_hid_descriptor_report_cb(uint8_t instance) {
 // Configuration Descriptor
 //--------------------------------------------------------------------+
 
-enum { ITF_NUM_HID, ITF_NUM_CDC, ITF_NUM_CDC_DATA, ITF_NUM_TOTAL };
+enum { ITF_NUM_HID, ITF_NUM_CDC, ITF_NUM_CDC_DATA, ITF_NUM_CAPTURE, ITF_NUM_TOTAL };
 
-#define CONFIG_TOTAL_LEN (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + TUD_CDC_DESC_LEN)
+#define CONFIG_TOTAL_LEN \
+  (TUD_CONFIG_DESC_LEN + TUD_HID_DESC_LEN + TUD_CDC_DESC_LEN + TUD_VENDOR_DESC_LEN)
 
 #define EPNUM_HID 0x84
 
+/* Poll the keyboard every frame so a key reaches the host within 1ms. */
+#define HID_POLL_INTERVAL_MS (1)
+
 uint8_t const desc_configuration[] = {
     // Config number, interface count, string index, total length, attribute, power in mA
     TUD_CONFIG_DESCRIPTOR(1,
@@ -119,7 +174,7 @@ uint8_t const desc_configuration[] = {
                        sizeof(desc_hid_report),
                        EPNUM_HID,
                        CFG_TUD_HID_EP_BUFSIZE,
-                       5),
+                       HID_POLL_INTERVAL_MS),
 
     TUD_CDC_DESCRIPTOR(ITF_NUM_CDC,
                        USBD_STR_CDC,
@@ -127,7 +182,13 @@ uint8_t const desc_configuration[] = {
                        USBD_CDC_CMD_MAX_SIZE,
                        USBD_CDC_EP_OUT,
                        USBD_CDC_EP_IN,
-                       USBD_CDC_IN_OUT_MAX_SIZE)};
+                       USBD_CDC_IN_OUT_MAX_SIZE),
+
+    TUD_VENDOR_DESCRIPTOR(ITF_NUM_CAPTURE,
+                          USBD_STR_CAPTURE,
+                          USBD_CAPTURE_EP_OUT,
+                          USBD_CAPTURE_EP_IN,
+                          USBD_CAPTURE_MAX_SIZE)};
 
 #if TUD_OPT_HIGH_SPEED
 // Per USB specs: high speed capable device must report device_qualifier and
@@ -196,6 +257,7 @@ char const *string_desc_arr[] = {
     "TinyUSB Device",            // 2: Product
     "123456",                    // 3: Serials, should use chip ID
     "Pico-CEC Console",          // 4: stdio
+    "Pico-CEC Capture",          // 5: bus capture
 };
 
 static uint16_t _desc_str[32];
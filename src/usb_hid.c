@@ -34,10 +34,28 @@
 
 #include "bsp/board.h"
 #include "pico/stdlib.h"
+#include "device/usbd_pvt.h"
 #include "tusb.h"
 #include "usb_descriptors.h"
 
+#include "bench.h"
+#include "boot-time.h"
+#include "cec-stats.h"
+#include "hdmi-cec.h"
+#include "hid-command.h"
+#include "key-ring.h"
+#include "recovery.h"
 #include "usb_hid.h"
+#include "wakeups.h"
+
+static void usb_device_progress(void *param) {
+  recovery_progress(RECOVERY_TASK_USB);
+}
+
+void usb_device_ping(void) {
+  // runs in the device task once it has handled the events queued before it
+  usbd_defer_func(usb_device_progress, NULL, false);
+}
 
 // USB Device Driver task
 // This top level thread process all usb events and invoke callbacks
@@ -63,7 +81,9 @@ void usb_device_task(void *param) {
 //--------------------------------------------------------------------+
 
 // Invoked when device is mounted
-void tud_mount_cb(void) {}
+void tud_mount_cb(void) {
+  boot_mark(BOOT_USB_MOUNTED);
+}
 
 // Invoked when device is unmounted
 void tud_umount_cb(void) {}
@@ -82,38 +102,103 @@ void tud_resume_cb(void) {}
 // USB HID
 //--------------------------------------------------------------------+
 
-static void send_hid_report(uint8_t key) {
-  // skip if hid is not ready yet
-  if (!tud_hid_ready())
-    return;
+/* Wait for the endpoint before retrying a report, normally cut short by
+ * tud_hid_report_complete_cb(). */
+#define HID_RETRY_MS (2)
+
+static TaskHandle_t xHIDTask;
+
+static bool send_hid_report(uint8_t key) {
+  // wait if hid is not ready yet
+  if (!tud_hid_ready()) {
+    return false;
+  }
 
+#if HID_NKRO
+  // modifier byte followed by one bit per key
+  uint8_t report[1 + NKRO_KEYS / 8] = {0};
+  if ((key != HID_KEY_NONE) && (key < NKRO_KEYS)) {
+    report[1 + key / 8] |= 1 << (key % 8);
+  }
+
+  return tud_hid_report(REPORT_ID_KEYBOARD, report, sizeof(report));
+#else
   uint8_t keycode[6] = {0};
   keycode[0] = key;
 
   if (key == HID_KEY_NONE) {
-    tud_hid_keyboard_report(REPORT_ID_KEYBOARD, key, NULL);
+    return tud_hid_keyboard_report(REPORT_ID_KEYBOARD, key, NULL);
   } else {
-    tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, keycode);
+    return tud_hid_keyboard_report(REPORT_ID_KEYBOARD, 0, keycode);
+  }
+#endif
+}
+
+uint32_t usb_hid_bench_report(void) {
+  if (!tud_mounted() || tud_suspended()) {
+    return BENCH_SKIPPED;
   }
+
+  // the endpoint frees up once the previous report has been polled
+  for (unsigned int i = 0; !tud_hid_ready() && (i < HID_RETRY_MS); i++) {
+    vTaskDelay(pdMS_TO_TICKS(1));
+  }
+
+  // the USB stack takes a mutex, so this runs with interrupts enabled
+  bench_mark_t start = bench_mark();
+  bool sent = send_hid_report(HID_KEY_NONE);
+  uint32_t cycles = bench_cycles(start);
+
+  return sent ? cycles : BENCH_SKIPPED;
+}
+
+/**
+ * Find the oldest key of the first bus with one waiting.
+ */
+static key_ring_t *next_key(key_ring_t *rings, uint8_t *key) {
+  for (unsigned int i = 0; i < CEC_BUSES; i++) {
+    if (key_ring_peek(&rings[i], key)) {
+      return &rings[i];
+    }
+  }
+
+  return NULL;
 }
 
 void hid_task(void *param) {
-  QueueHandle_t *q = (QueueHandle_t *)param;
+  // one ring per bus, so each keeps a single producer
+  key_ring_t *rings = (key_ring_t *)param;
+
+  xHIDTask = xTaskGetCurrentTaskHandle();
 
   while (1) {
-    // Poll every 100ms
-    uint8_t key = HID_KEY_NONE;
-    BaseType_t r = xQueueReceive(*q, &key, pdMS_TO_TICKS(100));
-    if (r == pdTRUE) {
-      // Remote wakeup
-      if (tud_suspended()) {
-        // Wake up host if we are in suspend mode
-        // and REMOTE_WAKEUP feature is enabled by host
-        tud_remote_wakeup();
-      } else {
-        // Send the 1st of report chain, the rest will be sent by tud_hid_report_complete_cb()
-        send_hid_report(key);
+    uint8_t key;
+    key_ring_t *keys = next_key(rings, &key);
+    if (keys == NULL) {
+      // sleep until a CEC task hands over a key
+      ulTaskNotifyTake(pdTRUE, portMAX_DELAY);
+      wakeups[WAKEUP_HID]++;
+      continue;
+    }
+
+    if (tud_suspended()) {
+      // Wake up host if we are in suspend mode
+      // and REMOTE_WAKEUP feature is enabled by host
+      tud_remote_wakeup();
+      key_ring_pop(keys);
+    } else if (!tud_mounted()) {
+      // nobody to send to, do not replay stale keys later
+      cec_stats.hid_drops++;
+      key_ring_pop(keys);
+    } else if (send_hid_report(key)) {
+      if (key != HID_KEY_NONE) {
+        boot_mark(BOOT_FIRST_KEY);
       }
+      key_ring_pop(keys);
+    } else {
+      // previous report still in flight, keep the key and retry
+      ulTaskNotifyTake(pdTRUE, pdMS_TO_TICKS(HID_RETRY_MS));
+      wakeups[WAKEUP_HID]++;
     }
   }
 }
@@ -123,7 +208,12 @@ void hid_task(void *param) {
 // Note: For composite reports, report[0] is report ID
 void tud_hid_report_complete_cb(uint8_t instance, uint8_t const *report, uint16_t len) {
   (void)instance;
+  (void)report;
   (void)len;
+
+  if (xHIDTask != NULL) {
+    xTaskNotifyGive(xHIDTask);
+  }
 }
 
 // Invoked when received GET_REPORT control request
@@ -134,12 +224,12 @@ uint16_t tud_hid_get_report_cb(uint8_t instance,
                                hid_report_type_t report_type,
                                uint8_t *buffer,
                                uint16_t reqlen) {
-  // TODO not Implemented
   (void)instance;
-  (void)report_id;
-  (void)report_type;
-  (void)buffer;
-  (void)reqlen;
+
+  // results of CEC commands and the bus state, the keyboard has nothing to read
+  if ((report_type == HID_REPORT_TYPE_FEATURE) && (report_id == REPORT_ID_CEC)) {
+    return hid_command_status(buffer, reqlen);
+  }
 
   return 0;
 }
@@ -153,6 +243,11 @@ void tud_hid_set_report_cb(uint8_t instance,
                            uint16_t bufsize) {
   (void)instance;
 
+  if ((report_type == HID_REPORT_TYPE_OUTPUT) && (report_id == REPORT_ID_CEC)) {
+    hid_command_output(buffer, bufsize);
+    return;
+  }
+
   if (report_type == HID_REPORT_TYPE_OUTPUT) {
     // Set keyboard LED e.g Capslock, Numlock etc...
     if (report_id == REPORT_ID_KEYBOARD) {
@@ -0,0 +1,11 @@
+#include "wakeups.h"
+
+volatile uint32_t wakeups[WAKEUP_COUNT];
+
+const char *wakeup_task_name[WAKEUP_COUNT] = {
+    [WAKEUP_CEC] = "cec",
+    [WAKEUP_HID] = "hid",
+    [WAKEUP_CDC] = "cdc",
+    [WAKEUP_BLINK] = "blink",
+    [WAKEUP_LOG] = "log",
+};